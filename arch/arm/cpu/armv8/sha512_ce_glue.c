@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * sha512_ce_glue.c - SHA-384/SHA-512 secure hash using ARMv8.2 Crypto
+ * Extensions
+ */
+
+#include <common.h>
+#include <asm/system.h>
+#include <u-boot/sha512.h>
+
+extern void sha512_armv8_ce_process(uint64_t state[8], uint8_t const *src,
+				    uint32_t blocks);
+
+/*
+ * Unlike SHA-1 and SHA-256 the SHA-512 instructions are optional even on
+ * ARMv8.2 and later cores, so check for them before use.
+ */
+static bool sha512_ce_present(void)
+{
+	u64 isar0;
+
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r" (isar0));
+
+	return (isar0 & ID_AA64ISAR0_EL1_SHA2) >= ID_AA64ISAR0_EL1_SHA2_512;
+}
+
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks)
+{
+	if (!blocks)
+		return;
+
+	if (sha512_ce_present())
+		sha512_armv8_ce_process(ctx->state, data, blocks);
+	else
+		sha512_generic_process(ctx, data, blocks);
+}
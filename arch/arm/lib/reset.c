@@ -21,6 +21,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <irq_func.h>
@@ -34,6 +35,7 @@ __weak void reset_misc(void)
 int do_reset(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 {
 	puts ("resetting ...\n");
+	blk_flush_all();
 	flush();
 
 	disable_interrupts();
@@ -560,6 +560,7 @@ int board_late_init(void)
 	status |= env_set_hex("kernel_comp_size", KERNEL_COMP_SIZE);
 	status |= env_set_hex("scriptaddr", lmb_alloc(&lmb, SZ_4M, SZ_2M));
 	status |= env_set_hex("pxefile_addr_r", lmb_alloc(&lmb, SZ_4M, SZ_2M));
+	lmb_uninit(&lmb);
 
 	if (status)
 		log_warning("late_init: Failed to set run time variables\n");
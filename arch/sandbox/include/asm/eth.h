@@ -80,6 +80,10 @@ typedef int sandbox_eth_tx_hand_f(struct udevice *dev, void *pkt,
  * recv_packet_buffer - buffers of the packet returned as received
  * recv_packet_length - lengths of the packet returned as received
  * recv_packets - number of packets returned
+ * place - where to receive the next packet, see eth_rx_place()
+ * batch_buffer - buffers of the packets handed out by recv_batch(), swapped
+ *		  with those of the receive queue as packets are handed out
+ * batch_mem - memory for the buffers in batch_buffer at start
  * tx_handler - function to generate responses to sent packets
  * priv - a pointer to some structure a test may want to keep track of
  */
@@ -90,6 +94,9 @@ struct eth_sandbox_priv {
 	uchar * recv_packet_buffer[PKTBUFSRX];
 	int recv_packet_length[PKTBUFSRX];
 	int recv_packets;
+	struct eth_rx_place place;
+	uchar *batch_buffer[PKTBUFSRX];
+	uchar batch_mem[PKTBUFSRX][PKTSIZE_ALIGN] __aligned(PKTALIGN);
 	sandbox_eth_tx_hand_f *tx_handler;
 	void *priv;
 };
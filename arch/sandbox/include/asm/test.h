@@ -120,6 +120,38 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_flash_uas_max_queued() - get the UAS queue depth seen so far
+ *
+ * @dev:	USB flash emulator
+ * Return: largest number of UAS commands the host has had queued at once
+ */
+int sandbox_flash_uas_max_queued(struct udevice *dev);
+
+/**
+ * sandbox_flash_uas_set_fail() - make a UAS data transfer fail
+ *
+ * @dev:	USB flash emulator
+ * @count:	fail the @count'th data transfer from now, 0 for none
+ */
+void sandbox_flash_uas_set_fail(struct udevice *dev, int count);
+
+/**
+ * sandbox_flash_uas_tmfs() - get the number of task management IUs received
+ *
+ * @dev:	USB flash emulator
+ * Return: number of UAS task management functions the host has sent
+ */
+int sandbox_flash_uas_tmfs(struct udevice *dev);
+
+/**
+ * sandbox_flash_uas_streams() - get the number of bulk streams set up
+ *
+ * @dev:	USB flash emulator
+ * Return: number of streams the host has set up and not freed
+ */
+int sandbox_flash_uas_streams(struct udevice *dev);
+
 /**
  * sandbox_osd_get_mem() - get the internal memory of a sandbox OSD
  *
@@ -382,4 +414,26 @@ bool sandbox_sf_bootdev_enabled(void);
  */
 void sandbox_sf_set_enable_bootdevs(bool enable);
 
+/**
+ * sandbox_nvme_set_drop() - Make the emulated NVMe controller ignore a command
+ *
+ * @dev: NVMe controller
+ * @cmd: Number of the I/O command to ignore, counting from 1 for the next
+ *	one taken, or 0 for none
+ * @abort: true to abort the command when asked, false to refuse, so that
+ *	the controller must be reset
+ */
+void sandbox_nvme_set_drop(struct udevice *dev, uint cmd, bool abort);
+
+/**
+ * sandbox_nvme_get_stats() - Get what the emulated NVMe controller has seen
+ *
+ * @dev: NVMe controller
+ * @max_busy: Returns the largest number of I/O commands outstanding at once
+ * @aborts: Returns the number of commands aborted
+ * @resets: Returns the number of times the controller was reset
+ */
+void sandbox_nvme_get_stats(struct udevice *dev, uint *max_busy,
+			    uint *aborts, uint *resets);
+
 #endif
@@ -6,6 +6,7 @@
 
 #ifndef USE_HOSTCC
 #include <common.h>
+#include <blk.h>
 #include <bootstage.h>
 #include <cli.h>
 #include <cpu_func.h>
@@ -71,6 +72,10 @@ static inline void boot_start_lmb(struct bootm_headers *images) { }
 static int bootm_start(struct cmd_tbl *cmdtp, int flag, int argc,
 		       char *const argv[])
 {
+#ifdef CONFIG_LMB
+	/* free what the last bootm may have allocated */
+	lmb_uninit(&images.lmb);
+#endif
 	memset((void *)&images, 0, sizeof(images));
 	images.verify = env_get_yesno("verify");
 
@@ -427,9 +432,22 @@ static int bootm_load_os(struct bootm_headers *images, int boot_progress)
 
 	load_buf = map_sysmem(load, 0);
 	image_buf = map_sysmem(os.image_start, image_len);
-	err = image_decomp(os.comp, load, os.image_start, os.type,
-			   load_buf, image_buf, image_len,
-			   CONFIG_SYS_BOOTM_LEN, &load_end);
+	if (CONFIG_IS_ENABLED(FIT_STREAM_VERIFY) && images->fit_stream_os) {
+		err = fit_image_decomp_verify(images->fit_hdr_os,
+					      images->fit_noffset_os, os.comp,
+					      load, os.image_start, os.type,
+					      load_buf, image_buf, image_len,
+					      CONFIG_SYS_BOOTM_LEN, &load_end);
+		if (err == -EACCES) {
+			bootstage_error(BOOTSTAGE_ID_FIT_KERNEL_START +
+					BOOTSTAGE_SUB_HASH);
+			return err;
+		}
+	} else {
+		err = image_decomp(os.comp, load, os.image_start, os.type,
+				   load_buf, image_buf, image_len,
+				   CONFIG_SYS_BOOTM_LEN, &load_end);
+	}
 	if (err) {
 		err = handle_decomp_error(os.comp, load_end - load,
 					  CONFIG_SYS_BOOTM_LEN, err);
@@ -806,9 +824,11 @@ int do_bootm_states(struct cmd_tbl *cmdtp, int flag, int argc,
 	}
 
 	/* Now run the OS! We hope this doesn't return */
-	if (!ret && (states & BOOTM_STATE_OS_GO))
+	if (!ret && (states & BOOTM_STATE_OS_GO)) {
+		blk_flush_all();
 		ret = boot_selected_os(argc, argv, BOOTM_STATE_OS_GO,
 				images, boot_fn);
+	}
 
 	/* Deal with any fallout */
 err:
@@ -966,6 +986,8 @@ static const void *boot_get_kernel(struct cmd_tbl *cmdtp, int flag, int argc,
 #endif
 #if CONFIG_IS_ENABLED(FIT)
 	case IMAGE_FORMAT_FIT:
+		/* let bootm_load_os() check the hashes while decompressing */
+		images->fit_stream_os = IS_ENABLED(CONFIG_FIT_STREAM_VERIFY);
 		os_noffset = fit_image_load(images, img_addr,
 				&fit_uname_kernel, &fit_uname_config,
 				IH_ARCH_DEFAULT, IH_TYPE_KERNEL,
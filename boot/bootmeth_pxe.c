@@ -39,6 +39,31 @@ static int extlinux_pxe_getfile(struct pxe_context *ctx, const char *file_path,
 	return 0;
 }
 
+static int extlinux_pxe_getfiles(struct pxe_context *ctx,
+				 struct pxe_prefetch *files, int count)
+{
+	struct net_get get[PXE_PREFETCH_MAX];
+	int ret;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		get[i].proto = TFTPGET;
+		get[i].name = files[i].path;
+		get[i].addr = files[i].addr;
+	}
+	ret = net_get_files(get, count);
+	for (i = 0; i < count; i++) {
+		files[i].size = get[i].size;
+		if (get[i].size >= 0 &&
+		    (ulong)get[i].size > files[i].max_size) {
+			files[i].size = -ENOSPC;
+			ret = log_msg_ret("spc", -ENOSPC);
+		}
+	}
+
+	return ret;
+}
+
 static int extlinux_pxe_check(struct udevice *dev, struct bootflow_iter *iter)
 {
 	int ret;
@@ -151,6 +176,7 @@ static int extlinux_pxe_boot(struct udevice *dev, struct bootflow *bflow)
 			    bflow->subdir, false);
 	if (ret)
 		return log_msg_ret("ctx", -EINVAL);
+	ctx->getfiles = extlinux_pxe_getfiles;
 
 	ret = pxe_process(ctx, addr, false);
 	if (ret)
@@ -0,0 +1,255 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Checking the hashes of a compressed FIT image while decompressing it
+ *
+ * fit_image_verify() reads the whole of an image to hash it, then bootm reads
+ * it all again to decompress it. For a large kernel this means going through
+ * memory twice. Here the hashes are computed on each chunk of the compressed
+ * data just before it goes through the decompressor, so that it is only read
+ * once.
+ */
+
+#include <common.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <asm/global_data.h>
+#include <linux/libfdt.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Hash nodes checked in one pass, more than enough for real images */
+#define FIT_STREAM_MAX_HASHES	4
+
+/**
+ * struct fit_hash_stream - progressive hashes of one image
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @noffset:	Offset in @fit of the component image node
+ * @size:	Number of bytes to hash
+ * @done:	Number of bytes hashed so far
+ * @count:	Number of entries in @hash
+ * @hash:	One entry for each hash node checked
+ * @hash.noffset:	Offset of the hash node in @fit
+ * @hash.algo:	Hash algorithm of the node
+ * @hash.ctx:	Progressive hash context
+ */
+struct fit_hash_stream {
+	const void *fit;
+	int noffset;
+	ulong size;
+	ulong done;
+	int count;
+	struct {
+		int noffset;
+		struct hash_algo *algo;
+		void *ctx;
+	} hash[FIT_STREAM_MAX_HASHES];
+};
+
+/* Check whether the control FDT requires an image signature to be verified */
+static bool fit_image_key_required(void)
+{
+	const void *key_blob = gd_fdt_blob();
+	const char *required;
+	int sig_node, noffset;
+
+	if (!FIT_IMAGE_ENABLE_VERIFY || !key_blob)
+		return false;
+
+	sig_node = fdt_subnode_offset(key_blob, 0, FIT_SIG_NODENAME);
+	if (sig_node < 0)
+		return false;
+
+	fdt_for_each_subnode(noffset, key_blob, sig_node) {
+		required = fdt_getprop(key_blob, noffset, FIT_KEY_REQUIRED,
+				       NULL);
+		if (required && !strcmp(required, "image"))
+			return true;
+	}
+
+	return false;
+}
+
+bool fit_image_can_stream(const void *fit, int noffset)
+{
+	struct hash_algo *algo;
+	const char *name, *algo_name;
+	int node, hashes = 0;
+	int ignore;
+	u8 comp;
+
+	if (fit_image_get_comp(fit, noffset, &comp) || comp != IH_COMP_GZIP)
+		return false;
+
+	/* leave fit_image_verify() to report these */
+	name = fit_get_name(fit, noffset, NULL);
+	if (IS_ENABLED(CONFIG_FIT_SIGNATURE) && strchr(name, '@'))
+		return false;
+
+	if (IS_ENABLED(CONFIG_FIT_IMAGE_POST_PROCESS) ||
+	    fdt_subnode_offset(fit, noffset, FIT_CIPHER_NODENAME) >= 0 ||
+	    fit_image_key_required())
+		return false;
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		name = fit_get_name(fit, node, NULL);
+		if (!strncmp(name, FIT_SIG_NODENAME, strlen(FIT_SIG_NODENAME)))
+			return false;
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+
+		fit_image_hash_get_ignore(fit, node, &ignore);
+		if (ignore)
+			continue;
+		if (fit_image_hash_get_algo(fit, node, &algo_name) ||
+		    hash_progressive_lookup_algo(algo_name, &algo) ||
+		    algo->digest_size > FIT_MAX_HASH_LEN)
+			return false;
+		if (++hashes > FIT_STREAM_MAX_HASHES)
+			return false;
+	}
+
+	/* with nothing to check there is nothing to gain */
+	return hashes > 0;
+}
+
+static void fit_hash_stream_abort(struct fit_hash_stream *hs)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, value, FIT_MAX_HASH_LEN);
+	int i;
+
+	for (i = 0; i < hs->count; i++)
+		hs->hash[i].algo->hash_finish(hs->hash[i].algo, hs->hash[i].ctx,
+					      value, FIT_MAX_HASH_LEN);
+	hs->count = 0;
+}
+
+static int fit_hash_stream_start(struct fit_hash_stream *hs, const void *fit,
+				 int noffset, ulong size)
+{
+	struct hash_algo *algo;
+	const char *name, *algo_name;
+	int node, ignore;
+
+	hs->fit = fit;
+	hs->noffset = noffset;
+	hs->size = size;
+	hs->done = 0;
+	hs->count = 0;
+
+	fdt_for_each_subnode(node, fit, noffset) {
+		name = fit_get_name(fit, node, NULL);
+		if (strncmp(name, FIT_HASH_NODENAME, strlen(FIT_HASH_NODENAME)))
+			continue;
+		fit_image_hash_get_ignore(fit, node, &ignore);
+		if (ignore)
+			continue;
+		if (hs->count == FIT_STREAM_MAX_HASHES ||
+		    fit_image_hash_get_algo(fit, node, &algo_name) ||
+		    hash_progressive_lookup_algo(algo_name, &algo) ||
+		    algo->hash_init(algo, &hs->hash[hs->count].ctx)) {
+			fit_hash_stream_abort(hs);
+			return -EINVAL;
+		}
+		hs->hash[hs->count].noffset = node;
+		hs->hash[hs->count].algo = algo;
+		hs->count++;
+	}
+
+	return 0;
+}
+
+static int fit_hash_stream_update(void *priv, const void *buf, ulong size)
+{
+	struct fit_hash_stream *hs = priv;
+	bool last;
+	int i;
+
+	hs->done += size;
+	last = hs->done >= hs->size;
+	for (i = 0; i < hs->count; i++) {
+		if (hs->hash[i].algo->hash_update(hs->hash[i].algo,
+						  hs->hash[i].ctx, buf, size,
+						  last))
+			return -EIO;
+	}
+
+	return 0;
+}
+
+/* Finish the hashes and compare them with the values in the FIT */
+static int fit_hash_stream_check(struct fit_hash_stream *hs)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(u8, value, FIT_MAX_HASH_LEN);
+	struct hash_algo *algo;
+	u8 *fit_value;
+	int fit_value_len;
+	char *err_msg = NULL;
+	int i, node = 0;
+
+	for (i = 0; i < hs->count; i++) {
+		algo = hs->hash[i].algo;
+		node = hs->hash[i].noffset;
+		printf("%s", algo->name);
+		if (algo->hash_finish(algo, hs->hash[i].ctx, value,
+				      FIT_MAX_HASH_LEN)) {
+			err_msg = "Unsupported hash algorithm";
+		} else if (fit_image_hash_get_value(hs->fit, node, &fit_value,
+						    &fit_value_len)) {
+			err_msg = "Can't get hash value property";
+		} else if (fit_value_len != algo->digest_size) {
+			err_msg = "Bad hash value len";
+		} else if (memcmp(value, fit_value, fit_value_len)) {
+			err_msg = "Bad hash value";
+		}
+		if (err_msg) {
+			/* drop the contexts not finished yet */
+			hs->count -= i + 1;
+			memmove(hs->hash, hs->hash + i + 1,
+				hs->count * sizeof(hs->hash[0]));
+			fit_hash_stream_abort(hs);
+			printf(" error!\n%s for '%s' hash node in '%s' image node\n",
+			       err_msg, fit_get_name(hs->fit, node, NULL),
+			       fit_get_name(hs->fit, hs->noffset, NULL));
+			return -EACCES;
+		}
+		puts("+ ");
+	}
+	hs->count = 0;
+
+	return 0;
+}
+
+int fit_image_decomp_verify(const void *fit, int noffset, int comp, ulong load,
+			    ulong image_start, int type, void *load_buf,
+			    void *image_buf, ulong image_len, uint unc_len,
+			    ulong *load_end)
+{
+	struct fit_hash_stream hs;
+	int ret;
+
+	*load_end = load;
+	ret = fit_hash_stream_start(&hs, fit, noffset, image_len);
+	if (ret)
+		return ret;
+
+	ret = image_decomp_stream(comp, load, image_start, type, load_buf,
+				  image_buf, image_len, unc_len, load_end,
+				  fit_hash_stream_update, &hs);
+	if (ret) {
+		fit_hash_stream_abort(&hs);
+		return ret;
+	}
+
+	puts("   Verifying Hash Integrity ... ");
+	ret = fit_hash_stream_check(&hs);
+	if (ret) {
+		puts("Bad Data Hash\n");
+		return ret;
+	}
+	puts("OK\n");
+
+	return 0;
+}
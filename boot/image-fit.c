@@ -1155,7 +1155,7 @@ int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
  *     0, on ignore not found
  *     value, on ignore found
  */
-static int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore)
 {
 	int len;
 	int *value;
@@ -2066,6 +2066,7 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 	void *loadbuf;
 	size_t size;
 	int type_ok, os_ok;
+	bool stream = false;
 	ulong load, load_end, data, len;
 	uint8_t os, comp;
 	const char *prop_name;
@@ -2142,7 +2143,12 @@ int fit_image_load(struct bootm_headers *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/* Kernel hashes may be checked later, while decompressing */
+	if (image_type == IH_TYPE_KERNEL && images->fit_stream_os) {
+		stream = images->verify && fit_image_can_stream(fit, noffset);
+		images->fit_stream_os = stream;
+	}
+	ret = fit_image_select(fit, noffset, images->verify && !stream);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
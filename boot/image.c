@@ -533,6 +533,34 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 	return 0;
 }
 
+int image_decomp_stream(int comp, ulong load, ulong image_start, int type,
+			void *load_buf, void *image_buf, ulong image_len,
+			uint unc_len, ulong *load_end,
+			int (*update)(void *priv, const void *buf, ulong size),
+			void *priv)
+{
+	int ret;
+
+	if (comp == IH_COMP_GZIP && !tools_build() && CONFIG_IS_ENABLED(GZIP)) {
+		*load_end = load;
+		print_decomp_msg(comp, type, load == image_start);
+		ret = gunzip_stream(load_buf, unc_len, image_buf, &image_len,
+				    CHUNKSZ, update, priv);
+		if (ret)
+			return ret;
+		*load_end = load + image_len;
+
+		return 0;
+	}
+
+	ret = update(priv, image_buf, image_len);
+	if (ret)
+		return ret;
+
+	return image_decomp(comp, load, image_start, type, load_buf, image_buf,
+			    image_len, unc_len, load_end);
+}
+
 const table_entry_t *get_table_entry(const table_entry_t *table, int id)
 {
 	for (; table->id >= 0; ++table) {
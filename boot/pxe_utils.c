@@ -83,6 +83,57 @@ int format_mac_pxe(char *outbuf, size_t outbuf_len)
 	return 1;
 }
 
+/*
+ * Join a path relative to the PXE file with the bootfile path, into @relfile
+ * which has room for MAX_TFTP_PATH_LEN characters
+ */
+static int get_relpath(struct pxe_context *ctx, const char *file_path,
+		       char *relfile)
+{
+	size_t path_len;
+
+	if (file_path[0] == '/' && ctx->allow_abs_path)
+		*relfile = '\0';
+	else
+		strncpy(relfile, ctx->bootdir, MAX_TFTP_PATH_LEN);
+
+	path_len = strlen(file_path) + strlen(relfile);
+
+	if (path_len > MAX_TFTP_PATH_LEN) {
+		printf("Base path too long (%s%s)\n", relfile, file_path);
+
+		return -ENAMETOOLONG;
+	}
+
+	strcat(relfile, file_path);
+
+	return 0;
+}
+
+/*
+ * Take the file from those fetched ahead, if it is there. Returns its size,
+ * -ENOSPC if it did not fit at its address, or -ENOENT if it has to be read.
+ */
+static long get_prefetched(struct pxe_context *ctx, const char *relfile,
+			   unsigned long file_addr)
+{
+	struct pxe_prefetch *pf;
+	int i;
+
+	for (i = 0; i < ctx->prefetch_count; i++) {
+		pf = &ctx->prefetch[i];
+		if (pf->path && (pf->size >= 0 || pf->size == -ENOSPC) &&
+		    pf->addr == file_addr && !strcmp(pf->path, relfile)) {
+			/* it is only good until something else goes there */
+			free(pf->path);
+			pf->path = NULL;
+			return pf->size;
+		}
+	}
+
+	return -ENOENT;
+}
+
 /**
  * get_relfile() - read a file relative to the PXE file
  *
@@ -100,38 +151,105 @@ int format_mac_pxe(char *outbuf, size_t outbuf_len)
 static int get_relfile(struct pxe_context *ctx, const char *file_path,
 		       unsigned long file_addr, ulong *filesizep)
 {
-	size_t path_len;
 	char relfile[MAX_TFTP_PATH_LEN + 1];
 	char addr_buf[18];
 	ulong size;
-	int ret;
+	long ret;
 
-	if (file_path[0] == '/' && ctx->allow_abs_path)
-		*relfile = '\0';
-	else
-		strncpy(relfile, ctx->bootdir, MAX_TFTP_PATH_LEN);
+	ret = get_relpath(ctx, file_path, relfile);
+	if (ret)
+		return ret;
 
-	path_len = strlen(file_path) + strlen(relfile);
-
-	if (path_len > MAX_TFTP_PATH_LEN) {
-		printf("Base path too long (%s%s)\n", relfile, file_path);
+	printf("Retrieving file: %s\n", relfile);
 
-		return -ENAMETOOLONG;
+	ret = get_prefetched(ctx, relfile, file_addr);
+	if (ret == -ENOSPC)
+		return log_msg_ret("spc", ret);
+	if (ret >= 0) {
+		size = ret;
+	} else {
+		sprintf(addr_buf, "%lx", file_addr);
+
+		ret = ctx->getfile(ctx, relfile, addr_buf, &size);
+		if (ret < 0)
+			return log_msg_ret("get", ret);
 	}
+	if (filesizep)
+		*filesizep = size;
 
-	strcat(relfile, file_path);
+	return 1;
+}
 
-	printf("Retrieving file: %s\n", relfile);
+static void prefetch_clear(struct pxe_context *ctx)
+{
+	int i;
 
-	sprintf(addr_buf, "%lx", file_addr);
+	for (i = 0; i < ctx->prefetch_count; i++)
+		free(ctx->prefetch[i].path);
+	ctx->prefetch_count = 0;
+}
 
-	ret = ctx->getfile(ctx, relfile, addr_buf, &size);
-	if (ret < 0)
-		return log_msg_ret("get", ret);
-	if (filesizep)
-		*filesizep = size;
+/* Add a file to be fetched ahead to the address in an env var */
+static void prefetch_add(struct pxe_context *ctx, const char *file_path,
+			 const char *envaddr_name)
+{
+	struct pxe_prefetch *pf = &ctx->prefetch[ctx->prefetch_count];
+	char relfile[MAX_TFTP_PATH_LEN + 1];
+	char *envaddr;
 
-	return 1;
+	envaddr = env_get(envaddr_name);
+	if (!envaddr || strict_strtoul(envaddr, 16, &pf->addr) < 0)
+		return;
+	if (get_relpath(ctx, file_path, relfile))
+		return;
+
+	pf->path = strdup(relfile);
+	pf->max_size = ULONG_MAX;
+	pf->size = -ENOENT;
+	if (pf->path)
+		ctx->prefetch_count++;
+}
+
+/**
+ * label_prefetch() - fetch the kernel, initrd and FDT of a label in a row
+ *
+ * This uses getfiles(), if the context has one, so that the files are read one
+ * after the other in a single network session. Those which cannot be fetched like this are read one at a time as
+ * usual later on.
+ *
+ * @ctx: PXE context
+ * @label: Label to boot
+ */
+static void label_prefetch(struct pxe_context *ctx, struct pxe_label *label)
+{
+	struct pxe_prefetch *pf, *next;
+
+	if (!ctx->getfiles)
+		return;
+
+	prefetch_clear(ctx);
+	prefetch_add(ctx, label->kernel, "kernel_addr_r");
+	if (label->initrd && strcmp(label->kernel_label, label->initrd))
+		prefetch_add(ctx, label->initrd, "ramdisk_addr_r");
+	if (label->fdt && strcmp(label->kernel_label, label->fdt))
+		prefetch_add(ctx, label->fdt, "fdt_addr_r");
+
+	/* each file must stop short of the next one up, which is also loaded */
+	for (pf = ctx->prefetch; pf < ctx->prefetch + ctx->prefetch_count;
+	     pf++) {
+		for (next = ctx->prefetch;
+		     next < ctx->prefetch + ctx->prefetch_count; next++) {
+			if (next->addr > pf->addr)
+				pf->max_size = min(pf->max_size,
+						   next->addr - pf->addr);
+		}
+	}
+
+	/* there is nothing to gain with a single file */
+	if (ctx->prefetch_count > 1)
+		ctx->getfiles(ctx, ctx->prefetch, ctx->prefetch_count);
+	else
+		prefetch_clear(ctx);
 }
 
 /**
@@ -522,6 +640,8 @@ static int label_boot(struct pxe_context *ctx, struct pxe_label *label)
 		return 1;
 	}
 
+	label_prefetch(ctx, label);
+
 	if (get_relfile_envaddr(ctx, label->kernel, "kernel_addr_r",
 				NULL) < 0) {
 		printf("Skipping %s for failure retrieving kernel\n",
@@ -1609,6 +1729,7 @@ int pxe_setup_ctx(struct pxe_context *ctx, struct cmd_tbl *cmdtp,
 
 void pxe_destroy_ctx(struct pxe_context *ctx)
 {
+	prefetch_clear(ctx);
 	free(ctx->bootdir);
 }
 
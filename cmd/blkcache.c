@@ -17,33 +17,80 @@ static int blkc_show(struct cmd_tbl *cmdtp, int flag,
 	blkcache_stats(&stats);
 
 	printf("hits: %u\n"
+	       "partial hits: %u\n"
 	       "misses: %u\n"
+	       "evictions: %u\n"
 	       "entries: %u\n"
+	       "size: %lu\n"
 	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max size: %lu\n",
+	       stats.hits, stats.partial_hits, stats.misses, stats.evictions,
+	       stats.entries, stats.bytes, stats.max_blocks_per_entry,
+	       stats.max_bytes);
 	return 0;
 }
 
 static int blkc_configure(struct cmd_tbl *cmdtp, int flag,
 			  int argc, char *const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
+	unsigned blocks_per_entry;
+	ulong max_bytes;
 	if (argc != 3)
 		return CMD_RET_USAGE;
 
 	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_bytes = simple_strtoul(argv[2], 0, 0);
+	blkcache_configure(blocks_per_entry, max_bytes);
+	printf("changed to max of %lu bytes, %u blocks per entry\n",
+	       max_bytes, blocks_per_entry);
+	return 0;
+}
+
+static int blkc_policy(struct cmd_tbl *cmdtp, int flag,
+		       int argc, char *const argv[])
+{
+	struct blk_desc *desc;
+	unsigned int max_blocks;
+
+	if (argc != 3 && argc != 4)
+		return CMD_RET_USAGE;
+
+	desc = blk_get_devnum_by_uclass_idname(argv[1],
+					       simple_strtoul(argv[2], 0, 0));
+	if (!desc) {
+		printf("No such device %s %s\n", argv[1], argv[2]);
+		return CMD_RET_FAILURE;
+	}
+
+	if (argc == 3) {
+		max_blocks = blkcache_get_policy(desc->uclass_id,
+						 desc->devnum);
+		if (max_blocks == BLKCACHE_DEFAULT)
+			printf("default\n");
+		else if (!max_blocks)
+			printf("off\n");
+		else
+			printf("max blocks/entry: %u\n", max_blocks);
+		return 0;
+	}
+
+	if (!strcmp(argv[3], "default"))
+		max_blocks = BLKCACHE_DEFAULT;
+	else if (!strcmp(argv[3], "off"))
+		max_blocks = 0;
+	else
+		max_blocks = simple_strtoul(argv[3], 0, 0);
+
+	if (blkcache_set_policy(desc->uclass_id, desc->devnum, max_blocks))
+		return CMD_RET_FAILURE;
+
 	return 0;
 }
 
 static struct cmd_tbl cmd_blkc_sub[] = {
 	U_BOOT_CMD_MKENT(show, 0, 0, blkc_show, "", ""),
 	U_BOOT_CMD_MKENT(configure, 3, 0, blkc_configure, "", ""),
+	U_BOOT_CMD_MKENT(policy, 4, 0, blkc_policy, "", ""),
 };
 
 static __maybe_unused void blkc_reloc(void)
@@ -80,9 +127,11 @@ static int do_blkcache(struct cmd_tbl *cmdtp, int flag,
 }
 
 U_BOOT_CMD(
-	blkcache, 4, 0, do_blkcache,
+	blkcache, 5, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure <blocks> <entries> "
-	"- set max blocks per entry and max cache entries\n"
+	"blkcache configure <blocks> <size> "
+	"- set max blocks per entry and max cache size in bytes\n"
+	"blkcache policy <interface> <dev> [default|off|<blocks>] "
+	"- show or set the cache policy of a device\n"
 );
@@ -20,6 +20,14 @@ static int do_hash(struct cmd_tbl *cmdtp, int flag, int argc,
 	char *s;
 	int flags = HASH_FLAG_ENV;
 
+	if (IS_ENABLED(CONFIG_CMD_HASH_BENCH) && argc == 5 &&
+	    !strcmp(argv[1], "bench")) {
+		if (hash_bench(strcmp(argv[2], "all") ? argv[2] : NULL,
+			       hextoul(argv[3], NULL), hextoul(argv[4], NULL)))
+			return CMD_RET_FAILURE;
+		return 0;
+	}
+
 #ifdef CONFIG_HASH_VERIFY
 	if (argc < 4)
 		return CMD_RET_USAGE;
@@ -53,4 +61,8 @@ U_BOOT_CMD(
 		"    - verify message digest of memory area to immediate value, \n"
 		"      env var or *address"
 #endif
+#ifdef CONFIG_CMD_HASH_BENCH
+	"\nhash bench algorithm|all address count\n"
+		"    - time message digests of memory area"
+#endif
 );
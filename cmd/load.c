@@ -153,6 +153,7 @@ static ulong load_serial(long offset)
 	ulong	start_addr = ~0;
 	ulong	end_addr   =  0;
 	int	line_count =  0;
+	ulong	result = ~0;			/* Download aborted		*/
 	long ret;
 
 	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
@@ -161,7 +162,7 @@ static ulong load_serial(long offset)
 		type = srec_decode(record, &binlen, &addr, binbuf);
 
 		if (type < 0) {
-			return (~0);		/* Invalid S-Record		*/
+			goto out;		/* Invalid S-Record		*/
 		}
 
 		switch (type) {
@@ -176,7 +177,7 @@ static ulong load_serial(long offset)
 			rc = flash_write((char *)binbuf,store_addr,binlen);
 			if (rc != 0) {
 				flash_perror(rc);
-				return (~0);
+				goto out;
 			}
 		    } else
 #endif
@@ -185,7 +186,8 @@ static ulong load_serial(long offset)
 			if (ret) {
 				printf("\nCannot overwrite reserved area (%08lx..%08lx)\n",
 					store_addr, store_addr + binlen);
-				return ret;
+				result = ret;
+				goto out;
 			}
 			memcpy((char *)(store_addr), binbuf, binlen);
 			lmb_free(&lmb, store_addr, binlen);
@@ -208,7 +210,8 @@ static ulong load_serial(long offset)
 		    );
 		    flush_cache(start_addr, size);
 		    env_set_hex("filesize", size);
-		    return (addr);
+		    result = addr;
+		    goto out;
 		case SREC_START:
 		    break;
 		default:
@@ -220,7 +223,10 @@ static ulong load_serial(long offset)
 		}
 	}
 
-	return (~0);			/* Download aborted		*/
+out:
+	lmb_uninit(&lmb);
+
+	return result;
 }
 
 static int read_record(char *buf, ulong len)
@@ -16,6 +16,7 @@
 #include <env.h>
 #include <image.h>
 #include <log.h>
+#include <malloc.h>
 #include <net.h>
 #include <net6.h>
 #include <net/udp.h>
@@ -207,6 +208,106 @@ U_BOOT_CMD(
 );
 #endif
 
+#if defined(CONFIG_CMD_NETGET)
+/* Most files that one netget command fetches */
+#define NETGET_MAX_FILES	8
+
+/*
+ * Turn a tftp:// or http:// URL into the protocol and the file name that the
+ * tftpboot or wget command takes. Anything else is a TFTP file name.
+ */
+static int netget_parse(const char *arg, struct net_get *get)
+{
+	const char *host, *slash;
+	char *name;
+
+	get->proto = TFTPGET;
+	if (!strncmp(arg, "http://", 7))
+		get->proto = WGET;
+	else if (strncmp(arg, "tftp://", 7))
+		get->name = arg;
+
+	if ((get->proto == WGET && !IS_ENABLED(CONFIG_CMD_WGET)) ||
+	    (get->proto == TFTPGET && !IS_ENABLED(CONFIG_CMD_TFTPBOOT))) {
+		printf("%s: protocol not supported\n", arg);
+		return -EPROTONOSUPPORT;
+	}
+	if (get->name)
+		return 0;
+
+	host = arg + 7;
+	slash = strchr(host, '/');
+	if (!slash || slash == host) {
+		printf("%s: no server given\n", arg);
+		return -EINVAL;
+	}
+	name = malloc(strlen(host) + 2);
+	if (!name)
+		return -ENOMEM;
+
+	/* HTTP wants the path from the root, TFTP takes it as it is */
+	sprintf(name, "%.*s:%s", (int)(slash - host), host,
+		get->proto == WGET ? slash : slash + 1);
+	get->name = name;
+
+	return 0;
+}
+
+static int do_netget(struct cmd_tbl *cmdtp, int flag, int argc,
+		     char *const argv[])
+{
+	struct net_get files[NETGET_MAX_FILES] = {};
+	int count = argc / 2;
+	char *end;
+	int ret;
+	int i;
+
+	if (argc < 3 || !(argc & 1) || count > NETGET_MAX_FILES)
+		return CMD_RET_USAGE;
+
+	for (i = 0, ret = 0; i < count && !ret; i++) {
+		files[i].addr = hextoul(argv[1 + 2 * i], &end);
+		if (*end)
+			ret = CMD_RET_USAGE;
+		else if (netget_parse(argv[2 + 2 * i], &files[i]))
+			ret = CMD_RET_FAILURE;
+	}
+
+	if (!ret) {
+		bootstage_mark_name(BOOTSTAGE_KERNELREAD_START,
+				    "netget_start");
+		if (net_get_files(files, count))
+			ret = CMD_RET_FAILURE;
+		bootstage_mark_name(BOOTSTAGE_KERNELREAD_STOP, "netget_done");
+
+		for (i = 0; i < count; i++) {
+			if (files[i].size < 0)
+				printf("%s: failed (%ld)\n", argv[2 + 2 * i],
+				       files[i].size);
+			else
+				printf("%s: %ld bytes at %lx\n",
+				       argv[2 + 2 * i], files[i].size,
+				       files[i].addr);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (files[i].name != argv[2 + 2 * i])
+			free((char *)files[i].name);
+	}
+
+	return ret;
+}
+
+U_BOOT_CMD(
+	netget,	1 + 2 * NETGET_MAX_FILES,	1,	do_netget,
+	"fetch several files over TFTP and/or HTTP in one session",
+	"address file [address file ...]\n"
+	"    - fetch each file to its address. A file is given as\n"
+	"      tftp://server/path, http://server/path or [server:]path for TFTP"
+);
+#endif
+
 static void netboot_update_env(void)
 {
 	char tmp[46];
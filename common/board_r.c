@@ -241,6 +241,13 @@ static int initr_dm(void)
 	gd->dm_root = NULL;
 #ifdef CONFIG_TIMER
 	gd->timer = NULL;
+#endif
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/* the index is in the pre-relocation malloc() area */
+	gd->dm_compat = NULL;
+#endif
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	gd->uclass_index = NULL;
 #endif
 	bootstage_start(BOOTSTAGE_ID_ACCUM_DM_R, "dm_r");
 	ret = dm_init_and_scan(false);
@@ -633,6 +633,13 @@ void mem_malloc_init(ulong start, ulong size)
 	      mem_malloc_end);
 #ifdef CONFIG_SYS_MALLOC_CLEAR_ON_INIT
 	memset((void *)mem_malloc_start, 0x0, size);
+#endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SLAB)
+	/* small objects come from the top of the area, if there is room */
+	if (size >= 2 * CONFIG_SYS_MALLOC_SLAB_LEN) {
+		mem_malloc_end -= CONFIG_SYS_MALLOC_SLAB_LEN;
+		malloc_slab_init(mem_malloc_end, CONFIG_SYS_MALLOC_SLAB_LEN);
+	}
 #endif
 	malloc_bin_reloc();
 }
@@ -1285,9 +1292,9 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 */
 
 #if __STD_C
-Void_t* mALLOc(size_t bytes)
+static Void_t* malloc_core(size_t bytes)
 #else
-Void_t* mALLOc(bytes) size_t bytes;
+static Void_t* malloc_core(bytes) size_t bytes;
 #endif
 {
   mchunkptr victim;                  /* inspected/selected chunk */
@@ -1544,6 +1551,44 @@ Void_t* mALLOc(bytes) size_t bytes;
 
 }
 
+/*
+ * Serve a small request from the slabs, honouring malloc_enable_testing().
+ * This returns NULL if the slabs cannot serve it, so the caller can use a
+ * chunk instead.
+ */
+static void *malloc_slab(size_t bytes)
+{
+	void *mem;
+
+	if (!CONFIG_IS_ENABLED(SYS_MALLOC_SLAB) ||
+	    !(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return NULL;
+	if (CONFIG_IS_ENABLED(UNIT_TEST) && malloc_testing &&
+	    malloc_max_allocs <= 0)
+		return NULL;
+
+	mem = malloc_slab_alloc(bytes);
+	if (!mem)
+		return NULL;
+	if (CONFIG_IS_ENABLED(UNIT_TEST) && malloc_testing)
+		malloc_max_allocs--;
+	/* slab objects have no header, so no red zone either */
+	VALGRIND_MALLOCLIKE_BLOCK(mem, bytes, 0, false);
+
+	return mem;
+}
+
+/*
+ * The public malloc(). Callers in this file which need a chunk, so that they
+ * can work on its header, use malloc_core() instead.
+ */
+Void_t *mALLOc(size_t bytes)
+{
+	void *mem = malloc_slab(bytes);
+
+	return mem ? mem : malloc_core(bytes);
+}
+
 
 
 
@@ -1597,6 +1642,11 @@ void fREe(mem) Void_t* mem;
   if (mem == NULL)                              /* free(0) has no effect */
     return;
 
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_SLAB) && malloc_slab_free(mem)) {
+		VALGRIND_FREELIKE_BLOCK(mem, 0);
+		return;
+	}
+
   p = mem2chunk(mem);
   hd = p->size;
 
@@ -1756,6 +1806,23 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 	}
 #endif
 
+	/* a slab object cannot grow in place */
+	oldsize = CONFIG_IS_ENABLED(SYS_MALLOC_SLAB) ?
+		malloc_slab_usable_size(oldmem) : 0;
+	if (oldsize) {
+		if (bytes <= oldsize) {
+			VALGRIND_RESIZEINPLACE_BLOCK(oldmem, 0, bytes, 0);
+			VALGRIND_MAKE_MEM_DEFINED(oldmem, bytes);
+			return oldmem;
+		}
+		newmem = mALLOc(bytes);
+		if (!newmem)
+			return NULL;
+		memcpy(newmem, oldmem, oldsize);
+		fREe(oldmem);
+		return newmem;
+	}
+
   newp    = oldp    = mem2chunk(oldmem);
   newsize = oldsize = chunksize(oldp);
 
@@ -1883,7 +1950,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
     /* Must allocate */
 
-    newmem = mALLOc (bytes);
+    newmem = malloc_core (bytes);
 
     if (newmem == NULL)  /* propagate failure */
       return NULL;
@@ -1988,7 +2055,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
   /* Call malloc with worst case padding to hit alignment. */
 
   nb = request2size(bytes);
-  m  = (char*)(mALLOc(nb + alignment + MINSIZE));
+  m  = (char*)(malloc_core(nb + alignment + MINSIZE));
 
   /*
   * The attempt to over-allocate (with a size large enough to guarantee the
@@ -2004,7 +2071,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
      * Use bytes not nb, since mALLOc internally calls request2size too, and
      * each call increases the size to allocate, to account for the header.
      */
-    m  = (char*)(mALLOc(bytes));
+    m  = (char*)(malloc_core(bytes));
     /* Aligned -> return it */
     if ((((unsigned long)(m)) % alignment) == 0)
       return m;
@@ -2015,7 +2082,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     fREe(m);
     /* Add in extra bytes to match misalignment of unexpanded allocation */
     extra = alignment - (((unsigned long)(m)) % alignment);
-    m  = (char*)(mALLOc(bytes + extra));
+    m  = (char*)(malloc_core(bytes + extra));
     /*
      * m might not be the same as before. Validate that the previous value of
      * extra still works for the current value of m.
@@ -2159,7 +2226,14 @@ Void_t* cALLOc(n, elem_size) size_t n; size_t elem_size;
   INTERNAL_SIZE_T oldtopsize = chunksize(top);
 #endif
 #endif
-  Void_t* mem = mALLOc (sz);
+  Void_t* mem;
+
+	mem = malloc_slab(sz);
+	if (mem) {
+		memset(mem, '\0', sz);
+		return mem;
+	}
+  mem = malloc_core(sz);
 
   if ((long)n < 0) return NULL;
 
@@ -2321,6 +2395,9 @@ size_t malloc_usable_size(mem) Void_t* mem;
   mchunkptr p;
   if (mem == NULL)
     return 0;
+  else if (CONFIG_IS_ENABLED(SYS_MALLOC_SLAB) &&
+	   malloc_slab_usable_size(mem))
+    return malloc_slab_usable_size(mem);
   else
   {
     p = mem2chunk(mem);
@@ -2410,6 +2487,8 @@ void malloc_stats(void)
   printf("max mmap regions = %10u\n",
 	  (unsigned int)max_n_mmaps);
 #endif
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_SLAB))
+		malloc_slab_stats();
 }
 #endif	/* DEBUG */
 
@@ -2420,8 +2499,14 @@ void malloc_stats(void)
 #ifdef DEBUG
 struct mallinfo mALLINFo(void)
 {
+  struct mallinfo info;
+
   malloc_update_mallinfo();
-  return current_mallinfo;
+  info = current_mallinfo;
+	/* count slab objects too, so that leaks of them show up */
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_SLAB))
+		info.uordblks += malloc_slab_in_use();
+  return info;
 }
 #endif	/* DEBUG */
 
@@ -16,14 +16,17 @@
 #include <log.h>
 #include <malloc.h>
 #include <mapmem.h>
+#include <time.h>
 #include <hw_sha.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
 #include <asm/io.h>
 #include <linux/errno.h>
+#include <linux/math64.h>
 #include <u-boot/crc.h>
 #else
 #include "mkimage.h"
+#include <arpa/inet.h>
 #include <linux/compiler_attributes.h>
 #include <time.h>
 #include <linux/kconfig.h>
@@ -170,10 +173,14 @@ static int hash_update_crc16_ccitt(struct hash_algo *algo, void *ctx,
 static int hash_finish_crc16_ccitt(struct hash_algo *algo, void *ctx,
 				   void *dest_buf, int size)
 {
+	uint16_t crc;
+
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint16_t *)dest_buf) = *((uint16_t *)ctx);
+	/* big-endian, like crc16_ccitt_wd_buf() */
+	crc = htons(*((uint16_t *)ctx));
+	memcpy(dest_buf, &crc, sizeof(crc));
 	free(ctx);
 	return 0;
 }
@@ -197,10 +204,14 @@ static int __maybe_unused hash_update_crc32(struct hash_algo *algo, void *ctx,
 static int __maybe_unused hash_finish_crc32(struct hash_algo *algo, void *ctx,
 					    void *dest_buf, int size)
 {
+	uint32_t crc;
+
 	if (size < algo->digest_size)
 		return -1;
 
-	*((uint32_t *)dest_buf) = *((uint32_t *)ctx);
+	/* big-endian, like crc32_wd_buf() */
+	crc = htonl(*((uint32_t *)ctx));
+	memcpy(dest_buf, &crc, sizeof(crc));
 	free(ctx);
 	return 0;
 }
@@ -645,4 +656,40 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 	return 0;
 }
 #endif /* CONFIG_CMD_HASH || CONFIG_CMD_SHA1SUM || CONFIG_CMD_CRC32) */
+
+#if !defined(CONFIG_SPL_BUILD) && defined(CONFIG_CMD_HASH_BENCH)
+int hash_bench(const char *algo_name, ulong addr, ulong len)
+{
+	u8 output[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo;
+	ulong start, us;
+	bool found = false;
+	void *buf;
+	int i;
+
+	reloc_update();
+	buf = map_sysmem(addr, len);
+	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
+		algo = &hash_algo[i];
+		if (algo_name && strcmp(algo_name, algo->name))
+			continue;
+		found = true;
+
+		start = timer_get_us();
+		algo->hash_func_ws(buf, len, output, algo->chunk_size);
+		us = max(timer_get_us() - start, 1UL);
+
+		printf("%-12s %10lu us %8llu KiB/s\n", algo->name, us,
+		       div_u64((u64)len * 1000000 / 1024, us));
+	}
+	unmap_sysmem(buf);
+
+	if (!found) {
+		printf("Unknown hash algorithm '%s'\n", algo_name);
+		return -EPROTONOSUPPORT;
+	}
+
+	return 0;
+}
+#endif /* CONFIG_CMD_HASH_BENCH */
 #endif /* !USE_HOSTCC */
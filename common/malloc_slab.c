@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Size-class slab front-end for malloc()
+ *
+ * Driver model allocates many small objects (devices, their private data
+ * and platform data). Serving these from dlmalloc costs a chunk header each
+ * and a walk through the bins. Instead, small requests are rounded up to one
+ * of a few size classes and served from pages set aside at the top of the
+ * malloc() area. Each page holds objects of one class only. A page is carved
+ * into objects all at once when its class runs out, and freed objects go on a
+ * per-class free list, so both malloc() and free() are O(1).
+ *
+ * When the slab area is used up, dlmalloc takes over.
+ */
+
+#define LOG_CATEGORY LOGC_ALLOC
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <linux/kernel.h>
+#include <valgrind/memcheck.h>
+
+/* Size of a slab page. All the objects in a page are the same size */
+#define SLAB_PAGE_SIZE	4096
+
+/* Object sizes are multiples of this, which keeps objects aligned */
+#define SLAB_ALIGN	16
+
+/* Largest request served from the slab area */
+#define SLAB_MAX	512
+
+static const u16 slab_sizes[] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, SLAB_MAX
+};
+
+/**
+ * struct slab_class - A size class
+ *
+ * @free: First free object; each one holds a pointer to the next
+ * @size: Size of each object in bytes
+ * @pages: Number of pages used by this class
+ * @in_use: Number of objects allocated
+ * @peak: Largest value seen for @in_use
+ * @allocs: Number of allocations made from this class
+ */
+struct slab_class {
+	void *free;
+	uint size;
+	uint pages;
+	uint in_use;
+	uint peak;
+	ulong allocs;
+};
+
+/**
+ * struct slab_area - State of the slab front-end
+ *
+ * @base: Start of the first page
+ * @pages: Number of pages in the area, 0 if not set up
+ * @used: Number of pages handed out to size classes so far
+ * @page_class: Class of each page handed out, indexed by page number
+ * @cls: Size classes, in order of size
+ * @class_of: Class to use for each request size, in units of SLAB_ALIGN
+ */
+struct slab_area {
+	char *base;
+	uint pages;
+	uint used;
+	u8 *page_class;
+	struct slab_class cls[ARRAY_SIZE(slab_sizes)];
+	u8 class_of[SLAB_MAX / SLAB_ALIGN + 1];
+};
+
+static struct slab_area slab;
+
+void malloc_slab_init(ulong start, ulong size)
+{
+	ulong end = start + size;
+	int c, i;
+
+	memset(&slab, '\0', sizeof(slab));
+
+	/* the table of page classes goes at the start, then the pages */
+	slab.page_class = (u8 *)start;
+	slab.base = (char *)ALIGN(start + size / SLAB_PAGE_SIZE,
+				  SLAB_PAGE_SIZE);
+	if ((ulong)slab.base >= end)
+		return;
+	slab.pages = (end - (ulong)slab.base) / SLAB_PAGE_SIZE;
+
+	for (c = 0, i = 0; i < ARRAY_SIZE(slab.class_of); i++) {
+		if (i * SLAB_ALIGN > slab_sizes[c])
+			c++;
+		slab.class_of[i] = c;
+	}
+	for (c = 0; c < ARRAY_SIZE(slab_sizes); c++)
+		slab.cls[c].size = slab_sizes[c];
+
+	log_debug("%u slab pages at %p\n", slab.pages, slab.base);
+}
+
+/* Hand the next page to @cls and put all its objects on the free list */
+static int slab_refill(struct slab_class *cls)
+{
+	char *page, *obj;
+	void *free = NULL;
+	uint count;
+
+	if (slab.used == slab.pages)
+		return -ENOMEM;
+
+	page = slab.base + slab.used * SLAB_PAGE_SIZE;
+	slab.page_class[slab.used++] = cls - slab.cls;
+	cls->pages++;
+
+	/* link them from the end, so the list runs up through the page */
+	count = SLAB_PAGE_SIZE / cls->size;
+	for (obj = page + (count - 1) * cls->size; obj >= page;
+	     obj -= cls->size) {
+		*(void **)obj = free;
+		free = obj;
+	}
+	cls->free = free;
+
+	return 0;
+}
+
+/* Find the class of the page holding @mem, or NULL if not a slab object */
+static struct slab_class *slab_class_of(const void *mem)
+{
+	ulong offset = (const char *)mem - slab.base;
+
+	if ((const char *)mem < slab.base ||
+	    offset >= (ulong)slab.used * SLAB_PAGE_SIZE)
+		return NULL;
+
+	return &slab.cls[slab.page_class[offset / SLAB_PAGE_SIZE]];
+}
+
+void *malloc_slab_alloc(size_t bytes)
+{
+	struct slab_class *cls;
+	void *obj;
+
+	if (bytes > SLAB_MAX || !slab.pages)
+		return NULL;
+
+	cls = &slab.cls[slab.class_of[DIV_ROUND_UP(bytes, SLAB_ALIGN)]];
+	if (!cls->free && slab_refill(cls))
+		return NULL;
+
+	obj = cls->free;
+	/* the link in a free object is valid, though the object is not */
+	VALGRIND_MAKE_MEM_DEFINED(obj, sizeof(void *));
+	cls->free = *(void **)obj;
+	cls->allocs++;
+	if (++cls->in_use > cls->peak)
+		cls->peak = cls->in_use;
+
+	return obj;
+}
+
+bool malloc_slab_free(void *mem)
+{
+	struct slab_class *cls;
+
+	cls = slab_class_of(mem);
+	if (!cls)
+		return false;
+
+	/* the object may have been asked for with less room than the link */
+	VALGRIND_MAKE_MEM_UNDEFINED(mem, sizeof(void *));
+	*(void **)mem = cls->free;
+	cls->free = mem;
+	cls->in_use--;
+
+	return true;
+}
+
+size_t malloc_slab_usable_size(const void *mem)
+{
+	struct slab_class *cls;
+
+	cls = slab_class_of(mem);
+
+	return cls ? cls->size : 0;
+}
+
+size_t malloc_slab_in_use(void)
+{
+	size_t total = 0;
+	int c;
+
+	for (c = 0; c < ARRAY_SIZE(slab.cls); c++)
+		total += (size_t)slab.cls[c].in_use * slab.cls[c].size;
+
+	return total;
+}
+
+void malloc_slab_stats(void)
+{
+	struct slab_class *cls;
+
+	printf("slab: %u of %u pages of %#x bytes used\n", slab.used,
+	       slab.pages, SLAB_PAGE_SIZE);
+	printf(" size  pages  in use    peak    allocs\n");
+	for (cls = slab.cls; cls < slab.cls + ARRAY_SIZE(slab.cls); cls++) {
+		if (!cls->pages)
+			continue;
+		printf("%5u %6u %7u %7u %9lu\n", cls->size, cls->pages,
+		       cls->in_use, cls->peak, cls->allocs);
+	}
+}
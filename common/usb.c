@@ -26,6 +26,7 @@
  * For each transfer (except "Interrupt") we wait for completion.
  */
 #include <common.h>
+#include <bootstage.h>
 #include <command.h>
 #include <dm.h>
 #include <log.h>
@@ -49,14 +50,35 @@ bool usb_started; /* flag for the started/stopped USB status */
 static struct usb_device usb_dev[USB_MAX_DEVICE];
 static int dev_index;
 
+/*
+ * Count the devices enumerated below a root hub, including the root hub
+ */
+static int usb_count_devices(struct usb_device *root)
+{
+	struct usb_device *dev;
+	int i, count = 0;
+
+	for (i = 0; i < dev_index; i++) {
+		dev = &usb_dev[i];
+		while (dev->parent)
+			dev = dev->parent;
+		if (dev == root)
+			count++;
+	}
+
+	return count;
+}
+
 /***************************************************************************
  * Init USB Device
  */
 int usb_init(void)
 {
+	struct usb_device *root[CONFIG_USB_MAX_CONTROLLER_COUNT] = { NULL };
+	bool scanned[CONFIG_USB_MAX_CONTROLLER_COUNT] = { false };
 	void *ctrl;
 	struct usb_device *dev;
-	int i, start_index = 0;
+	int i, count;
 	int controllers_initialized = 0;
 	int ret;
 
@@ -70,19 +92,28 @@ int usb_init(void)
 		usb_dev[i].devnum = -1;
 	}
 
-	/* init low_level USB */
+	/*
+	 * Power on the root hubs of all controllers before polling any of
+	 * their ports, so that the controllers are scanned in parallel
+	 */
+	bootstage_mark_name(BOOTSTAGE_ID_USB_SCAN_START, "usb_scan_start");
+	usb_hub_scan_begin();
+
+	/*
+	 * init low_level USB. Each controller gets its USB%d: line once it
+	 * failed, or else when its bus is reported below, so that the lines
+	 * of several controllers do not run into each other.
+	 */
 	for (i = 0; i < CONFIG_USB_MAX_CONTROLLER_COUNT; i++) {
-		/* init low_level USB */
-		printf("USB%d:   ", i);
 		ret = usb_lowlevel_init(i, USB_INIT_HOST, &ctrl);
 		if (ret == -ENODEV) {	/* No such device. */
-			puts("Port not available.\n");
+			printf("USB%d:   Port not available.\n", i);
 			controllers_initialized++;
 			continue;
 		}
 
 		if (ret) {		/* Other error. */
-			puts("lowlevel init failed\n");
+			printf("USB%d:   lowlevel init failed\n", i);
 			continue;
 		}
 		/*
@@ -90,8 +121,6 @@ int usb_init(void)
 		 * i.e. search HUBs and configure them
 		 */
 		controllers_initialized++;
-		start_index = dev_index;
-		printf("scanning bus %d for devices... ", i);
 		ret = usb_alloc_new_device(ctrl, &dev);
 		if (ret)
 			break;
@@ -103,14 +132,25 @@ int usb_init(void)
 		ret = usb_new_device(dev);
 		if (ret)
 			usb_free_device(dev->controller);
+		else
+			root[i] = dev;
+		scanned[i] = true;
+	}
 
-		if (start_index == dev_index) {
+	usb_hub_scan_end();
+	bootstage_mark_name(BOOTSTAGE_ID_USB_SCAN_DONE, "usb_scan_done");
+
+	for (i = 0; i < CONFIG_USB_MAX_CONTROLLER_COUNT; i++) {
+		if (!scanned[i])
+			continue;
+
+		printf("USB%d:   scanning bus %d for devices... ", i, i);
+		count = root[i] ? usb_count_devices(root[i]) : 0;
+		if (!count) {
 			puts("No USB Device found\n");
 			continue;
-		} else {
-			printf("%d USB Device(s) found\n",
-				dev_index - start_index);
 		}
+		printf("%d USB Device(s) found\n", count);
 
 		usb_started = 1;
 	}
@@ -60,6 +60,13 @@ struct usb_device_scan {
 
 static LIST_HEAD(usb_scan_list);
 
+/*
+ * While set, usb_hub_configure() only powers the hub ports and queues them
+ * on usb_scan_list. The ports are polled later by usb_hub_scan_end(), so the
+ * power-on and debounce delays of all buses run concurrently.
+ */
+static bool usb_scan_deferred;
+
 __weak void usb_hub_reset_devices(struct usb_hub_device *hub, int port)
 {
 	return;
@@ -563,8 +570,11 @@ static int usb_device_list_scan(void)
 	static int running;
 	int ret = 0;
 
-	/* Only run this loop once for each controller */
-	if (running)
+	/*
+	 * Only run this loop once for each controller, or once for all of
+	 * them when the scan is deferred
+	 */
+	if (running || usb_scan_deferred)
 		return 0;
 
 	running = 1;
@@ -595,6 +605,18 @@ out:
 	return ret;
 }
 
+void usb_hub_scan_begin(void)
+{
+	usb_scan_deferred = true;
+}
+
+int usb_hub_scan_end(void)
+{
+	usb_scan_deferred = false;
+
+	return usb_device_list_scan();
+}
+
 static struct usb_hub_device *usb_get_hub_device(struct usb_device *dev)
 {
 	struct usb_hub_device *hub;
@@ -867,7 +889,8 @@ static int usb_hub_configure(struct usb_device *dev)
 	}
 
 	/*
-	 * And now call the scanning code which loops over the generated list
+	 * And now call the scanning code which loops over the generated list,
+	 * unless this is left to usb_hub_scan_end()
 	 */
 	ret = usb_device_list_scan();
 
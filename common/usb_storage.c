@@ -39,6 +39,7 @@
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <memalign.h>
 #include <asm/byteorder.h>
@@ -47,6 +48,7 @@
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <linux/delay.h>
+#include <linux/usb/uas.h>
 
 #include <part.h>
 #include <usb.h>
@@ -102,6 +104,12 @@ struct us_data {
 	trans_reset	transport_reset;	/* reset routine */
 	trans_cmnd	transport;		/* transport routine */
 	unsigned short	max_xfer_blk;		/* maximum transfer blocks */
+#ifdef CONFIG_USB_UAS
+	unsigned char	ep_cmd;			/* UAS command out */
+	unsigned char	ep_status;		/* UAS status in */
+	unsigned short	uas_streams;		/* bulk streams, 0 if none */
+	unsigned short	uas_depth;		/* max commands in flight */
+#endif
 };
 
 #if !CONFIG_IS_ENABLED(BLK)
@@ -176,6 +184,10 @@ static unsigned int usb_get_max_lun(struct us_data *us)
 {
 	int len;
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, result, 1);
+
+	/* This is a Bulk-Only request; UAS devices use REPORT LUNS */
+	if (us->protocol == US_PR_UAS)
+		return 0;
 	len = usb_control_msg(us->pusb_dev,
 			      usb_rcvctrlpipe(us->pusb_dev, 0),
 			      US_BBB_GET_MAX_LUN,
@@ -955,6 +967,374 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+#ifdef CONFIG_USB_UAS
+/*
+ * USB Attached SCSI: commands go out on the command pipe, each with a tag,
+ * and the device can have several of them in hand at once. With bulk streams
+ * (SuperSpeed) the tag is also the stream ID used for the command's data and
+ * status, so the host picks the order. Without streams the device reports on
+ * the status pipe which command it is ready to move data for. The tag after
+ * the last one used for commands is kept for task management, so that
+ * commands left on the device after an error can be aborted.
+ */
+#define UAS_MAX_TAGS	16
+
+static struct scsi_cmd uas_ccb[UAS_MAX_TAGS] __aligned(ARCH_DMA_MINALIGN);
+
+static int usb_stor_UAS_reset(struct us_data *us)
+{
+	struct usb_device *udev = us->pusb_dev;
+
+	debug("UAS reset\n");
+	usb_clear_halt(udev, usb_sndbulkpipe(udev, us->ep_cmd));
+	usb_clear_halt(udev, usb_rcvbulkpipe(udev, us->ep_status));
+	usb_clear_halt(udev, usb_rcvbulkpipe(udev, us->ep_in));
+	usb_clear_halt(udev, usb_sndbulkpipe(udev, us->ep_out));
+
+	return 0;
+}
+
+/* Pipes which have bulk streams, for usb_alloc_streams() */
+static void usb_stor_UAS_stream_pipes(struct us_data *us, unsigned long *pipes)
+{
+	struct usb_device *udev = us->pusb_dev;
+
+	pipes[0] = usb_rcvbulkpipe(udev, us->ep_status);
+	pipes[1] = usb_rcvbulkpipe(udev, us->ep_in);
+	pipes[2] = usb_sndbulkpipe(udev, us->ep_out);
+}
+
+static int usb_stor_UAS_bulk(struct us_data *us, unsigned int pipe, int tag,
+			     void *buf, int len, int *actlen)
+{
+	int result;
+
+	if (!us->uas_streams)
+		return usb_bulk_msg(us->pusb_dev, pipe, buf, len, actlen,
+				    USB_CNTL_TIMEOUT * 5);
+
+	result = submit_bulk_stream_msg(us->pusb_dev, pipe, tag, buf, len);
+	*actlen = us->pusb_dev->act_len;
+
+	return result < 0 ? result : 0;
+}
+
+static int usb_stor_UAS_data(struct us_data *us, struct scsi_cmd *srb,
+			     int tag, bool dir_in)
+{
+	struct usb_device *udev = us->pusb_dev;
+	unsigned int pipe;
+	int actlen, result;
+
+	if (dir_in)
+		pipe = usb_rcvbulkpipe(udev, us->ep_in);
+	else
+		pipe = usb_sndbulkpipe(udev, us->ep_out);
+	result = usb_stor_UAS_bulk(us, pipe, tag, srb->pdata, srb->datalen,
+				   &actlen);
+	if (result < 0)
+		return result;
+	srb->trans_bytes = actlen;
+
+	return 0;
+}
+
+/**
+ * usb_stor_UAS_reset_lun() - abort every command queued on a logical unit
+ *
+ * This sends a LOGICAL UNIT RESET task management function and waits for
+ * the device to answer it. Without streams, anything the device still had
+ * to report for the aborted commands is thrown away.
+ *
+ * @us:		Mass storage device
+ * @lun:	Logical unit to reset
+ * Return: 0 if OK, -ve on error
+ */
+static int usb_stor_UAS_reset_lun(struct us_data *us, int lun)
+{
+	struct usb_device *udev = us->pusb_dev;
+	ALLOC_CACHE_ALIGN_BUFFER(struct task_mgmt_iu, tiu, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct sense_iu, siu, 1);
+	struct response_iu *riu = (struct response_iu *)siu;
+	int tag = us->uas_depth + 1;
+	int i, actlen, result;
+
+	debug("UAS: reset LUN %d\n", lun);
+	memset(tiu, '\0', sizeof(*tiu));
+	tiu->iu_id = IU_ID_TASK_MGMT;
+	tiu->tag = cpu_to_be16(tag);
+	tiu->function = TMF_LOGICAL_UNIT_RESET;
+	tiu->lun[1] = lun;
+	result = usb_bulk_msg(udev, usb_sndbulkpipe(udev, us->ep_cmd), tiu,
+			      sizeof(*tiu), &actlen, USB_CNTL_TIMEOUT * 5);
+	if (result < 0)
+		return result;
+
+	for (i = 0; i <= us->uas_depth; i++) {
+		result = usb_stor_UAS_bulk(us,
+					   usb_rcvbulkpipe(udev, us->ep_status),
+					   tag, siu, sizeof(*siu), &actlen);
+		if (result < 0)
+			return result;
+		if (actlen >= sizeof(*riu) && riu->iu_id == IU_ID_RESPONSE &&
+		    be16_to_cpu(riu->tag) == tag)
+			break;
+	}
+	if (i > us->uas_depth)
+		return -EIO;
+	if (riu->response_code != RC_TMF_COMPLETE &&
+	    riu->response_code != RC_TMF_SUCCEEDED) {
+		debug("UAS: LUN reset failed, response %x\n",
+		      riu->response_code);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * usb_stor_UAS_queue() - run several commands on a UAS device at once
+ *
+ * All the command IUs are sent before any data moves, so the device can
+ * work through them back to back. Command @i uses tag @i + 1. The SCSI
+ * status of each command ends up in its status field, with any sense data
+ * in sense_buf.
+ *
+ * @us:		Mass storage device
+ * @srb:	Commands to run
+ * @count:	Number of commands, at most us->uas_depth
+ * Return: USB_STOR_TRANSPORT_GOOD if all the commands succeeded,
+ *	USB_STOR_TRANSPORT_FAILED if any failed, or USB_STOR_TRANSPORT_ERROR
+ *	if the device could not be brought back after a transport error
+ */
+static int usb_stor_UAS_queue(struct us_data *us, struct scsi_cmd *srb,
+			      int count)
+{
+	struct usb_device *udev = us->pusb_dev;
+	ALLOC_CACHE_ALIGN_BUFFER(struct command_iu, ciu, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct sense_iu, siu, 1);
+	unsigned int pipe;
+	int i, tag, len, done, actlen, result;
+
+	for (i = 0; i < count; i++)
+		srb[i].status = S_ILLEGAL;
+
+	/* COMMAND phase: queue everything */
+	pipe = usb_sndbulkpipe(udev, us->ep_cmd);
+	for (i = 0; i < count; i++) {
+		memset(ciu, '\0', sizeof(*ciu));
+		ciu->iu_id = IU_ID_COMMAND;
+		ciu->tag = cpu_to_be16(i + 1);
+		ciu->prio_attr = UAS_SIMPLE_TAG;
+		ciu->lun[1] = srb[i].lun;
+		memcpy(ciu->cdb, srb[i].cmd,
+		       min_t(int, srb[i].cmdlen, sizeof(ciu->cdb)));
+		result = usb_bulk_msg(udev, pipe, ciu, sizeof(*ciu), &actlen,
+				      USB_CNTL_TIMEOUT * 5);
+		if (result < 0) {
+			debug("failed to send command IU %d\n", i + 1);
+			goto fail;
+		}
+	}
+
+	/* DATA and STATUS phases, as the device asks for them */
+	pipe = usb_rcvbulkpipe(udev, us->ep_status);
+	for (done = 0; done < count;) {
+		tag = done + 1;
+		if (us->uas_streams && srb[done].datalen) {
+			result = usb_stor_UAS_data(us, &srb[done], tag,
+						   US_DIRECTION(srb[done].cmd[0]));
+			if (result < 0)
+				goto fail;
+		}
+		result = usb_stor_UAS_bulk(us, pipe, tag, siu, sizeof(*siu),
+					   &actlen);
+		if (result < 0 || actlen < sizeof(struct iu))
+			goto fail;
+		tag = be16_to_cpu(siu->tag);
+		if (tag < 1 || tag > count || srb[tag - 1].status != S_ILLEGAL ||
+		    (us->uas_streams && tag != done + 1)) {
+			debug("UAS: unexpected tag %d\n", tag);
+			goto fail;
+		}
+		switch (siu->iu_id) {
+		case IU_ID_READ_READY:
+		case IU_ID_WRITE_READY:
+			if (us->uas_streams || !srb[tag - 1].datalen)
+				goto fail;
+			result = usb_stor_UAS_data(us, &srb[tag - 1], tag,
+					siu->iu_id == IU_ID_READ_READY);
+			if (result < 0)
+				goto fail;
+			break;
+		case IU_ID_STATUS:
+			srb[tag - 1].status = siu->status;
+			if (siu->status != S_GOOD) {
+				len = min_t(int, be16_to_cpu(siu->len),
+					    sizeof(srb->sense_buf));
+				memset(srb[tag - 1].sense_buf, '\0',
+				       sizeof(srb->sense_buf));
+				memcpy(srb[tag - 1].sense_buf, siu->sense, len);
+			}
+			done++;
+			break;
+		default:
+			debug("UAS: IU %x for tag %d\n", siu->iu_id, tag);
+			goto fail;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (srb[i].status != S_GOOD)
+			return USB_STOR_TRANSPORT_FAILED;
+	}
+
+	return USB_STOR_TRANSPORT_GOOD;
+fail:
+	debug("UAS transport error, status %lx\n", udev->status);
+	usb_stor_UAS_reset(us);
+	/* Commands still queued on the device would clash with a retry */
+	if (usb_stor_UAS_reset_lun(us, srb[0].lun))
+		return USB_STOR_TRANSPORT_ERROR;
+
+	return USB_STOR_TRANSPORT_FAILED;
+}
+
+static int usb_stor_UAS_transport(struct scsi_cmd *srb, struct us_data *us)
+{
+	return usb_stor_UAS_queue(us, srb, 1);
+}
+
+/*
+ * Find the UAS alternate setting of interface @ifnum in a raw configuration
+ * descriptor and the endpoint used for each pipe. Returns the alternate
+ * setting, or -ENOENT if there is none.
+ */
+static int usb_stor_UAS_parse(unsigned char *buf, int len, int ifnum,
+			      unsigned char *ep_id)
+{
+	struct usb_descriptor_header *head;
+	struct usb_interface_descriptor *idesc;
+	struct usb_endpoint_descriptor *ep = NULL;
+	struct usb_pipe_usage_descriptor *usage;
+	int pos, alt = -ENOENT;
+
+	for (pos = 0; pos + sizeof(*head) <= len; pos += head->bLength) {
+		head = (struct usb_descriptor_header *)&buf[pos];
+		if (head->bLength < sizeof(*head) ||
+		    pos + head->bLength > len)
+			break;
+		switch (head->bDescriptorType) {
+		case USB_DT_INTERFACE:
+			idesc = (struct usb_interface_descriptor *)head;
+			if (alt >= 0)
+				return alt;
+			if (idesc->bInterfaceNumber == ifnum &&
+			    idesc->bInterfaceSubClass == US_SC_SCSI &&
+			    idesc->bInterfaceProtocol == US_PR_UAS)
+				alt = idesc->bAlternateSetting;
+			ep = NULL;
+			break;
+		case USB_DT_ENDPOINT:
+			ep = (struct usb_endpoint_descriptor *)head;
+			break;
+		case USB_DT_PIPE_USAGE:
+			usage = (struct usb_pipe_usage_descriptor *)head;
+			if (alt < 0 || !ep || usage->bPipeID < CMD_PIPE_ID ||
+			    usage->bPipeID > DATA_OUT_PIPE_ID)
+				break;
+			ep_id[usage->bPipeID] = ep->bEndpointAddress &
+						USB_ENDPOINT_NUMBER_MASK;
+			break;
+		}
+	}
+
+	return alt;
+}
+
+/*
+ * Switch the device over to UAS, if it has a UAS alternate setting. If this
+ * fails the caller carries on with alternate setting 0.
+ */
+static int usb_stor_UAS_probe(struct usb_device *dev, struct us_data *ss,
+			      struct usb_interface *iface)
+{
+	unsigned char ep_id[DATA_OUT_PIPE_ID + 1] = { 0 };
+	int ifnum = iface->desc.bInterfaceNumber;
+	unsigned long pipes[3];
+	unsigned char *buf;
+	int len, alt, ret;
+
+	len = usb_get_configuration_len(dev, 0);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	ret = usb_get_configuration_no(dev, 0, buf, len);
+	alt = ret < len ? -EIO : usb_stor_UAS_parse(buf, len, ifnum, ep_id);
+	free(buf);
+	if (alt < 0)
+		return alt;
+	if (!ep_id[CMD_PIPE_ID] || !ep_id[STATUS_PIPE_ID] ||
+	    !ep_id[DATA_IN_PIPE_ID] || !ep_id[DATA_OUT_PIPE_ID]) {
+		debug("UAS: missing pipe\n");
+		return -EINVAL;
+	}
+	ret = usb_set_interface(dev, ifnum, alt);
+	if (ret)
+		return ret;
+
+	ss->ep_cmd = ep_id[CMD_PIPE_ID];
+	ss->ep_status = ep_id[STATUS_PIPE_ID];
+	ss->ep_in = ep_id[DATA_IN_PIPE_ID];
+	ss->ep_out = ep_id[DATA_OUT_PIPE_ID];
+
+	/* One stream more than there are tags, for task management */
+	usb_stor_UAS_stream_pipes(ss, pipes);
+	ret = usb_alloc_streams(dev, pipes, ARRAY_SIZE(pipes),
+				UAS_MAX_TAGS + 1);
+	if (ret == 1) {
+		usb_free_streams(dev, pipes, ARRAY_SIZE(pipes));
+		ret = -ENOSPC;
+	}
+	if (ret > 0) {
+		ss->uas_streams = ret;
+		ss->uas_depth = min(ret - 1, UAS_MAX_TAGS);
+	} else if (dev->speed >= USB_SPEED_SUPER) {
+		/* SuperSpeed UAS cannot work without streams */
+		debug("UAS: cannot set up streams, err=%d\n", ret);
+		usb_set_interface(dev, ifnum, 0);
+		return ret ? ret : -ENOSPC;
+	} else {
+		ss->uas_streams = 0;
+		ss->uas_depth = UAS_MAX_TAGS;
+	}
+	debug("UAS: alt %d, cmd %d status %d in %d out %d, streams %d\n",
+	      alt, ss->ep_cmd, ss->ep_status, ss->ep_in, ss->ep_out,
+	      ss->uas_streams);
+
+	ss->subclass = US_SC_SCSI;
+	ss->protocol = US_PR_UAS;
+	ss->transport = usb_stor_UAS_transport;
+	ss->transport_reset = usb_stor_UAS_reset;
+
+	return 0;
+}
+
+/* Give back the streams set up by usb_stor_UAS_probe() */
+static void usb_stor_UAS_remove(struct us_data *ss)
+{
+	unsigned long pipes[3];
+
+	if (ss->protocol != US_PR_UAS || !ss->uas_streams)
+		return;
+	usb_stor_UAS_stream_pipes(ss, pipes);
+	usb_free_streams(ss->pusb_dev, pipes, ARRAY_SIZE(pipes));
+	ss->uas_streams = 0;
+}
+#endif /* CONFIG_USB_UAS */
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 				      struct us_data *us)
 {
@@ -1017,6 +1397,10 @@ static int usb_request_sense(struct scsi_cmd *srb, struct us_data *ss)
 {
 	char *ptr;
 
+	/* UAS devices send the sense data with the status of a failed command */
+	if (ss->protocol == US_PR_UAS)
+		return 0;
+
 	ptr = (char *)srb->pdata;
 	memset(&srb->cmd[0], 0, 12);
 	srb->cmd[0] = SCSI_REQ_SENSE;
@@ -1082,11 +1466,11 @@ static int usb_read_capacity(struct scsi_cmd *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
-		       unsigned long start, unsigned short blocks)
+static void usb_setup_rw_10(struct scsi_cmd *srb, unsigned char opcode,
+			    unsigned long start, unsigned short blocks)
 {
 	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_READ10;
+	srb->cmd[0] = opcode;
 	srb->cmd[1] = srb->lun << 5;
 	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
 	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
@@ -1095,6 +1479,12 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
 	srb->cmd[8] = (unsigned char) blocks & 0xff;
 	srb->cmdlen = 12;
+}
+
+static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
+		       unsigned long start, unsigned short blocks)
+{
+	usb_setup_rw_10(srb, SCSI_READ10, start, blocks);
 	debug("read10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
@@ -1102,20 +1492,69 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 static int usb_write_10(struct scsi_cmd *srb, struct us_data *ss,
 			unsigned long start, unsigned short blocks)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_WRITE10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = 12;
+	usb_setup_rw_10(srb, SCSI_WRITE10, start, blocks);
 	debug("write10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
 
+#ifdef CONFIG_USB_UAS
+/*
+ * Read or write on a UAS device, keeping up to us->uas_depth READ(10) or
+ * WRITE(10) commands in flight. Returns the number of blocks transferred.
+ */
+static lbaint_t usb_stor_UAS_rw(struct us_data *ss,
+				struct blk_desc *block_dev, lbaint_t start,
+				lbaint_t blks, uintptr_t buf_addr, bool write)
+{
+	lbaint_t done = 0, pos, left;
+	unsigned short smallblks;
+	uintptr_t addr;
+	int count, i, ret;
+	int retry = 2;
+
+	while (done < blks) {
+		pos = start + done;
+		addr = buf_addr + done * block_dev->blksz;
+		left = blks - done;
+		for (count = 0; count < ss->uas_depth && left; count++) {
+			struct scsi_cmd *srb = &uas_ccb[count];
+
+			smallblks = min_t(lbaint_t, left, ss->max_xfer_blk);
+			if (smallblks == ss->max_xfer_blk)
+				usb_show_progress();
+			srb->lun = block_dev->lun;
+			srb->pdata = (unsigned char *)addr;
+			srb->datalen = block_dev->blksz * smallblks;
+			usb_setup_rw_10(srb, write ? SCSI_WRITE10 : SCSI_READ10,
+					pos, smallblks);
+			pos += smallblks;
+			addr += srb->datalen;
+			left -= smallblks;
+		}
+		debug("%s: %d commands from " LBAF "\n", __func__, count,
+		      start + done);
+		ret = usb_stor_UAS_queue(ss, uas_ccb, count);
+		if (ret == USB_STOR_TRANSPORT_GOOD) {
+			done = pos - start;
+			continue;
+		}
+
+		/*
+		 * Keep what completed before the first failure, then retry
+		 * unless the device may still be working on the rest
+		 */
+		debug("%s ERROR\n", write ? "Write" : "Read");
+		ss->flags &= ~USB_READY;
+		for (i = 0; i < count && uas_ccb[i].status == S_GOOD; i++)
+			done += uas_ccb[i].datalen / block_dev->blksz;
+		if (ret == USB_STOR_TRANSPORT_ERROR || !retry--)
+			break;
+	}
+
+	return done;
+}
+#endif
+
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1186,6 +1625,14 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
+#ifdef CONFIG_USB_UAS
+	if (ss->protocol == US_PR_UAS) {
+		blkcnt = usb_stor_UAS_rw(ss, block_dev, start, blks, buf_addr,
+					 false);
+		goto out;
+	}
+#endif
+
 	do {
 		/* XXX need some comment here */
 		retry = 2;
@@ -1216,6 +1663,9 @@ retry_it:
 	debug("usb_read: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
 
+#ifdef CONFIG_USB_UAS
+out:
+#endif
 	usb_lock_async(udev, 0);
 	usb_disable_asynch(0); /* asynch transfer allowed */
 	if (blkcnt >= ss->max_xfer_blk)
@@ -1271,6 +1721,14 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
+#ifdef CONFIG_USB_UAS
+	if (ss->protocol == US_PR_UAS) {
+		blkcnt = usb_stor_UAS_rw(ss, block_dev, start, blks, buf_addr,
+					 true);
+		goto out;
+	}
+#endif
+
 	do {
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
@@ -1303,6 +1761,9 @@ retry_it:
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
 
+#ifdef CONFIG_USB_UAS
+out:
+#endif
 	usb_lock_async(udev, 0);
 	usb_disable_asynch(0); /* asynch transfer allowed */
 	if (blkcnt >= ss->max_xfer_blk)
@@ -1345,6 +1806,16 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 	ss->subclass = iface->desc.bInterfaceSubClass;
 	ss->protocol = iface->desc.bInterfaceProtocol;
 
+#ifdef CONFIG_USB_UAS
+	/* Prefer UAS where the device has it, else use alternate setting 0 */
+	if (!usb_stor_UAS_probe(dev, ss, iface)) {
+		debug("Transport: USB Attached SCSI\n");
+		usb_stor_set_max_xfer_blk(dev, ss);
+		dev->privptr = (void *)ss;
+		return 1;
+	}
+#endif
+
 	/* set the handler pointers based on the protocol */
 	debug("Transport: ");
 	switch (ss->protocol) {
@@ -1534,6 +2005,15 @@ static int usb_mass_storage_probe(struct udevice *dev)
 	return ret;
 }
 
+static int usb_mass_storage_remove(struct udevice *dev)
+{
+#ifdef CONFIG_USB_UAS
+	usb_stor_UAS_remove(dev_get_plat(dev));
+#endif
+
+	return 0;
+}
+
 static const struct udevice_id usb_mass_storage_ids[] = {
 	{ .compatible = "usb-mass-storage" },
 	{ }
@@ -1544,6 +2024,7 @@ U_BOOT_DRIVER(usb_mass_storage) = {
 	.id	= UCLASS_MASS_STORAGE,
 	.of_match = usb_mass_storage_ids,
 	.probe = usb_mass_storage_probe,
+	.remove = usb_mass_storage_remove,
 #if CONFIG_IS_ENABLED(BLK)
 	.plat_auto	= sizeof(struct us_data),
 #endif
@@ -68,14 +68,7 @@ int part_create_block_devices(struct udevice *blk_dev)
 static ulong part_blk_read(struct udevice *dev, lbaint_t start,
 			   lbaint_t blkcnt, void *buffer)
 {
-	struct udevice *parent;
 	struct disk_part *part;
-	const struct blk_ops *ops;
-
-	parent = dev_get_parent(dev);
-	ops = blk_get_ops(parent);
-	if (!ops->read)
-		return -ENOSYS;
 
 	part = dev_get_uclass_plat(dev);
 	if (start >= part->gpt_part_info.size)
@@ -85,20 +78,13 @@ static ulong part_blk_read(struct udevice *dev, lbaint_t start,
 		blkcnt = part->gpt_part_info.size - start;
 	start += part->gpt_part_info.start;
 
-	return ops->read(parent, start, blkcnt, buffer);
+	return blk_read(dev_get_parent(dev), start, blkcnt, buffer);
 }
 
 static ulong part_blk_write(struct udevice *dev, lbaint_t start,
 			    lbaint_t blkcnt, const void *buffer)
 {
-	struct udevice *parent;
 	struct disk_part *part;
-	const struct blk_ops *ops;
-
-	parent = dev_get_parent(dev);
-	ops = blk_get_ops(parent);
-	if (!ops->write)
-		return -ENOSYS;
 
 	part = dev_get_uclass_plat(dev);
 	if (start >= part->gpt_part_info.size)
@@ -108,20 +94,13 @@ static ulong part_blk_write(struct udevice *dev, lbaint_t start,
 		blkcnt = part->gpt_part_info.size - start;
 	start += part->gpt_part_info.start;
 
-	return ops->write(parent, start, blkcnt, buffer);
+	return blk_write(dev_get_parent(dev), start, blkcnt, buffer);
 }
 
 static ulong part_blk_erase(struct udevice *dev, lbaint_t start,
 			    lbaint_t blkcnt)
 {
-	struct udevice *parent;
 	struct disk_part *part;
-	const struct blk_ops *ops;
-
-	parent = dev_get_parent(dev);
-	ops = blk_get_ops(parent);
-	if (!ops->erase)
-		return -ENOSYS;
 
 	part = dev_get_uclass_plat(dev);
 	if (start >= part->gpt_part_info.size)
@@ -131,7 +110,7 @@ static ulong part_blk_erase(struct udevice *dev, lbaint_t start,
 		blkcnt = part->gpt_part_info.size - start;
 	start += part->gpt_part_info.start;
 
-	return ops->erase(parent, start, blkcnt);
+	return blk_erase(dev_get_parent(dev), start, blkcnt);
 }
 
 static const struct blk_ops blk_part_ops = {
@@ -168,76 +147,44 @@ static struct blk_desc *dev_get_blk(struct udevice *dev)
 	return desc;
 }
 
+/*
+ * Partition devices pass their accesses on to the parent block device, which
+ * takes care of the block cache, read-ahead and write-back
+ */
 unsigned long disk_blk_read(struct udevice *dev, lbaint_t start,
 			    lbaint_t blkcnt, void *buffer)
 {
-	struct blk_desc *desc;
-	const struct blk_ops *ops;
-	struct disk_part *part;
-	lbaint_t start_in_disk;
-	ulong blks_read;
-
-	desc = dev_get_blk(dev);
-	if (!desc)
+	if (!dev_get_blk(dev))
 		return -ENOSYS;
 
-	ops = blk_get_ops(dev);
-	if (!ops->read)
-		return -ENOSYS;
+	if (device_get_uclass_id(dev) == UCLASS_PARTITION)
+		return part_blk_read(dev, start, blkcnt, buffer);
 
-	start_in_disk = start;
-	if (device_get_uclass_id(dev) == UCLASS_PARTITION) {
-		part = dev_get_uclass_plat(dev);
-		start_in_disk += part->gpt_part_info.start;
-	}
-
-	if (blkcache_read(desc->uclass_id, desc->devnum, start_in_disk, blkcnt,
-			  desc->blksz, buffer))
-		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buffer);
-	if (blks_read == blkcnt)
-		blkcache_fill(desc->uclass_id, desc->devnum, start_in_disk,
-			      blkcnt, desc->blksz, buffer);
-
-	return blks_read;
+	return blk_read(dev, start, blkcnt, buffer);
 }
 
 unsigned long disk_blk_write(struct udevice *dev, lbaint_t start,
 			     lbaint_t blkcnt, const void *buffer)
 {
-	struct blk_desc *desc;
-	const struct blk_ops *ops;
-
-	desc = dev_get_blk(dev);
-	if (!desc)
+	if (!dev_get_blk(dev))
 		return -ENOSYS;
 
-	ops = blk_get_ops(dev);
-	if (!ops->write)
-		return -ENOSYS;
+	if (device_get_uclass_id(dev) == UCLASS_PARTITION)
+		return part_blk_write(dev, start, blkcnt, buffer);
 
-	blkcache_invalidate(desc->uclass_id, desc->devnum);
-
-	return ops->write(dev, start, blkcnt, buffer);
+	return blk_write(dev, start, blkcnt, buffer);
 }
 
 unsigned long disk_blk_erase(struct udevice *dev, lbaint_t start,
 			     lbaint_t blkcnt)
 {
-	struct blk_desc *desc;
-	const struct blk_ops *ops;
-
-	desc = dev_get_blk(dev);
-	if (!desc)
-		return -ENOSYS;
-
-	ops = blk_get_ops(dev);
-	if (!ops->erase)
+	if (!dev_get_blk(dev))
 		return -ENOSYS;
 
-	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	if (device_get_uclass_id(dev) == UCLASS_PARTITION)
+		return part_blk_erase(dev, start, blkcnt);
 
-	return ops->erase(dev, start, blkcnt);
+	return blk_erase(dev, start, blkcnt);
 }
 
 UCLASS_DRIVER(partition) = {
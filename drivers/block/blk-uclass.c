@@ -11,12 +11,78 @@
 #include <dm.h>
 #include <log.h>
 #include <malloc.h>
+#include <memalign.h>
 #include <part.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <dm/uclass-internal.h>
+#include <time.h>
 #include <linux/err.h>
 
+/**
+ * struct blk_uclass_priv - uclass-private data for a block device
+ *
+ * @ra_buf: Read-ahead buffer, allocated on first use
+ * @ra_blocks: Size of the read-ahead window in blocks, 0 to disable
+ * @ra_start: First block held in @ra_buf
+ * @ra_count: Number of valid blocks in @ra_buf
+ * @ra_next: Block following the previous read
+ * @ra_seq: Number of consecutive reads which started at @ra_next
+ * @wb_enabled: true if writes are held back until blk_flush()
+ * @wb_dirty: List of struct blk_dirty, sorted by block number
+ * @wb_bytes: Number of bytes held in @wb_dirty
+ * @aq_pending: Asynchronous requests not yet started, in order of submission
+ * @aq_active: Asynchronous requests started but not yet completed
+ * @aq_done: Asynchronous requests completed, waiting for blk_poll()
+ * @aq_depth: Maximum number of requests in @aq_active
+ * @aq_count: Number of requests in @aq_active
+ * @aq_errors: Number of requests which have failed
+ * @aq_busy: true while the driver is starting a request, which may select a
+ *	hardware partition and so flush the device from within blk_poll()
+ */
+struct blk_uclass_priv {
+	void *ra_buf;
+	lbaint_t ra_blocks;
+	lbaint_t ra_start;
+	lbaint_t ra_count;
+	lbaint_t ra_next;
+	uint ra_seq;
+	bool wb_enabled;
+	struct list_head wb_dirty;
+	ulong wb_bytes;
+	struct list_head aq_pending;
+	struct list_head aq_active;
+	struct list_head aq_done;
+	uint aq_depth;
+	uint aq_count;
+	uint aq_errors;
+	bool aq_busy;
+};
+
+/**
+ * struct blk_dirty - a run of blocks written but not yet flushed
+ *
+ * Runs never overlap and are never adjacent: a write touching a run is merged
+ * into it.
+ *
+ * @sibling: Node in the device's list of runs
+ * @start: First block of the run
+ * @count: Number of blocks in the run
+ * @data: Contents of the blocks, cache-aligned since it is written directly
+ */
+struct blk_dirty {
+	struct list_head sibling;
+	lbaint_t start;
+	lbaint_t count;
+	char *data;
+};
+
+/* Number of sequential reads after which read-ahead starts */
+#define BLK_READAHEAD_TRIGGER	2
+
+/* Time blk_wait() waits for a request to complete without any progress, ms */
+#define BLK_WAIT_TIMEOUT_MS	30000
+
 static struct {
 	enum uclass_id id;
 	const char *name;
@@ -354,12 +420,544 @@ ulong blk_write_devnum(enum uclass_id uclass_id, int devnum, lbaint_t start,
 	return blk_dwrite(desc, start, blkcnt, buffer);
 }
 
+/* Get the read-ahead state of a device, or NULL if read-ahead is disabled */
+static struct blk_uclass_priv *blk_readahead_priv(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv;
+
+	if (!CONFIG_IS_ENABLED(BLK_READAHEAD))
+		return NULL;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv || !priv->ra_blocks)
+		return NULL;
+
+	return priv;
+}
+
+static void blk_readahead_invalidate(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = blk_readahead_priv(dev);
+
+	if (priv) {
+		priv->ra_count = 0;
+		priv->ra_seq = 0;
+	}
+}
+
+int blk_set_readahead(struct udevice *dev, lbaint_t blocks)
+{
+	struct blk_uclass_priv *priv;
+
+	if (!CONFIG_IS_ENABLED(BLK_READAHEAD))
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv)
+		return -EINVAL;
+
+	free(priv->ra_buf);
+	priv->ra_buf = NULL;
+	priv->ra_count = 0;
+	priv->ra_next = 0;
+	priv->ra_seq = 0;
+	priv->ra_blocks = blocks;
+
+	return 0;
+}
+
+/* Get the write-back state of a device, or NULL if write-back is disabled */
+static struct blk_uclass_priv *blk_writeback_priv(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv;
+
+	if (!CONFIG_IS_ENABLED(BLK_WRITEBACK))
+		return NULL;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv || !priv->wb_enabled)
+		return NULL;
+
+	return priv;
+}
+
+/* Allocate a run of @count blocks starting at @start */
+static struct blk_dirty *blk_dirty_alloc(ulong blksz, lbaint_t start,
+					 lbaint_t count)
+{
+	struct blk_dirty *run;
+
+	run = malloc(sizeof(*run));
+	if (!run)
+		return NULL;
+	run->data = malloc_cache_aligned(count * blksz);
+	if (!run->data) {
+		free(run);
+		return NULL;
+	}
+	run->start = start;
+	run->count = count;
+
+	return run;
+}
+
+static void blk_dirty_free(struct blk_dirty *run)
+{
+	free(run->data);
+	free(run);
+}
+
+/* Hold back a write, merging it with the runs it overlaps or touches */
+static int blk_writeback_add(struct blk_uclass_priv *priv, ulong blksz,
+			     lbaint_t start, lbaint_t blkcnt, const void *buf)
+{
+	lbaint_t lo = start, hi = start + blkcnt;
+	struct blk_dirty *run, *tmp, *merged;
+
+	list_for_each_entry(run, &priv->wb_dirty, sibling) {
+		if (run->start + run->count < lo)
+			continue;
+		if (run->start > hi)
+			break;
+		lo = min(lo, run->start);
+		hi = max(hi, run->start + run->count);
+	}
+
+	merged = blk_dirty_alloc(blksz, lo, hi - lo);
+	if (!merged)
+		return -ENOMEM;
+
+	list_for_each_entry_safe(run, tmp, &priv->wb_dirty, sibling) {
+		if (run->start + run->count < lo)
+			continue;
+		if (run->start > hi)
+			break;
+		memcpy(merged->data + (run->start - lo) * blksz, run->data,
+		       run->count * blksz);
+		priv->wb_bytes -= run->count * blksz;
+		list_del(&run->sibling);
+		blk_dirty_free(run);
+	}
+	memcpy(merged->data + (start - lo) * blksz, buf, blkcnt * blksz);
+
+	/* @run is now the first run after the merged one, or the list head */
+	list_add_tail(&merged->sibling, &run->sibling);
+	priv->wb_bytes += merged->count * blksz;
+
+	return 0;
+}
+
+/* Drop held-back data for blocks which are about to be overwritten */
+static int blk_writeback_discard(struct blk_uclass_priv *priv, ulong blksz,
+				 lbaint_t start, lbaint_t blkcnt)
+{
+	lbaint_t end = start + blkcnt, run_end;
+	struct blk_dirty *run, *tmp, *tail;
+
+	list_for_each_entry_safe(run, tmp, &priv->wb_dirty, sibling) {
+		run_end = run->start + run->count;
+		if (run_end <= start)
+			continue;
+		if (run->start >= end)
+			break;
+
+		if (run_end > end) {
+			/* keep the part after the write */
+			tail = blk_dirty_alloc(blksz, end, run_end - end);
+			if (!tail)
+				return -ENOMEM;
+			memcpy(tail->data, run->data + (end - run->start) * blksz,
+			       tail->count * blksz);
+			list_add(&tail->sibling, &run->sibling);
+		}
+		priv->wb_bytes -= (min(run_end, end) - max(run->start, start)) *
+				  blksz;
+		if (run->start < start) {
+			/* keep the part before the write */
+			run->count = start - run->start;
+		} else {
+			list_del(&run->sibling);
+			blk_dirty_free(run);
+		}
+		if (run_end > end)
+			break;
+	}
+
+	return 0;
+}
+
+/* Copy held-back data over blocks just read from the device */
+static void blk_writeback_overlay(struct blk_uclass_priv *priv, ulong blksz,
+				  lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	lbaint_t end = start + blkcnt, from, to;
+	struct blk_dirty *run;
+
+	list_for_each_entry(run, &priv->wb_dirty, sibling) {
+		if (run->start + run->count <= start)
+			continue;
+		if (run->start >= end)
+			break;
+		from = max(run->start, start);
+		to = min(run->start + run->count, end);
+		memcpy(buf + (from - start) * blksz,
+		       run->data + (from - run->start) * blksz,
+		       (to - from) * blksz);
+	}
+}
+
+/*
+ * Start queued requests while the device has room for them. Requests the
+ * driver cannot start are carried out with read() or write(), but only when
+ * @sync is true and only one of them, so that blk_submit() never waits.
+ */
+static void blk_async_start(struct udevice *dev, struct blk_uclass_priv *priv,
+			    bool sync)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_request *req;
+	ulong blks;
+	int ret;
+
+	while (!list_empty(&priv->aq_pending) &&
+	       priv->aq_count < priv->aq_depth) {
+		req = list_first_entry(&priv->aq_pending, struct blk_request,
+				       sibling);
+
+		/* the driver may complete the request straight away */
+		list_move_tail(&req->sibling, &priv->aq_active);
+		priv->aq_count++;
+		priv->aq_busy = true;
+		ret = ops->submit ? ops->submit(dev, req) : -ENOSYS;
+		priv->aq_busy = false;
+		if (!ret)
+			continue;
+
+		if (ret == -EAGAIN || (ret == -ENOSYS && !sync)) {
+			list_move(&req->sibling, &priv->aq_pending);
+			priv->aq_count--;
+			return;
+		}
+		if (ret != -ENOSYS) {
+			blk_complete(req, ret);
+			continue;
+		}
+
+		priv->aq_busy = true;
+		if (req->write)
+			blks = ops->write(dev, req->start, req->blkcnt,
+					  req->buffer);
+		else
+			blks = ops->read(dev, req->start, req->blkcnt,
+					 req->buffer);
+		priv->aq_busy = false;
+		blk_complete(req, blks);
+		sync = false;
+	}
+}
+
+int blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv;
+	int ret;
+
+	if (!CONFIG_IS_ENABLED(BLK_ASYNC))
+		return -ENOSYS;
+	if (req->write ? !ops->write : !ops->read)
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv)
+		return -EINVAL;
+
+	if (req->write) {
+		blkcache_invalidate(desc->uclass_id, desc->devnum);
+		blk_readahead_invalidate(dev);
+		if (blk_writeback_priv(dev)) {
+			ret = blk_writeback_discard(priv, desc->blksz,
+						    req->start, req->blkcnt);
+			if (ret)
+				return ret;
+		}
+	}
+
+	req->dev = dev;
+	req->result = 0;
+	req->done = false;
+	list_add_tail(&req->sibling, &priv->aq_pending);
+	blk_async_start(dev, priv, false);
+
+	return 0;
+}
+
+static bool blk_async_active(struct blk_uclass_priv *priv,
+			     struct blk_request *req)
+{
+	struct blk_request *pos;
+
+	list_for_each_entry(pos, &priv->aq_active, sibling) {
+		if (pos == req)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Fail a request which is not done, with @err. If the driver started it, it
+ * may still complete it later on, which blk_complete() then ignores.
+ */
+static void blk_async_fail(struct blk_uclass_priv *priv,
+			   struct blk_request *req, int err)
+{
+	if (blk_async_active(priv, req))
+		priv->aq_count--;
+	priv->aq_errors++;
+	req->result = err;
+	list_move_tail(&req->sibling, &priv->aq_done);
+}
+
+/* Fail all the requests on @list, with @err */
+static void blk_async_fail_list(struct blk_uclass_priv *priv,
+				struct list_head *list, int err)
+{
+	struct blk_request *req;
+
+	while (!list_empty(list)) {
+		req = list_first_entry(list, struct blk_request, sibling);
+		blk_async_fail(priv, req, err);
+	}
+}
+
+void blk_complete(struct blk_request *req, long result)
+{
+	struct udevice *dev = req->dev;
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	/* the request failed already, see blk_async_fail() */
+	if (!blk_async_active(priv, req))
+		return;
+	if (!req->write && result > 0 && blk_writeback_priv(dev))
+		blk_writeback_overlay(priv, desc->blksz, req->start, result,
+				      req->buffer);
+	if (result != req->blkcnt)
+		priv->aq_errors++;
+	req->result = result;
+	list_move_tail(&req->sibling, &priv->aq_done);
+	priv->aq_count--;
+}
+
+int blk_poll(struct udevice *dev)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv;
+	struct blk_request *req;
+	int count = 0;
+	int ret;
+
+	if (!CONFIG_IS_ENABLED(BLK_ASYNC))
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv)
+		return -EINVAL;
+
+	/* the device may be busy with requests made through another one */
+	if (ops->poll && (priv->aq_count || !list_empty(&priv->aq_pending))) {
+		ret = ops->poll(dev);
+		if (ret) {
+			/* the requests in flight cannot be relied on now */
+			log_debug("%s: poll failed (err=%d)\n", dev->name, ret);
+			blk_async_fail_list(priv, &priv->aq_active, ret);
+		}
+	}
+	blk_async_start(dev, priv, true);
+
+	while (!list_empty(&priv->aq_done)) {
+		req = list_first_entry(&priv->aq_done, struct blk_request,
+				       sibling);
+		list_del(&req->sibling);
+		req->done = true;
+		count++;
+		if (req->complete)
+			req->complete(req);
+	}
+
+	return count;
+}
+
+long blk_wait(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_uclass_priv *priv;
+	ulong start;
+
+	if (!CONFIG_IS_ENABLED(BLK_ASYNC))
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv)
+		return -EINVAL;
+
+	start = get_timer(0);
+	while (!req->done) {
+		if (blk_poll(dev) > 0) {
+			start = get_timer(0);
+		} else if (get_timer(start) > BLK_WAIT_TIMEOUT_MS) {
+			log_debug("%s: request timed out\n", dev->name);
+			blk_async_fail(priv, req, -ETIMEDOUT);
+		}
+	}
+
+	return req->result;
+}
+
+int blk_wait_all(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv;
+	bool timed_out = false;
+	ulong start;
+	uint errors;
+
+	if (!CONFIG_IS_ENABLED(BLK_ASYNC))
+		return 0;
+
+	/* the request being started cannot finish until the driver returns */
+	priv = dev_get_uclass_priv(dev);
+	if (!priv || priv->aq_busy)
+		return 0;
+
+	errors = priv->aq_errors;
+	start = get_timer(0);
+	while (!list_empty(&priv->aq_pending) ||
+	       !list_empty(&priv->aq_active) || !list_empty(&priv->aq_done)) {
+		if (blk_poll(dev) > 0) {
+			start = get_timer(0);
+		} else if (get_timer(start) > BLK_WAIT_TIMEOUT_MS) {
+			log_debug("%s: requests timed out\n", dev->name);
+			blk_async_fail_list(priv, &priv->aq_active, -ETIMEDOUT);
+			blk_async_fail_list(priv, &priv->aq_pending,
+					    -ETIMEDOUT);
+			timed_out = true;
+		}
+	}
+	if (timed_out)
+		return -ETIMEDOUT;
+
+	return priv->aq_errors != errors ? -EIO : 0;
+}
+
+int blk_set_queue_depth(struct udevice *dev, uint depth)
+{
+	struct blk_uclass_priv *priv;
+
+	if (!CONFIG_IS_ENABLED(BLK_ASYNC))
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv || !depth)
+		return -EINVAL;
+	priv->aq_depth = depth;
+
+	return 0;
+}
+
+int blk_flush(struct udevice *dev)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv;
+	struct blk_dirty *run, *tmp;
+	ulong blks_written;
+	int ret;
+
+	/* requests still in flight are written before anything held back */
+	ret = blk_wait_all(dev);
+	if (!CONFIG_IS_ENABLED(BLK_WRITEBACK))
+		return ret;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv || list_empty(&priv->wb_dirty))
+		return ret;
+
+	list_for_each_entry_safe(run, tmp, &priv->wb_dirty, sibling) {
+		log_debug("flush " LBAFU " blocks at " LBAF "\n", run->count,
+			  run->start);
+		blks_written = ops->write(dev, run->start, run->count,
+					  run->data);
+		if (blks_written != run->count) {
+			log_err("%s: failed to write " LBAFU " blocks at " LBAF "\n",
+				dev->name, run->count, run->start);
+			ret = -EIO;
+		}
+		list_del(&run->sibling);
+		blk_dirty_free(run);
+	}
+	priv->wb_bytes = 0;
+
+	/* the device may have returned stale data before the flush */
+	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_readahead_invalidate(dev);
+
+	return ret;
+}
+
+int blk_flush_all(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+	int ret = 0;
+
+	if (!CONFIG_IS_ENABLED(BLK_WRITEBACK) && !CONFIG_IS_ENABLED(BLK_ASYNC))
+		return 0;
+
+	if (uclass_get(UCLASS_BLK, &uc))
+		return 0;
+
+	uclass_foreach_dev(dev, uc) {
+		if (device_active(dev) && blk_flush(dev))
+			ret = -EIO;
+	}
+
+	return ret;
+}
+
+int blk_set_writeback(struct udevice *dev, bool enable)
+{
+	struct blk_uclass_priv *priv;
+	int ret;
+
+	if (!CONFIG_IS_ENABLED(BLK_WRITEBACK))
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(dev);
+	if (!priv)
+		return -EINVAL;
+
+	if (!enable) {
+		ret = blk_flush(dev);
+		priv->wb_enabled = false;
+		return ret;
+	}
+	priv->wb_enabled = true;
+
+	return 0;
+}
+
 int blk_select_hwpart(struct udevice *dev, int hwpart)
 {
 	const struct blk_ops *ops = blk_get_ops(dev);
+	int ret;
 
 	if (!ops)
 		return -ENOSYS;
+	/* held-back data belongs to the current hardware partition */
+	ret = blk_flush(dev);
+	if (ret)
+		return ret;
+	blk_readahead_invalidate(dev);
 	if (!ops->select_hwpart)
 		return 0;
 
@@ -444,24 +1042,105 @@ int blk_get_device(int uclass_id, int devnum, struct udevice **devp)
 	return device_probe(*devp);
 }
 
+/*
+ * Read blocks through the read-ahead window. Once a few reads have each
+ * started where the previous one ended, small reads are widened to the
+ * whole window and the following reads are served from the buffer.
+ */
+static ulong blk_read_ahead(struct udevice *dev, struct blk_uclass_priv *priv,
+			    lbaint_t start, lbaint_t blkcnt, void *buf)
+{
+	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	lbaint_t done = 0, count;
+	ulong blks_read;
+
+	if (priv->ra_count && start >= priv->ra_start &&
+	    start < priv->ra_start + priv->ra_count) {
+		done = min(blkcnt, priv->ra_start + priv->ra_count - start);
+		memcpy(buf, priv->ra_buf + (start - priv->ra_start) *
+		       desc->blksz, done * desc->blksz);
+	}
+
+	if (start == priv->ra_next)
+		priv->ra_seq++;
+	else
+		priv->ra_seq = 0;
+	priv->ra_next = start + blkcnt;
+	start += done;
+	blkcnt -= done;
+	buf += done * desc->blksz;
+	if (!blkcnt)
+		return done;
+
+	if (priv->ra_seq < BLK_READAHEAD_TRIGGER ||
+	    blkcnt >= priv->ra_blocks || start >= desc->lba)
+		goto direct;
+
+	if (!priv->ra_buf) {
+		priv->ra_buf = malloc_cache_aligned(priv->ra_blocks *
+						    desc->blksz);
+		if (!priv->ra_buf)
+			goto direct;
+	}
+
+	count = min(priv->ra_blocks, desc->lba - start);
+	priv->ra_count = 0;
+	blks_read = ops->read(dev, start, count, priv->ra_buf);
+	if (IS_ERR_VALUE(blks_read) || blks_read < blkcnt)
+		goto direct;
+
+	log_debug("read-ahead " LBAFU " blocks at " LBAF "\n", count, start);
+	priv->ra_start = start;
+	priv->ra_count = blks_read;
+	memcpy(buf, priv->ra_buf, blkcnt * desc->blksz);
+
+	return done + blkcnt;
+
+direct:
+	blks_read = ops->read(dev, start, blkcnt, buf);
+	if (IS_ERR_VALUE(blks_read))
+		return done ? done : blks_read;
+
+	return done + blks_read;
+}
+
 long blk_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt, void *buf)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv;
 	ulong blks_read;
+	lbaint_t cached;
 
 	if (!ops->read)
 		return -ENOSYS;
+	blk_wait_all(dev);
 
-	if (blkcache_read(desc->uclass_id, desc->devnum,
-			  start, blkcnt, desc->blksz, buf))
+	cached = blkcache_read(desc->uclass_id, desc->devnum,
+			       start, blkcnt, desc->blksz, buf);
+	if (cached == blkcnt)
 		return blkcnt;
-	blks_read = ops->read(dev, start, blkcnt, buf);
+	start += cached;
+	blkcnt -= cached;
+	buf += cached * desc->blksz;
+
+	priv = blk_readahead_priv(dev);
+	if (priv)
+		blks_read = blk_read_ahead(dev, priv, start, blkcnt, buf);
+	else
+		blks_read = ops->read(dev, start, blkcnt, buf);
+	if (IS_ERR_VALUE(blks_read))
+		return cached ? cached : blks_read;
+
+	priv = blk_writeback_priv(dev);
+	if (priv)
+		blk_writeback_overlay(priv, desc->blksz, start, blks_read, buf);
 	if (blks_read == blkcnt)
 		blkcache_fill(desc->uclass_id, desc->devnum, start, blkcnt,
 			      desc->blksz, buf);
 
-	return blks_read;
+	return cached + blks_read;
 }
 
 long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
@@ -469,11 +1148,33 @@ long blk_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv;
+	int ret;
 
 	if (!ops->write)
 		return -ENOSYS;
+	blk_wait_all(dev);
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_readahead_invalidate(dev);
+
+	priv = blk_writeback_priv(dev);
+	if (priv) {
+		if (blkcnt * desc->blksz <= CONFIG_BLK_WRITEBACK_SIZE << 10 &&
+		    !blk_writeback_add(priv, desc->blksz, start, blkcnt, buf)) {
+			if (priv->wb_bytes > CONFIG_BLK_WRITEBACK_SIZE << 10) {
+				ret = blk_flush(dev);
+				if (ret)
+					return ret;
+			}
+			return blkcnt;
+		}
+
+		/* too large to hold back: write it now, in place of older data */
+		ret = blk_writeback_discard(priv, desc->blksz, start, blkcnt);
+		if (ret)
+			return ret;
+	}
 
 	return ops->write(dev, start, blkcnt, buf);
 }
@@ -482,11 +1183,22 @@ long blk_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
 {
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
 	const struct blk_ops *ops = blk_get_ops(dev);
+	struct blk_uclass_priv *priv;
+	int ret;
 
 	if (!ops->erase)
 		return -ENOSYS;
+	blk_wait_all(dev);
 
 	blkcache_invalidate(desc->uclass_id, desc->devnum);
+	blk_readahead_invalidate(dev);
+
+	priv = blk_writeback_priv(dev);
+	if (priv) {
+		ret = blk_writeback_discard(priv, desc->blksz, start, blkcnt);
+		if (ret)
+			return ret;
+	}
 
 	return ops->erase(dev, start, blkcnt);
 }
@@ -766,6 +1478,19 @@ int blk_unbind_all(int uclass_id)
 	return 0;
 }
 
+static int blk_pre_probe(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	INIT_LIST_HEAD(&priv->wb_dirty);
+	INIT_LIST_HEAD(&priv->aq_pending);
+	INIT_LIST_HEAD(&priv->aq_active);
+	INIT_LIST_HEAD(&priv->aq_done);
+	priv->aq_depth = 1;
+
+	return 0;
+}
+
 static int blk_post_probe(struct udevice *dev)
 {
 	if (CONFIG_IS_ENABLED(PARTITIONS) && blk_enabled()) {
@@ -778,12 +1503,34 @@ static int blk_post_probe(struct udevice *dev)
 			debug("*** creating partitions failed\n");
 	}
 
+	if (CONFIG_IS_ENABLED(BLK_READAHEAD)) {
+		struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+		priv->ra_blocks = CONFIG_BLK_READAHEAD_BLOCKS;
+	}
+
+	return 0;
+}
+
+static int blk_pre_remove(struct udevice *dev)
+{
+	struct blk_uclass_priv *priv = dev_get_uclass_priv(dev);
+
+	blk_flush(dev);
+	priv->wb_enabled = false;
+	free(priv->ra_buf);
+	priv->ra_buf = NULL;
+	priv->ra_count = 0;
+
 	return 0;
 }
 
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
+	.pre_probe	= blk_pre_probe,
 	.post_probe	= blk_post_probe,
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto	= sizeof(struct blk_uclass_priv),
 	.per_device_plat_auto	= sizeof(struct blk_desc),
 };
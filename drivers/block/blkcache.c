@@ -17,21 +17,46 @@
 DECLARE_GLOBAL_DATA_PTR;
 #endif
 
+/*
+ * The cache is made of segments of BLKCACHE_SEG_BLOCKS consecutive blocks,
+ * aligned to BLKCACHE_SEG_BLOCKS. Each segment is hashed on (iftype, devnum,
+ * segment number) so that a lookup costs a single bucket walk, no matter how
+ * many segments are cached. Segments track which of their blocks are valid,
+ * which lets a read be served from the cache even if it only covers part of
+ * what was filled, or spans data filled by several earlier reads.
+ */
+#define BLKCACHE_SEG_SHIFT	3
+#define BLKCACHE_SEG_BLOCKS	(1 << BLKCACHE_SEG_SHIFT)
+#define BLKCACHE_SEG_MASK	(BLKCACHE_SEG_BLOCKS - 1)
+#define BLKCACHE_HASH_BITS	8
+#define BLKCACHE_HASH_SIZE	(1 << BLKCACHE_HASH_BITS)
+
 struct block_cache_node {
+	struct hlist_node hash;
 	struct list_head lh;
 	int iftype;
 	int devnum;
-	lbaint_t start;
-	lbaint_t blkcnt;
+	lbaint_t seg;
 	unsigned long blksz;
-	char *cache;
+	unsigned int valid;
+	char cache[];
+};
+
+/* per-device override of max_blocks_per_entry */
+struct block_cache_policy {
+	struct list_head lh;
+	int iftype;
+	int devnum;
+	unsigned int max_blocks;
 };
 
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_policies);
+static struct hlist_head block_cache_hash[BLKCACHE_HASH_SIZE];
 
 static struct block_cache_stats _stats = {
 	.max_blocks_per_entry = 8,
-	.max_entries = 32
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE << 10,
 };
 
 #ifdef CONFIG_NEEDS_MANUAL_RELOC
@@ -42,22 +67,42 @@ int blkcache_init(void)
 	head->next = (uintptr_t)head->next + gd->reloc_off;
 	head->prev = (uintptr_t)head->prev + gd->reloc_off;
 
+	head = &block_cache_policies;
+	head->next = (uintptr_t)head->next + gd->reloc_off;
+	head->prev = (uintptr_t)head->prev + gd->reloc_off;
+
 	return 0;
 }
 #endif
 
+static unsigned int cache_hash(int iftype, int devnum, lbaint_t seg)
+{
+	u64 key = ((u64)seg << 16) ^ ((u64)iftype << 8) ^ devnum;
+
+	/* Fibonacci hashing: keep the top bits of the product */
+	return (key * 0x9e3779b97f4a7c15ULL) >> (64 - BLKCACHE_HASH_BITS);
+}
+
+static unsigned int cache_max_blocks(int iftype, int devnum)
+{
+	unsigned int max_blocks = blkcache_get_policy(iftype, devnum);
+
+	if (max_blocks == BLKCACHE_DEFAULT)
+		return _stats.max_blocks_per_entry;
+
+	return max_blocks;
+}
+
 static struct block_cache_node *cache_find(int iftype, int devnum,
-					   lbaint_t start, lbaint_t blkcnt,
-					   unsigned long blksz)
+					   lbaint_t seg, unsigned long blksz)
 {
+	struct hlist_head *head;
 	struct block_cache_node *node;
 
-	list_for_each_entry(node, &block_cache, lh)
-		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum) &&
-		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
+	head = &block_cache_hash[cache_hash(iftype, devnum, seg)];
+	hlist_for_each_entry(node, head, hash)
+		if (node->seg == seg && node->devnum == devnum &&
+		    node->iftype == iftype && node->blksz == blksz) {
 			if (block_cache.next != &node->lh) {
 				/* maintain MRU ordering */
 				list_del(&node->lh);
@@ -65,123 +110,232 @@ static struct block_cache_node *cache_find(int iftype, int devnum,
 			}
 			return node;
 		}
-	return 0;
+
+	return NULL;
 }
 
-int blkcache_read(int iftype, int devnum,
-		  lbaint_t start, lbaint_t blkcnt,
-		  unsigned long blksz, void *buffer)
+static void cache_drop(struct block_cache_node *node)
 {
-	struct block_cache_node *node = cache_find(iftype, devnum, start,
-						   blkcnt, blksz);
-	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
-		debug("hit: start " LBAF ", count " LBAFU "\n",
-		      start, blkcnt);
+	hlist_del(&node->hash);
+	list_del(&node->lh);
+	_stats.entries--;
+	_stats.bytes -= node->blksz * BLKCACHE_SEG_BLOCKS;
+}
+
+static struct block_cache_node *cache_alloc(int iftype, int devnum,
+					    lbaint_t seg, unsigned long blksz)
+{
+	struct block_cache_node *node, *victim;
+	ulong bytes = blksz * BLKCACHE_SEG_BLOCKS;
+
+	if (bytes > _stats.max_bytes)
+		return NULL;
+
+	node = NULL;
+	while (_stats.bytes + bytes > _stats.max_bytes) {
+		/* pop LRU, keeping it around if it can be recycled */
+		victim = list_last_entry(&block_cache, struct block_cache_node,
+					 lh);
+		debug("drop: seg " LBAF ", blksz %lu\n", victim->seg,
+		      victim->blksz);
+		cache_drop(victim);
+		_stats.evictions++;
+		if (!node && victim->blksz == blksz)
+			node = victim;
+		else
+			free(victim);
+	}
+
+	if (!node) {
+		node = malloc(sizeof(*node) + bytes);
+		if (!node)
+			return NULL;
+	}
+
+	node->iftype = iftype;
+	node->devnum = devnum;
+	node->seg = seg;
+	node->blksz = blksz;
+	node->valid = 0;
+	hlist_add_head(&node->hash,
+		       &block_cache_hash[cache_hash(iftype, devnum, seg)]);
+	list_add(&node->lh, &block_cache);
+	_stats.entries++;
+	_stats.bytes += bytes;
+
+	return node;
+}
+
+lbaint_t blkcache_read(int iftype, int devnum,
+		       lbaint_t start, lbaint_t blkcnt,
+		       unsigned long blksz, void *buffer)
+{
+	struct block_cache_node *node;
+	char *dst = buffer;
+	lbaint_t done = 0;
+	uint idx, cnt;
+
+	if (!_stats.entries)
+		goto out;
+
+	while (done < blkcnt) {
+		node = cache_find(iftype, devnum,
+				  (start + done) >> BLKCACHE_SEG_SHIFT, blksz);
+		if (!node)
+			break;
+
+		idx = (start + done) & BLKCACHE_SEG_MASK;
+		for (cnt = 0; idx + cnt < BLKCACHE_SEG_BLOCKS &&
+		     done + cnt < blkcnt; cnt++)
+			if (!(node->valid & BIT(idx + cnt)))
+				break;
+
+		memcpy(dst + done * blksz, node->cache + idx * blksz,
+		       cnt * blksz);
+		done += cnt;
+		if (idx + cnt < BLKCACHE_SEG_BLOCKS)
+			break;
+	}
+
+out:
+	if (done == blkcnt) {
+		debug("hit: start " LBAF ", count " LBAFU "\n", start, blkcnt);
 		++_stats.hits;
-		return 1;
+	} else if (done) {
+		debug("partial: start " LBAF ", count " LBAFU "/" LBAFU "\n",
+		      start, done, blkcnt);
+		++_stats.partial_hits;
+	} else {
+		debug("miss: start " LBAF ", count " LBAFU "\n", start,
+		      blkcnt);
+		++_stats.misses;
 	}
 
-	debug("miss: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
-	++_stats.misses;
-	return 0;
+	return done;
 }
 
 void blkcache_fill(int iftype, int devnum,
 		   lbaint_t start, lbaint_t blkcnt,
 		   unsigned long blksz, void const *buffer)
 {
-	lbaint_t bytes;
 	struct block_cache_node *node;
+	const char *src = buffer;
+	lbaint_t done = 0;
+	lbaint_t seg;
+	uint idx, cnt;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	if (blkcnt > cache_max_blocks(iftype, devnum))
 		return;
 
-	if (_stats.max_entries == 0)
-		return;
+	debug("fill: start " LBAF ", count " LBAFU "\n", start, blkcnt);
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
-		}
-	} else {
-		node = malloc(sizeof(*node));
+	while (done < blkcnt) {
+		seg = (start + done) >> BLKCACHE_SEG_SHIFT;
+		idx = (start + done) & BLKCACHE_SEG_MASK;
+		cnt = min_t(lbaint_t, BLKCACHE_SEG_BLOCKS - idx,
+			    blkcnt - done);
+
+		node = cache_find(iftype, devnum, seg, blksz);
+		if (!node)
+			node = cache_alloc(iftype, devnum, seg, blksz);
 		if (!node)
 			return;
-		node->cache = 0;
-	}
 
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
+		memcpy(node->cache + idx * blksz, src + done * blksz,
+		       cnt * blksz);
+		node->valid |= GENMASK(idx + cnt - 1, idx);
+		done += cnt;
 	}
-
-	debug("fill: start " LBAF ", count " LBAFU "\n",
-	      start, blkcnt);
-
-	node->iftype = iftype;
-	node->devnum = devnum;
-	node->start = start;
-	node->blkcnt = blkcnt;
-	node->blksz = blksz;
-	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_node *node, *n;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
 		if (iftype == -1 ||
 		    (node->iftype == iftype && node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
+			cache_drop(node);
 			free(node);
-			--_stats.entries;
 		}
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+int blkcache_set_policy(int iftype, int devnum, unsigned int max_blocks)
+{
+	struct block_cache_policy *pol;
+
+	blkcache_invalidate(iftype, devnum);
+
+	list_for_each_entry(pol, &block_cache_policies, lh) {
+		if (pol->iftype == iftype && pol->devnum == devnum) {
+			if (max_blocks == BLKCACHE_DEFAULT) {
+				list_del(&pol->lh);
+				free(pol);
+			} else {
+				pol->max_blocks = max_blocks;
+			}
+			return 0;
+		}
+	}
+	if (max_blocks == BLKCACHE_DEFAULT)
+		return 0;
+
+	pol = malloc(sizeof(*pol));
+	if (!pol)
+		return -ENOMEM;
+	pol->iftype = iftype;
+	pol->devnum = devnum;
+	pol->max_blocks = max_blocks;
+	list_add_tail(&pol->lh, &block_cache_policies);
+
+	return 0;
+}
+
+unsigned int blkcache_get_policy(int iftype, int devnum)
+{
+	struct block_cache_policy *pol;
+
+	list_for_each_entry(pol, &block_cache_policies, lh)
+		if (pol->iftype == iftype && pol->devnum == devnum)
+			return pol->max_blocks;
+
+	return BLKCACHE_DEFAULT;
+}
+
+void blkcache_configure(unsigned blocks, ulong bytes)
 {
 	/* invalidate cache if there is a change */
 	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries))
+	    (bytes != _stats.max_bytes))
 		blkcache_invalidate(-1, 0);
 
 	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	_stats.max_bytes = bytes;
 
 	_stats.hits = 0;
+	_stats.partial_hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
 {
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
+	_stats.partial_hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
 
 void blkcache_free(void)
 {
+	struct block_cache_policy *pol, *n;
+
 	blkcache_invalidate(-1, 0);
+	list_for_each_entry_safe(pol, n, &block_cache_policies, lh) {
+		list_del(&pol->lh);
+		free(pol);
+	}
 }
@@ -11,6 +11,7 @@
 #include <os.h>
 #include <malloc.h>
 #include <sandbox_host.h>
+#include <time.h>
 #include <asm/global_data.h>
 #include <dm/device_compat.h>
 #include <dm/device-internal.h>
@@ -26,6 +27,7 @@ static unsigned long host_block_read(struct udevice *dev,
 	struct udevice *host_dev = dev_get_parent(dev);
 	struct host_sb_plat *plat = dev_get_plat(host_dev);
 
+	plat->read_count++;
 	if (os_lseek(plat->fd, start * desc->blksz, OS_SEEK_SET) == -1) {
 		printf("ERROR: Invalid block %lx\n", start);
 		return -1;
@@ -45,6 +47,7 @@ static unsigned long host_block_write(struct udevice *dev,
 	struct udevice *host_dev = dev_get_parent(dev);
 	struct host_sb_plat *plat = dev_get_plat(host_dev);
 
+	plat->write_count++;
 	if (os_lseek(plat->fd, start * desc->blksz, OS_SEEK_SET) == -1) {
 		printf("ERROR: Invalid block %lx\n", start);
 		return -1;
@@ -56,13 +59,89 @@ static unsigned long host_block_write(struct udevice *dev,
 	return -EIO;
 }
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+/* Number of requests the emulated controller can hold */
+#define HOST_BLK_QUEUE_DEPTH	4
+
+/**
+ * struct host_blk_priv - Asynchronous requests held by a host block device
+ *
+ * @queue: Requests submitted, oldest first
+ * @count: Number of requests in @queue
+ */
+struct host_blk_priv {
+	struct blk_request *queue[HOST_BLK_QUEUE_DEPTH];
+	int count;
+};
+
+static int host_block_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+
+	if (priv->count == HOST_BLK_QUEUE_DEPTH)
+		return -EAGAIN;
+	priv->queue[priv->count++] = req;
+
+	return 0;
+}
+
+/* Carry out the oldest request, like a controller that is slow to finish */
+static int host_block_poll(struct udevice *dev)
+{
+	struct host_blk_priv *priv = dev_get_priv(dev);
+	struct host_sb_plat *plat = dev_get_plat(dev_get_parent(dev));
+	struct blk_request *req;
+	ulong blks;
+	int ret;
+
+	if (plat->poll_err) {
+		ret = plat->poll_err;
+		plat->poll_err = 0;
+		return ret;
+	}
+	/* let time go by, so that waiting for the requests times out */
+	if (plat->poll_stall) {
+		timer_test_add_offset(1000);
+		return 0;
+	}
+	if (!priv->count)
+		return 0;
+	req = priv->queue[0];
+	priv->count--;
+	memmove(priv->queue, priv->queue + 1, priv->count * sizeof(req));
+
+	if (req->write)
+		blks = host_block_write(dev, req->start, req->blkcnt,
+					req->buffer);
+	else
+		blks = host_block_read(dev, req->start, req->blkcnt,
+				       req->buffer);
+	blk_complete(req, blks);
+
+	return 0;
+}
+
+static int host_block_probe(struct udevice *dev)
+{
+	return blk_set_queue_depth(dev, HOST_BLK_QUEUE_DEPTH);
+}
+#endif
+
 static const struct blk_ops sandbox_host_blk_ops = {
 	.read	= host_block_read,
 	.write	= host_block_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit	= host_block_submit,
+	.poll	= host_block_poll,
+#endif
 };
 
 U_BOOT_DRIVER(sandbox_host_blk) = {
 	.name		= "sandbox_host_blk",
 	.id		= UCLASS_BLK,
 	.ops		= &sandbox_host_blk_ops,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.probe		= host_block_probe,
+	.priv_auto	= sizeof(struct host_blk_priv),
+#endif
 };
@@ -9,8 +9,11 @@
 #define LOG_CATEGORY LOGC_DM
 
 #include <common.h>
+#include <bootstage.h>
 #include <errno.h>
 #include <log.h>
+#include <malloc.h>
+#include <sort.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -18,8 +21,11 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <asm/global_data.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -181,11 +187,144 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
-		   struct driver *drv, bool pre_reloc_only)
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+/**
+ * struct driver_compat - An entry in the index of compatible strings
+ *
+ * Entries are indices rather than pointers, so that the index is small enough
+ * for the malloc() space there is before relocation.
+ *
+ * @drv: Driver which lists the compatible string, in the driver linker list
+ * @id: Matching entry in the driver's of_match table
+ */
+struct driver_compat {
+	u16 drv;
+	u16 id;
+};
+
+static struct driver *driver_compat_drv(const struct driver_compat *c)
+{
+	return ll_entry_start(struct driver, driver) + c->drv;
+}
+
+static const struct udevice_id *driver_compat_id(const struct driver_compat *c)
+{
+	return driver_compat_drv(c)->of_match + c->id;
+}
+
+static int driver_compat_cmp(const void *s1, const void *s2)
+{
+	const struct driver_compat *c1 = s1, *c2 = s2;
+	int ret;
+
+	ret = strcmp(driver_compat_id(c1)->compatible,
+		     driver_compat_id(c2)->compatible);
+	if (ret)
+		return ret;
+
+	/* keep linker-list order, so that the first driver still wins */
+	if (c1->drv != c2->drv)
+		return c1->drv < c2->drv ? -1 : 1;
+
+	return c1->id < c2->id ? -1 : c1->id > c2->id;
+}
+
+/**
+ * lists_compat_index() - Set up the index of compatible strings
+ *
+ * This collects the compatible strings of all drivers and sorts them, the
+ * first time it is called before relocation and again after it.
+ *
+ * Return: 0 if OK, -ENOENT if no driver has a compatible string, -E2BIG if
+ * there are too many drivers to index, -ENOMEM if out of memory
+ */
+static int lists_compat_index(void)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id;
+	struct driver_compat *index;
+	struct driver *entry;
+	int count = 0;
+
+	if (gd->dm_compat)
+		return 0;
+	if (n_ents > U16_MAX)
+		return -E2BIG;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++)
+			count++;
+	}
+	if (!count)
+		return -ENOENT;
+
+	index = malloc(count * sizeof(*index));
+	if (!index) {
+		log_debug("No memory for %d compatible strings\n", count);
+		return -ENOMEM;
+	}
+
+	count = 0;
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++) {
+			index[count].drv = entry - driver;
+			index[count].id = id - entry->of_match;
+			count++;
+		}
+	}
+	qsort(index, count, sizeof(*index), driver_compat_cmp);
+	log_debug("Indexed %d compatible strings\n", count);
+
+	gd->dm_compat = index;
+	gd->dm_compat_count = count;
+
+	return 0;
+}
+#endif
+
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	if (!lists_compat_index()) {
+		const struct driver_compat *index = gd->dm_compat;
+		int low = 0, high = gd->dm_compat_count;
+
+		/* find the first entry which is not before @compat */
+		while (low < high) {
+			int mid = (low + high) / 2;
+
+			if (strcmp(driver_compat_id(&index[mid])->compatible,
+				   compat) < 0)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		if (low == gd->dm_compat_count ||
+		    strcmp(driver_compat_id(&index[low])->compatible, compat))
+			return NULL;
+		*idp = driver_compat_id(&index[low]);
+
+		return driver_compat_drv(&index[low]);
+	}
+#endif
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
+int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+		   struct driver *drv, bool pre_reloc_only)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -222,20 +361,18 @@ int lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
 		log_debug("   - attempt to match compatible string '%s'\n",
 			  compat);
 
+		bootstage_start(BOOTSTAGE_ID_ACCUM_DM_MATCH, "dm_match");
 		id = NULL;
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			if (drv) {
-				if (drv != entry)
-					continue;
-				if (!entry->of_match)
-					break;
-			}
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
+		if (!drv) {
+			entry = lists_driver_lookup_compat(compat, &id);
+		} else if (!drv->of_match ||
+			   !driver_check_compatible(drv->of_match, &id, compat)) {
+			entry = drv;
+		} else {
+			entry = NULL;
 		}
-		if (entry == driver + n_ents)
+		bootstage_accum(BOOTSTAGE_ID_ACCUM_DM_MATCH);
+		if (!entry)
 			continue;
 
 		if (pre_reloc_only) {
@@ -180,6 +180,8 @@ int dm_init(bool of_live)
 		gd->uclass_root = &DM_UCLASS_ROOT_S_NON_CONST;
 		INIT_LIST_HEAD(DM_UCLASS_ROOT_NON_CONST);
 	}
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_init();
 
 	if (IS_ENABLED(CONFIG_NEEDS_MANUAL_RELOC)) {
 		fix_drivers();
@@ -198,8 +200,11 @@ int dm_init(bool of_live)
 					  &DM_ROOT_NON_CONST);
 		if (ret)
 			return ret;
-		if (CONFIG_IS_ENABLED(OF_CONTROL))
+		if (CONFIG_IS_ENABLED(OF_CONTROL)) {
 			dev_set_ofnode(DM_ROOT_NON_CONST, ofnode_root());
+			if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+				uclass_index_update_device(DM_ROOT_NON_CONST);
+		}
 		ret = device_probe(DM_ROOT_NON_CONST);
 		if (ret)
 			return ret;
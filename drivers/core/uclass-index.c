@@ -0,0 +1,413 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Index of uclasses and their devices
+ *
+ * Finding a uclass by ID, or a device by sequence number, devicetree node or
+ * phandle, otherwise means walking a list. This keeps a table of uclasses and
+ * a hash table for each kind of device lookup, so that these take constant
+ * time however many devices there are.
+ *
+ * Each hash table maps a uclass ID and key to the first device in that
+ * uclass with the key, i.e. the one a walk of the uclass's device list would
+ * find. Phandles are only collected for a uclass the first time a device in it
+ * is looked up by phandle.
+ */
+
+#define LOG_CATEGORY LOGC_DM
+
+#include <common.h>
+#include <dm.h>
+#include <log.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+#include <dm/uclass-internal.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Smallest hash table, must be a power of two */
+#define INDEX_MIN_SIZE	16
+
+/**
+ * struct uclass_index_ent - Entry in a hash table
+ *
+ * @key: Sequence number, ofnode or phandle of the device
+ * @id: ID of the device's uclass
+ * @dev: Device, or NULL if the entry is empty
+ */
+struct uclass_index_ent {
+	ulong key;
+	enum uclass_id id;
+	struct udevice *dev;
+};
+
+/**
+ * struct uclass_index_table - Hash table for one kind of lookup
+ *
+ * @ent: Entries, using linear probing
+ * @size: Number of entries, a power of two, or 0 if not allocated yet
+ * @count: Number of entries in use
+ * @dups: true if two devices in a uclass have had the same key, so that
+ *	removing one must look for the other
+ */
+struct uclass_index_table {
+	struct uclass_index_ent *ent;
+	uint size;
+	uint count;
+	bool dups;
+};
+
+/**
+ * struct uclass_index - Index of uclasses and devices
+ *
+ * @uclass: Uclass for each ID, NULL if not created
+ * @table: Hash table for each kind of lookup
+ * @phandles: true for each uclass whose devices have been added to the
+ *	phandle table
+ * @failed: true if a hash table could not be grown, so that the tables are
+ *	incomplete and must not be used
+ * @lookups: Number of device lookups made
+ * @steps: Number of hash-table entries checked by those lookups
+ */
+struct uclass_index {
+	struct uclass *uclass[UCLASS_COUNT];
+	struct uclass_index_table table[UCLASS_INDEX_COUNT];
+	bool phandles[UCLASS_COUNT];
+	bool failed;
+	ulong lookups;
+	ulong steps;
+};
+
+void uclass_index_init(void)
+{
+	struct uclass_index *idx = gd->uclass_index;
+	int i;
+
+	if (!idx) {
+		/* growing the tables needs free() */
+		if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+			return;
+		gd->uclass_index = calloc(1, sizeof(*idx));
+		if (!gd->uclass_index)
+			log_debug("No memory for uclass index\n");
+		return;
+	}
+
+	/* driver model is starting again, so drop everything */
+	memset(idx->uclass, '\0', sizeof(idx->uclass));
+	memset(idx->phandles, '\0', sizeof(idx->phandles));
+	for (i = 0; i < UCLASS_INDEX_COUNT; i++) {
+		struct uclass_index_table *tab = &idx->table[i];
+
+		if (tab->ent)
+			memset(tab->ent, '\0', tab->size * sizeof(*tab->ent));
+		tab->count = 0;
+		tab->dups = false;
+	}
+	idx->failed = false;
+}
+
+void uclass_index_add_uclass(struct uclass *uc)
+{
+	struct uclass_index *idx = gd->uclass_index;
+
+	if (idx)
+		idx->uclass[uc->uc_drv->id] = uc;
+}
+
+void uclass_index_remove_uclass(struct uclass *uc)
+{
+	struct uclass_index *idx = gd->uclass_index;
+
+	if (idx) {
+		idx->uclass[uc->uc_drv->id] = NULL;
+		idx->phandles[uc->uc_drv->id] = false;
+	}
+}
+
+int uclass_index_find_uclass(enum uclass_id id, struct uclass **ucp)
+{
+	struct uclass_index *idx = gd->uclass_index;
+
+	if (!idx)
+		return -ENOSYS;
+	*ucp = (uint)id < UCLASS_COUNT ? idx->uclass[id] : NULL;
+
+	return 0;
+}
+
+/* Get the key of @dev for a lookup, returning false if it has none */
+static bool index_key(struct udevice *dev, enum uclass_index_t type,
+		      ulong *keyp)
+{
+	switch (type) {
+	case UCLASS_INDEX_SEQ:
+		*keyp = dev->seq_;
+		return dev->seq_ >= 0;
+	case UCLASS_INDEX_OFNODE:
+		*keyp = dev_ofnode(dev).of_offset;
+		return ofnode_valid(dev_ofnode(dev));
+	case UCLASS_INDEX_PHANDLE:
+		if (!CONFIG_IS_ENABLED(OF_REAL) ||
+		    !ofnode_valid(dev_ofnode(dev)))
+			return false;
+		*keyp = dev_read_phandle(dev);
+		return *keyp;
+	default:
+		return false;
+	}
+}
+
+static uint index_hash(const struct uclass_index_table *tab,
+		       enum uclass_id id, ulong key)
+{
+	u32 hash;
+
+	hash = lower_32_bits(key) ^ upper_32_bits(key) ^ id << 24;
+
+	return (hash * 0x9e3779b9) >> (32 - ilog2(tab->size));
+}
+
+/* Find the entry for @id and @key, returning NULL if there is none */
+static struct uclass_index_ent *index_find(struct uclass_index_table *tab,
+					   enum uclass_id id, ulong key,
+					   ulong *stepsp)
+{
+	struct uclass_index_ent *ent;
+	uint i;
+
+	if (!tab->count)
+		return NULL;
+	for (i = index_hash(tab, id, key);; i = (i + 1) & (tab->size - 1)) {
+		ent = &tab->ent[i];
+		if (stepsp)
+			(*stepsp)++;
+		if (!ent->dev)
+			return NULL;
+		if (ent->key == key && ent->id == id)
+			return ent;
+	}
+}
+
+static void index_insert(struct uclass_index_table *tab,
+			 const struct uclass_index_ent *new)
+{
+	uint i;
+
+	for (i = index_hash(tab, new->id, new->key); tab->ent[i].dev;
+	     i = (i + 1) & (tab->size - 1))
+		;
+	tab->ent[i] = *new;
+	tab->count++;
+}
+
+/* Make room for another entry, keeping the table at most 3/4 full */
+static int index_grow(struct uclass_index_table *tab)
+{
+	struct uclass_index_ent *old = tab->ent;
+	uint old_size = tab->size;
+	uint i;
+
+	if ((tab->count + 1) * 4 <= tab->size * 3)
+		return 0;
+
+	tab->size = old_size ? old_size * 2 : INDEX_MIN_SIZE;
+	tab->ent = calloc(tab->size, sizeof(*tab->ent));
+	if (!tab->ent) {
+		tab->ent = old;
+		tab->size = old_size;
+		return -ENOMEM;
+	}
+	tab->count = 0;
+	for (i = 0; i < old_size; i++) {
+		if (old[i].dev)
+			index_insert(tab, &old[i]);
+	}
+	free(old);
+
+	return 0;
+}
+
+/* Empty an entry, moving later ones back so that they can still be found */
+static void index_delete(struct uclass_index_table *tab,
+			 struct uclass_index_ent *ent)
+{
+	uint mask = tab->size - 1;
+	uint i = ent - tab->ent;
+	uint j = i;
+	uint home;
+
+	tab->count--;
+	for (;;) {
+		tab->ent[i].dev = NULL;
+		do {
+			j = (j + 1) & mask;
+			if (!tab->ent[j].dev)
+				return;
+			home = index_hash(tab, tab->ent[j].id, tab->ent[j].key);
+		} while (i <= j ? i < home && home <= j : i < home || home <= j);
+		tab->ent[i] = tab->ent[j];
+		i = j;
+	}
+}
+
+/* Check whether @dev comes before @other in their uclass */
+static bool index_dev_before(struct udevice *dev, struct udevice *other)
+{
+	struct udevice *pos;
+
+	uclass_foreach_dev(pos, dev->uclass) {
+		if (pos == dev)
+			return true;
+		if (pos == other)
+			return false;
+	}
+
+	return false;
+}
+
+static void index_add(struct uclass_index *idx, enum uclass_index_t type,
+		      struct udevice *dev)
+{
+	struct uclass_index_table *tab = &idx->table[type];
+	struct uclass_index_ent new, *ent;
+
+	if (!index_key(dev, type, &new.key))
+		return;
+	new.id = dev->uclass->uc_drv->id;
+	new.dev = dev;
+
+	ent = index_find(tab, new.id, new.key, NULL);
+	if (ent) {
+		tab->dups = true;
+		if (index_dev_before(dev, ent->dev))
+			ent->dev = dev;
+		return;
+	}
+	if (index_grow(tab)) {
+		log_debug("No memory to index '%s'\n", dev->name);
+		idx->failed = true;
+		return;
+	}
+	index_insert(tab, &new);
+}
+
+/* Drop @ent, which points to @dev, or hand it to another device with its key */
+static void index_drop(struct uclass_index *idx, enum uclass_index_t type,
+		       struct uclass_index_ent *ent, struct udevice *dev)
+{
+	struct uclass_index_table *tab = &idx->table[type];
+	struct udevice *other;
+	ulong key;
+
+	if (tab->dups) {
+		uclass_foreach_dev(other, dev->uclass) {
+			if (other != dev && index_key(other, type, &key) &&
+			    key == ent->key) {
+				ent->dev = other;
+				return;
+			}
+		}
+	}
+	index_delete(tab, ent);
+}
+
+static bool index_uses(struct uclass_index *idx, enum uclass_index_t type,
+		       struct udevice *dev)
+{
+	return type != UCLASS_INDEX_PHANDLE ||
+		idx->phandles[dev->uclass->uc_drv->id];
+}
+
+void uclass_index_add_device(struct udevice *dev)
+{
+	struct uclass_index *idx = gd->uclass_index;
+	int type;
+
+	if (!idx)
+		return;
+	for (type = 0; type < UCLASS_INDEX_COUNT; type++) {
+		if (index_uses(idx, type, dev))
+			index_add(idx, type, dev);
+	}
+}
+
+void uclass_index_remove_device(struct udevice *dev)
+{
+	struct uclass_index *idx = gd->uclass_index;
+	struct uclass_index_ent *ent;
+	ulong key;
+	int type;
+
+	if (!idx)
+		return;
+	for (type = 0; type < UCLASS_INDEX_COUNT; type++) {
+		struct uclass_index_table *tab = &idx->table[type];
+
+		if (!index_uses(idx, type, dev) || !index_key(dev, type, &key))
+			continue;
+		ent = index_find(tab, dev->uclass->uc_drv->id, key, NULL);
+		if (ent && ent->dev == dev)
+			index_drop(idx, type, ent, dev);
+	}
+}
+
+void uclass_index_update_device(struct udevice *dev)
+{
+	struct uclass_index *idx = gd->uclass_index;
+	struct uclass_index_ent *ent;
+	int type;
+
+	if (!idx)
+		return;
+
+	/* the old key is not known, so look for the device itself */
+	for (type = 0; type < UCLASS_INDEX_COUNT; type++) {
+		struct uclass_index_table *tab = &idx->table[type];
+
+		for (ent = tab->ent; ent < tab->ent + tab->size; ent++) {
+			if (ent->dev == dev) {
+				index_drop(idx, type, ent, dev);
+				break;
+			}
+		}
+	}
+	uclass_index_add_device(dev);
+}
+
+int uclass_index_find_device(struct uclass *uc, enum uclass_index_t type,
+			     ulong key, struct udevice **devp)
+{
+	struct uclass_index *idx = gd->uclass_index;
+	enum uclass_id id = uc->uc_drv->id;
+	struct uclass_index_ent *ent;
+	struct udevice *dev;
+
+	if (!idx || idx->failed)
+		return -ENOSYS;
+
+	if (type == UCLASS_INDEX_PHANDLE && !idx->phandles[id]) {
+		uclass_foreach_dev(dev, uc)
+			index_add(idx, type, dev);
+		if (idx->failed)
+			return -ENOSYS;
+		idx->phandles[id] = true;
+	}
+
+	idx->lookups++;
+	ent = index_find(&idx->table[type], id, key, &idx->steps);
+	if (!ent)
+		return -ENODEV;
+	*devp = ent->dev;
+
+	return 0;
+}
+
+void uclass_index_get_stats(ulong *lookupsp, ulong *stepsp)
+{
+	struct uclass_index *idx = gd->uclass_index;
+
+	*lookupsp = idx ? idx->lookups : 0;
+	*stepsp = idx ? idx->steps : 0;
+}
@@ -29,11 +29,10 @@ struct uclass *uclass_find(enum uclass_id key)
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX) &&
+	    !uclass_index_find_uclass(key, &uc))
+		return uc;
+
 	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -86,6 +85,8 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, DM_UCLASS_ROOT_NON_CONST);
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_add_uclass(uc);
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -101,6 +102,8 @@ fail:
 		free(uclass_get_priv(uc));
 		uclass_set_priv(uc, NULL);
 	}
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_remove_uclass(uc);
 	list_del(&uc->sibling_node);
 fail_mem:
 	free(uc);
@@ -134,6 +137,8 @@ int uclass_destroy(struct uclass *uc)
 	uc_drv = uc->uc_drv;
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_remove_uclass(uc);
 	list_del(&uc->sibling_node);
 	if (uc_drv->priv_auto)
 		free(uclass_get_priv(uc));
@@ -342,6 +347,12 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq, struct udevice **devp)
 	if (ret)
 		return ret;
 
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX)) {
+		ret = uclass_index_find_device(uc, UCLASS_INDEX_SEQ, seq, devp);
+		if (ret != -ENOSYS)
+			return ret;
+	}
+
 	uclass_foreach_dev(dev, uc) {
 		log_debug("   - %d '%s'\n", dev->seq_, dev->name);
 		if (dev->seq_ == seq) {
@@ -394,6 +405,13 @@ int uclass_find_device_by_ofnode(enum uclass_id id, ofnode node,
 	if (ret)
 		return ret;
 
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX)) {
+		ret = uclass_index_find_device(uc, UCLASS_INDEX_OFNODE,
+					       node.of_offset, devp);
+		if (ret != -ENOSYS)
+			goto done;
+	}
+
 	uclass_foreach_dev(dev, uc) {
 		log(LOGC_DM, LOGL_DEBUG_CONTENT, "      - checking %s\n",
 		    dev->name);
@@ -423,6 +441,13 @@ static int uclass_find_device_by_phandle_id(enum uclass_id id,
 	if (ret)
 		return ret;
 
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX)) {
+		ret = uclass_index_find_device(uc, UCLASS_INDEX_PHANDLE,
+					       find_phandle, devp);
+		if (ret != -ENOSYS)
+			return ret;
+	}
+
 	uclass_foreach_dev(dev, uc) {
 		uint phandle;
 
@@ -694,6 +719,8 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_add_device(dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -708,6 +735,8 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_remove_device(dev);
 	list_del(&dev->uclass_node);
 
 	return ret;
@@ -731,6 +760,8 @@ int uclass_pre_unbind_device(struct udevice *dev)
 
 int uclass_unbind_device(struct udevice *dev)
 {
+	if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+		uclass_index_remove_device(dev);
 	list_del(&dev->uclass_node);
 
 	return 0;
@@ -84,6 +84,36 @@ int mmc_wait_dat0(struct mmc *mmc, int state, int timeout_us)
 	return dm_mmc_wait_dat0(mmc->dev, state, timeout_us);
 }
 
+static int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+				 struct mmc_data *data)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->send_cmd_start || !ops->poll_data)
+		return -ENOSYS;
+	return ops->send_cmd_start(dev, cmd, data);
+}
+
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	return dm_mmc_send_cmd_start(mmc->dev, cmd, data);
+}
+
+static int dm_mmc_poll_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->poll_data)
+		return -ENOSYS;
+	return ops->poll_data(dev, data);
+}
+
+int mmc_poll_data(struct mmc *mmc, struct mmc_data *data)
+{
+	return dm_mmc_poll_data(mmc->dev, data);
+}
+
 static int dm_mmc_get_wp(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -525,6 +555,10 @@ static const struct blk_ops mmc_blk_ops = {
 	.erase	= mmc_berase,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit		= mmc_bsubmit,
+	.poll		= mmc_bpoll,
+#endif
 };
 
 U_BOOT_DRIVER(mmc_blk) = {
@@ -532,6 +566,9 @@ U_BOOT_DRIVER(mmc_blk) = {
 	.id		= UCLASS_BLK,
 	.ops		= &mmc_blk_ops,
 	.probe		= mmc_blk_probe,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.priv_auto	= sizeof(struct mmc_blk_priv),
+#endif
 #if CONFIG_IS_ENABLED(MMC_UHS_SUPPORT) || \
     CONFIG_IS_ENABLED(MMC_HS200_SUPPORT) || \
     CONFIG_IS_ENABLED(MMC_HS400_SUPPORT)
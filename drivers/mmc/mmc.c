@@ -398,44 +398,60 @@ int mmc_send_tuning(struct mmc *mmc, u32 opcode, int *cmd_error)
 }
 #endif
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+static void mmc_setup_read(struct mmc *mmc, struct mmc_cmd *cmd,
+			   struct mmc_data *data, void *dst, lbaint_t start,
 			   lbaint_t blkcnt)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
-
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
 
-	if (mmc_send_cmd(mmc, &cmd, &data))
-		return 0;
+static int mmc_stop_read(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+	int err;
 
-	if (blkcnt > 1) {
-		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
-		cmd.cmdarg = 0;
-		cmd.resp_type = MMC_RSP_R1b;
-		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+	cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+	cmd.cmdarg = 0;
+	cmd.resp_type = MMC_RSP_R1b;
+	err = mmc_send_cmd(mmc, &cmd, NULL);
+	if (err) {
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-			pr_err("mmc fail to send stop cmd\n");
+		pr_err("mmc fail to send stop cmd\n");
 #endif
-			return 0;
-		}
+		return err;
 	}
 
+	return 0;
+}
+
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+
+	mmc_setup_read(mmc, &cmd, &data, dst, start, blkcnt);
+	if (mmc_send_cmd(mmc, &cmd, &data))
+		return 0;
+
+	if (blkcnt > 1 && mmc_stop_read(mmc))
+		return 0;
+
 	return blkcnt;
 }
 
@@ -508,6 +524,94 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	return blkcnt;
 }
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC) && CONFIG_IS_ENABLED(DM_MMC)
+/* Send the read command for the next piece of the request */
+static int mmc_bsubmit_next(struct mmc *mmc, struct mmc_blk_priv *priv)
+{
+	struct blk_request *req = priv->req;
+	lbaint_t cur = min_t(lbaint_t, req->blkcnt - priv->done, priv->b_max);
+	struct mmc_cmd cmd;
+
+	mmc_setup_read(mmc, &cmd, &priv->data, req->buffer +
+		       priv->done * mmc->read_bl_len, req->start + priv->done,
+		       cur);
+
+	return mmc_send_cmd_start(mmc, &cmd, &priv->data);
+}
+
+/*
+ * Reads are started in the background if the controller supports it. Writes
+ * are left to mmc_bwrite(), since the card must finish programming before
+ * anything else can be done.
+ */
+int mmc_bsubmit(struct udevice *dev, struct blk_request *req)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	struct mmc_blk_priv *priv = dev_get_priv(dev);
+	struct mmc *mmc;
+	int err;
+
+	mmc = find_mmc_device(block_dev->devnum);
+	if (!mmc)
+		return -ENODEV;
+	if (req->write || !mmc_get_ops(mmc->dev)->send_cmd_start)
+		return -ENOSYS;
+	if (priv->req)
+		return -EAGAIN;
+	if (!req->blkcnt || req->start + req->blkcnt > block_dev->lba)
+		return -EINVAL;
+
+	err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
+	if (err < 0)
+		return err;
+	err = mmc_set_blocklen(mmc, mmc->read_bl_len);
+	if (err)
+		return err;
+
+	priv->req = req;
+	priv->done = 0;
+	priv->b_max = mmc_get_b_max(mmc, req->buffer, req->blkcnt);
+	err = mmc_bsubmit_next(mmc, priv);
+	if (err)
+		priv->req = NULL;
+
+	return err;
+}
+
+int mmc_bpoll(struct udevice *dev)
+{
+	struct blk_desc *block_dev = dev_get_uclass_plat(dev);
+	struct mmc_blk_priv *priv = dev_get_priv(dev);
+	struct blk_request *req = priv->req;
+	struct mmc *mmc;
+	int err;
+
+	if (!req)
+		return 0;
+
+	mmc = find_mmc_device(block_dev->devnum);
+	err = mmc_poll_data(mmc, &priv->data);
+	if (err == -EBUSY)
+		return 0;
+
+	if (!err && priv->data.blocks > 1)
+		err = mmc_stop_read(mmc);
+	if (!err) {
+		priv->done += priv->data.blocks;
+		if (priv->done < req->blkcnt) {
+			err = mmc_bsubmit_next(mmc, priv);
+			if (!err)
+				return 0;
+		}
+	}
+
+	priv->req = NULL;
+	blk_complete(req, err ? err : priv->done);
+
+	return 0;
+}
+#endif
+
 static int mmc_go_idle(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
@@ -25,6 +25,26 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		void *dst);
 #endif
 
+#if CONFIG_IS_ENABLED(BLK_ASYNC) && CONFIG_IS_ENABLED(DM_MMC)
+/**
+ * struct mmc_blk_priv - Asynchronous read in progress on an MMC block device
+ *
+ * @req: Request being read, or NULL if none
+ * @data: Data transfer of the command in flight
+ * @b_max: Most blocks to read with one command
+ * @done: Number of blocks read so far
+ */
+struct mmc_blk_priv {
+	struct blk_request *req;
+	struct mmc_data data;
+	uint b_max;
+	lbaint_t done;
+};
+
+int mmc_bsubmit(struct udevice *dev, struct blk_request *req);
+int mmc_bpoll(struct udevice *dev);
+#endif
+
 #if CONFIG_IS_ENABLED(MMC_WRITE)
 
 #if CONFIG_IS_ENABLED(BLK)
@@ -185,6 +185,32 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 	return 0;
 }
 
+/* Clear up after a command, resetting the controller if it failed */
+static int sdhci_finish_command(struct sdhci_host *host, struct mmc_data *data,
+				int ret, int is_aligned, int trans_bytes)
+{
+	unsigned int stat;
+
+	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
+		udelay(1000);
+
+	stat = sdhci_readl(host, SDHCI_INT_STATUS);
+	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
+	if (!ret) {
+		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+				!is_aligned && (data->flags == MMC_DATA_READ))
+			memcpy(data->dest, host->align_buffer, trans_bytes);
+		return 0;
+	}
+
+	sdhci_reset(host, SDHCI_RESET_CMD);
+	sdhci_reset(host, SDHCI_RESET_DATA);
+	if (stat & SDHCI_INT_TIMEOUT)
+		return -ETIMEDOUT;
+	else
+		return -ECOMM;
+}
+
 /*
  * No command will be sent by driver if card is busy, so driver must wait
  * for card ready state.
@@ -196,17 +222,13 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data)
 #define SDHCI_CMD_DEFAULT_TIMEOUT		100
 #define SDHCI_READ_STATUS_TIMEOUT		1000
 
-#ifdef CONFIG_DM_MMC
-static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
-			      struct mmc_data *data)
-{
-	struct mmc *mmc = mmc_get_mmc_dev(dev);
-
-#else
-static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
-			      struct mmc_data *data)
+/*
+ * Send a command and transfer its data. With @background, return as soon as
+ * the card has responded, leaving the data to move by DMA.
+ */
+static int sdhci_issue_command(struct mmc *mmc, struct mmc_cmd *cmd,
+			       struct mmc_data *data, bool background)
 {
-#endif
 	struct sdhci_host *host = mmc->priv;
 	unsigned int stat = 0;
 	int ret = 0;
@@ -322,28 +344,74 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	} else
 		ret = -1;
 
+	if (!ret && data && background)
+		return 0;
+
 	if (!ret && data)
 		ret = sdhci_transfer_data(host, data);
 
-	if (host->quirks & SDHCI_QUIRK_WAIT_SEND_CMD)
-		udelay(1000);
+	return sdhci_finish_command(host, data, ret, is_aligned, trans_bytes);
+}
+
+#ifdef CONFIG_DM_MMC
+static int sdhci_send_command(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
+{
+	return sdhci_issue_command(mmc_get_mmc_dev(dev), cmd, data, false);
+}
+#else
+static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
+			      struct mmc_data *data)
+{
+	return sdhci_issue_command(mmc, cmd, data, false);
+}
+#endif
+
+#if defined(CONFIG_DM_MMC) && CONFIG_IS_ENABLED(MMC_SDHCI_ADMA) && \
+	CONFIG_IS_ENABLED(BLK_ASYNC)
+/* Longest time a data transfer may take, in milliseconds */
+#define SDHCI_DATA_TIMEOUT			10000
+
+static int sdhci_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+				struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+
+	/* SDMA stops at each boundary and needs the CPU to carry on */
+	if (!data || !(host->flags & (USE_ADMA | USE_ADMA64)))
+		return -ENOSYS;
+
+	host->data_start = get_timer(0);
+
+	return sdhci_issue_command(mmc, cmd, data, true);
+}
+
+static int sdhci_poll_data(struct udevice *dev, struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct sdhci_host *host = mmc->priv;
+	unsigned int stat;
+	int ret = 0;
 
 	stat = sdhci_readl(host, SDHCI_INT_STATUS);
-	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
-	if (!ret) {
-		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
-				!is_aligned && (data->flags == MMC_DATA_READ))
-			memcpy(data->dest, host->align_buffer, trans_bytes);
-		return 0;
+	if (stat & SDHCI_INT_ERROR) {
+		pr_debug("%s: Error detected in status(0x%X)!\n", __func__,
+			 stat);
+		ret = -EIO;
+	} else if (!(stat & SDHCI_INT_DATA_END)) {
+		if (get_timer(host->data_start) < SDHCI_DATA_TIMEOUT)
+			return -EBUSY;
+		printf("%s: Transfer data timeout\n", __func__);
+		ret = -ETIMEDOUT;
 	}
 
-	sdhci_reset(host, SDHCI_RESET_CMD);
-	sdhci_reset(host, SDHCI_RESET_DATA);
-	if (stat & SDHCI_INT_TIMEOUT)
-		return -ETIMEDOUT;
-	else
-		return -ECOMM;
+	dma_unmap_single(host->start_addr, data->blocks * data->blocksize,
+			 mmc_get_dma_dir(data));
+
+	return sdhci_finish_command(host, data, ret, 1, 0);
 }
+#endif
 
 #if defined(CONFIG_DM_MMC) && defined(MMC_SUPPORTS_TUNING)
 static int sdhci_execute_tuning(struct udevice *dev, uint opcode)
@@ -849,6 +917,10 @@ const struct dm_mmc_ops sdhci_ops = {
 #if CONFIG_IS_ENABLED(MMC_HS400_ES_SUPPORT)
 	.set_enhanced_strobe = sdhci_set_enhanced_strobe,
 #endif
+#if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA) && CONFIG_IS_ENABLED(BLK_ASYNC)
+	.send_cmd_start	= sdhci_send_cmd_start,
+	.poll_data	= sdhci_poll_data,
+#endif
 };
 #else
 static const struct mmc_ops sdhci_ops = {
@@ -29,6 +29,7 @@
 #include <linux/err.h>
 #include <linux/kernel.h>
 #include <asm/io.h>
+#include <wait_bit.h>
 #include <power/regulator.h>
 #include "designware.h"
 
@@ -299,6 +300,8 @@ static void rx_descs_init(struct dw_eth_dev *priv)
 
 	writel((ulong)&desc_table_p[0], &dma_p->rxdesclistaddr);
 	priv->rx_currdescnum = 0;
+	priv->rx_held = 0;
+	priv->rx_place_desc = -1;
 }
 
 static int _dw_write_hwaddr(struct dw_eth_dev *priv, u8 *mac_id)
@@ -506,24 +509,136 @@ static int _dw_eth_send(struct dw_eth_dev *priv, void *packet, int length)
 	return 0;
 }
 
-static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
+/* Cache maintenance on a buffer which need not be cache aligned */
+static void _dw_invalidate_buf(const void *buf, int len)
+{
+	invalidate_dcache_range(rounddown((ulong)buf, ARCH_DMA_MINALIGN),
+				roundup((ulong)buf + len, ARCH_DMA_MINALIGN));
+}
+
+static void _dw_invalidate_desc(struct dmamacdescr *desc_p)
+{
+	ulong desc_start = (ulong)desc_p;
+
+	invalidate_dcache_range(desc_start, desc_start +
+				roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN));
+}
+
+static void _dw_flush_desc(struct dmamacdescr *desc_p)
+{
+	ulong desc_start = (ulong)desc_p;
+
+	flush_dcache_range(desc_start, desc_start +
+			   roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN));
+}
+
+/* Point a receive descriptor back at its own buffer */
+static void _dw_rx_desc_own_buf(struct dw_eth_dev *priv, u32 desc_num)
+{
+	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+
+	desc_p->dmamac_addr = (ulong)&priv->rxbuffs[desc_num * CFG_ETH_BUFSIZE];
+	desc_p->dmamac_cntl = (MAC_MAX_FRAME_SZ & DESC_RXCTRL_SIZE1MASK) |
+			      DESC_RXCTRL_RXCHAIN;
+}
+
+/*
+ * Stop the receive DMA, once it is done with the frame it may be writing, so
+ * that it reads the current descriptor again when started
+ */
+static int _dw_rx_dma_stop(struct dw_eth_dev *priv)
+{
+	struct eth_dma_regs *dma_p = priv->dma_regs_p;
+
+	writel(readl(&dma_p->opmode) & ~RXSTART, &dma_p->opmode);
+
+	return wait_for_bit_le32(&dma_p->status, RXSTATEMASK, false, 10,
+				 false);
+}
+
+static void _dw_rx_dma_start(struct dw_eth_dev *priv)
+{
+	struct eth_dma_regs *dma_p = priv->dma_regs_p;
+
+	writel(readl(&dma_p->opmode) | RXSTART, &dma_p->opmode);
+	writel(POLL_DATA, &dma_p->rxpolldemand);
+}
+
+/*
+ * Receive a frame which the DMA put in place. The buffer of the descriptor is
+ * the place rounded down to what the DMA takes, so the end of a frame which
+ * fills the place, and its FCS, go on into the buffer of the next descriptor
+ * and are copied back from there. A frame too long for the place is copied
+ * into the buffer of the descriptor instead, like any other packet.
+ */
+static int _dw_eth_recv_placed(struct dw_eth_dev *priv, u32 desc_num,
+			       u32 status, uchar **packetp, u32 *descsp)
+{
+	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	u32 next_num = (desc_num + 1) % CFG_RX_DESCR_NUM;
+	struct dmamacdescr *next_p = &priv->rx_mac_descrtable[next_num];
+	uchar *place = (uchar *)(ulong)desc_p->dmamac_addr;
+	uchar *next_buf = (uchar *)(ulong)next_p->dmamac_addr;
+	uchar *buf = (uchar *)&priv->rxbuffs[desc_num * CFG_ETH_BUFSIZE];
+	int size = desc_p->dmamac_cntl & DESC_RXCTRL_SIZE1MASK;
+	int length;
+
+	if (status & DESC_RXSTS_RXLAST) {
+		length = (status & DESC_RXSTS_FRMLENMSK) >>
+			 DESC_RXSTS_FRMLENSHFT;
+		_dw_invalidate_buf(place, length);
+		*packetp = place;
+		*descsp = 1;
+		priv->rx_place_desc = -1;
+
+		return length;
+	}
+
+	_dw_invalidate_desc(next_p);
+	status = next_p->txrx_status;
+	if (status & DESC_RXSTS_OWNBYDMA)
+		return -EAGAIN;
+
+	length = (status & DESC_RXSTS_FRMLENMSK) >> DESC_RXSTS_FRMLENSHFT;
+	length = clamp(length, size, MAC_MAX_FRAME_SZ);
+	_dw_invalidate_buf(place, size);
+	_dw_invalidate_buf(next_buf, length - size);
+	if ((status & DESC_RXSTS_RXLAST) &&
+	    length - ETH_FCS_LEN <= priv->rx_place_size) {
+		length -= ETH_FCS_LEN;
+		if (length > size)
+			memcpy(place + size, next_buf, length - size);
+		*packetp = place;
+	} else {
+		memcpy(buf, place, size);
+		memcpy(buf + size, next_buf, length - size);
+		*packetp = buf;
+	}
+	*descsp = 2;
+	priv->rx_place_desc = -1;
+
+	return length;
+}
+
+static int _dw_eth_recv_desc(struct dw_eth_dev *priv, u32 desc_num,
+			     uchar **packetp, u32 *descsp)
 {
-	u32 status, desc_num = priv->rx_currdescnum;
+	u32 status;
 	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
 	int length = -EAGAIN;
-	ulong desc_start = (ulong)desc_p;
-	ulong desc_end = desc_start +
-		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
 	ulong data_start = desc_p->dmamac_addr;
 	ulong data_end;
 
 	/* Invalidate entire buffer descriptor */
-	invalidate_dcache_range(desc_start, desc_end);
+	_dw_invalidate_desc(desc_p);
 
 	status = desc_p->txrx_status;
 
 	/* Check  if the owner is the CPU */
 	if (!(status & DESC_RXSTS_OWNBYDMA)) {
+		if (desc_num == priv->rx_place_desc)
+			return _dw_eth_recv_placed(priv, desc_num, status,
+						   packetp, descsp);
 
 		length = (status & DESC_RXSTS_FRMLENMSK) >>
 			 DESC_RXSTS_FRMLENSHFT;
@@ -532,36 +647,164 @@ static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
 		data_end = data_start + roundup(length, ARCH_DMA_MINALIGN);
 		invalidate_dcache_range(data_start, data_end);
 		*packetp = (uchar *)(ulong)desc_p->dmamac_addr;
+		*descsp = 1;
 	}
 
 	return length;
 }
 
-static int _dw_free_pkt(struct dw_eth_dev *priv)
+static int _dw_eth_recv(struct dw_eth_dev *priv, uchar **packetp)
+{
+	u32 descs;
+	int length;
+
+	length = _dw_eth_recv_desc(priv, priv->rx_currdescnum, packetp, &descs);
+	if (length >= 0)
+		priv->rx_held = descs;
+
+	return length;
+}
+
+static int _dw_eth_recv_batch(struct dw_eth_dev *priv,
+			      struct eth_rx_pkt *pkts, int count)
 {
 	u32 desc_num = priv->rx_currdescnum;
-	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
-	ulong desc_start = (ulong)desc_p;
-	ulong desc_end = desc_start +
-		roundup(sizeof(*desc_p), ARCH_DMA_MINALIGN);
+	u32 held = 0;
+	u32 descs;
+	int length;
+	int i;
+
+	count = min(count, CFG_RX_DESCR_NUM);
+	for (i = 0; i < count; i++) {
+		/*
+		 * A packet received in place starts a batch, so that the place
+		 * is not cancelled while it is held in the batch
+		 */
+		if (i && desc_num == priv->rx_place_desc)
+			break;
+		length = _dw_eth_recv_desc(priv, desc_num, &pkts[i].packet,
+					   &descs);
+		if (length < 0)
+			break;
+		pkts[i].len = length;
+		held += descs;
 
-	/*
-	 * Make the current descriptor valid again and go to
-	 * the next one
-	 */
-	desc_p->txrx_status |= DESC_RXSTS_OWNBYDMA;
+		desc_num = (desc_num + descs) % CFG_RX_DESCR_NUM;
+	}
+	priv->rx_held = held;
 
-	/* Flush only status field - others weren't changed */
-	flush_dcache_range(desc_start, desc_end);
+	return i;
+}
 
-	/* Test the wrap-around condition. */
-	if (++desc_num >= CFG_RX_DESCR_NUM)
-		desc_num = 0;
+/* Give the descriptors handed out back to the DMA */
+static int _dw_free_held(struct dw_eth_dev *priv)
+{
+	struct dmamacdescr *desc_p = priv->rx_mac_descrtable;
+	u32 first = priv->rx_currdescnum;
+	u32 desc_num = first;
+	u32 count = max(priv->rx_held, 1U);
+	u32 i;
+
+	for (i = 0; i < count; i++) {
+		if (desc_p[desc_num].dmamac_addr !=
+		    (ulong)&priv->rxbuffs[desc_num * CFG_ETH_BUFSIZE])
+			_dw_rx_desc_own_buf(priv, desc_num);
+		desc_p[desc_num].txrx_status |= DESC_RXSTS_OWNBYDMA;
+		if (++desc_num >= CFG_RX_DESCR_NUM)
+			desc_num = 0;
+	}
+
+	/*
+	 * The descriptors are a cache line each, so those of the batch are
+	 * flushed together, in two ranges if the batch wraps around
+	 */
+	if (desc_num > first) {
+		flush_dcache_range((ulong)&desc_p[first],
+				   (ulong)&desc_p[desc_num]);
+	} else {
+		flush_dcache_range((ulong)&desc_p[first],
+				   (ulong)&desc_p[CFG_RX_DESCR_NUM]);
+		flush_dcache_range((ulong)desc_p, (ulong)&desc_p[desc_num]);
+	}
 	priv->rx_currdescnum = desc_num;
+	priv->rx_held = 0;
 
 	return 0;
 }
 
+/* Take back the place from a descriptor which has not received into it */
+static int _dw_rx_place_cancel(struct dw_eth_dev *priv)
+{
+	struct dmamacdescr *desc_p;
+	int ret;
+
+	if (priv->rx_place_desc < 0)
+		return 0;
+
+	desc_p = &priv->rx_mac_descrtable[priv->rx_place_desc];
+	/* a DMA which does not stop may still receive into the place */
+	ret = _dw_rx_dma_stop(priv) ? -EBUSY : 0;
+	if (!ret) {
+		_dw_invalidate_desc(desc_p);
+		if (desc_p->txrx_status & DESC_RXSTS_OWNBYDMA) {
+			_dw_rx_desc_own_buf(priv, priv->rx_place_desc);
+			_dw_flush_desc(desc_p);
+			priv->rx_place_desc = -1;
+		} else {
+			/* recv() returns the packet there later on */
+			ret = -EBUSY;
+		}
+	}
+	_dw_rx_dma_start(priv);
+
+	return ret;
+}
+
+/*
+ * Point the descriptor the DMA fills next at the place. The DMA is stopped
+ * meanwhile, as it may have read that descriptor already.
+ */
+static int _dw_rx_place(struct dw_eth_dev *priv,
+			const struct eth_rx_place *place)
+{
+	u32 desc_num = (priv->rx_currdescnum + priv->rx_held) %
+		       CFG_RX_DESCR_NUM;
+	struct dmamacdescr *desc_p = &priv->rx_mac_descrtable[desc_num];
+	uchar *start = place->buf - place->hdr_len;
+	int len = place->hdr_len + place->len;
+	int size;
+	int ret;
+
+	/* the buffer size must be a multiple of the bus width */
+	size = rounddown(min(len, MAC_MAX_FRAME_SZ), 16);
+	if (!size)
+		return -ENOSYS;
+	if (priv->rx_place_desc >= 0)
+		return -EBUSY;
+
+	ret = _dw_rx_dma_stop(priv);
+	if (!ret) {
+		_dw_invalidate_desc(desc_p);
+		/* packets already received are processed first */
+		if (!(desc_p->txrx_status & DESC_RXSTS_OWNBYDMA))
+			ret = -EBUSY;
+	}
+	if (!ret) {
+		flush_dcache_range(rounddown((ulong)start, ARCH_DMA_MINALIGN),
+				   roundup((ulong)start + size,
+					   ARCH_DMA_MINALIGN));
+		desc_p->dmamac_addr = (ulong)start;
+		desc_p->dmamac_cntl = (size & DESC_RXCTRL_SIZE1MASK) |
+				      DESC_RXCTRL_RXCHAIN;
+		_dw_flush_desc(desc_p);
+		priv->rx_place_desc = desc_num;
+		priv->rx_place_size = len;
+	}
+	_dw_rx_dma_start(priv);
+
+	return ret;
+}
+
 static int dw_phy_init(struct dw_eth_dev *priv, void *dev)
 {
 	struct phy_device *phydev;
@@ -631,7 +874,34 @@ int designware_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct dw_eth_dev *priv = dev_get_priv(dev);
 
-	return _dw_free_pkt(priv);
+	return _dw_free_held(priv);
+}
+
+int designware_eth_rx_place(struct udevice *dev,
+			    const struct eth_rx_place *place)
+{
+	struct dw_eth_dev *priv = dev_get_priv(dev);
+
+	if (!place)
+		return _dw_rx_place_cancel(priv);
+
+	return _dw_rx_place(priv, place);
+}
+
+int designware_eth_recv_batch(struct udevice *dev, int flags,
+			      struct eth_rx_pkt *pkts, int count)
+{
+	struct dw_eth_dev *priv = dev_get_priv(dev);
+
+	return _dw_eth_recv_batch(priv, pkts, count);
+}
+
+int designware_eth_free_batch(struct udevice *dev, struct eth_rx_pkt *pkts,
+			      int count)
+{
+	struct dw_eth_dev *priv = dev_get_priv(dev);
+
+	return _dw_free_held(priv);
 }
 
 void designware_eth_stop(struct udevice *dev)
@@ -800,6 +1070,9 @@ const struct eth_ops designware_eth_ops = {
 	.free_pkt		= designware_eth_free_pkt,
 	.stop			= designware_eth_stop,
 	.write_hwaddr		= designware_eth_write_hwaddr,
+	.rx_place		= designware_eth_rx_place,
+	.recv_batch		= designware_eth_recv_batch,
+	.free_batch		= designware_eth_free_batch,
 };
 
 int designware_eth_of_to_plat(struct udevice *dev)
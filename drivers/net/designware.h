@@ -108,6 +108,9 @@ struct eth_dma_regs {
 #define TXSECONDFRAME		(1 << 2)
 #define RXSTART			(1 << 1)
 
+/* Status definitions */
+#define RXSTATEMASK		(7 << 17)
+
 /* Descriptior related definitions */
 #define MAC_MAX_FRAME_SZ	(1600)
 
@@ -230,6 +233,9 @@ struct dw_eth_dev {
 	u32 max_speed;
 	u32 tx_currdescnum;
 	u32 rx_currdescnum;
+	u32 rx_held;		/* descriptors handed out, not freed yet */
+	int rx_place_desc;	/* descriptor receiving in place, or -1 */
+	u32 rx_place_size;	/* length of the place, headers included */
 
 	struct eth_mac_regs *mac_regs_p;
 	struct eth_dma_regs *dma_regs_p;
@@ -260,6 +266,12 @@ int designware_eth_send(struct udevice *dev, void *packet, int length);
 int designware_eth_recv(struct udevice *dev, int flags, uchar **packetp);
 int designware_eth_free_pkt(struct udevice *dev, uchar *packet,
 				   int length);
+int designware_eth_rx_place(struct udevice *dev,
+			    const struct eth_rx_place *place);
+int designware_eth_recv_batch(struct udevice *dev, int flags,
+			      struct eth_rx_pkt *pkts, int count);
+int designware_eth_free_batch(struct udevice *dev, struct eth_rx_pkt *pkts,
+			      int count);
 void designware_eth_stop(struct udevice *dev);
 int designware_eth_write_hwaddr(struct udevice *dev);
 
@@ -691,6 +691,9 @@ const struct eth_ops gmac_rockchip_eth_ops = {
 	.free_pkt		= designware_eth_free_pkt,
 	.stop			= designware_eth_stop,
 	.write_hwaddr		= designware_eth_write_hwaddr,
+	.rx_place		= designware_eth_rx_place,
+	.recv_batch		= designware_eth_recv_batch,
+	.free_batch		= designware_eth_free_batch,
 };
 
 const struct rk_gmac_ops px30_gmac_ops = {
@@ -327,9 +327,11 @@ static int sb_eth_start(struct udevice *dev)
 	debug("eth_sandbox: Start\n");
 
 	priv->recv_packets = 0;
+	priv->place.buf = NULL;
 	for (int i = 0; i < PKTBUFSRX; i++) {
 		priv->recv_packet_buffer[i] = net_rx_packets[i];
 		priv->recv_packet_length[i] = 0;
+		priv->batch_buffer[i] = priv->batch_mem[i];
 	}
 
 	return 0;
@@ -362,11 +364,34 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		debug("eth_sandbox: received packet[%d], %d waiting\n",
 		      lcl_recv_packet_length, priv->recv_packets - 1);
 		*packetp = priv->recv_packet_buffer[0];
+
+		/* do what DMA into the place given would do */
+		if (priv->place.buf && lcl_recv_packet_length <=
+		    priv->place.hdr_len + priv->place.len) {
+			*packetp = priv->place.buf - priv->place.hdr_len;
+			memcpy(*packetp, priv->recv_packet_buffer[0],
+			       lcl_recv_packet_length);
+		}
+		priv->place.buf = NULL;
+
 		return lcl_recv_packet_length;
 	}
 	return 0;
 }
 
+static int sb_eth_rx_place(struct udevice *dev,
+			   const struct eth_rx_place *place)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+
+	if (place)
+		priv->place = *place;
+	else
+		priv->place.buf = NULL;
+
+	return 0;
+}
+
 static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -387,6 +412,46 @@ static int sb_eth_free_pkt(struct udevice *dev, uchar *packet, int length)
 	return 0;
 }
 
+/*
+ * Hand out the packets queued, taking their buffers out of the queue so
+ * that the responses to them can be queued while they are processed
+ */
+static int sb_eth_recv_batch(struct udevice *dev, int flags,
+			     struct eth_rx_pkt *pkts, int count)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	uchar *buf[PKTBUFSRX];
+	int i;
+
+	if (!priv->recv_packets)
+		return sb_eth_recv(dev, flags, &pkts[0].packet);
+
+	/* the first packet is the one the place given applies to */
+	pkts[0].len = sb_eth_recv(dev, flags, &pkts[0].packet);
+	count = min(count, priv->recv_packets);
+	for (i = 0; i < count; i++) {
+		if (i)
+			pkts[i].packet = priv->recv_packet_buffer[i];
+		pkts[i].len = priv->recv_packet_length[i];
+		buf[i] = priv->batch_buffer[i];
+		priv->batch_buffer[i] = priv->recv_packet_buffer[i];
+	}
+
+	priv->recv_packets -= count;
+	for (i = 0; i < priv->recv_packets; i++) {
+		priv->recv_packet_buffer[i] =
+			priv->recv_packet_buffer[i + count];
+		priv->recv_packet_length[i] =
+			priv->recv_packet_length[i + count];
+	}
+	for (i = 0; i < count; i++) {
+		priv->recv_packet_buffer[priv->recv_packets + i] = buf[i];
+		priv->recv_packet_length[priv->recv_packets + i] = 0;
+	}
+
+	return count;
+}
+
 static void sb_eth_stop(struct udevice *dev)
 {
 	debug("eth_sandbox: Stop\n");
@@ -410,6 +475,8 @@ static const struct eth_ops sb_eth_ops = {
 	.free_pkt		= sb_eth_free_pkt,
 	.stop			= sb_eth_stop,
 	.write_hwaddr		= sb_eth_write_hwaddr,
+	.rx_place		= sb_eth_rx_place,
+	.recv_batch		= sb_eth_recv_batch,
 };
 
 static int sb_eth_remove(struct udevice *dev)
@@ -8,6 +8,7 @@
 #include <blk.h>
 #include <bootdev.h>
 #include <cpu_func.h>
+#include <cyclic.h>
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
@@ -18,15 +19,22 @@
 #include <linux/compat.h>
 #include "nvme.h"
 
-#define NVME_Q_DEPTH		2
+/* A submission queue of this depth fills one page */
+#define NVME_Q_DEPTH		64
+/*
+ * Controller-specific completion, which frees submission entries in order,
+ * handles one command at a time
+ */
+#define NVME_Q_DEPTH_LINEAR	2
 #define NVME_AQ_DEPTH		2
 #define NVME_SQ_SIZE(depth)	(depth * sizeof(struct nvme_command))
 #define NVME_CQ_SIZE(depth)	(depth * sizeof(struct nvme_completion))
-#define NVME_CQ_ALLOCATION	ALIGN(NVME_CQ_SIZE(NVME_Q_DEPTH), \
-				      ARCH_DMA_MINALIGN)
+#define NVME_CQ_ALLOCATION(depth)	ALIGN(NVME_CQ_SIZE(depth), \
+					      ARCH_DMA_MINALIGN)
 #define ADMIN_TIMEOUT		60
 #define IO_TIMEOUT		30
-#define MAX_PRP_POOL		512
+/* Largest transfer of a single read or write command, 1MB */
+#define NVME_MAX_TRANSFER_SHIFT	20
 
 static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 {
@@ -40,17 +48,31 @@ static int nvme_wait_csts(struct nvme_dev *dev, u32 mask, u32 val)
 	while (get_timer(start) < timeout) {
 		if ((readl(&dev->bar->csts) & mask) == val)
 			return 0;
+		schedule();
 	}
 
 	return -ETIME;
 }
 
-static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
-			   int total_len, u64 dma_addr)
+/* Number of pages of PRP list needed by a command of the largest size */
+static u32 nvme_prp_list_pages(struct nvme_dev *dev)
+{
+	u32 prps_per_page = dev->page_size >> 3;
+	u32 nprps = (1 << dev->max_transfer_shift) / dev->page_size;
+
+	return max(DIV_ROUND_UP(nprps - 1, prps_per_page - 1), 1U);
+}
+
+/*
+ * Set up the PRPs for a transfer of @total_len bytes at @dma_addr, using
+ * @prp_list, which holds enough pages for the largest transfer
+ */
+static void nvme_setup_prps(struct nvme_dev *dev, u64 *prp2, u64 *prp_list,
+			    int total_len, u64 dma_addr)
 {
 	u32 page_size = dev->page_size;
 	int offset = dma_addr & (page_size - 1);
-	u64 *prp_pool;
+	u64 *prp_pool = prp_list;
 	int length = total_len;
 	int i, nprps;
 	u32 prps_per_page = page_size >> 3;
@@ -60,7 +82,7 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 
 	if (length <= 0) {
 		*prp2 = 0;
-		return 0;
+		return;
 	}
 
 	if (length)
@@ -68,45 +90,28 @@ static int nvme_setup_prps(struct nvme_dev *dev, u64 *prp2,
 
 	if (length <= page_size) {
 		*prp2 = dma_addr;
-		return 0;
+		return;
 	}
 
 	nprps = DIV_ROUND_UP(length, page_size);
 	num_pages = DIV_ROUND_UP(nprps - 1, prps_per_page - 1);
 
-	if (nprps > dev->prp_entry_num) {
-		free(dev->prp_pool);
-		/*
-		 * Always increase in increments of pages.  It doesn't waste
-		 * much memory and reduces the number of allocations.
-		 */
-		dev->prp_pool = memalign(page_size, num_pages * page_size);
-		if (!dev->prp_pool) {
-			printf("Error: malloc prp_pool fail\n");
-			return -ENOMEM;
-		}
-		dev->prp_entry_num = num_pages * (prps_per_page - 1) + 1;
-	}
-
-	prp_pool = dev->prp_pool;
 	i = 0;
 	while (nprps) {
 		if ((i == (prps_per_page - 1)) && nprps > 1) {
 			*(prp_pool + i) = cpu_to_le64((ulong)prp_pool +
 					page_size);
 			i = 0;
-			prp_pool += page_size;
+			prp_pool += prps_per_page;
 		}
 		*(prp_pool + i++) = cpu_to_le64(dma_addr);
 		dma_addr += page_size;
 		nprps--;
 	}
-	*prp2 = (ulong)dev->prp_pool;
+	*prp2 = (ulong)prp_list;
 
-	flush_dcache_range((ulong)dev->prp_pool, (ulong)dev->prp_pool +
+	flush_dcache_range((ulong)prp_list, (ulong)prp_list +
 			   num_pages * page_size);
-
-	return 0;
 }
 
 static __le16 nvme_get_cmd_id(void)
@@ -125,7 +130,7 @@ static u16 nvme_read_completion_status(struct nvme_queue *nvmeq, u16 index)
 	 * as the cache line should never become dirty.
 	 */
 	ulong start = (ulong)&nvmeq->cqes[0];
-	ulong stop = start + NVME_CQ_ALLOCATION;
+	ulong stop = start + NVME_CQ_ALLOCATION(nvmeq->q_depth);
 
 	invalidate_dcache_range(start, stop);
 
@@ -159,52 +164,36 @@ static void nvme_submit_cmd(struct nvme_queue *nvmeq, struct nvme_command *cmd)
 	nvmeq->sq_tail = tail;
 }
 
-static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
-				struct nvme_command *cmd,
-				u32 *result, unsigned timeout)
+/**
+ * nvme_check_completion() - consume the completion of a command, if it is there
+ *
+ * @nvmeq:	The queue the command was sent to
+ * @cmd:	The command
+ * @result:	Returns the command-specific result, if not NULL
+ * Return: 0 if the command completed, -EBUSY if it has not completed yet,
+ * -EIO if it failed
+ */
+static int nvme_check_completion(struct nvme_queue *nvmeq,
+				 struct nvme_command *cmd, u32 *result)
 {
 	struct nvme_ops *ops;
 	u16 head = nvmeq->cq_head;
 	u16 phase = nvmeq->cq_phase;
 	u16 status;
-	ulong start_time;
-	ulong timeout_us = timeout * 100000;
 
-	cmd->common.command_id = nvme_get_cmd_id();
-	nvme_submit_cmd(nvmeq, cmd);
-
-	start_time = timer_get_us();
-
-	for (;;) {
-		status = nvme_read_completion_status(nvmeq, head);
-		if ((status & 0x01) == phase)
-			break;
-		if (timeout_us > 0 && (timer_get_us() - start_time)
-		    >= timeout_us)
-			return -ETIMEDOUT;
-	}
+	status = nvme_read_completion_status(nvmeq, head);
+	if ((status & 0x01) != phase)
+		return -EBUSY;
 
 	ops = (struct nvme_ops *)nvmeq->dev->udev->driver->ops;
 	if (ops && ops->complete_cmd)
 		ops->complete_cmd(nvmeq, cmd);
 
 	status >>= 1;
-	if (status) {
+	if (status)
 		printf("ERROR: status = %x, phase = %d, head = %d\n",
 		       status, phase, head);
-		status = 0;
-		if (++head == nvmeq->q_depth) {
-			head = 0;
-			phase = !phase;
-		}
-		writel(head, nvmeq->q_db + nvmeq->dev->db_stride);
-		nvmeq->cq_head = head;
-		nvmeq->cq_phase = phase;
-
-		return -EIO;
-	}
-
-	if (result)
+	else if (result)
 		*result = readl(&(nvmeq->cqes[head].result));
 
 	if (++head == nvmeq->q_depth) {
@@ -215,7 +204,31 @@ static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
 	nvmeq->cq_head = head;
 	nvmeq->cq_phase = phase;
 
-	return status;
+	return status ? -EIO : 0;
+}
+
+static int nvme_submit_sync_cmd(struct nvme_queue *nvmeq,
+				struct nvme_command *cmd,
+				u32 *result, unsigned timeout)
+{
+	ulong start_time;
+	ulong timeout_us = timeout * 100000;
+	int ret;
+
+	cmd->common.command_id = nvme_get_cmd_id();
+	nvme_submit_cmd(nvmeq, cmd);
+
+	start_time = timer_get_us();
+
+	for (;;) {
+		ret = nvme_check_completion(nvmeq, cmd, result);
+		if (ret != -EBUSY)
+			return ret;
+		if (timeout_us > 0 && (timer_get_us() - start_time)
+		    >= timeout_us)
+			return -ETIMEDOUT;
+		schedule();
+	}
 }
 
 static int nvme_submit_admin_cmd(struct nvme_dev *dev, struct nvme_command *cmd,
@@ -234,7 +247,7 @@ static struct nvme_queue *nvme_alloc_queue(struct nvme_dev *dev,
 		return NULL;
 	memset(nvmeq, 0, sizeof(*nvmeq));
 
-	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION);
+	nvmeq->cqes = (void *)memalign(4096, NVME_CQ_ALLOCATION(depth));
 	if (!nvmeq->cqes)
 		goto free_nvmeq;
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(depth));
@@ -345,7 +358,8 @@ static void nvme_init_queue(struct nvme_queue *nvmeq, u16 qid)
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	memset((void *)nvmeq->cqes, 0, NVME_CQ_SIZE(nvmeq->q_depth));
 	flush_dcache_range((ulong)nvmeq->cqes,
-			   (ulong)nvmeq->cqes + NVME_CQ_ALLOCATION);
+			   (ulong)nvmeq->cqes +
+			   NVME_CQ_ALLOCATION(nvmeq->q_depth));
 	dev->online_queues++;
 }
 
@@ -610,6 +624,19 @@ static int nvme_setup_io_queues(struct nvme_dev *dev)
 	return 0;
 }
 
+/* Delete the I/O queues created on the controller and free all the queues */
+static void nvme_release_queues(struct nvme_dev *dev)
+{
+	int i;
+
+	for (i = dev->online_queues - 1; i > NVME_ADMIN_Q; i--) {
+		nvme_delete_sq(dev, i);
+		nvme_delete_cq(dev, i);
+		dev->online_queues--;
+	}
+	nvme_free_queues(dev, 0);
+}
+
 static int nvme_get_info_from_identify(struct nvme_dev *dev)
 {
 	struct nvme_id_ctrl *ctrl;
@@ -654,6 +681,12 @@ static int nvme_get_info_from_identify(struct nvme_dev *dev)
 		 */
 		dev->max_transfer_shift = 20;
 	}
+	/*
+	 * Several commands are outstanding at once, so larger ones gain
+	 * little and would need longer PRP lists in the pool
+	 */
+	dev->max_transfer_shift = min_t(u32, dev->max_transfer_shift,
+					NVME_MAX_TRANSFER_SHIFT);
 
 	free(ctrl);
 	return 0;
@@ -724,69 +757,405 @@ static int nvme_blk_probe(struct udevice *udev)
 	memcpy(desc->product, ndev->serial, sizeof(ndev->serial));
 	memcpy(desc->revision, ndev->firmware_rev, sizeof(ndev->firmware_rev));
 
+	/* all namespaces share the command slots of the I/O queue */
+	if (CONFIG_IS_ENABLED(BLK_ASYNC))
+		blk_set_queue_depth(udev, ndev->io_cmd_num);
+
 	free(id);
 	return 0;
 }
 
-static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
-			 lbaint_t blkcnt, void *buffer, bool read)
+/* Set up the parts of a read or write command which are the same for all */
+static void nvme_init_rw_cmd(struct nvme_ns *ns, struct nvme_command *c,
+			     bool read)
+{
+	memset(c, '\0', sizeof(*c));
+	c->rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
+	c->rw.nsid = cpu_to_le32(ns->ns_id);
+}
+
+/* Point a read or write command at @lbas blocks from @slba, in @buffer */
+static void nvme_setup_rw_cmd(struct nvme_ns *ns, struct nvme_command *c,
+			      u64 *prp_list, u64 slba, u16 lbas,
+			      uintptr_t buffer)
 {
-	struct nvme_ns *ns = dev_get_priv(udev);
-	struct nvme_dev *dev = ns->dev;
-	struct nvme_command c;
-	struct blk_desc *desc = dev_get_uclass_plat(udev);
-	int status;
 	u64 prp2;
-	u64 total_len = blkcnt << desc->log2blksz;
-	u64 temp_len = total_len;
-	uintptr_t temp_buffer = (uintptr_t)buffer;
-
-	u64 slba = blknr;
-	u16 lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
-	u64 total_lbas = blkcnt;
-
-	flush_dcache_range((unsigned long)buffer,
-			   (unsigned long)buffer + total_len);
-
-	c.rw.opcode = read ? nvme_cmd_read : nvme_cmd_write;
-	c.rw.flags = 0;
-	c.rw.nsid = cpu_to_le32(ns->ns_id);
-	c.rw.control = 0;
-	c.rw.dsmgmt = 0;
-	c.rw.reftag = 0;
-	c.rw.apptag = 0;
-	c.rw.appmask = 0;
-	c.rw.metadata = 0;
-
-	while (total_lbas) {
-		if (total_lbas < lbas) {
-			lbas = (u16)total_lbas;
-			total_lbas = 0;
-		} else {
-			total_lbas -= lbas;
+
+	nvme_setup_prps(ns->dev, &prp2, prp_list, lbas << ns->lba_shift,
+			buffer);
+	c->rw.slba = cpu_to_le64(slba);
+	c->rw.length = cpu_to_le16(lbas - 1);
+	c->rw.prp1 = cpu_to_le64(buffer);
+	c->rw.prp2 = cpu_to_le64(prp2);
+}
+
+/* Allocate the command slots of the I/O queue and their PRP lists */
+static int nvme_io_alloc(struct nvme_dev *dev)
+{
+	u32 list_size;
+	uint i;
+
+	dev->io_cmd_num = dev->q_depth - 1;
+	dev->prp_list_pages = nvme_prp_list_pages(dev);
+	list_size = dev->prp_list_pages * dev->page_size;
+	INIT_LIST_HEAD(&dev->io_xfers);
+
+	dev->io_cmds = calloc(dev->io_cmd_num, sizeof(*dev->io_cmds));
+	if (!dev->io_cmds)
+		return -ENOMEM;
+	dev->prp_pool = memalign(dev->page_size, dev->io_cmd_num * list_size);
+	if (!dev->prp_pool)
+		return -ENOMEM;
+	for (i = 0; i < dev->io_cmd_num; i++)
+		dev->io_cmds[i].prp_list = (void *)dev->prp_pool + i * list_size;
+
+	if (CONFIG_IS_ENABLED(BLK_ASYNC)) {
+		dev->xfer_pool = calloc(dev->io_cmd_num,
+					sizeof(*dev->xfer_pool));
+		if (!dev->xfer_pool)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/* Free what nvme_io_alloc() allocated, even if it failed part-way */
+static void nvme_io_free(struct nvme_dev *dev)
+{
+	free(dev->xfer_pool);
+	dev->xfer_pool = NULL;
+	free(dev->prp_pool);
+	dev->prp_pool = NULL;
+	free(dev->io_cmds);
+	dev->io_cmds = NULL;
+}
+
+/* Finish a transfer whose commands have all completed */
+static void nvme_xfer_finish(struct nvme_dev *dev, struct nvme_xfer *xfer)
+{
+	list_del(&xfer->sibling);
+	if (xfer->read)
+		invalidate_dcache_range(xfer->buffer, xfer->buffer +
+					(xfer->blkcnt << xfer->ns->lba_shift));
+	xfer->done = true;
+	if (CONFIG_IS_ENABLED(BLK_ASYNC) && xfer->req) {
+		xfer->busy = false;
+		blk_complete(xfer->req, xfer->valid ? xfer->valid : xfer->err);
+	}
+}
+
+/*
+ * Record how the command in a slot went, for its transfer. The slot stays in
+ * use until the controller is known to be done with the command.
+ */
+static void nvme_io_cmd_done(struct nvme_dev *dev, struct nvme_io_cmd *io,
+			     int err)
+{
+	struct nvme_xfer *xfer = io->xfer;
+
+	io->xfer = NULL;
+	if (xfer->read) {
+		if (!--dev->rd_busy)
+			dev->rd_us += timer_get_us() - dev->rd_start;
+		if (!err) {
+			dev->rd_cmds++;
+			dev->rd_bytes += io->lbas << xfer->ns->lba_shift;
 		}
+	}
 
-		if (nvme_setup_prps(dev, &prp2,
-				    lbas << ns->lba_shift, temp_buffer))
-			return -EIO;
-		c.rw.slba = cpu_to_le64(slba);
-		slba += lbas;
-		c.rw.length = cpu_to_le16(lbas - 1);
-		c.rw.prp1 = cpu_to_le64(temp_buffer);
-		c.rw.prp2 = cpu_to_le64(prp2);
-		status = nvme_submit_sync_cmd(dev->queues[NVME_IO_Q],
-				&c, NULL, IO_TIMEOUT);
-		if (status)
+	xfer->cmds--;
+	if (err && io->offset < xfer->valid) {
+		xfer->valid = io->offset;
+		xfer->err = err;
+	}
+	if (!xfer->cmds && (xfer->sent == xfer->blkcnt || xfer->err))
+		nvme_xfer_finish(dev, xfer);
+}
+
+/* Release a command slot */
+static void nvme_io_cmd_free(struct nvme_dev *dev, struct nvme_io_cmd *io)
+{
+	io->busy = false;
+	dev->io_busy--;
+}
+
+/* Send the next command of @xfer in a free slot */
+static void nvme_io_send_cmd(struct nvme_dev *dev, struct nvme_xfer *xfer)
+{
+	struct nvme_ns *ns = xfer->ns;
+	u32 max_lbas = 1 << (dev->max_transfer_shift - ns->lba_shift);
+	struct nvme_io_cmd *io;
+	uint slot;
+
+	for (slot = 0; dev->io_cmds[slot].busy; slot++)
+		;
+	io = &dev->io_cmds[slot];
+	io->xfer = xfer;
+	io->offset = xfer->sent;
+	io->lbas = min_t(u64, xfer->blkcnt - xfer->sent, max_lbas);
+	nvme_init_rw_cmd(ns, &io->cmd, xfer->read);
+	nvme_setup_rw_cmd(ns, &io->cmd, io->prp_list, xfer->start + io->offset,
+			  io->lbas,
+			  xfer->buffer + (io->offset << ns->lba_shift));
+	io->cmd.common.command_id = cpu_to_le16(slot);
+	io->busy = true;
+	io->sent = timer_get_us();
+
+	xfer->sent += io->lbas;
+	xfer->cmds++;
+	dev->io_busy++;
+	dev->io_max_busy = max(dev->io_max_busy, dev->io_busy);
+	if (xfer->read && !dev->rd_busy++)
+		dev->rd_start = io->sent;
+
+	nvme_submit_cmd(dev->queues[NVME_IO_Q], &io->cmd);
+}
+
+/*
+ * Send commands for the transfers in progress, oldest first, while there is
+ * room for them
+ */
+static void nvme_io_send(struct nvme_dev *dev)
+{
+	struct nvme_xfer *xfer, *next;
+
+	list_for_each_entry_safe(xfer, next, &dev->io_xfers, sibling) {
+		/* the I/O queue is gone if resetting the controller failed */
+		if (dev->online_queues <= NVME_IO_Q && !xfer->err) {
+			xfer->valid = min(xfer->valid, xfer->sent);
+			xfer->err = -EIO;
+			if (!xfer->cmds)
+				nvme_xfer_finish(dev, xfer);
+			continue;
+		}
+		while (xfer->sent < xfer->blkcnt && !xfer->err) {
+			if (dev->io_busy == dev->io_cmd_num)
+				return;
+			nvme_io_send_cmd(dev, xfer);
+		}
+	}
+}
+
+/* Consume the completions posted on the I/O queue, in any order */
+static void nvme_io_reap(struct nvme_dev *dev)
+{
+	struct nvme_queue *nvmeq = dev->queues[NVME_IO_Q];
+	struct nvme_ops *ops = (struct nvme_ops *)dev->udev->driver->ops;
+	u16 head = nvmeq->cq_head;
+	u16 phase = nvmeq->cq_phase;
+	struct nvme_io_cmd *io;
+	u16 status, slot;
+
+	for (;;) {
+		status = nvme_read_completion_status(nvmeq, head);
+		if ((status & 0x01) != phase)
 			break;
-		temp_len -= (u32)lbas << ns->lba_shift;
-		temp_buffer += lbas << ns->lba_shift;
+		slot = readw(&nvmeq->cqes[head].command_id);
+		if (++head == nvmeq->q_depth) {
+			head = 0;
+			phase = !phase;
+		}
+
+		if (slot >= dev->io_cmd_num || !dev->io_cmds[slot].busy)
+			continue;
+		io = &dev->io_cmds[slot];
+		if (ops && ops->complete_cmd)
+			ops->complete_cmd(nvmeq, &io->cmd);
+
+		/* a command which timed out has been given up on already */
+		status >>= 1;
+		if (io->xfer) {
+			if (status)
+				printf("ERROR: status = %x, slot = %d\n",
+				       status, slot);
+			nvme_io_cmd_done(dev, io, status ? -EIO : 0);
+		}
+		nvme_io_cmd_free(dev, io);
 	}
 
-	if (read)
-		invalidate_dcache_range((unsigned long)buffer,
-					(unsigned long)buffer + total_len);
+	if (head != nvmeq->cq_head || phase != nvmeq->cq_phase) {
+		writel(head, nvmeq->q_db + dev->db_stride);
+		nvmeq->cq_head = head;
+		nvmeq->cq_phase = phase;
+	}
+}
 
-	return (total_len - temp_len) >> desc->log2blksz;
+/*
+ * Ask the controller to abort a command on the I/O queue
+ *
+ * Return: 0 if the command is aborted and so is sure to complete, -EBUSY if
+ * the controller did not abort it, other -ve on error
+ */
+static int nvme_io_abort(struct nvme_dev *dev, u16 slot)
+{
+	struct nvme_command c;
+	u32 result;
+	int ret;
+
+	memset(&c, 0, sizeof(c));
+	c.abort.opcode = nvme_admin_abort_cmd;
+	c.abort.sqid = cpu_to_le16(NVME_IO_Q);
+	c.abort.cid = cpu_to_le16(slot);
+
+	ret = nvme_submit_admin_cmd(dev, &c, &result);
+	if (ret)
+		return ret;
+
+	/* bit 0 is set if the command was not aborted */
+	return result & 1 ? -EBUSY : 0;
+}
+
+/*
+ * Reset the controller and set up its queues again, which ends all the
+ * commands outstanding. Those which have not timed out are sent again.
+ */
+static void nvme_io_reset(struct nvme_dev *dev)
+{
+	uint slot;
+	int ret;
+
+	printf("%s: Resetting controller\n", dev->udev->name);
+	dev->online_queues = 0;
+	ret = nvme_configure_admin_queue(dev);
+	if (!ret)
+		ret = nvme_setup_io_queues(dev);
+	if (!ret && dev->online_queues <= NVME_IO_Q)
+		ret = -EIO;
+
+	for (slot = 0; slot < dev->io_cmd_num; slot++) {
+		struct nvme_io_cmd *io = &dev->io_cmds[slot];
+
+		if (!io->busy)
+			continue;
+		if (io->xfer && !ret) {
+			io->sent = timer_get_us();
+			nvme_submit_cmd(dev->queues[NVME_IO_Q], &io->cmd);
+			continue;
+		}
+		if (io->xfer)
+			nvme_io_cmd_done(dev, io, ret);
+		nvme_io_cmd_free(dev, io);
+	}
+}
+
+/*
+ * Give up on commands outstanding for too long. The slot of such a command
+ * cannot be used again until the command completes, since the controller may
+ * still transfer its data, so abort it. If that fails, or the aborted command
+ * does not complete either, reset the controller.
+ */
+static void nvme_io_timeout(struct nvme_dev *dev)
+{
+	ulong now = timer_get_us();
+	bool reset = false;
+	uint slot;
+
+	for (slot = 0; slot < dev->io_cmd_num; slot++) {
+		struct nvme_io_cmd *io = &dev->io_cmds[slot];
+
+		if (!io->busy || now - io->sent < IO_TIMEOUT * 100000)
+			continue;
+		if (!io->xfer) {
+			reset = true;
+			continue;
+		}
+		nvme_io_cmd_done(dev, io, -ETIMEDOUT);
+		if (nvme_io_abort(dev, slot))
+			reset = true;
+		io->sent = timer_get_us();
+	}
+
+	if (reset)
+		nvme_io_reset(dev);
+}
+
+/* Make progress on the transfers in progress */
+static void nvme_io_poll(struct nvme_dev *dev)
+{
+	if (dev->io_busy) {
+		nvme_io_reap(dev);
+		nvme_io_timeout(dev);
+	}
+	nvme_io_send(dev);
+}
+
+/* Queue a transfer and send as many of its commands as there is room for */
+static void nvme_xfer_start(struct nvme_ns *ns, struct nvme_xfer *xfer,
+			    u64 start, u64 blkcnt, void *buffer, bool read)
+{
+	struct nvme_dev *dev = ns->dev;
+
+	xfer->ns = ns;
+	xfer->start = start;
+	xfer->blkcnt = blkcnt;
+	xfer->buffer = (uintptr_t)buffer;
+	xfer->read = read;
+	xfer->sent = 0;
+	xfer->valid = blkcnt;
+	xfer->err = 0;
+	xfer->cmds = 0;
+	xfer->done = false;
+
+	flush_dcache_range(xfer->buffer,
+			   xfer->buffer + (blkcnt << ns->lba_shift));
+	list_add_tail(&xfer->sibling, &dev->io_xfers);
+	nvme_io_send(dev);
+}
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+static int nvme_blk_submit(struct udevice *udev, struct blk_request *req)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_dev *dev = ns->dev;
+	struct nvme_xfer *xfer;
+	uint i;
+
+	/* the pool is shared by all namespaces */
+	for (i = 0; i < dev->io_cmd_num && dev->xfer_pool[i].busy; i++)
+		;
+	if (i == dev->io_cmd_num)
+		return -EAGAIN;
+
+	xfer = &dev->xfer_pool[i];
+	xfer->busy = true;
+	xfer->req = req;
+	nvme_xfer_start(ns, xfer, req->start, req->blkcnt, req->buffer,
+			!req->write);
+
+	return 0;
+}
+
+static int nvme_blk_poll(struct udevice *udev)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+
+	nvme_io_poll(ns->dev);
+
+	return 0;
+}
+#endif
+
+/*
+ * Split the transfer into commands of at most the maximum transfer size and
+ * keep as many of them outstanding as the I/O queue allows
+ */
+static ulong nvme_blk_rw(struct udevice *udev, lbaint_t blknr,
+			 lbaint_t blkcnt, void *buffer, bool read)
+{
+	struct nvme_ns *ns = dev_get_priv(udev);
+	struct nvme_xfer xfer;
+
+	if (!blkcnt)
+		return 0;
+
+	xfer.req = NULL;
+	nvme_xfer_start(ns, &xfer, blknr, blkcnt, buffer, read);
+	while (!xfer.done) {
+		nvme_io_poll(ns->dev);
+		schedule();
+	}
+
+	return xfer.valid;
 }
 
 static ulong nvme_blk_read(struct udevice *udev, lbaint_t blknr,
@@ -804,6 +1173,10 @@ static ulong nvme_blk_write(struct udevice *udev, lbaint_t blknr,
 static const struct blk_ops nvme_blk_ops = {
 	.read	= nvme_blk_read,
 	.write	= nvme_blk_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit	= nvme_blk_submit,
+	.poll	= nvme_blk_poll,
+#endif
 };
 
 U_BOOT_DRIVER(nvme_blk) = {
@@ -817,6 +1190,7 @@ U_BOOT_DRIVER(nvme_blk) = {
 int nvme_init(struct udevice *udev)
 {
 	struct nvme_dev *ndev = dev_get_priv(udev);
+	struct nvme_ops *ops = (struct nvme_ops *)udev->driver->ops;
 	struct nvme_id_ns *id;
 	int ret;
 
@@ -838,6 +1212,8 @@ int nvme_init(struct udevice *udev)
 
 	ndev->cap = nvme_readq(&ndev->bar->cap);
 	ndev->q_depth = min_t(int, NVME_CAP_MQES(ndev->cap) + 1, NVME_Q_DEPTH);
+	if (ops && ops->complete_cmd)
+		ndev->q_depth = NVME_Q_DEPTH_LINEAR;
 	ndev->db_stride = 1 << NVME_CAP_STRIDE(ndev->cap);
 	ndev->dbs = ((void __iomem *)ndev->bar) + 4096;
 
@@ -845,27 +1221,27 @@ int nvme_init(struct udevice *udev)
 	if (ret)
 		goto free_queue;
 
-	/* Allocate after the page size is known */
-	ndev->prp_pool = memalign(ndev->page_size, MAX_PRP_POOL);
-	if (!ndev->prp_pool) {
-		ret = -ENOMEM;
-		printf("Error: %s: Out of memory!\n", udev->name);
-		goto free_nvme;
-	}
-	ndev->prp_entry_num = MAX_PRP_POOL >> 3;
-
 	ret = nvme_setup_io_queues(ndev);
 	if (ret)
-		goto free_queue;
+		goto free_queues;
 
-	nvme_get_info_from_identify(ndev);
+	ret = nvme_get_info_from_identify(ndev);
+	if (ret)
+		goto free_queues;
+
+	/* Allocate after the page size and maximum transfer size are known */
+	ret = nvme_io_alloc(ndev);
+	if (ret) {
+		printf("Error: %s: Out of memory!\n", udev->name);
+		goto free_io;
+	}
 
 	/* Create a blk device for each namespace */
 
 	id = memalign(ndev->page_size, sizeof(struct nvme_id_ns));
 	if (!id) {
 		ret = -ENOMEM;
-		goto free_queue;
+		goto free_io;
 	}
 
 	for (int i = 1; i <= ndev->nn; i++) {
@@ -908,6 +1284,10 @@ int nvme_init(struct udevice *udev)
 
 free_id:
 	free(id);
+free_io:
+	nvme_io_free(ndev);
+free_queues:
+	nvme_release_queues(ndev);
 free_queue:
 	free((void *)ndev->queues);
 free_nvme:
@@ -594,6 +594,60 @@ enum {
 	NVME_CSTS_SHST_MASK	= 3 << 2,
 };
 
+/**
+ * struct nvme_xfer - a read or write split into commands on the I/O queue
+ *
+ * @ns: Namespace to transfer to or from
+ * @start: First block to transfer
+ * @blkcnt: Number of blocks to transfer
+ * @buffer: Address of the data
+ * @read: true to read, false to write
+ * @sent: Number of blocks covered by the commands sent so far
+ * @valid: Number of blocks before the first failed command, or @blkcnt
+ * @err: Error from the first failed command, or 0
+ * @cmds: Number of commands outstanding
+ * @done: true once all commands have completed
+ * @req: Asynchronous request this carries out, or NULL
+ * @busy: true while this pool entry is in use by an asynchronous request
+ * @sibling: Node in the device's list of transfers in progress
+ */
+struct nvme_xfer {
+	struct nvme_ns *ns;
+	u64 start;
+	u64 blkcnt;
+	uintptr_t buffer;
+	bool read;
+	u64 sent;
+	u64 valid;
+	int err;
+	uint cmds;
+	bool done;
+	struct blk_request *req;
+	bool busy;
+	struct list_head sibling;
+};
+
+/**
+ * struct nvme_io_cmd - a command slot on the I/O queue
+ *
+ * @cmd: Command, whose command_id is the number of the slot
+ * @xfer: Transfer the command belongs to
+ * @prp_list: PRP list for the command, from the device's pool
+ * @offset: First block of the command, counted from the start of @xfer
+ * @lbas: Number of blocks the command transfers
+ * @sent: Time the command was sent, in microseconds
+ * @busy: true while the command is outstanding
+ */
+struct nvme_io_cmd {
+	struct nvme_command cmd;
+	struct nvme_xfer *xfer;
+	u64 *prp_list;
+	u64 offset;
+	u16 lbas;
+	ulong sent;
+	bool busy;
+};
+
 /* Represents an NVM Express device. Each nvme_dev is a PCI function. */
 struct nvme_dev {
 	struct udevice *udev;
@@ -618,9 +672,26 @@ struct nvme_dev {
 	u32 stripe_size;
 	u32 page_size;
 	u8 vwc;
-	u64 *prp_pool;
-	u32 prp_entry_num;
 	u32 nn;
+	/* Command slots on the I/O queue, the number of them and in use */
+	struct nvme_io_cmd *io_cmds;
+	uint io_cmd_num;
+	uint io_busy;
+	/* PRP lists for the slots, each of prp_list_pages pages */
+	u64 *prp_pool;
+	u32 prp_list_pages;
+	/* Transfers in progress, oldest first */
+	struct list_head io_xfers;
+	/* Transfers for asynchronous requests, io_cmd_num of them */
+	struct nvme_xfer *xfer_pool;
+	/* Read statistics: commands, bytes and time with reads outstanding */
+	u64 rd_cmds;
+	u64 rd_bytes;
+	u64 rd_us;
+	ulong rd_start;
+	uint rd_busy;
+	/* Largest number of commands outstanding at once */
+	uint io_max_busy;
 };
 
 /* Admin queue and a single I/O queue. */
@@ -677,6 +748,8 @@ struct nvme_ops {
 	 *
 	 * If this function pointer is set to NULL, normal command
 	 * submission is performed according to the NVM Express spec.
+	 * Otherwise this function rings the doorbell and looks after the
+	 * tail of the submission queue.
 	 *
 	 * @nvmeq: NVM Express queue
 	 * @cmd:   NVM Express command
@@ -685,6 +758,9 @@ struct nvme_ops {
 	/**
 	 * complete_cmd - Controller-specific NVM Express command completion
 	 *
+	 * Commands must then complete in the order they were sent, so a
+	 * controller with this function has one command outstanding at most.
+	 *
 	 * @nvmeq: NVM Express queue
 	 * @cmd:   NVM Express command
 	 */
@@ -0,0 +1,410 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Emulation of an NVMe controller with a single namespace, for sandbox
+ *
+ * Register writes cannot be trapped in sandbox, so the controller does its
+ * work from a cyclic function, which runs whenever the driver polls. New
+ * I/O commands are completed newest first, so that the driver sees them
+ * complete out of order.
+ */
+
+#include <common.h>
+#include <cyclic.h>
+#include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <time.h>
+#include <asm/test.h>
+#include "nvme.h"
+
+#define SB_NVME_MQES		63
+#define SB_NVME_PAGE_SIZE	4096
+/* Maximum transfer size of 2^1 pages, so that transfers take many commands */
+#define SB_NVME_MDTS		1
+#define SB_NVME_LBA_SHIFT	9
+#define SB_NVME_BLOCKS		2048
+/* Time which passes on each run while a command is being ignored, in ms */
+#define SB_NVME_STUCK_MS	100
+
+/**
+ * struct sb_nvme_queue - a queue as the controller sees it
+ *
+ * @sq: Submission queue, or NULL if not created
+ * @cq: Completion queue, or NULL if not created
+ * @depth: Number of entries in each queue
+ * @sq_head: Next entry to take from @sq
+ * @cq_tail: Next entry to fill in @cq
+ * @phase: Phase tag of the completions being posted
+ */
+struct sb_nvme_queue {
+	struct nvme_command *sq;
+	struct nvme_completion *cq;
+	u16 depth;
+	u16 sq_head;
+	u16 cq_tail;
+	u8 phase;
+};
+
+/**
+ * struct sandbox_nvme_priv - private data for the emulator
+ *
+ * @ndev: Data for the NVMe core, which uses the start of the private data
+ * @regs: Registers, followed by the doorbells
+ * @data: Contents of the namespace
+ * @cyclic: Cyclic function which does the work of the controller
+ * @queues: Admin queue and I/O queue
+ * @busy: Number of I/O commands outstanding
+ * @max_busy: Largest number of I/O commands outstanding at once
+ * @count: Number of I/O commands taken
+ * @drop: Number of the I/O command to ignore, counting from 1, or 0
+ * @abort: true to abort the ignored command when asked, false to refuse
+ * @held: Command being ignored, if @held_valid
+ * @held_valid: true if a command is being ignored
+ * @aborts: Number of commands aborted
+ * @resets: Number of times the controller was disabled after being enabled
+ */
+struct sandbox_nvme_priv {
+	struct nvme_dev ndev;
+	void *regs;
+	u8 *data;
+	struct cyclic_info *cyclic;
+	struct sb_nvme_queue queues[NVME_Q_NUM];
+	uint busy;
+	uint max_busy;
+	uint count;
+	uint drop;
+	bool abort;
+	struct nvme_command held;
+	bool held_valid;
+	uint aborts;
+	uint resets;
+};
+
+static u32 *sb_nvme_db(struct sandbox_nvme_priv *priv, int qid, bool cq)
+{
+	return priv->regs + 4096 + (qid * 2 + cq) * 4;
+}
+
+static void sb_nvme_post(struct sandbox_nvme_priv *priv, int qid, u16 cmd_id,
+			 u16 status, u32 result)
+{
+	struct sb_nvme_queue *q = &priv->queues[qid];
+	struct nvme_completion *cqe = &q->cq[q->cq_tail];
+
+	cqe->result = cpu_to_le32(result);
+	cqe->sq_head = cpu_to_le16(q->sq_head);
+	cqe->sq_id = cpu_to_le16(qid);
+	cqe->command_id = cmd_id;
+	cqe->status = cpu_to_le16(status << 1 | q->phase);
+	if (++q->cq_tail == q->depth) {
+		q->cq_tail = 0;
+		q->phase = !q->phase;
+	}
+}
+
+/* Copy between the namespace and the memory described by a PRP pair */
+static void sb_nvme_xfer(u8 *data, u64 prp1, u64 prp2, u32 len, bool read)
+{
+	u32 offset = prp1 & (SB_NVME_PAGE_SIZE - 1);
+	u64 *list = NULL;
+	u64 addr = prp1;
+	uint i = 0;
+
+	while (len) {
+		u32 chunk = min_t(u32, len, SB_NVME_PAGE_SIZE - offset);
+		void *mem = (void *)(uintptr_t)addr;
+
+		if (read)
+			memcpy(mem, data, chunk);
+		else
+			memcpy(data, mem, chunk);
+		data += chunk;
+		len -= chunk;
+		offset = 0;
+		if (!len)
+			break;
+
+		if (!list && len <= SB_NVME_PAGE_SIZE) {
+			addr = prp2;
+			continue;
+		}
+		if (!list)
+			list = (u64 *)(uintptr_t)prp2;
+		/* the last entry of a full list page points to the next one */
+		if (i == SB_NVME_PAGE_SIZE / 8 - 1 && len > SB_NVME_PAGE_SIZE) {
+			list = (u64 *)(uintptr_t)le64_to_cpu(list[i]);
+			i = 0;
+		}
+		addr = le64_to_cpu(list[i++]);
+	}
+}
+
+static u16 sb_nvme_identify(struct sandbox_nvme_priv *priv,
+			    struct nvme_command *c)
+{
+	u8 buf[SB_NVME_PAGE_SIZE];
+
+	memset(buf, '\0', sizeof(buf));
+	if (le32_to_cpu(c->identify.cns) == 1) {
+		struct nvme_id_ctrl *ctrl = (void *)buf;
+
+		memcpy(ctrl->sn, "SB0001", 6);
+		memcpy(ctrl->mn, "Sandbox NVMe", 12);
+		memcpy(ctrl->fr, "1.0", 3);
+		ctrl->mdts = SB_NVME_MDTS;
+		ctrl->nn = cpu_to_le32(1);
+	} else if (le32_to_cpu(c->identify.nsid) == 1) {
+		struct nvme_id_ns *id = (void *)buf;
+
+		id->nsze = cpu_to_le64(SB_NVME_BLOCKS);
+		id->ncap = id->nsze;
+		id->lbaf[0].ds = SB_NVME_LBA_SHIFT;
+	}
+	sb_nvme_xfer(buf, le64_to_cpu(c->identify.prp1),
+		     le64_to_cpu(c->identify.prp2), sizeof(buf), true);
+
+	return NVME_SC_SUCCESS;
+}
+
+static u16 sb_nvme_admin(struct sandbox_nvme_priv *priv,
+			 struct nvme_command *c, u32 *result)
+{
+	struct sb_nvme_queue *q = &priv->queues[NVME_IO_Q];
+
+	switch (c->common.opcode) {
+	case nvme_admin_identify:
+		return sb_nvme_identify(priv, c);
+	case nvme_admin_set_features:
+		/* a single I/O queue of each kind */
+		*result = 0;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_create_cq:
+		if (le16_to_cpu(c->create_cq.cqid) != NVME_IO_Q)
+			return NVME_SC_QID_INVALID;
+		q->cq = (void *)(uintptr_t)le64_to_cpu(c->create_cq.prp1);
+		q->depth = le16_to_cpu(c->create_cq.qsize) + 1;
+		q->cq_tail = 0;
+		q->phase = 1;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_create_sq:
+		if (le16_to_cpu(c->create_sq.sqid) != NVME_IO_Q || !q->cq)
+			return NVME_SC_QID_INVALID;
+		q->sq = (void *)(uintptr_t)le64_to_cpu(c->create_sq.prp1);
+		q->sq_head = 0;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_delete_sq:
+		q->sq = NULL;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_delete_cq:
+		q->cq = NULL;
+		return NVME_SC_SUCCESS;
+	case nvme_admin_abort_cmd:
+		*result = 1;
+		if (!priv->held_valid || !priv->abort ||
+		    le16_to_cpu(c->abort.sqid) != NVME_IO_Q ||
+		    le16_to_cpu(c->abort.cid) != priv->held.common.command_id)
+			return NVME_SC_SUCCESS;
+		sb_nvme_post(priv, NVME_IO_Q, priv->held.common.command_id,
+			     NVME_SC_ABORT_REQ, 0);
+		priv->held_valid = false;
+		priv->busy--;
+		priv->aborts++;
+		*result = 0;
+		return NVME_SC_SUCCESS;
+	default:
+		return NVME_SC_INVALID_OPCODE;
+	}
+}
+
+static u16 sb_nvme_rw(struct sandbox_nvme_priv *priv, struct nvme_command *c)
+{
+	u64 slba = le64_to_cpu(c->rw.slba);
+	u32 lbas = le16_to_cpu(c->rw.length) + 1;
+
+	if (le32_to_cpu(c->rw.nsid) != 1)
+		return NVME_SC_INVALID_NS;
+	if (lbas << SB_NVME_LBA_SHIFT > SB_NVME_PAGE_SIZE << SB_NVME_MDTS)
+		return NVME_SC_INVALID_FIELD;
+	if (slba + lbas > SB_NVME_BLOCKS)
+		return NVME_SC_LBA_RANGE;
+
+	sb_nvme_xfer(priv->data + (slba << SB_NVME_LBA_SHIFT),
+		     le64_to_cpu(c->rw.prp1), le64_to_cpu(c->rw.prp2),
+		     lbas << SB_NVME_LBA_SHIFT,
+		     c->rw.opcode == nvme_cmd_read);
+
+	return NVME_SC_SUCCESS;
+}
+
+static void sb_nvme_run_admin(struct sandbox_nvme_priv *priv)
+{
+	struct sb_nvme_queue *q = &priv->queues[NVME_ADMIN_Q];
+	u32 tail = *sb_nvme_db(priv, NVME_ADMIN_Q, false);
+
+	while (q->sq_head != tail) {
+		struct nvme_command *c = &q->sq[q->sq_head];
+		u32 result = 0;
+		u16 status;
+
+		if (++q->sq_head == q->depth)
+			q->sq_head = 0;
+		status = sb_nvme_admin(priv, c, &result);
+		sb_nvme_post(priv, NVME_ADMIN_Q, c->common.command_id, status,
+			     result);
+	}
+}
+
+static void sb_nvme_run_io(struct sandbox_nvme_priv *priv)
+{
+	struct sb_nvme_queue *q = &priv->queues[NVME_IO_Q];
+	u32 tail = *sb_nvme_db(priv, NVME_IO_Q, false);
+	struct nvme_command *batch[SB_NVME_MQES + 1];
+	int n = 0;
+
+	if (!q->sq)
+		return;
+
+	/* take the new commands, which free their submission entries */
+	while (q->sq_head != tail) {
+		batch[n++] = &q->sq[q->sq_head];
+		if (++q->sq_head == q->depth)
+			q->sq_head = 0;
+	}
+	priv->busy += n;
+	priv->max_busy = max(priv->max_busy, priv->busy);
+
+	while (n--) {
+		struct nvme_command *c = batch[n];
+
+		if (++priv->count == priv->drop) {
+			priv->held = *c;
+			priv->held_valid = true;
+			continue;
+		}
+		sb_nvme_post(priv, NVME_IO_Q, c->common.command_id,
+			     sb_nvme_rw(priv, c), 0);
+		priv->busy--;
+	}
+}
+
+/* Do whatever the driver has asked for since the last run */
+static void sb_nvme_run(void *ctx)
+{
+	struct sandbox_nvme_priv *priv = ctx;
+	struct nvme_bar *bar = priv->regs;
+	struct sb_nvme_queue *aq = &priv->queues[NVME_ADMIN_Q];
+
+	if (!(bar->cc & NVME_CC_ENABLE)) {
+		/* a reset ends all commands */
+		if (bar->csts & NVME_CSTS_RDY)
+			priv->resets++;
+		memset(priv->queues, '\0', sizeof(priv->queues));
+		memset(priv->regs + 4096, '\0', 4096);
+		priv->held_valid = false;
+		priv->busy = 0;
+		bar->csts = 0;
+		return;
+	}
+
+	if (!(bar->csts & NVME_CSTS_RDY)) {
+		aq->sq = (void *)(uintptr_t)bar->asq;
+		aq->cq = (void *)(uintptr_t)bar->acq;
+		aq->depth = (bar->aqa & 0xfff) + 1;
+		aq->phase = 1;
+		bar->csts = NVME_CSTS_RDY;
+	}
+	if (bar->cc & NVME_CC_SHN_MASK)
+		bar->csts |= NVME_CSTS_SHST_CMPLT;
+
+	sb_nvme_run_admin(priv);
+	sb_nvme_run_io(priv);
+
+	/* let time pass, so that the driver soon gives up on the command */
+	if (priv->held_valid)
+		timer_test_add_offset(SB_NVME_STUCK_MS);
+}
+
+void sandbox_nvme_set_drop(struct udevice *dev, uint cmd, bool abort)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	priv->drop = cmd ? priv->count + cmd : 0;
+	priv->abort = abort;
+}
+
+void sandbox_nvme_get_stats(struct udevice *dev, uint *max_busy,
+			    uint *aborts, uint *resets)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	*max_busy = priv->max_busy;
+	*aborts = priv->aborts;
+	*resets = priv->resets;
+}
+
+static int sandbox_nvme_probe(struct udevice *dev)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+	struct nvme_bar *bar;
+	int ret;
+
+	priv->regs = memalign(SB_NVME_PAGE_SIZE, 2 * SB_NVME_PAGE_SIZE);
+	priv->data = calloc(SB_NVME_BLOCKS, 1 << SB_NVME_LBA_SHIFT);
+	if (!priv->regs || !priv->data) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	memset(priv->regs, '\0', 2 * SB_NVME_PAGE_SIZE);
+
+	bar = priv->regs;
+	bar->cap = SB_NVME_MQES | 1 << 24;
+	bar->vs = NVME_VS(1, 4);
+
+	priv->cyclic = cyclic_register(sb_nvme_run, 0, dev->name, priv);
+	if (!priv->cyclic) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	strcpy(priv->ndev.vendor, "Sandbox");
+	priv->ndev.bar = priv->regs;
+	ret = nvme_init(dev);
+	if (ret)
+		goto err_cyclic;
+
+	return 0;
+
+err_cyclic:
+	cyclic_unregister(priv->cyclic);
+err:
+	free(priv->data);
+	free(priv->regs);
+
+	return ret;
+}
+
+static int sandbox_nvme_remove(struct udevice *dev)
+{
+	struct sandbox_nvme_priv *priv = dev_get_priv(dev);
+
+	nvme_shutdown(dev);
+	cyclic_unregister(priv->cyclic);
+	free(priv->data);
+	free(priv->regs);
+
+	return 0;
+}
+
+static const struct udevice_id sandbox_nvme_ids[] = {
+	{ .compatible = "sandbox,nvme" },
+	{ }
+};
+
+U_BOOT_DRIVER(sandbox_nvme) = {
+	.name	= "sandbox_nvme",
+	.id	= UCLASS_NVME,
+	.of_match	= sandbox_nvme_ids,
+	.probe	= sandbox_nvme_probe,
+	.remove	= sandbox_nvme_remove,
+	.priv_auto	= sizeof(struct sandbox_nvme_priv),
+};
@@ -7,6 +7,7 @@
 #include <common.h>
 #include <dm.h>
 #include <errno.h>
+#include <div64.h>
 #include <memalign.h>
 #include <nvme.h>
 #include "nvme.h"
@@ -102,6 +103,19 @@ static void print_metadata_cap(u8 mc, int devnum)
 	       mc & 0x01 ? "yes" : "No");
 }
 
+static void print_read_stats(struct nvme_dev *dev, int devnum)
+{
+	u64 kib = dev->rd_bytes >> 10;
+	u64 ms = lldiv(dev->rd_us, 1000);
+
+	printf("Blk device %d: Read statistics:\n", devnum);
+	printf("\tCommand slots: %u, most in use: %u\n", dev->io_cmd_num,
+	       dev->io_max_busy);
+	printf("\tCommands: %llu\n", dev->rd_cmds);
+	printf("\tData read: %llu KiB in %llu ms\n", kib, ms);
+	printf("\tThroughput: %llu KiB/s\n", ms ? lldiv(kib * 1000, ms) : 0);
+}
+
 int nvme_print_info(struct udevice *udev)
 {
 	struct nvme_ns *ns = dev_get_priv(udev);
@@ -137,6 +151,7 @@ int nvme_print_info(struct udevice *udev)
 	print_formats(id, ns);
 	print_data_protect_cap(id->dpc, ns->devnum);
 	print_metadata_cap(id->mc, ns->devnum);
+	print_read_stats(dev, ns->devnum);
 
 free_id:
 	free(id);
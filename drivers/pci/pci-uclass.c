@@ -1106,6 +1106,8 @@ static int pci_uclass_pre_probe(struct udevice *bus)
 		if (ret)
 			return ret;
 		bus->seq_ = uclass_find_next_free_seq(uc);
+		if (CONFIG_IS_ENABLED(DM_UCLASS_INDEX))
+			uclass_index_update_device(bus);
 	}
 
 	/* For bridges, use the top-level PCI controller */
@@ -7,6 +7,7 @@
 #define LOG_CATEGORY UCLASS_SYSRESET
 
 #include <common.h>
+#include <blk.h>
 #include <command.h>
 #include <cpu_func.h>
 #include <dm.h>
@@ -132,6 +133,7 @@ int do_reset(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	}
 
 	printf("resetting ...\n");
+	blk_flush_all();
 	mdelay(100);
 
 	sysreset_walk_halt(reset_type);
@@ -14,11 +14,22 @@
 #include <scsi.h>
 #include <scsi_emul.h>
 #include <usb.h>
+#include <linux/usb/uas.h>
 
 /*
  * This driver emulates a flash stick using the UFI command specification and
  * the BBB (bulk/bulk/bulk) protocol. It supports only a single logical unit
  * number (LUN 0).
+ *
+ * The "sandbox,usb-flash-uas" variant uses the SCSI command set and offers
+ * USB Attached SCSI (UAS) as alternate setting 1. Commands can be queued
+ * with tags 1 to SANDBOX_FLASH_UAS_TAGS and are run one at a time, in the
+ * order the host asks for their data or status. With "sandbox,uas-streams"
+ * set, the device supports that many bulk streams and the stream ID selects
+ * the command. Without it, the device reports each command in turn on the
+ * status pipe, as a READ_READY or WRITE_READY IU before its data phase and
+ * then a sense IU with the result. A task management IU aborts the commands
+ * it names; clearing a halt leaves them queued.
  */
 
 enum {
@@ -26,6 +37,12 @@ enum {
 	SANDBOX_FLASH_EP_IN		= 2,
 	SANDBOX_FLASH_BLOCK_LEN		= 512,
 	SANDBOX_FLASH_BUF_SIZE		= 512,
+
+	SANDBOX_FLASH_EP_UAS_CMD	= 1,	/* endpoints in UAS setting */
+	SANDBOX_FLASH_EP_UAS_STATUS	= 2,
+	SANDBOX_FLASH_EP_UAS_DATA_IN	= 3,
+	SANDBOX_FLASH_EP_UAS_DATA_OUT	= 4,
+	SANDBOX_FLASH_UAS_TAGS		= 32,
 };
 
 enum {
@@ -36,6 +53,19 @@ enum {
 	STRINGID_COUNT,
 };
 
+/**
+ * struct sandbox_flash_uas_cmd - a UAS command queued by the host
+ *
+ * @queued:	true if the tag is in use
+ * @seq:	Sequence number, used to run commands in the order received
+ * @cdb:	SCSI command to run
+ */
+struct sandbox_flash_uas_cmd {
+	bool queued;
+	uint seq;
+	u8 cdb[16];
+};
+
 /**
  * struct sandbox_flash_priv - private state for this driver
  *
@@ -45,6 +75,19 @@ enum {
  * @fd:		File descriptor of backing file
  * @file_size:	Size of file in bytes
  * @status_buff:	Data buffer for outgoing status
+ * @alt:	Alternate setting selected by the host (1 for UAS)
+ * @streams:	Number of bulk streams set up by the host, 0 if none
+ * @uas_active:	Tag of the UAS command being run, 0 if none
+ * @uas_seq:	Sequence number for the next UAS command
+ * @uas_status:	SCSI status of the active UAS command
+ * @uas_max_queued: Largest number of UAS commands queued at once
+ * @uas_fail:	Number of UAS data transfers to allow before one fails, or 0
+ *		to let them all through
+ * @uas_tmfs:	Number of UAS task management functions received
+ * @uas_resp_tag: Tag of the task management function whose response IU is
+ *		still to be sent, 0 if none
+ * @uas_resp_code: Response code to send for it
+ * @uas_cmd:	UAS commands, indexed by tag
  */
 struct sandbox_flash_priv {
 	struct scsi_emul_info eminfo;
@@ -52,10 +95,30 @@ struct sandbox_flash_priv {
 	u32 tag;
 	int fd;
 	struct umass_bbb_csw status;
+	int alt;
+	int streams;
+	int uas_active;
+	uint uas_seq;
+	u8 uas_status;
+	int uas_max_queued;
+	int uas_fail;
+	int uas_tmfs;
+	int uas_resp_tag;
+	u8 uas_resp_code;
+	struct sandbox_flash_uas_cmd uas_cmd[SANDBOX_FLASH_UAS_TAGS + 1];
 };
 
+/**
+ * struct sandbox_flash_plat - platform data for this driver
+ *
+ * @pathname:	Path to the backing file
+ * @max_streams: Number of bulk streams supported in the UAS setting, 0 if
+ *		none
+ * @flash_strings: USB strings for the device
+ */
 struct sandbox_flash_plat {
 	const char *pathname;
+	int max_streams;
 	struct usb_string flash_strings[STRINGID_COUNT];
 };
 
@@ -131,6 +194,242 @@ static void *flash_desc_list[] = {
 	NULL,
 };
 
+static struct usb_config_descriptor flash_uas_config0 = {
+	.bLength		= sizeof(flash_uas_config0),
+	.bDescriptorType	= USB_DT_CONFIG,
+
+	/* wTotalLength is set up by usb-emul-uclass */
+	.bNumInterfaces		= 1,
+	.bConfigurationValue	= 0,
+	.iConfiguration		= 0,
+	.bmAttributes		= 1 << 7,
+	.bMaxPower		= 50,
+};
+
+static struct usb_interface_descriptor flash_uas_interface0 = {
+	.bLength		= sizeof(flash_uas_interface0),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 0,
+	.bNumEndpoints		= 2,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_BULK,
+	.iInterface		= 0,
+};
+
+static struct usb_interface_descriptor flash_uas_interface1 = {
+	.bLength		= sizeof(flash_uas_interface1),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 1,
+	.bNumEndpoints		= 4,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_UAS,
+	.iInterface		= 0,
+};
+
+static struct usb_endpoint_descriptor flash_uas_cmd_out = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_UAS_CMD,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(1024),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_cmd_usage = {
+	.bLength		= sizeof(flash_uas_cmd_usage),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= CMD_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_uas_status_in = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_UAS_STATUS |
+				  USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(1024),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_status_usage = {
+	.bLength		= sizeof(flash_uas_status_usage),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= STATUS_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_uas_data_in = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_UAS_DATA_IN |
+				  USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(1024),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_data_in_usage = {
+	.bLength		= sizeof(flash_uas_data_in_usage),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= DATA_IN_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_uas_data_out = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_UAS_DATA_OUT,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(1024),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_data_out_usage = {
+	.bLength		= sizeof(flash_uas_data_out_usage),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= DATA_OUT_PIPE_ID,
+};
+
+static void *flash_uas_desc_list[] = {
+	&flash_device_desc,
+	&flash_uas_config0,
+	&flash_uas_interface0,
+	&flash_endpoint0_out,
+	&flash_endpoint1_in,
+	&flash_uas_interface1,
+	&flash_uas_cmd_out,
+	&flash_uas_cmd_usage,
+	&flash_uas_status_in,
+	&flash_uas_status_usage,
+	&flash_uas_data_in,
+	&flash_uas_data_in_usage,
+	&flash_uas_data_out,
+	&flash_uas_data_out_usage,
+	NULL,
+};
+
+/**
+ * sandbox_flash_uas_max_queued() - get the UAS queue depth seen so far
+ *
+ * @dev:	the flash emulation device
+ * Return: largest number of UAS commands the host has had queued at once
+ */
+int sandbox_flash_uas_max_queued(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->uas_max_queued;
+}
+
+/**
+ * sandbox_flash_uas_set_fail() - make a UAS data transfer fail
+ *
+ * @dev:	the flash emulation device
+ * @count:	fail the @count'th data transfer from now, 0 for none
+ */
+void sandbox_flash_uas_set_fail(struct udevice *dev, int count)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	priv->uas_fail = count;
+}
+
+/**
+ * sandbox_flash_uas_tmfs() - get the number of task management IUs received
+ *
+ * @dev:	the flash emulation device
+ * Return: number of UAS task management functions the host has sent
+ */
+int sandbox_flash_uas_tmfs(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->uas_tmfs;
+}
+
+/**
+ * sandbox_flash_uas_streams() - get the number of bulk streams set up
+ *
+ * @dev:	the flash emulation device
+ * Return: number of streams the host has set up and not freed
+ */
+int sandbox_flash_uas_streams(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return priv->streams;
+}
+
+/* Abort the UAS command with tag @tag, or all of them if @tag is 0 */
+static void sandbox_flash_uas_abort(struct sandbox_flash_priv *priv, int tag)
+{
+	if (tag)
+		priv->uas_cmd[tag].queued = false;
+	else
+		memset(priv->uas_cmd, '\0', sizeof(priv->uas_cmd));
+	if (!tag || priv->uas_active == tag) {
+		priv->uas_active = 0;
+		priv->eminfo.phase = SCSIPH_START;
+	}
+}
+
+static void sandbox_flash_uas_reset(struct sandbox_flash_priv *priv)
+{
+	sandbox_flash_uas_abort(priv, 0);
+	priv->uas_resp_tag = 0;
+}
+
+/**
+ * sandbox_flash_uas_task_mgmt() - handle a UAS task management IU
+ *
+ * Only ABORT TASK and LOGICAL UNIT RESET are supported. The response IU is
+ * sent on the next read of the status pipe, on the IU's own stream if there
+ * are streams.
+ */
+static int sandbox_flash_uas_task_mgmt(struct sandbox_flash_priv *priv,
+				       struct task_mgmt_iu *tiu, int len)
+{
+	int tag = be16_to_cpu(tiu->tag);
+	int task_tag = be16_to_cpu(tiu->task_tag);
+
+	if (len < sizeof(*tiu) || tag < 1 || tag > SANDBOX_FLASH_UAS_TAGS ||
+	    priv->uas_resp_tag)
+		return -EIO;
+	priv->uas_tmfs++;
+	priv->uas_resp_tag = tag;
+	if (priv->uas_cmd[tag].queued) {
+		priv->uas_resp_code = RC_OVERLAPPED_TAG;
+		return len;
+	}
+	switch (tiu->function) {
+	case TMF_ABORT_TASK:
+		if (task_tag < 1 || task_tag > SANDBOX_FLASH_UAS_TAGS) {
+			priv->uas_resp_code = RC_INVALID_INFO_UNIT;
+			break;
+		}
+		sandbox_flash_uas_abort(priv, task_tag);
+		priv->uas_resp_code = RC_TMF_COMPLETE;
+		break;
+	case TMF_LOGICAL_UNIT_RESET:
+		sandbox_flash_uas_abort(priv, 0);
+		priv->uas_resp_code = RC_TMF_COMPLETE;
+		break;
+	default:
+		priv->uas_resp_code = RC_TMF_NOT_SUPPORTED;
+		break;
+	}
+
+	return len;
+}
+
 static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 				 unsigned long pipe, void *buff, int len,
 				 struct devrequest *setup)
@@ -149,6 +448,26 @@ static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 			debug("request=%x\n", setup->request);
 			break;
 		}
+	} else if (pipe == usb_sndctrlpipe(udev, 0)) {
+		switch (setup->request) {
+		case USB_REQ_SET_INTERFACE:
+			if (setup->value > 1 ||
+			    (setup->value && !dev_get_driver_data(dev)))
+				break;
+			priv->alt = setup->value;
+			priv->streams = 0;
+			priv->error = false;
+			sandbox_flash_uas_reset(priv);
+			return 0;
+		case USB_REQ_CLEAR_FEATURE:
+			/* Nothing halts; queued UAS commands are kept */
+			if (priv->alt != 1)
+				break;
+			return 0;
+		default:
+			debug("request=%x\n", setup->request);
+			break;
+		}
 	}
 	debug("pipe=%lx\n", pipe);
 
@@ -208,6 +527,274 @@ static int handle_ufi_command(struct sandbox_flash_priv *priv, const void *buff,
 	return 0;
 }
 
+static int sandbox_flash_data_out(struct sandbox_flash_priv *priv,
+				  const void *buff, int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+
+	log_debug("data out, len=%x, info->write_len=%x\n", len,
+		  info->write_len);
+	if (!info->write_len)
+		return 0;
+	if (priv->fd != -1) {
+		ulong bytes_written;
+
+		bytes_written = os_write(priv->fd, buff, len);
+		log_debug("bytes_written=%lx", bytes_written);
+		if (bytes_written != len)
+			return -EIO;
+		info->write_len -= len / info->block_size;
+		if (!info->write_len)
+			info->phase = SCSIPH_STATUS;
+	} else {
+		if (info->alloc_len && len > info->alloc_len)
+			len = info->alloc_len;
+		if (len > SANDBOX_FLASH_BUF_SIZE)
+			len = SANDBOX_FLASH_BUF_SIZE;
+		memcpy(info->buff, buff, len);
+		info->phase = SCSIPH_STATUS;
+	}
+
+	return len;
+}
+
+static int sandbox_flash_data_in(struct sandbox_flash_priv *priv, void *buff,
+				 int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+
+	debug("data in, len=%x, alloc_len=%x, info->read_len=%x\n",
+	      len, info->alloc_len, info->read_len);
+	if (info->read_len) {
+		ulong bytes_read;
+
+		if (priv->fd == -1)
+			return -EIO;
+
+		bytes_read = os_read(priv->fd, buff, len);
+		if (bytes_read != len)
+			return -EIO;
+		info->read_len -= len / info->block_size;
+		if (!info->read_len)
+			info->phase = SCSIPH_STATUS;
+	} else {
+		if (info->alloc_len && len > info->alloc_len)
+			len = info->alloc_len;
+		if (len > SANDBOX_FLASH_BUF_SIZE)
+			len = SANDBOX_FLASH_BUF_SIZE;
+		memcpy(buff, info->buff, len);
+		info->phase = SCSIPH_STATUS;
+	}
+
+	return len;
+}
+
+/**
+ * sandbox_flash_uas_start() - start running a queued UAS command
+ *
+ * This runs the SCSI command and sets up the data phase, if any. Only one
+ * command runs at a time.
+ *
+ * @priv:	Sandbox flash private data
+ * @tag:	Tag of the command to run
+ * Return: 0 if OK, -EIO if the tag is not in use or another command is
+ *	running
+ */
+static int sandbox_flash_uas_start(struct sandbox_flash_priv *priv, int tag)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+	struct sandbox_flash_uas_cmd *cmd;
+	int ret;
+
+	if (priv->uas_active == tag)
+		return 0;
+	if (priv->uas_active || tag < 1 || tag > SANDBOX_FLASH_UAS_TAGS ||
+	    !priv->uas_cmd[tag].queued)
+		return -EIO;
+	cmd = &priv->uas_cmd[tag];
+	priv->uas_active = tag;
+	info->alloc_len = 0;
+	info->read_len = 0;
+	info->write_len = 0;
+	info->transfer_len = 0;
+	priv->uas_status = S_GOOD;
+	ret = sb_scsi_emul_command(info, (struct scsi_cmd *)cmd->cdb,
+				   sizeof(cmd->cdb));
+	if ((ret == SCSI_EMUL_DO_READ || ret == SCSI_EMUL_DO_WRITE) &&
+	    priv->fd != -1) {
+		if (os_lseek(priv->fd, info->seek_block * info->block_size,
+			     OS_SEEK_SET) == (off_t)-1)
+			ret = -EIO;
+	} else if (ret > 0) {
+		ret = -EIO;
+	}
+	if (ret < 0) {
+		priv->uas_status = S_CHECK_COND;
+		info->buff_used = 0;
+	}
+	info->phase = info->buff_used ? SCSIPH_DATA : SCSIPH_STATUS;
+
+	return 0;
+}
+
+/**
+ * sandbox_flash_uas_next() - find the oldest UAS command not yet run
+ *
+ * Return: tag of the command, or 0 if none
+ */
+static int sandbox_flash_uas_next(struct sandbox_flash_priv *priv)
+{
+	int tag, best = 0;
+
+	for (tag = 1; tag <= SANDBOX_FLASH_UAS_TAGS; tag++) {
+		struct sandbox_flash_uas_cmd *cmd = &priv->uas_cmd[tag];
+
+		if (cmd->queued &&
+		    (!best || cmd->seq < priv->uas_cmd[best].seq))
+			best = tag;
+	}
+
+	return best;
+}
+
+/**
+ * sandbox_flash_uas_status() - send an IU on the status pipe
+ *
+ * If the active command has a data phase still to do, this sends a
+ * READ_READY or WRITE_READY IU. Otherwise it sends a sense IU and the command
+ * is complete.
+ */
+static int sandbox_flash_uas_status(struct sandbox_flash_priv *priv,
+				    void *buff, int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+	int tag = priv->uas_active;
+
+	if (info->phase == SCSIPH_DATA) {
+		struct iu *iu = buff;
+
+		if (len < sizeof(*iu))
+			return -EIO;
+		memset(iu, '\0', sizeof(*iu));
+		iu->iu_id = info->write_len ? IU_ID_WRITE_READY :
+			IU_ID_READ_READY;
+		iu->tag = cpu_to_be16(tag);
+
+		return sizeof(*iu);
+	} else {
+		struct sense_iu *iu = buff;
+		int size = offsetof(struct sense_iu, sense);
+
+		if (len < size)
+			return -EIO;
+		memset(iu, '\0', min(len, (int)sizeof(*iu)));
+		iu->iu_id = IU_ID_STATUS;
+		iu->tag = cpu_to_be16(tag);
+		iu->status = priv->uas_status;
+		if (priv->uas_status != S_GOOD && len >= size + 18) {
+			/* fixed-format sense: invalid field in CDB */
+			iu->sense[0] = 0x70;
+			iu->sense[2] = SENSE_ILLEGAL_REQUEST;
+			iu->sense[7] = 10;
+			iu->sense[12] = 0x24;
+			iu->len = cpu_to_be16(18);
+			size += 18;
+		}
+		priv->uas_cmd[tag].queued = false;
+		priv->uas_active = 0;
+		info->phase = SCSIPH_START;
+
+		return size;
+	}
+}
+
+/**
+ * sandbox_flash_uas_bulk() - handle a bulk transfer in the UAS setting
+ *
+ * @stream_id:	Stream used for the transfer, 0 if none
+ */
+static int sandbox_flash_uas_bulk(struct sandbox_flash_priv *priv,
+				  unsigned long pipe, unsigned int stream_id,
+				  void *buff, int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+	int ep = usb_pipeendpoint(pipe);
+	struct sandbox_flash_uas_cmd *cmd;
+	struct command_iu *ciu = buff;
+	int tag, count, ret;
+
+	debug("%s: pipe=%lx, ep=%x, stream=%u, len=%x, active=%d\n",
+	      __func__, pipe, ep, stream_id, len, priv->uas_active);
+	if (ep == SANDBOX_FLASH_EP_UAS_CMD && usb_pipeout(pipe)) {
+		if (stream_id || len < sizeof(struct iu))
+			return -EIO;
+		if (ciu->iu_id == IU_ID_TASK_MGMT)
+			return sandbox_flash_uas_task_mgmt(priv, buff, len);
+		if (len < sizeof(*ciu) || ciu->iu_id != IU_ID_COMMAND)
+			return -EIO;
+		tag = be16_to_cpu(ciu->tag);
+		if (tag < 1 || tag > SANDBOX_FLASH_UAS_TAGS)
+			return -EIO;
+		cmd = &priv->uas_cmd[tag];
+		if (cmd->queued)
+			return -EIO;
+		cmd->queued = true;
+		cmd->seq = priv->uas_seq++;
+		memcpy(cmd->cdb, ciu->cdb, sizeof(cmd->cdb));
+		for (tag = 1, count = 0; tag <= SANDBOX_FLASH_UAS_TAGS; tag++)
+			count += priv->uas_cmd[tag].queued;
+		priv->uas_max_queued = max(priv->uas_max_queued, count);
+
+		return len;
+	}
+
+	/* With streams, the host picks the command; otherwise we do */
+	if (!stream_id != !priv->streams || stream_id > priv->streams)
+		return -EIO;
+	if (ep == SANDBOX_FLASH_EP_UAS_STATUS && priv->uas_resp_tag &&
+	    (!stream_id || stream_id == priv->uas_resp_tag)) {
+		struct response_iu *riu = buff;
+
+		if (len < sizeof(*riu))
+			return -EIO;
+		memset(riu, '\0', sizeof(*riu));
+		riu->iu_id = IU_ID_RESPONSE;
+		riu->tag = cpu_to_be16(priv->uas_resp_tag);
+		riu->response_code = priv->uas_resp_code;
+		priv->uas_resp_tag = 0;
+
+		return sizeof(*riu);
+	}
+	if (ep != SANDBOX_FLASH_EP_UAS_STATUS && priv->uas_fail &&
+	    !--priv->uas_fail)
+		return -EIO;
+	tag = stream_id;
+	if (!tag)
+		tag = priv->uas_active;
+	if (!tag)
+		tag = sandbox_flash_uas_next(priv);
+	ret = sandbox_flash_uas_start(priv, tag);
+	if (ret)
+		return ret;
+
+	switch (ep) {
+	case SANDBOX_FLASH_EP_UAS_STATUS:
+		if (stream_id && info->phase == SCSIPH_DATA)
+			return -EIO;
+		return sandbox_flash_uas_status(priv, buff, len);
+	case SANDBOX_FLASH_EP_UAS_DATA_IN:
+		if (info->phase != SCSIPH_DATA || info->write_len)
+			return -EIO;
+		return sandbox_flash_data_in(priv, buff, len);
+	case SANDBOX_FLASH_EP_UAS_DATA_OUT:
+		if (info->phase != SCSIPH_DATA || !info->write_len)
+			return -EIO;
+		return sandbox_flash_data_out(priv, buff, len);
+	default:
+		return -EIO;
+	}
+}
+
 static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 			      unsigned long pipe, void *buff, int len)
 {
@@ -218,6 +805,8 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 
 	debug("%s: dev=%s, pipe=%lx, ep=%x, len=%x, phase=%d\n", __func__,
 	      dev->name, pipe, ep, len, info->phase);
+	if (priv->alt == 1)
+		return sandbox_flash_uas_bulk(priv, pipe, 0, buff, len);
 	switch (ep) {
 	case SANDBOX_FLASH_EP_OUT:
 		switch (info->phase) {
@@ -238,31 +827,9 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 			return handle_ufi_command(priv, cbw->CBWCDB,
 						  cbw->bCDBLength);
 		case SCSIPH_DATA:
-			log_debug("data out, len=%x, info->write_len=%x\n", len,
-				  info->write_len);
 			info->transfer_len = cbw->dCBWDataTransferLength;
 			priv->tag = cbw->dCBWTag;
-			if (!info->write_len)
-				return 0;
-			if (priv->fd != -1) {
-				ulong bytes_written;
-
-				bytes_written = os_write(priv->fd, buff, len);
-				log_debug("bytes_written=%lx", bytes_written);
-				if (bytes_written != len)
-					return -EIO;
-				info->write_len -= len / info->block_size;
-				if (!info->write_len)
-					info->phase = SCSIPH_STATUS;
-			} else {
-				if (info->alloc_len && len > info->alloc_len)
-					len = info->alloc_len;
-				if (len > SANDBOX_FLASH_BUF_SIZE)
-					len = SANDBOX_FLASH_BUF_SIZE;
-				memcpy(info->buff, buff, len);
-				info->phase = SCSIPH_STATUS;
-			}
-			return len;
+			return sandbox_flash_data_out(priv, buff, len);
 		default:
 			break;
 		}
@@ -270,29 +837,7 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 	case SANDBOX_FLASH_EP_IN:
 		switch (info->phase) {
 		case SCSIPH_DATA:
-			debug("data in, len=%x, alloc_len=%x, info->read_len=%x\n",
-			      len, info->alloc_len, info->read_len);
-			if (info->read_len) {
-				ulong bytes_read;
-
-				if (priv->fd == -1)
-					return -EIO;
-
-				bytes_read = os_read(priv->fd, buff, len);
-				if (bytes_read != len)
-					return -EIO;
-				info->read_len -= len / info->block_size;
-				if (!info->read_len)
-					info->phase = SCSIPH_STATUS;
-			} else {
-				if (info->alloc_len && len > info->alloc_len)
-					len = info->alloc_len;
-				if (len > SANDBOX_FLASH_BUF_SIZE)
-					len = SANDBOX_FLASH_BUF_SIZE;
-				memcpy(buff, info->buff, len);
-				info->phase = SCSIPH_STATUS;
-			}
-			return len;
+			return sandbox_flash_data_in(priv, buff, len);
 		case SCSIPH_STATUS:
 			debug("status in, len=%x\n", len);
 			if (len > sizeof(priv->status))
@@ -310,11 +855,52 @@ err:
 	return 0;
 }
 
+static int sandbox_flash_bulk_stream(struct udevice *dev,
+				     struct usb_device *udev,
+				     unsigned long pipe, unsigned int stream_id,
+				     void *buff, int len)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	if (priv->alt != 1)
+		return -EIO;
+
+	return sandbox_flash_uas_bulk(priv, pipe, stream_id, buff, len);
+}
+
+static int sandbox_flash_alloc_streams(struct udevice *dev,
+				       struct usb_device *udev,
+				       unsigned long *pipes, int num_pipes,
+				       unsigned int num_streams)
+{
+	struct sandbox_flash_plat *plat = dev_get_plat(dev);
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	if (priv->alt != 1 || !plat->max_streams)
+		return -ENOSYS;
+	priv->streams = min_t(int, num_streams, plat->max_streams);
+
+	return priv->streams;
+}
+
+static int sandbox_flash_free_streams(struct udevice *dev,
+				      struct usb_device *udev,
+				      unsigned long *pipes, int num_pipes)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	priv->streams = 0;
+
+	return 0;
+}
+
 static int sandbox_flash_of_to_plat(struct udevice *dev)
 {
 	struct sandbox_flash_plat *plat = dev_get_plat(dev);
 
 	plat->pathname = dev_read_string(dev, "sandbox,filepath");
+	plat->max_streams = dev_read_u32_default(dev, "sandbox,uas-streams",
+						 0);
 
 	return 0;
 }
@@ -332,7 +918,9 @@ static int sandbox_flash_bind(struct udevice *dev)
 	fs[2].id = STRINGID_SERIAL;
 	fs[2].s = dev->name;
 
-	return usb_emul_setup_device(dev, plat->flash_strings, flash_desc_list);
+	return usb_emul_setup_device(dev, plat->flash_strings,
+				     dev_get_driver_data(dev) ?
+				     flash_uas_desc_list : flash_desc_list);
 }
 
 static int sandbox_flash_probe(struct udevice *dev)
@@ -371,10 +959,14 @@ static int sandbox_flash_remove(struct udevice *dev)
 static const struct dm_usb_ops sandbox_usb_flash_ops = {
 	.control	= sandbox_flash_control,
 	.bulk		= sandbox_flash_bulk,
+	.alloc_streams	= sandbox_flash_alloc_streams,
+	.free_streams	= sandbox_flash_free_streams,
+	.bulk_stream	= sandbox_flash_bulk_stream,
 };
 
 static const struct udevice_id sandbox_usb_flash_ids[] = {
 	{ .compatible = "sandbox,usb-flash" },
+	{ .compatible = "sandbox,usb-flash-uas", .data = 1 },
 	{ }
 };
 
@@ -105,7 +105,19 @@ static int usb_emul_get_descriptor(struct usb_dev_plat *plat, int value,
 	return upto ? upto : length ? -EIO : 0;
 }
 
-static int usb_emul_find_devnum(int devnum, int port1, struct udevice **emulp)
+/* Find the USB bus (controller) which @dev is below, or NULL if none */
+static struct udevice *usb_emul_get_bus(struct udevice *dev)
+{
+	for (dev = dev->parent; dev; dev = dev->parent) {
+		if (device_get_uclass_id(dev) == UCLASS_USB)
+			return dev;
+	}
+
+	return NULL;
+}
+
+static int usb_emul_find_devnum(struct udevice *bus, int devnum, int port1,
+				struct udevice **emulp)
 {
 	struct udevice *dev;
 	struct uclass *uc;
@@ -118,6 +130,10 @@ static int usb_emul_find_devnum(int devnum, int port1, struct udevice **emulp)
 	uclass_foreach_dev(dev, uc) {
 		struct usb_dev_plat *udev = dev_get_parent_plat(dev);
 
+		/* Each bus has its own device numbers */
+		if (usb_emul_get_bus(dev) != bus)
+			continue;
+
 		/*
 		 * devnum is initialzied to zero at the beginning of the
 		 * enumeration process in usb_setup_device(). At this
@@ -132,7 +148,7 @@ static int usb_emul_find_devnum(int devnum, int port1, struct udevice **emulp)
 			/*
 			 * If the parent is sandbox USB controller, we are
 			 * the root hub. And there is only one root hub
-			 * in the system.
+			 * on the bus.
 			 */
 			if (device_get_uclass_id(dev->parent) == UCLASS_USB) {
 				debug("%s: Found emulator '%s'\n",
@@ -165,14 +181,15 @@ int usb_emul_find(struct udevice *bus, ulong pipe, int port1,
 {
 	int devnum = usb_pipedevice(pipe);
 
-	return usb_emul_find_devnum(devnum, port1, emulp);
+	return usb_emul_find_devnum(bus, devnum, port1, emulp);
 }
 
 int usb_emul_find_for_dev(struct udevice *dev, struct udevice **emulp)
 {
 	struct usb_dev_plat *udev = dev_get_parent_plat(dev);
 
-	return usb_emul_find_devnum(udev->devnum, 0, emulp);
+	return usb_emul_find_devnum(usb_emul_get_bus(dev), udev->devnum, 0,
+				    emulp);
 }
 
 int usb_emul_control(struct udevice *emul, struct usb_device *udev,
@@ -246,6 +263,50 @@ int usb_emul_bulk(struct udevice *emul, struct usb_device *udev,
 	return ops->bulk(emul, udev, pipe, buffer, length);
 }
 
+int usb_emul_bulk_stream(struct udevice *emul, struct usb_device *udev,
+			 unsigned long pipe, unsigned int stream_id,
+			 void *buffer, int length)
+{
+	struct dm_usb_ops *ops = usb_get_emul_ops(emul);
+	int ret;
+
+	if (!ops->bulk_stream)
+		return -ENOSYS;
+	debug("%s: dev=%s, stream=%u\n", __func__, emul->name, stream_id);
+	ret = device_probe(emul);
+	if (ret)
+		return ret;
+	return ops->bulk_stream(emul, udev, pipe, stream_id, buffer, length);
+}
+
+int usb_emul_alloc_streams(struct udevice *emul, struct usb_device *udev,
+			   unsigned long *pipes, int num_pipes,
+			   unsigned int num_streams)
+{
+	struct dm_usb_ops *ops = usb_get_emul_ops(emul);
+	int ret;
+
+	if (!ops->alloc_streams)
+		return -ENOSYS;
+	ret = device_probe(emul);
+	if (ret)
+		return ret;
+	return ops->alloc_streams(emul, udev, pipes, num_pipes, num_streams);
+}
+
+int usb_emul_free_streams(struct udevice *emul, struct usb_device *udev,
+			  unsigned long *pipes, int num_pipes)
+{
+	struct dm_usb_ops *ops = usb_get_emul_ops(emul);
+
+	if (!ops->free_streams)
+		return -ENOSYS;
+	/* An emulator which has been removed has no streams left */
+	if (!device_active(emul))
+		return 0;
+	return ops->free_streams(emul, udev, pipes, num_pipes);
+}
+
 int usb_emul_int(struct udevice *emul, struct usb_device *udev,
 		  unsigned long pipe, void *buffer, int length, int interval,
 		  bool nonblock)
@@ -105,6 +105,64 @@ static int sandbox_submit_bulk(struct udevice *bus, struct usb_device *udev,
 	return ret;
 }
 
+static int sandbox_submit_bulk_stream(struct udevice *bus,
+				      struct usb_device *udev,
+				      unsigned long pipe, unsigned int stream_id,
+				      void *buffer, int length)
+{
+	struct udevice *emul;
+	int ret;
+
+	ret = usb_emul_find(bus, pipe, udev->portnr, &emul);
+	usbmon_trace(bus, pipe, NULL, emul);
+	if (ret)
+		return ret;
+	ret = usb_emul_bulk_stream(emul, udev, pipe, stream_id, buffer,
+				   length);
+	if (ret < 0) {
+		debug("ret=%d\n", ret);
+		udev->status = ret;
+		udev->act_len = 0;
+	} else {
+		udev->status = 0;
+		udev->act_len = ret;
+	}
+
+	return ret;
+}
+
+static int sandbox_alloc_streams(struct udevice *bus, struct usb_device *udev,
+				 unsigned long *pipes, int num_pipes,
+				 unsigned int num_streams)
+{
+	struct udevice *emul;
+	int ret;
+
+	if (!num_pipes)
+		return -EINVAL;
+	ret = usb_emul_find(bus, pipes[0], udev->portnr, &emul);
+	if (ret)
+		return ret;
+
+	return usb_emul_alloc_streams(emul, udev, pipes, num_pipes,
+				      num_streams);
+}
+
+static int sandbox_free_streams(struct udevice *bus, struct usb_device *udev,
+				unsigned long *pipes, int num_pipes)
+{
+	struct udevice *emul;
+	int ret;
+
+	if (!num_pipes)
+		return -EINVAL;
+	ret = usb_emul_find(bus, pipes[0], udev->portnr, &emul);
+	if (ret)
+		return ret;
+
+	return usb_emul_free_streams(emul, udev, pipes, num_pipes);
+}
+
 static int sandbox_submit_int(struct udevice *bus, struct usb_device *udev,
 			      unsigned long pipe, void *buffer, int length,
 			      int interval, bool nonblock)
@@ -170,6 +228,9 @@ static const struct dm_usb_ops sandbox_usb_ops = {
 	.bulk		= sandbox_submit_bulk,
 	.interrupt	= sandbox_submit_int,
 	.alloc_device	= sandbox_alloc_device,
+	.alloc_streams	= sandbox_alloc_streams,
+	.free_streams	= sandbox_free_streams,
+	.bulk_stream	= sandbox_submit_bulk_stream,
 };
 
 static const struct udevice_id sandbox_usb_ids[] = {
@@ -9,6 +9,7 @@
 #define LOG_CATEGORY UCLASS_USB
 
 #include <common.h>
+#include <bootstage.h>
 #include <dm.h>
 #include <errno.h>
 #include <log.h>
@@ -172,6 +173,42 @@ int usb_get_max_xfer_size(struct usb_device *udev, size_t *size)
 	return ops->get_max_xfer_size(bus, size);
 }
 
+int usb_alloc_streams(struct usb_device *udev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->alloc_streams)
+		return -ENOSYS;
+
+	return ops->alloc_streams(bus, udev, pipes, num_pipes, num_streams);
+}
+
+int usb_free_streams(struct usb_device *udev, unsigned long *pipes,
+		     int num_pipes)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->free_streams)
+		return -ENOSYS;
+
+	return ops->free_streams(bus, udev, pipes, num_pipes);
+}
+
+int submit_bulk_stream_msg(struct usb_device *udev, unsigned long pipe,
+			   unsigned int stream_id, void *buffer, int length)
+{
+	struct udevice *bus = udev->controller_dev;
+	struct dm_usb_ops *ops = usb_get_ops(bus);
+
+	if (!ops->bulk_stream)
+		return -ENOSYS;
+
+	return ops->bulk_stream(bus, udev, pipe, stream_id, buffer, length);
+}
+
 int usb_stop(void)
 {
 	struct udevice *bus;
@@ -218,23 +255,59 @@ static void usb_scan_bus(struct udevice *bus, bool recurse)
 {
 	struct usb_bus_priv *priv;
 	struct udevice *dev;
-	int ret;
 
 	priv = dev_get_uclass_priv(bus);
 
 	assert(recurse);	/* TODO: Support non-recusive */
 
+	debug("%s: powering on root hub\n", bus->name);
+	priv->scan_err = usb_scan_device(bus, 0, USB_SPEED_FULL, &dev);
+}
+
+static void usb_show_bus(struct udevice *bus)
+{
+	struct usb_bus_priv *priv = dev_get_uclass_priv(bus);
+
 	printf("scanning bus %s for devices... ", bus->name);
-	debug("\n");
-	ret = usb_scan_device(bus, 0, USB_SPEED_FULL, &dev);
-	if (ret)
-		printf("failed, error %d\n", ret);
+	if (priv->scan_err)
+		printf("failed, error %d\n", priv->scan_err);
 	else if (priv->next_addr == 0)
 		printf("No USB Device found\n");
 	else
 		printf("%d USB Device(s) found\n", priv->next_addr);
 }
 
+/*
+ * Enumerate either the primary or the companion controllers. The root hubs of
+ * all of them are powered on first and their ports are then polled together,
+ * so the slowest bus rather than the sum of all buses sets the time taken.
+ */
+static void usb_scan_buses(struct uclass *uc, bool companion)
+{
+	struct usb_bus_priv *priv;
+	struct udevice *bus;
+
+	usb_hub_scan_begin();
+	uclass_foreach_dev(bus, uc) {
+		if (!device_active(bus))
+			continue;
+
+		priv = dev_get_uclass_priv(bus);
+		if (priv->companion == companion)
+			usb_scan_bus(bus, true);
+	}
+	usb_hub_scan_end();
+
+	uclass_foreach_dev(bus, uc) {
+		if (!device_active(bus))
+			continue;
+
+		priv = dev_get_uclass_priv(bus);
+		if (priv->companion == companion)
+			usb_show_bus(bus);
+	}
+}
+
 static void remove_inactive_children(struct uclass *uc, struct udevice *bus)
 {
 	uclass_foreach_dev(bus, uc) {
@@ -253,7 +326,6 @@ int usb_init(void)
 {
 	int controllers_initialized = 0;
 	struct usb_uclass_priv *uc_priv;
-	struct usb_bus_priv *priv;
 	struct udevice *bus;
 	struct uclass *uc;
 	int ret;
@@ -266,6 +338,7 @@ int usb_init(void)
 
 	uc_priv = uclass_get_priv(uc);
 
+	bootstage_mark_name(BOOTSTAGE_ID_USB_SCAN_START, "usb_scan_start");
 	uclass_foreach_dev(bus, uc) {
 		/* init low_level USB */
 		printf("Bus %s: ", bus->name);
@@ -307,30 +380,16 @@ int usb_init(void)
 	 * lowlevel init done, now scan the bus for devices i.e. search HUBs
 	 * and configure them, first scan primary controllers.
 	 */
-	uclass_foreach_dev(bus, uc) {
-		if (!device_active(bus))
-			continue;
-
-		priv = dev_get_uclass_priv(bus);
-		if (!priv->companion)
-			usb_scan_bus(bus, true);
-	}
+	usb_scan_buses(uc, false);
 
 	/*
 	 * Now that the primary controllers have been scanned and have handed
 	 * over any devices they do not understand to their companions, scan
 	 * the companions if necessary.
 	 */
-	if (uc_priv->companion_device_count) {
-		uclass_foreach_dev(bus, uc) {
-			if (!device_active(bus))
-				continue;
-
-			priv = dev_get_uclass_priv(bus);
-			if (priv->companion)
-				usb_scan_bus(bus, true);
-		}
-	}
+	if (uc_priv->companion_device_count)
+		usb_scan_buses(uc, true);
+	bootstage_mark_name(BOOTSTAGE_ID_USB_SCAN_DONE, "usb_scan_done");
 
 	debug("scan end\n");
 
@@ -162,9 +162,12 @@ static void xhci_free_virt_devices(struct xhci_ctrl *ctrl)
 
 		ctrl->dcbaa->dev_context_ptrs[slot_id] = 0;
 
-		for (i = 0; i < 31; ++i)
+		for (i = 0; i < 31; ++i) {
+			if (virt_dev->eps[i].stream_rings)
+				xhci_free_stream_rings(ctrl, &virt_dev->eps[i]);
 			if (virt_dev->eps[i].ring)
 				xhci_ring_free(ctrl, virt_dev->eps[i].ring);
+		}
 
 		if (virt_dev->in_ctx)
 			xhci_free_container_ctx(ctrl, virt_dev->in_ctx);
@@ -515,6 +518,68 @@ int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id)
 	return 0;
 }
 
+/**
+ * Allocates the stream context array of an endpoint, and a transfer ring
+ * for each of its streams. Entry 0 of the array is reserved, so this gives
+ * num_stream_ctxs - 1 streams, with IDs counted from 1.
+ *
+ * @param ctrl	Host controller data structure
+ * @param ep	endpoint to set up
+ * @param num_stream_ctxs	number of entries in the array, a power of two
+ * Return: none
+ */
+void xhci_alloc_stream_rings(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			     unsigned int num_stream_ctxs)
+{
+	struct xhci_ring *ring;
+	unsigned int i;
+	u64 addr;
+
+	ep->stream_ctx = xhci_malloc(num_stream_ctxs *
+				     sizeof(struct xhci_stream_ctx));
+	ep->stream_ctx_dma = xhci_dma_map(ctrl, ep->stream_ctx,
+					  num_stream_ctxs *
+					  sizeof(struct xhci_stream_ctx));
+	ep->stream_rings = calloc(num_stream_ctxs, sizeof(struct xhci_ring *));
+	BUG_ON(!ep->stream_rings);
+	ep->num_stream_ctxs = num_stream_ctxs;
+
+	for (i = 1; i < num_stream_ctxs; i++) {
+		ring = xhci_ring_alloc(ctrl, 1, true);
+		ep->stream_rings[i] = ring;
+		addr = xhci_trb_virt_to_dma(ring->enq_seg, ring->enqueue);
+		ep->stream_ctx[i].stream_ring = cpu_to_le64(addr |
+						SCT_FOR_CTX(SCT_PRI_TR) |
+						ring->cycle_state);
+	}
+
+	xhci_flush_cache((uintptr_t)ep->stream_ctx,
+			 num_stream_ctxs * sizeof(struct xhci_stream_ctx));
+}
+
+/**
+ * Frees the stream context array of an endpoint and its stream rings
+ *
+ * @param ctrl	Host controller data structure
+ * @param ep	endpoint whose streams are to be freed
+ * Return: none
+ */
+void xhci_free_stream_rings(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep)
+{
+	unsigned int i;
+
+	for (i = 1; i < ep->num_stream_ctxs; i++)
+		xhci_ring_free(ctrl, ep->stream_rings[i]);
+	free(ep->stream_rings);
+	xhci_dma_unmap(ctrl, ep->stream_ctx_dma,
+		       ep->num_stream_ctxs * sizeof(struct xhci_stream_ctx));
+	free(ep->stream_ctx);
+
+	ep->stream_rings = NULL;
+	ep->stream_ctx = NULL;
+	ep->num_stream_ctxs = 0;
+}
+
 /**
  * Allocates the necessary data structures
  * for XHCI host controller
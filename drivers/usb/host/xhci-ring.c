@@ -277,18 +277,21 @@ static int prepare_ring(struct xhci_ctrl *ctrl, struct xhci_ring *ep_ring,
 }
 
 /**
- * Generic function for queueing a command TRB on the command ring.
- * Check to make sure there's room on the command ring for one command TRB.
+ * Queue a command TRB for an endpoint stream on the command ring.
+ * Only 'set TR dequeue pointer' needs a stream ID, for other commands
+ * use xhci_queue_command().
  *
  * @param ctrl		Host controller data structure
  * @param ptr		Pointer address to write in the first two fields (opt.)
  * @param slot_id	Slot ID to encode in the flags field (opt.)
  * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param stream_id	Stream ID to encode in the status field (opt.)
  * @param cmd		Command type to enqueue
  * Return: none
  */
-void xhci_queue_command(struct xhci_ctrl *ctrl, dma_addr_t addr, u32 slot_id,
-			u32 ep_index, trb_type cmd)
+static void queue_stream_command(struct xhci_ctrl *ctrl, dma_addr_t addr,
+				 u32 slot_id, u32 ep_index, u32 stream_id,
+				 trb_type cmd)
 {
 	u32 fields[4];
 
@@ -296,7 +299,7 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, dma_addr_t addr, u32 slot_id,
 
 	fields[0] = lower_32_bits(addr);
 	fields[1] = upper_32_bits(addr);
-	fields[2] = 0;
+	fields[2] = STREAM_ID_FOR_TRB(stream_id);
 	fields[3] = TRB_TYPE(cmd) | SLOT_ID_FOR_TRB(slot_id) |
 		    ctrl->cmd_ring->cycle_state;
 
@@ -313,6 +316,23 @@ void xhci_queue_command(struct xhci_ctrl *ctrl, dma_addr_t addr, u32 slot_id,
 	xhci_writel(&ctrl->dba->doorbell[0], DB_VALUE_HOST);
 }
 
+/**
+ * Generic function for queueing a command TRB on the command ring.
+ * Check to make sure there's room on the command ring for one command TRB.
+ *
+ * @param ctrl		Host controller data structure
+ * @param ptr		Pointer address to write in the first two fields (opt.)
+ * @param slot_id	Slot ID to encode in the flags field (opt.)
+ * @param ep_index	Endpoint index to encode in the flags field (opt.)
+ * @param cmd		Command type to enqueue
+ * Return: none
+ */
+void xhci_queue_command(struct xhci_ctrl *ctrl, dma_addr_t addr, u32 slot_id,
+			u32 ep_index, trb_type cmd)
+{
+	queue_stream_command(ctrl, addr, slot_id, ep_index, 0, cmd);
+}
+
 /*
  * For xHCI 1.0 host controllers, TD size is the number of max packet sized
  * packets remaining in the TD (*not* including this TRB).
@@ -371,13 +391,14 @@ static u32 xhci_td_remainder(struct xhci_ctrl *ctrl, int transferred,
  *
  * @param udev		pointer to the USB device structure
  * @param ep_index	index of the endpoint
+ * @param stream_id	stream the TRBs were queued on, or 0 if none
  * @param start_cycle	cycle flag of the first TRB
  * @param start_trb	pionter to the first TRB
  * Return: none
  */
 static void giveback_first_trb(struct usb_device *udev, int ep_index,
-				int start_cycle,
-				struct xhci_generic_trb *start_trb)
+			       unsigned int stream_id, int start_cycle,
+			       struct xhci_generic_trb *start_trb)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
 
@@ -394,7 +415,7 @@ static void giveback_first_trb(struct usb_device *udev, int ep_index,
 
 	/* Ringing EP doorbell here */
 	xhci_writel(&ctrl->dba->doorbell[udev->slot_id],
-				DB_VALUE(ep_index, 0));
+				DB_VALUE(ep_index, stream_id));
 
 	return;
 }
@@ -498,31 +519,49 @@ union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected)
 
 /*
  * Send reset endpoint command for given endpoint. This recovers from a
- * halted endpoint (e.g. due to a stall error).
+ * halted endpoint (e.g. due to a stall error). On an endpoint with streams
+ * only the ring of the stream which halted is moved on; the others keep
+ * their place.
  */
-static void reset_ep(struct usb_device *udev, int ep_index)
+static int reset_ep(struct usb_device *udev, int ep_index,
+		    unsigned int stream_id)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
-	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_ring *ring = stream_id ? ep->stream_rings[stream_id] :
+				 ep->ring;
 	union xhci_trb *event;
 	u64 addr;
-	u32 field;
+	u32 field, comp;
 
 	printf("Resetting EP %d...\n", ep_index);
 	xhci_queue_command(ctrl, 0, udev->slot_id, ep_index, TRB_RESET_EP);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
-	field = le32_to_cpu(event->trans_event.flags);
-	BUG_ON(TRB_TO_SLOT_ID(field) != udev->slot_id);
+	field = le32_to_cpu(event->event_cmd.flags);
+	comp = GET_COMP_CODE(le32_to_cpu(event->event_cmd.status));
 	xhci_acknowledge_event(ctrl);
+	if (TRB_TO_SLOT_ID(field) != udev->slot_id || comp != COMP_SUCCESS) {
+		printf("Reset of EP %d failed (%d)\n", ep_index, comp);
+		return -EIO;
+	}
 
 	addr = xhci_trb_virt_to_dma(ring->enq_seg,
 		(void *)((uintptr_t)ring->enqueue | ring->cycle_state));
-	xhci_queue_command(ctrl, addr, udev->slot_id, ep_index, TRB_SET_DEQ);
+	if (stream_id)
+		addr |= SCT_FOR_CTX(SCT_PRI_TR);
+	queue_stream_command(ctrl, addr, udev->slot_id, ep_index, stream_id,
+			     TRB_SET_DEQ);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
-	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
-		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
-		event->event_cmd.status)) != COMP_SUCCESS);
+	field = le32_to_cpu(event->event_cmd.flags);
+	comp = GET_COMP_CODE(le32_to_cpu(event->event_cmd.status));
 	xhci_acknowledge_event(ctrl);
+	if (TRB_TO_SLOT_ID(field) != udev->slot_id || comp != COMP_SUCCESS) {
+		printf("Moving dequeue pointer of EP %d failed (%d)\n",
+		       ep_index, comp);
+		return -EIO;
+	}
+
+	return 0;
 }
 
 /*
@@ -533,10 +572,13 @@ static void reset_ep(struct usb_device *udev, int ep_index)
  * (Careful: This will BUG() when there was no transfer in progress. Shouldn't
  * happen in practice for current uses and is too complicated to fix right now.)
  */
-static void abort_td(struct usb_device *udev, int ep_index)
+static void abort_td(struct usb_device *udev, int ep_index,
+		     unsigned int stream_id)
 {
 	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
-	struct xhci_ring *ring =  ctrl->devs[udev->slot_id]->eps[ep_index].ring;
+	struct xhci_virt_ep *ep = &ctrl->devs[udev->slot_id]->eps[ep_index];
+	struct xhci_ring *ring = stream_id ? ep->stream_rings[stream_id] :
+				 ep->ring;
 	union xhci_trb *event;
 	u64 addr;
 	u32 field;
@@ -559,7 +601,10 @@ static void abort_td(struct usb_device *udev, int ep_index)
 
 	addr = xhci_trb_virt_to_dma(ring->enq_seg,
 		(void *)((uintptr_t)ring->enqueue | ring->cycle_state));
-	xhci_queue_command(ctrl, addr, udev->slot_id, ep_index, TRB_SET_DEQ);
+	if (stream_id)
+		addr |= SCT_FOR_CTX(SCT_PRI_TR);
+	queue_stream_command(ctrl, addr, udev->slot_id, ep_index, stream_id,
+			     TRB_SET_DEQ);
 	event = xhci_wait_for_event(ctrl, TRB_COMPLETION);
 	BUG_ON(TRB_TO_SLOT_ID(le32_to_cpu(event->event_cmd.flags))
 		!= udev->slot_id || GET_COMP_CODE(le32_to_cpu(
@@ -597,16 +642,18 @@ static void record_transfer_result(struct usb_device *udev,
 
 /**** Bulk and Control transfer methods ****/
 /**
- * Queues up the BULK Request
+ * Queues up the BULK Request on a stream of the endpoint
  *
  * @param udev		pointer to the USB device structure
  * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param stream_id	stream to queue the request on, or 0 if the endpoint
+ *			has no streams
  * @param length	length of the buffer
  * @param buffer	buffer to be read/written based on the request
  * Return: returns 0 if successful else -1 on failure
  */
-int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
-			int length, void *buffer)
+int xhci_bulk_tx_stream(struct usb_device *udev, unsigned long pipe,
+			unsigned int stream_id, int length, void *buffer)
 {
 	int num_trbs = 0;
 	struct xhci_generic_trb *start_trb;
@@ -618,6 +665,7 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	int slot_id = udev->slot_id;
 	int ep_index;
 	struct xhci_virt_device *virt_dev;
+	struct xhci_virt_ep *ep;
 	struct xhci_ep_ctx *ep_ctx;
 	struct xhci_ring *ring;		/* EP transfer ring */
 	union xhci_trb *event;
@@ -632,19 +680,27 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 	dma_addr_t last_transfer_trb_addr;
 	int available_length;
 
-	debug("dev=%p, pipe=%lx, buffer=%p, length=%d\n",
-		udev, pipe, buffer, length);
+	debug("dev=%p, pipe=%lx, stream=%u, buffer=%p, length=%d\n",
+		udev, pipe, stream_id, buffer, length);
 
 	available_length = length;
 	ep_index = usb_pipe_ep_index(pipe);
 	virt_dev = ctrl->devs[slot_id];
+	ep = &virt_dev->eps[ep_index];
+
+	/* an endpoint with streams only takes requests on a stream */
+	if (!ep->stream_rings != !stream_id ||
+	    (stream_id && stream_id >= ep->num_stream_ctxs)) {
+		xhci_dma_unmap(ctrl, buf_64, length);
+		return -EINVAL;
+	}
 
 	xhci_inval_cache((uintptr_t)virt_dev->out_ctx->bytes,
 			 virt_dev->out_ctx->size);
 
 	ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->out_ctx, ep_index);
 
-	ring = virt_dev->eps[ep_index].ring;
+	ring = stream_id ? ep->stream_rings[stream_id] : ep->ring;
 	/*
 	 * How much data is (potentially) left before the 64KB boundary?
 	 * XHCI Spec puts restriction( TABLE 49 and 6.4.1 section of XHCI Spec)
@@ -760,13 +816,13 @@ int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		trb_buff_len = min((length - running_total), TRB_MAX_BUFF_SIZE);
 	} while (running_total < length);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	giveback_first_trb(udev, ep_index, stream_id, start_cycle, start_trb);
 
 again:
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event) {
 		debug("XHCI bulk transfer timed out, aborting...\n");
-		abort_td(udev, ep_index);
+		abort_td(udev, ep_index, stream_id);
 		udev->status = USB_ST_NAK_REC;  /* closest thing to a timeout */
 		udev->act_len = 0;
 		return -ETIMEDOUT;
@@ -789,9 +845,29 @@ again:
 	xhci_inval_cache((uintptr_t)buffer, length);
 	xhci_dma_unmap(ctrl, buf_64, length);
 
+	if (udev->status == USB_ST_STALLED) {
+		reset_ep(udev, ep_index, stream_id);
+		return -EPIPE;
+	}
+
 	return (udev->status != USB_ST_NOT_PROC) ? 0 : -1;
 }
 
+/**
+ * Queues up the BULK Request
+ *
+ * @param udev		pointer to the USB device structure
+ * @param pipe		contains the DIR_IN or OUT , devnum
+ * @param length	length of the buffer
+ * @param buffer	buffer to be read/written based on the request
+ * Return: returns 0 if successful else -1 on failure
+ */
+int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
+			int length, void *buffer)
+{
+	return xhci_bulk_tx_stream(udev, pipe, 0, length, buffer);
+}
+
 /**
  * Queues up the Control Transfer Request
  *
@@ -963,7 +1039,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 	queue_trb(ctrl, ep_ring, false, trb_fields);
 
-	giveback_first_trb(udev, ep_index, start_cycle, start_trb);
+	giveback_first_trb(udev, ep_index, 0, start_cycle, start_trb);
 
 	event = xhci_wait_for_event(ctrl, TRB_TRANSFER);
 	if (!event)
@@ -976,7 +1052,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 	record_transfer_result(udev, event, length);
 	xhci_acknowledge_event(ctrl);
 	if (udev->status == USB_ST_STALLED) {
-		reset_ep(udev, ep_index);
+		reset_ep(udev, ep_index, 0);
 		return -EPIPE;
 	}
 
@@ -1001,7 +1077,7 @@ int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 
 abort:
 	debug("XHCI control transfer timed out, aborting...\n");
-	abort_td(udev, ep_index);
+	abort_td(udev, ep_index, 0);
 	udev->status = USB_ST_NAK_REC;
 	udev->act_len = 0;
 	return -ETIMEDOUT;
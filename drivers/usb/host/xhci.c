@@ -36,6 +36,7 @@
 #include <linux/delay.h>
 #include <linux/errno.h>
 #include <linux/iopoll.h>
+#include <linux/log2.h>
 
 static struct descriptor {
 	struct usb_hub_descriptor hub;
@@ -1386,6 +1387,181 @@ static int xhci_get_max_xfer_size(struct udevice *dev, size_t *size)
 	return 0;
 }
 
+/* Most streams the device offers on the bulk endpoint that @pipe goes to */
+static int xhci_ep_max_streams(struct usb_device *udev, unsigned long pipe)
+{
+	u8 addr = usb_pipeendpoint(pipe) | (usb_pipein(pipe) ? USB_DIR_IN : 0);
+	struct usb_interface *ifdesc;
+	int max_streams = 0;
+	int i, j;
+
+	/* the endpoint may appear in several alternate settings */
+	for (i = 0; i < udev->config.no_of_if; i++) {
+		ifdesc = &udev->config.if_desc[i];
+		for (j = 0; j < ifdesc->no_of_ep; j++) {
+			if (ifdesc->ep_desc[j].bEndpointAddress != addr ||
+			    !usb_endpoint_xfer_bulk(&ifdesc->ep_desc[j]))
+				continue;
+			max_streams = max(max_streams, usb_ss_max_streams(
+					  &ifdesc->ss_ep_comp_desc[j]));
+		}
+	}
+
+	return max_streams;
+}
+
+/*
+ * Set up the input context to reconfigure the endpoints of @pipes, which
+ * the caller then changes before issuing a configure endpoint command
+ */
+static void xhci_streams_prepare(struct usb_device *udev,
+				 unsigned long *pipes, int num_pipes)
+{
+	struct xhci_ctrl *ctrl = xhci_get_ctrl(udev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_container_ctx *out_ctx = virt_dev->out_ctx;
+	struct xhci_container_ctx *in_ctx = virt_dev->in_ctx;
+	struct xhci_input_control_ctx *ctrl_ctx;
+	int ep_index, i;
+
+	xhci_inval_cache((uintptr_t)out_ctx->bytes, out_ctx->size);
+
+	ctrl_ctx = xhci_get_input_control_ctx(in_ctx);
+	ctrl_ctx->add_flags = cpu_to_le32(SLOT_FLAG);
+	ctrl_ctx->drop_flags = 0;
+	xhci_slot_copy(ctrl, in_ctx, out_ctx);
+
+	/* dropping and adding an endpoint again reconfigures it */
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		xhci_endpoint_copy(ctrl, in_ctx, out_ctx, ep_index);
+		ctrl_ctx->add_flags |= cpu_to_le32(1 << (ep_index + 1));
+		ctrl_ctx->drop_flags |= cpu_to_le32(1 << (ep_index + 1));
+	}
+}
+
+static int xhci_alloc_streams(struct udevice *dev, struct usb_device *udev,
+			      unsigned long *pipes, int num_pipes,
+			      unsigned int num_streams)
+{
+	struct xhci_ctrl *ctrl = dev_get_priv(dev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	unsigned int max_psa, num_stream_ctxs;
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_virt_ep *ep;
+	int ep_index, i, ret;
+
+	debug("%s: dev='%s', udev=%p, num_streams=%u\n", __func__, dev->name,
+	      udev, num_streams);
+
+	max_psa = HCC_MAX_PSA(xhci_readl(&ctrl->hccr->cr_hccparams));
+	if (max_psa < 4)
+		return -ENOSYS;
+
+	/* stream 0 is reserved, so the array has room for one stream less */
+	num_streams = min(num_streams, max_psa - 1);
+	for (i = 0; i < num_pipes; i++) {
+		if (usb_pipetype(pipes[i]) != PIPE_BULK)
+			return -EINVAL;
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		if (virt_dev->eps[ep_index].stream_rings)
+			return -EBUSY;
+		num_streams = min_t(unsigned int, num_streams,
+				    xhci_ep_max_streams(udev, pipes[i]));
+	}
+	if (!num_streams)
+		return -ENOSYS;
+
+	/* the smallest array the endpoint context can describe has 4 entries */
+	num_stream_ctxs = max_t(unsigned int,
+				roundup_pow_of_two(num_streams + 1), 4);
+
+	xhci_streams_prepare(udev, pipes, num_pipes);
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		ep = &virt_dev->eps[ep_index];
+		xhci_alloc_stream_rings(ctrl, ep, num_stream_ctxs);
+
+		ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->in_ctx, ep_index);
+		ep_ctx->ep_info &= cpu_to_le32(~(EP_MAXPSTREAMS_MASK |
+					       EP_STATE_MASK));
+		ep_ctx->ep_info |= cpu_to_le32(EP_MAXPSTREAMS(
+					       ilog2(num_stream_ctxs) - 1) |
+					       EP_HAS_LSA);
+		ep_ctx->deq = cpu_to_le64(ep->stream_ctx_dma);
+	}
+
+	ret = xhci_configure_endpoints(udev, false);
+	if (ret) {
+		for (i = 0; i < num_pipes; i++) {
+			ep_index = usb_pipe_ep_index(pipes[i]);
+			xhci_free_stream_rings(ctrl, &virt_dev->eps[ep_index]);
+		}
+		return ret;
+	}
+
+	return num_stream_ctxs - 1;
+}
+
+static int xhci_free_streams(struct udevice *dev, struct usb_device *udev,
+			     unsigned long *pipes, int num_pipes)
+{
+	struct xhci_ctrl *ctrl = dev_get_priv(dev);
+	struct xhci_virt_device *virt_dev = ctrl->devs[udev->slot_id];
+	struct xhci_ep_ctx *ep_ctx;
+	struct xhci_ring *ring;
+	int ep_index, i, ret;
+	u64 deq;
+
+	debug("%s: dev='%s', udev=%p\n", __func__, dev->name, udev);
+
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		if (!virt_dev->eps[ep_index].stream_rings)
+			return -EINVAL;
+	}
+
+	/* go back to the endpoint's own transfer ring */
+	xhci_streams_prepare(udev, pipes, num_pipes);
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		ring = virt_dev->eps[ep_index].ring;
+
+		ep_ctx = xhci_get_ep_ctx(ctrl, virt_dev->in_ctx, ep_index);
+		ep_ctx->ep_info &= cpu_to_le32(~(EP_MAXPSTREAMS_MASK |
+					       EP_HAS_LSA | EP_STATE_MASK));
+		deq = xhci_trb_virt_to_dma(ring->enq_seg, ring->enqueue);
+		ep_ctx->deq = cpu_to_le64(deq | ring->cycle_state);
+	}
+
+	ret = xhci_configure_endpoints(udev, false);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < num_pipes; i++) {
+		ep_index = usb_pipe_ep_index(pipes[i]);
+		xhci_free_stream_rings(ctrl, &virt_dev->eps[ep_index]);
+	}
+
+	return 0;
+}
+
+static int xhci_submit_bulk_stream_msg(struct udevice *dev,
+				       struct usb_device *udev,
+				       unsigned long pipe,
+				       unsigned int stream_id, void *buffer,
+				       int length)
+{
+	debug("%s: dev='%s', udev=%p, stream=%u\n", __func__, dev->name, udev,
+	      stream_id);
+	if (usb_pipetype(pipe) != PIPE_BULK) {
+		printf("non-bulk pipe (type=%lu)", usb_pipetype(pipe));
+		return -EINVAL;
+	}
+
+	return xhci_bulk_tx_stream(udev, pipe, stream_id, length, buffer);
+}
+
 int xhci_register(struct udevice *dev, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor)
 {
@@ -1440,4 +1616,7 @@ struct dm_usb_ops xhci_usb_ops = {
 	.alloc_device = xhci_alloc_device,
 	.update_hub_device = xhci_update_hub_device,
 	.get_max_xfer_size  = xhci_get_max_xfer_size,
+	.alloc_streams = xhci_alloc_streams,
+	.free_streams = xhci_free_streams,
+	.bulk_stream = xhci_submit_bulk_stream_msg,
 };
@@ -9,57 +9,330 @@
 #include <common.h>
 #include <blk.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <virtio_types.h>
 #include <virtio.h>
 #include <virtio_ring.h>
+#include <linux/sizes.h>
 #include "virtio_blk.h"
 
-struct virtio_blk_priv {
+/* Most requests which can be handed to the device at once */
+#define VIRTIO_BLK_SLOTS	32
+/* Most data segments in a request, besides its header and status */
+#define VIRTIO_BLK_MAX_SEGS	32
+/* Largest request, used when the device has no maximum segment size */
+#define VIRTIO_BLK_MAX_REQ	SZ_4M
+/* Most request queues used when the device offers several */
+#define VIRTIO_BLK_MAX_VQS	4
+
+static const u32 feature[] = {
+	VIRTIO_BLK_F_SIZE_MAX,
+	VIRTIO_BLK_F_SEG_MAX,
+	VIRTIO_BLK_F_MQ,
+	VIRTIO_RING_F_INDIRECT_DESC,
+};
+
+/**
+ * struct virtio_blk_xfer - A read or write split into requests to the device
+ *
+ * @start: First sector to transfer
+ * @blkcnt: Number of sectors to transfer
+ * @buffer: Data to write, or place to put the data read
+ * @type: VIRTIO_BLK_T_IN or VIRTIO_BLK_T_OUT
+ * @sent: Number of sectors covered by the requests handed over so far
+ * @valid: Number of sectors before the first failed request, or @blkcnt
+ * @err: Error from the first failed request, or 0
+ * @reqs: Number of requests the device has
+ * @done: true once all requests have been handed back
+ * @req: Asynchronous request this carries out, or NULL
+ * @busy: true while this pool entry is in use by an asynchronous request
+ * @sibling: Node in the list of transfers in progress
+ */
+struct virtio_blk_xfer {
+	u64 start;
+	lbaint_t blkcnt;
+	void *buffer;
+	u32 type;
+	lbaint_t sent;
+	lbaint_t valid;
+	int err;
+	uint reqs;
+	bool done;
+	struct blk_request *req;
+	bool busy;
+	struct list_head sibling;
+};
+
+/**
+ * struct virtio_blk_slot - A request handed to the device
+ *
+ * @out_hdr: Request header
+ * @status: Status written by the device
+ * @xfer: Transfer the request belongs to
+ * @offset: First sector of the request, counted from the start of @xfer
+ * @blkcnt: Number of sectors in the request
+ * @vq: Queue the request is handed over on
+ * @busy: true while the device has the request
+ * @table: Indirect descriptors for the header, data segments and status
+ */
+struct virtio_blk_slot {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+	struct virtio_blk_xfer *xfer;
+	lbaint_t offset;
+	lbaint_t blkcnt;
 	struct virtqueue *vq;
+	bool busy;
+	struct vring_desc table[VIRTIO_BLK_MAX_SEGS + 2] __aligned(16);
 };
 
-static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
-			       lbaint_t blkcnt, void *buffer, u32 type)
+/**
+ * struct virtio_blk_priv - Private data for a virtio block device
+ *
+ * @vqs: Request queues
+ * @num_vqs: Number of @vqs
+ * @slots: Requests which can be handed to the device
+ * @num_slots: Number of @slots, limited by the size of the queues
+ * @xfers: Transfers in progress, oldest first
+ * @xfer_pool: Transfers for asynchronous requests, @num_slots of them
+ * @max_segs: Most data segments in a request
+ * @seg_size: Largest data segment, a multiple of the sector size
+ */
+struct virtio_blk_priv {
+	struct virtqueue *vqs[VIRTIO_BLK_MAX_VQS];
+	uint num_vqs;
+	struct virtio_blk_slot *slots;
+	uint num_slots;
+	struct list_head xfers;
+	struct virtio_blk_xfer *xfer_pool;
+	uint max_segs;
+	u32 seg_size;
+};
+
+/* Hand the next request of @xfer to the device, using @slot */
+static int virtio_blk_add(struct udevice *dev, struct virtio_blk_slot *slot,
+			  struct virtio_blk_xfer *xfer)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
-	unsigned int num_out = 0, num_in = 0;
-	struct virtio_sg *sgs[3];
-	u8 status;
-	int ret;
-
-	struct virtio_blk_outhdr out_hdr = {
-		.type = cpu_to_virtio32(dev, type),
-		.sector = cpu_to_virtio64(dev, sector),
-	};
-	struct virtio_sg hdr_sg = { &out_hdr, sizeof(out_hdr) };
-	struct virtio_sg data_sg = { buffer, blkcnt * 512 };
-	struct virtio_sg status_sg = { &status, sizeof(status) };
+	struct virtio_sg sg[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtio_sg *sgs[VIRTIO_BLK_MAX_SEGS + 2];
+	uint num_out = 1, num_in = 1, num_sgs = 0;
+	lbaint_t max_blks = priv->max_segs * (priv->seg_size >> 9);
+	void *buffer;
+	ulong left, len;
+	int i, ret;
 
-	sgs[num_out++] = &hdr_sg;
+	slot->offset = xfer->sent;
+	slot->blkcnt = min(xfer->blkcnt - xfer->sent, max_blks);
+	slot->out_hdr.type = cpu_to_virtio32(dev, xfer->type);
+	slot->out_hdr.ioprio = 0;
+	slot->out_hdr.sector = cpu_to_virtio64(dev, xfer->start + slot->offset);
+	sg[num_sgs].addr = &slot->out_hdr;
+	sg[num_sgs++].length = sizeof(slot->out_hdr);
 
-	if (type & VIRTIO_BLK_T_OUT)
-		sgs[num_out++] = &data_sg;
+	buffer = xfer->buffer + slot->offset * 512;
+	for (left = slot->blkcnt * 512; left; left -= len) {
+		len = min_t(ulong, left, priv->seg_size);
+		sg[num_sgs].addr = buffer;
+		sg[num_sgs++].length = len;
+		buffer += len;
+	}
+	if (xfer->type & VIRTIO_BLK_T_OUT)
+		num_out += num_sgs - 1;
 	else
-		sgs[num_out + num_in++] = &data_sg;
+		num_in += num_sgs - 1;
 
-	sgs[num_out + num_in++] = &status_sg;
-	log_debug("dev=%s, active=%d, priv=%p, priv->vq=%p\n", dev->name,
-		  device_active(dev), priv, priv->vq);
+	sg[num_sgs].addr = &slot->status;
+	sg[num_sgs++].length = sizeof(slot->status);
+	for (i = 0; i < num_sgs; i++)
+		sgs[i] = &sg[i];
 
-	ret = virtqueue_add(priv->vq, sgs, num_out, num_in);
+	ret = virtqueue_add_indirect(slot->vq, sgs, num_out, num_in,
+				     slot->table);
 	if (ret)
 		return ret;
+	slot->xfer = xfer;
+	slot->busy = true;
+	xfer->sent += slot->blkcnt;
+	xfer->reqs++;
+
+	return 0;
+}
+
+/* Finish a transfer whose requests have all been handed back */
+static void virtio_blk_finish(struct virtio_blk_xfer *xfer)
+{
+	list_del(&xfer->sibling);
+	xfer->done = true;
+	if (CONFIG_IS_ENABLED(BLK_ASYNC) && xfer->req) {
+		xfer->busy = false;
+		blk_complete(xfer->req, xfer->valid ? xfer->valid : xfer->err);
+	}
+}
+
+/*
+ * Find the busy slot whose header is @buf, the token virtqueue_get_buf() hands
+ * back for the request, or NULL if there is none
+ */
+static struct virtio_blk_slot *virtio_blk_find_slot(struct virtio_blk_priv *priv,
+						    void *buf)
+{
+	ulong i;
+
+	i = ((ulong)buf - (ulong)&priv->slots[0].out_hdr) / sizeof(*priv->slots);
+	if (i >= priv->num_slots || buf != &priv->slots[i].out_hdr ||
+	    !priv->slots[i].busy)
+		return NULL;
+
+	return &priv->slots[i];
+}
+
+/* Take back the requests the device has finished, on all queues */
+static void virtio_blk_reap(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_slot *slot;
+	struct virtio_blk_xfer *xfer;
+	void *buf;
+	int i;
+
+	for (i = 0; i < priv->num_vqs; i++) {
+		while ((buf = virtqueue_get_buf(priv->vqs[i], NULL))) {
+			slot = virtio_blk_find_slot(priv, buf);
+			if (!slot) {
+				log_err("%s: unknown request %p\n", dev->name,
+					buf);
+				continue;
+			}
+			slot->busy = false;
+			xfer = slot->xfer;
+			xfer->reqs--;
+			if (slot->status != VIRTIO_BLK_S_OK &&
+			    slot->offset < xfer->valid) {
+				xfer->valid = slot->offset;
+				xfer->err = -EIO;
+			}
+			if (!xfer->reqs &&
+			    (xfer->sent == xfer->blkcnt || xfer->err))
+				virtio_blk_finish(xfer);
+		}
+	}
+}
+
+static struct virtio_blk_slot *virtio_blk_free_slot(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	int i;
+
+	for (i = 0; i < priv->num_slots; i++) {
+		if (!priv->slots[i].busy)
+			return &priv->slots[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * Hand requests for the transfers in progress to the device, oldest first,
+ * while there are free slots, then notify each queue once for the batch
+ */
+static void virtio_blk_send(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	bool added[VIRTIO_BLK_MAX_VQS] = {};
+	struct virtio_blk_xfer *xfer;
+	struct virtio_blk_slot *slot;
+	int i;
+
+	list_for_each_entry(xfer, &priv->xfers, sibling) {
+		while (xfer->sent < xfer->blkcnt && !xfer->err) {
+			slot = virtio_blk_free_slot(dev);
+			if (!slot || virtio_blk_add(dev, slot, xfer))
+				goto kick;
+			added[(slot - priv->slots) % priv->num_vqs] = true;
+		}
+	}
+
+kick:
+	for (i = 0; i < priv->num_vqs; i++) {
+		if (added[i])
+			virtqueue_kick(priv->vqs[i]);
+	}
+}
+
+/* Queue a transfer and hand as many of its requests over as there is room */
+static void virtio_blk_start(struct udevice *dev, struct virtio_blk_xfer *xfer,
+			     u64 sector, lbaint_t blkcnt, void *buffer,
+			     u32 type)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+
+	xfer->start = sector;
+	xfer->blkcnt = blkcnt;
+	xfer->buffer = buffer;
+	xfer->type = type;
+	xfer->sent = 0;
+	xfer->valid = blkcnt;
+	xfer->err = 0;
+	xfer->reqs = 0;
+	xfer->done = false;
+	list_add_tail(&xfer->sibling, &priv->xfers);
+	log_debug("dev=%s, sector=%llx, blkcnt=" LBAFU "\n", dev->name,
+		  sector, blkcnt);
+	virtio_blk_send(dev);
+}
 
-	virtqueue_kick(priv->vq);
+static ulong virtio_blk_do_req(struct udevice *dev, u64 sector,
+			       lbaint_t blkcnt, void *buffer, u32 type)
+{
+	struct virtio_blk_xfer xfer;
+
+	if (!blkcnt)
+		return 0;
+
+	xfer.req = NULL;
+	virtio_blk_start(dev, &xfer, sector, blkcnt, buffer, type);
 
 	log_debug("wait...");
-	while (!virtqueue_get_buf(priv->vq, NULL))
-		;
+	while (!xfer.done) {
+		virtio_blk_reap(dev);
+		virtio_blk_send(dev);
+	}
 	log_debug("done\n");
 
-	return status == VIRTIO_BLK_S_OK ? blkcnt : -EIO;
+	return xfer.valid ? xfer.valid : xfer.err;
+}
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+static int virtio_blk_submit(struct udevice *dev, struct blk_request *req)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	struct virtio_blk_xfer *xfer;
+	int i;
+
+	for (i = 0; i < priv->num_slots && priv->xfer_pool[i].busy; i++)
+		;
+	if (i == priv->num_slots)
+		return -EAGAIN;
+
+	xfer = &priv->xfer_pool[i];
+	xfer->busy = true;
+	xfer->req = req;
+	virtio_blk_start(dev, xfer, req->start, req->blkcnt, req->buffer,
+			 req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN);
+
+	return 0;
+}
+
+static int virtio_blk_poll(struct udevice *dev)
+{
+	virtio_blk_reap(dev);
+	virtio_blk_send(dev);
+
+	return 0;
 }
+#endif
 
 static ulong virtio_blk_read(struct udevice *dev, lbaint_t start,
 			     lbaint_t blkcnt, void *buffer)
@@ -105,33 +378,123 @@ static int virtio_blk_bind(struct udevice *dev)
 	desc->bdev = dev;
 
 	/* Indicate what driver features we support */
-	virtio_driver_features_init(uc_priv, NULL, 0, NULL, 0);
+	virtio_driver_features_init(uc_priv, feature, ARRAY_SIZE(feature),
+				    NULL, 0);
 
 	return 0;
 }
 
+/* Read the request limits from the config space and size the slots to fit */
+static int virtio_blk_setup(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+	u32 size_max, seg_max;
+	u16 num_queues;
+
+	priv->num_vqs = 1;
+	if (!virtio_cread_feature(dev, VIRTIO_BLK_F_MQ, struct virtio_blk_config,
+				  num_queues, &num_queues))
+		priv->num_vqs = clamp_t(uint, num_queues, 1,
+					VIRTIO_BLK_MAX_VQS);
+
+	/* without a limit, each request has a single data segment */
+	if (virtio_cread_feature(dev, VIRTIO_BLK_F_SEG_MAX,
+				 struct virtio_blk_config, seg_max, &seg_max))
+		seg_max = 1;
+	priv->max_segs = clamp_t(uint, seg_max, 1, VIRTIO_BLK_MAX_SEGS);
+
+	if (virtio_cread_feature(dev, VIRTIO_BLK_F_SIZE_MAX,
+				 struct virtio_blk_config, size_max,
+				 &size_max) || !size_max)
+		size_max = VIRTIO_BLK_MAX_REQ;
+	priv->seg_size = clamp_t(u32, ALIGN_DOWN(size_max, 512), 512,
+				 VIRTIO_BLK_MAX_REQ / priv->max_segs);
+
+	return virtio_find_vqs(dev, priv->num_vqs, priv->vqs);
+}
+
 static int virtio_blk_probe(struct udevice *dev)
 {
 	struct virtio_blk_priv *priv = dev_get_priv(dev);
 	struct blk_desc *desc = dev_get_uclass_plat(dev);
+	struct virtqueue *vq;
+	uint per_vq;
 	u64 cap;
-	int ret;
+	int i, ret;
 
-	ret = virtio_find_vqs(dev, 1, &priv->vq);
+	INIT_LIST_HEAD(&priv->xfers);
+	ret = virtio_blk_setup(dev);
 	if (ret)
 		return ret;
 
+	/*
+	 * A request takes a single descriptor if it is indirect, or else one
+	 * for each segment besides its header and status
+	 */
+	vq = priv->vqs[0];
+	if (vq->indirect) {
+		per_vq = virtqueue_get_vring_size(vq);
+	} else {
+		priv->max_segs = min(priv->max_segs,
+				     virtqueue_get_vring_size(vq) - 2);
+		per_vq = virtqueue_get_vring_size(vq) / (priv->max_segs + 2);
+	}
+	priv->num_slots = clamp(per_vq * priv->num_vqs, 1U,
+				(uint)VIRTIO_BLK_SLOTS);
+	log_debug("%s: %u queues, %u slots, %u segments of %u bytes%s\n",
+		  dev->name, priv->num_vqs, priv->num_slots, priv->max_segs,
+		  priv->seg_size, vq->indirect ? ", indirect" : "");
+
+	priv->slots = calloc(priv->num_slots, sizeof(*priv->slots));
+	if (!priv->slots)
+		return -ENOMEM;
+	/* spread the slots over the queues */
+	for (i = 0; i < priv->num_slots; i++)
+		priv->slots[i].vq = priv->vqs[i % priv->num_vqs];
+
+	if (CONFIG_IS_ENABLED(BLK_ASYNC)) {
+		priv->xfer_pool = calloc(priv->num_slots,
+					 sizeof(*priv->xfer_pool));
+		if (!priv->xfer_pool) {
+			ret = -ENOMEM;
+			goto err_free;
+		}
+		ret = blk_set_queue_depth(dev, priv->num_slots);
+		if (ret)
+			goto err_free;
+	}
+
 	desc->blksz = 512;
 	desc->log2blksz = 9;
 	virtio_cread(dev, struct virtio_blk_config, capacity, &cap);
 	desc->lba = cap;
 
 	return 0;
+
+err_free:
+	free(priv->xfer_pool);
+	free(priv->slots);
+
+	return ret;
+}
+
+static int virtio_blk_remove(struct udevice *dev)
+{
+	struct virtio_blk_priv *priv = dev_get_priv(dev);
+
+	free(priv->slots);
+	free(priv->xfer_pool);
+
+	return virtio_reset(dev);
 }
 
 static const struct blk_ops virtio_blk_ops = {
 	.read	= virtio_blk_read,
 	.write	= virtio_blk_write,
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+	.submit	= virtio_blk_submit,
+	.poll	= virtio_blk_poll,
+#endif
 };
 
 U_BOOT_DRIVER(virtio_blk) = {
@@ -140,7 +503,7 @@ U_BOOT_DRIVER(virtio_blk) = {
 	.ops	= &virtio_blk_ops,
 	.bind	= virtio_blk_bind,
 	.probe	= virtio_blk_probe,
-	.remove	= virtio_reset,
+	.remove	= virtio_blk_remove,
 	.priv_auto	= sizeof(struct virtio_blk_priv),
 	.flags	= DM_FLAG_ACTIVE_DMA,
 };
@@ -98,12 +98,44 @@ static void virtqueue_detach_desc(struct virtqueue *vq, unsigned int idx)
 	desc->addr = cpu_to_virtio64(vq->vdev, (u64)(uintptr_t)bb->user_buffer);
 }
 
+/* Mark @head as the head of a chain and make it available to the device */
+static void virtqueue_add_avail(struct virtqueue *vq, unsigned int head)
+{
+	unsigned int avail;
+
+	/* Mark the descriptor as the head of a chain. */
+	vq->vring_desc_shadow[head].chain_head = true;
+
+	/*
+	 * Put entry in available array (but don't update avail->idx
+	 * until they do sync).
+	 */
+	avail = vq->avail_idx_shadow & (vq->vring.num - 1);
+	vq->vring.avail->ring[avail] = cpu_to_virtio16(vq->vdev, head);
+
+	/*
+	 * Descriptors and available array need to be set before we expose the
+	 * new available array entries.
+	 */
+	virtio_wmb();
+	vq->avail_idx_shadow++;
+	vq->vring.avail->idx = cpu_to_virtio16(vq->vdev, vq->avail_idx_shadow);
+	vq->num_added++;
+
+	/*
+	 * This is very unlikely, but theoretically possible.
+	 * Kick just in case.
+	 */
+	if (unlikely(vq->num_added == (1 << 16) - 1))
+		virtqueue_kick(vq);
+}
+
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs)
 {
 	struct vring_desc *desc;
 	unsigned int descs_used = out_sgs + in_sgs;
-	unsigned int i, n, avail, uninitialized_var(prev);
+	unsigned int i, n, uninitialized_var(prev);
 	int head;
 
 	WARN_ON(descs_used == 0);
@@ -144,31 +176,65 @@ int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 	/* Update free pointer */
 	vq->free_head = i;
 
-	/* Mark the descriptor as the head of a chain. */
-	vq->vring_desc_shadow[head].chain_head = true;
-
 	/*
-	 * Put entry in available array (but don't update avail->idx
-	 * until they do sync).
+	 * Remember the caller's buffer, since with bounce buffers the
+	 * descriptor address is only valid until the chain is detached
 	 */
-	avail = vq->avail_idx_shadow & (vq->vring.num - 1);
-	vq->vring.avail->ring[avail] = cpu_to_virtio16(vq->vdev, head);
+	vq->vring_desc_shadow[head].data = sgs[0]->addr;
+	virtqueue_add_avail(vq, head);
 
-	/*
-	 * Descriptors and available array need to be set before we expose the
-	 * new available array entries.
-	 */
-	virtio_wmb();
-	vq->avail_idx_shadow++;
-	vq->vring.avail->idx = cpu_to_virtio16(vq->vdev, vq->avail_idx_shadow);
-	vq->num_added++;
+	return 0;
+}
 
-	/*
-	 * This is very unlikely, but theoretically possible.
-	 * Kick just in case.
-	 */
-	if (unlikely(vq->num_added == (1 << 16) - 1))
-		virtqueue_kick(vq);
+int virtqueue_add_indirect(struct virtqueue *vq, struct virtio_sg *sgs[],
+			   unsigned int out_sgs, unsigned int in_sgs,
+			   struct vring_desc *table)
+{
+	unsigned int descs_used = out_sgs + in_sgs;
+	struct vring_desc_shadow *desc_shadow;
+	struct vring_desc *desc;
+	unsigned int head, n;
+	u16 flags;
+
+	if (!vq->indirect)
+		return virtqueue_add(vq, sgs, out_sgs, in_sgs);
+
+	WARN_ON(descs_used == 0);
+
+	if (!vq->num_free) {
+		debug("Can't add indirect buf - avail = 0\n");
+		if (out_sgs)
+			virtio_notify(vq->vdev, vq);
+		return -ENOSPC;
+	}
+
+	for (n = 0; n < descs_used; n++) {
+		flags = n < out_sgs ? 0 : VRING_DESC_F_WRITE;
+		if (n < descs_used - 1)
+			flags |= VRING_DESC_F_NEXT;
+		table[n].addr = cpu_to_virtio64(vq->vdev,
+						(u64)(uintptr_t)sgs[n]->addr);
+		table[n].len = cpu_to_virtio32(vq->vdev, sgs[n]->length);
+		table[n].flags = cpu_to_virtio16(vq->vdev, flags);
+		table[n].next = cpu_to_virtio16(vq->vdev, n + 1);
+	}
+
+	head = vq->free_head;
+	desc_shadow = &vq->vring_desc_shadow[head];
+	desc = &vq->vring.desc[head];
+
+	desc_shadow->addr = (u64)(uintptr_t)table;
+	desc_shadow->data = sgs[0]->addr;
+	desc_shadow->len = descs_used * sizeof(*table);
+	desc_shadow->flags = VRING_DESC_F_INDIRECT;
+
+	desc->addr = cpu_to_virtio64(vq->vdev, desc_shadow->addr);
+	desc->len = cpu_to_virtio32(vq->vdev, desc_shadow->len);
+	desc->flags = cpu_to_virtio16(vq->vdev, desc_shadow->flags);
+
+	vq->num_free--;
+	vq->free_head = desc_shadow->next;
+	virtqueue_add_avail(vq, head);
 
 	return 0;
 }
@@ -281,7 +347,7 @@ void *virtqueue_get_buf(struct virtqueue *vq, unsigned int *len)
 		virtio_store_mb(&vring_used_event(&vq->vring),
 				cpu_to_virtio16(vq->vdev, vq->last_used_idx));
 
-	return (void *)(uintptr_t)vq->vring_desc_shadow[i].addr;
+	return vq->vring_desc_shadow[i].data;
 }
 
 static struct virtqueue *__vring_new_virtqueue(unsigned int index,
@@ -316,6 +382,9 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	list_add_tail(&vq->list, &uc_priv->vqs);
 
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	/* the table would need bouncing along with the buffers */
+	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
+		       !vring.bouncebufs;
 
 	/* Tell other side not to bother us */
 	vq->avail_flags_shadow |= VRING_AVAIL_F_NO_INTERRUPT;
@@ -1647,8 +1647,13 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
-long int read_allocated_block(struct ext2_inode *inode, int fileblock,
-			      struct ext_block_cache *cache)
+/*
+ * Map 'fileblock' of 'inode' to a disk block, or 0 for a hole, and return in
+ * '*count' how many blocks from 'fileblock' on are known to map the same way,
+ * i.e. are contiguous on disk or part of the same hole.
+ */
+long int read_allocated_blocks(struct ext2_inode *inode, int fileblock,
+			       struct ext_block_cache *cache, int *count)
 {
 	long int blknr;
 	int blksz;
@@ -1698,6 +1703,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 				/* Sparse file */
 				if (!cache)
 					ext_cache_fini(c);
+				*count = startblock - fileblock;
 				return 0;
 
 			} else if (fileblock < endblock) {
@@ -1706,12 +1712,14 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 					le32_to_cpu(extent[i].ee_start_lo);
 				if (!cache)
 					ext_cache_fini(c);
+				*count = endblock - fileblock;
 				return (fileblock - startblock) + start;
 			}
 		}
 
 		if (!cache)
 			ext_cache_fini(c);
+		*count = 1;
 		return 0;
 	}
 
@@ -1996,10 +2004,19 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock,
 				      [rblock % perblock_child]);
 	}
 	debug("read_allocated_block %ld\n", blknr);
+	*count = 1;
 
 	return blknr;
 }
 
+long int read_allocated_block(struct ext2_inode *inode, int fileblock,
+			      struct ext_block_cache *cache)
+{
+	int count;
+
+	return read_allocated_blocks(inode, fileblock, cache, &count);
+}
+
 /**
  * ext4fs_reinit_global() - Reinitialize values of ext4 write implementation's
  *			    global pointers
@@ -2047,6 +2064,60 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/*
+ * Set up a node for the directory entry 'dirent' of 'diro' and work out its
+ * type, reading its inode if the entry does not record the type.
+ */
+static struct ext2fs_node *ext4fs_dirent_node(struct ext2fs_node *diro,
+					      struct ext2_dirent *dirent,
+					      int *ftype)
+{
+	struct ext2fs_node *fdiro;
+	int type = FILETYPE_UNKNOWN;
+	int status;
+
+	fdiro = zalloc(sizeof(struct ext2fs_node));
+	if (!fdiro)
+		return NULL;
+
+	fdiro->data = diro->data;
+	fdiro->ino = le32_to_cpu(dirent->inode);
+
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY)
+			type = FILETYPE_DIRECTORY;
+		else if (dirent->filetype == FILETYPE_SYMLINK)
+			type = FILETYPE_SYMLINK;
+		else if (dirent->filetype == FILETYPE_REG)
+			type = FILETYPE_REG;
+	} else {
+		status = ext4fs_read_inode(diro->data, fdiro->ino,
+					   &fdiro->inode);
+		if (status == 0) {
+			free(fdiro);
+			return NULL;
+		}
+		fdiro->inode_read = 1;
+
+		switch (le16_to_cpu(fdiro->inode.mode) & FILETYPE_INO_MASK) {
+		case FILETYPE_INO_DIRECTORY:
+			type = FILETYPE_DIRECTORY;
+			break;
+		case FILETYPE_INO_SYMLINK:
+			type = FILETYPE_SYMLINK;
+			break;
+		case FILETYPE_INO_REG:
+			type = FILETYPE_REG;
+			break;
+		}
+	}
+	*ftype = type;
+
+	return fdiro;
+}
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2064,6 +2135,20 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (status == 0)
 			return 0;
 	}
+
+	/* Use the hash tree index if there is one */
+	if ((name != NULL) && (fnode != NULL) && (ftype != NULL)) {
+		struct ext2_dirent dirent;
+
+		status = ext4fs_htree_find(diro, name, &dirent);
+		if (status == 0)
+			return 0;
+		if (status > 0) {
+			*fnode = ext4fs_dirent_node(diro, &dirent, ftype);
+			return *fnode ? 1 : 0;
+		}
+	}
+
 	/* Search the file.  */
 	while (fpos < le32_to_cpu(diro->inode.size)) {
 		struct ext2_dirent dirent;
@@ -2082,7 +2167,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		if (dirent.namelen != 0) {
 			char filename[dirent.namelen + 1];
 			struct ext2fs_node *fdiro;
-			int type = FILETYPE_UNKNOWN;
+			int type;
 
 			status = ext4fs_read_file(diro,
 						  fpos +
@@ -2092,49 +2177,12 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			if (status < 0)
 				return 0;
 
-			fdiro = zalloc(sizeof(struct ext2fs_node));
+			fdiro = ext4fs_dirent_node(diro, &dirent, &type);
 			if (!fdiro)
 				return 0;
 
-			fdiro->data = diro->data;
-			fdiro->ino = le32_to_cpu(dirent.inode);
-
 			filename[dirent.namelen] = '\0';
 
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
-
-				if (dirent.filetype == FILETYPE_DIRECTORY)
-					type = FILETYPE_DIRECTORY;
-				else if (dirent.filetype == FILETYPE_SYMLINK)
-					type = FILETYPE_SYMLINK;
-				else if (dirent.filetype == FILETYPE_REG)
-					type = FILETYPE_REG;
-			} else {
-				status = ext4fs_read_inode(diro->data,
-							   le32_to_cpu
-							   (dirent.inode),
-							   &fdiro->inode);
-				if (status == 0) {
-					free(fdiro);
-					return 0;
-				}
-				fdiro->inode_read = 1;
-
-				if ((le16_to_cpu(fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((le16_to_cpu(fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
-			}
 #ifdef DEBUG
 			printf("iterate >%s<\n", filename);
 #endif /* of DEBUG */
@@ -57,6 +57,26 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 			struct ext2fs_node **fnode, int *ftype);
 
+#if IS_ENABLED(CONFIG_EXT4_DIR_INDEX)
+/**
+ * ext4fs_htree_find() - look up a name through a directory's hash tree
+ *
+ * @dir:	directory to search, with its inode read
+ * @name:	name to look for
+ * @dirent:	returns the directory entry if found
+ * Return:	1 if found, 0 if not, or -ve if the directory has no usable
+ *		index and must be scanned instead
+ */
+int ext4fs_htree_find(struct ext2fs_node *dir, const char *name,
+		      struct ext2_dirent *dirent);
+#else
+static inline int ext4fs_htree_find(struct ext2fs_node *dir, const char *name,
+				    struct ext2_dirent *dirent)
+{
+	return -ENOSYS;
+}
+#endif
+
 #if defined(CONFIG_EXT4_WRITE)
 uint32_t ext4fs_div_roundup(uint32_t size, uint32_t n);
 uint16_t ext4fs_checksum_update(unsigned int i);
@@ -0,0 +1,459 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Lookups in ext4 hashed directory indexes (dir_index).
+ *
+ * The directory hash functions are taken from the original ext4 fs code as
+ * found in the linux kernel.
+ *
+ * Copyright (C) 2002 by Theodore Ts'o
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <ext_common.h>
+#include <ext4fs.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include "ext4_common.h"
+
+#define DX_HASH_LEGACY		0
+#define DX_HASH_HALF_MD4	1
+#define DX_HASH_TEA		2
+#define DX_HASH_UNSIGNED_DELTA	3
+
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+/* the kernel limits the index to three levels with largedir, two without */
+#define DX_MAX_LEVELS		3
+
+struct dx_root_info {
+	__le32 reserved_zero;
+	__u8 hash_version;
+	__u8 info_length;
+	__u8 indirect_levels;
+	__u8 unused_flags;
+};
+
+struct dx_entry {
+	__le32 hash;
+	__le32 block;
+};
+
+/* The first entry of each index block holds limit and count, not a hash */
+struct dx_countlimit {
+	__le16 limit;
+	__le16 count;
+};
+
+#define DELTA 0x9E3779B9
+
+static void tea_transform(__u32 buf[4], __u32 const in[])
+{
+	__u32 sum = 0;
+	__u32 b0 = buf[0], b1 = buf[1];
+	__u32 a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = (a << (s)) | (a >> (32 - (s))))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+static void half_md4_transform(__u32 buf[4], __u32 const in[8])
+{
+	__u32 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+#undef MD4_ROUND
+#undef K1
+#undef K2
+#undef K3
+#undef F
+#undef G
+#undef H
+
+/* The old legacy hash */
+static __u32 dx_hack_hash(const char *name, int len, bool unsigned_char)
+{
+	__u32 hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		if (unsigned_char)
+			c = (unsigned char)*name++;
+		else
+			c = (signed char)*name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return hash0 << 1;
+}
+
+static void str2hashbuf(const char *msg, int len, __u32 *buf, int num,
+			bool unsigned_char)
+{
+	__u32 pad, val;
+	int i, c;
+
+	pad = (__u32)len | ((__u32)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		if (unsigned_char)
+			c = (unsigned char)msg[i];
+		else
+			c = (signed char)msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/**
+ * ext4fs_dirhash() - compute the hash of a directory entry name
+ *
+ * @version:	hash version, DX_HASH_... with DX_HASH_UNSIGNED_DELTA added for
+ *		the unsigned variants
+ * @seed:	hash seed from the superblock
+ * @name:	name to hash
+ * @len:	length of @name
+ * @hashp:	returns the hash, with the low bit cleared
+ * Return:	0 if OK, -EINVAL if the hash version is unknown
+ */
+static int ext4fs_dirhash(int version, const __le32 seed[4], const char *name,
+			  int len, __u32 *hashp)
+{
+	bool unsigned_char = version >= DX_HASH_UNSIGNED_DELTA;
+	__u32 buf[4], in[8];
+	__u32 hash;
+	int i;
+
+	/* Initialize the default seed for the hash checksum functions */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	/* Check to see if the seed is all zero's */
+	for (i = 0; i < 4; i++) {
+		if (seed[i]) {
+			for (i = 0; i < 4; i++)
+				buf[i] = le32_to_cpu(seed[i]);
+			break;
+		}
+	}
+
+	if (unsigned_char)
+		version -= DX_HASH_UNSIGNED_DELTA;
+
+	switch (version) {
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, unsigned_char);
+		break;
+	case DX_HASH_HALF_MD4:
+		while (len > 0) {
+			str2hashbuf(name, len, in, 8, unsigned_char);
+			half_md4_transform(buf, in);
+			len -= 32;
+			name += 32;
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA:
+		while (len > 0) {
+			str2hashbuf(name, len, in, 4, unsigned_char);
+			tea_transform(buf, in);
+			len -= 16;
+			name += 16;
+		}
+		hash = buf[0];
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	hash &= ~1;
+	if (hash == (0x7fffffffU << 1))
+		hash = (0x7fffffffU - 1) << 1;
+	*hashp = hash;
+
+	return 0;
+}
+
+/* One level of the walk down the index */
+struct dx_frame {
+	char *buf;
+	struct dx_entry *entries;
+	struct dx_entry *at;
+};
+
+static int dx_count(struct dx_entry *entries)
+{
+	return le16_to_cpu(((struct dx_countlimit *)entries)->count);
+}
+
+static int dx_limit(struct dx_entry *entries)
+{
+	return le16_to_cpu(((struct dx_countlimit *)entries)->limit);
+}
+
+static __u32 dx_block(struct dx_entry *entry)
+{
+	return le32_to_cpu(entry->block) & 0x0fffffff;
+}
+
+static int dx_read_block(struct ext2fs_node *dir, __u32 block, char *buf)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	loff_t actread;
+
+	if ((loff_t)(block + 1) * blksz > le32_to_cpu(dir->inode.size))
+		return -EINVAL;
+	if (ext4fs_read_file(dir, (loff_t)block * blksz, blksz, buf,
+			     &actread) < 0 || actread != blksz)
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Point 'frame' at the entries of an index block, and at the last entry whose
+ * hash is not above 'hash'.
+ */
+static int dx_probe_block(struct dx_frame *frame, struct dx_entry *entries,
+			  int blksz, __u32 hash)
+{
+	struct dx_entry *p, *q, *m;
+	int count = dx_count(entries);
+
+	if (!count || count > dx_limit(entries) ||
+	    (char *)(entries + dx_limit(entries)) > frame->buf + blksz)
+		return -EINVAL;
+
+	p = entries + 1;
+	q = entries + count - 1;
+	while (p <= q) {
+		m = p + (q - p) / 2;
+		if (le32_to_cpu(m->hash) > hash)
+			q = m - 1;
+		else
+			p = m + 1;
+	}
+	frame->entries = entries;
+	frame->at = p - 1;
+
+	return 0;
+}
+
+/*
+ * Search one leaf block for 'name'. Return 1 and fill 'dirent' if found, 0 if
+ * not or -EINVAL if the block is corrupt.
+ */
+static int dx_search_leaf(const char *buf, int blksz, const char *name,
+			  int len, struct ext2_dirent *dirent)
+{
+	const struct ext2_dirent *de;
+	int off, reclen;
+
+	for (off = 0; off < blksz; off += reclen) {
+		if (off + sizeof(*de) > blksz)
+			return -EINVAL;
+		de = (const struct ext2_dirent *)(buf + off);
+		reclen = le16_to_cpu(de->direntlen);
+		if (reclen < sizeof(*de) || off + reclen > blksz ||
+		    sizeof(*de) + de->namelen > reclen)
+			return -EINVAL;
+		if (de->inode && de->namelen == len &&
+		    !memcmp(buf + off + sizeof(*de), name, len)) {
+			*dirent = *de;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Move to the next leaf if the entries for 'hash' may continue there, which
+ * happens when hash collisions span a leaf boundary. Return 1 if so, 0 if not
+ * or a negative error.
+ */
+static int dx_next_leaf(struct ext2fs_node *dir, struct dx_frame *frames,
+			struct dx_frame *frame, __u32 hash)
+{
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame *p = frame;
+	int num_frames = 0;
+	int ret;
+
+	/* find the next entry, going up as many levels as needed */
+	while (++p->at >= p->entries + dx_count(p->entries)) {
+		if (p == frames)
+			return 0;
+		num_frames++;
+		p--;
+	}
+
+	/* the low bit of the hash is set when collisions continue */
+	if ((le32_to_cpu(p->at->hash) & ~1) != hash)
+		return 0;
+
+	/* and go back down to the leaf level */
+	while (num_frames--) {
+		ret = dx_read_block(dir, dx_block(p->at), p[1].buf);
+		if (ret)
+			return ret;
+		p++;
+		ret = dx_probe_block(p, (struct dx_entry *)(p->buf + 8),
+				     blksz, 0);
+		if (ret)
+			return ret;
+		p->at = p->entries;
+	}
+
+	return 1;
+}
+
+int ext4fs_htree_find(struct ext2fs_node *dir, const char *name,
+		      struct ext2_dirent *dirent)
+{
+	struct ext2_sblock *sb = &dir->data->sblock;
+	int blksz = EXT2_BLOCK_SIZE(dir->data);
+	struct dx_frame frames[DX_MAX_LEVELS], *frame;
+	struct dx_root_info *info;
+	int len = strlen(name);
+	int levels, version;
+	char *leaf;
+	__u32 hash;
+	int i, ret;
+
+	/* the index is only kept up to date while the feature is enabled */
+	if (!(le32_to_cpu(sb->feature_compatibility) &
+	      EXT4_FEATURE_COMPAT_DIR_INDEX) ||
+	    !(le32_to_cpu(dir->inode.flags) & EXT4_INDEX_FL))
+		return -ENOENT;
+
+	leaf = malloc_cache_aligned(blksz * (DX_MAX_LEVELS + 1));
+	if (!leaf)
+		return -ENOMEM;
+	for (i = 0; i < DX_MAX_LEVELS; i++)
+		frames[i].buf = leaf + blksz * (i + 1);
+
+	/* the root follows the "." and ".." entries of the first block */
+	frame = frames;
+	ret = dx_read_block(dir, 0, frame->buf);
+	if (ret)
+		goto out;
+	info = (struct dx_root_info *)(frame->buf + 24);
+	levels = info->indirect_levels + 1;
+	version = info->hash_version;
+	if (info->reserved_zero || info->unused_flags & 1 ||
+	    levels > DX_MAX_LEVELS || 24 + info->info_length > blksz) {
+		debug("ext4: unsupported index in directory %d\n", dir->ino);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (version <= DX_HASH_TEA &&
+	    le32_to_cpu(sb->flags) & EXT2_FLAGS_UNSIGNED_HASH)
+		version += DX_HASH_UNSIGNED_DELTA;
+	ret = ext4fs_dirhash(version, sb->hash_seed, name, len, &hash);
+	if (ret) {
+		debug("ext4: unsupported hash version %d\n", version);
+		goto out;
+	}
+
+	ret = dx_probe_block(frame, (struct dx_entry *)(frame->buf + 24 +
+			     info->info_length), blksz, hash);
+	while (!ret && --levels) {
+		ret = dx_read_block(dir, dx_block(frame->at), frame[1].buf);
+		if (ret)
+			break;
+		frame++;
+		/* index nodes start with an empty entry covering the block */
+		ret = dx_probe_block(frame, (struct dx_entry *)(frame->buf + 8),
+				     blksz, hash);
+	}
+	if (ret)
+		goto out;
+
+	do {
+		ret = dx_read_block(dir, dx_block(frame->at), leaf);
+		if (ret)
+			break;
+		ret = dx_search_leaf(leaf, blksz, name, len, dirent);
+		if (ret)
+			break;
+		ret = dx_next_leaf(dir, frames, frame, hash);
+	} while (ret > 0);
+
+out:
+	free(leaf);
+	return ret;
+}
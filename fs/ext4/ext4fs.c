@@ -44,6 +44,34 @@ void ext4fs_free_node(struct ext2fs_node *node, struct ext2fs_node *currroot)
 		free(node);
 }
 
+/*
+ * Map 'fileblock' of 'node', going through the last run mapped for it so that
+ * the extent tree or indirect blocks are only walked once per run.
+ */
+static long int ext4fs_map_block(struct ext2fs_node *node, int fileblock,
+				 struct ext_block_cache *cache, int *count)
+{
+	struct ext2fs_run *run = &node->run;
+	long int blknr;
+
+	if (fileblock < run->fileblock ||
+	    fileblock >= run->fileblock + run->count) {
+		blknr = read_allocated_blocks(&node->inode, fileblock, cache,
+					      count);
+		if (blknr < 0)
+			return blknr;
+		run->fileblock = fileblock;
+		run->count = *count;
+		run->blknr = blknr;
+	}
+
+	*count = run->fileblock + run->count - fileblock;
+	if (!run->blknr)
+		return 0;
+
+	return run->blknr + fileblock - run->fileblock;
+}
+
 /*
  * Taken from openmoko-kernel mailing list: By Andy green
  * Optimized read file API : collects and defers contiguous sector
@@ -53,20 +81,17 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
+	int i, n;
 	lbaint_t blockcnt;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
-	lbaint_t delayed_extent = 0;
-	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
+	int delayed_extent = 0;
+	int delayed_skipfirst = 0;
 	char *delayed_buf = NULL;
-	char *start_buf = buf;
-	short status;
 	struct ext_block_cache cache;
 
 	ext_cache_init(&cache);
@@ -82,100 +107,72 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
 
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
+	/* Handle a run of contiguous blocks, or a hole, at a time */
+	for (i = lldiv(pos, blocksize); i < blockcnt; i += n) {
 		long int blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
-		int skipfirst = 0;
-		blknr = read_allocated_block(&node->inode, i, &cache);
+		loff_t skipfirst = 0;
+		loff_t bytes;
+
+		blknr = ext4fs_map_block(node, i, &cache, &n);
 		if (blknr < 0) {
 			ext_cache_fini(&cache);
 			return -1;
 		}
+		if (n <= 0 || n > blockcnt - i)
+			n = blockcnt - i;
+		/* keep each read within what ext4fs_devread() can take */
+		if (n > INT_MAX / blocksize - 1)
+			n = INT_MAX / blocksize - 1;
 
-		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
-
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
-
+		bytes = (loff_t)n * blocksize;
 		/* First block. */
 		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
+			skipfirst = pos - (loff_t)blocksize * i;
+			bytes -= skipfirst;
 		}
+		/* Last block. */
+		if (i + n == blockcnt)
+			bytes -= (loff_t)blockcnt * blocksize - (len + pos);
+
 		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-					if (status == 0) {
-						ext_cache_fini(&cache);
-						return -1;
-					}
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
-			}
-		} else {
-			int n;
-			int n_left;
-			if (previous_block_number != -1) {
-				/* spill */
-				status = ext4fs_devread(delayed_start,
-							delayed_skipfirst,
-							delayed_extent,
-							delayed_buf);
-				if (status == 0) {
-					ext_cache_fini(&cache);
-					return -1;
-				}
-				previous_block_number = -1;
+			blknr = blknr << log2_fs_blocksize;
+
+			/* extend the pending read if the run follows on */
+			if (delayed_extent && delayed_next == blknr &&
+			    bytes <= INT_MAX - delayed_extent) {
+				delayed_extent += bytes;
+				delayed_next += (lbaint_t)n << log2_fs_blocksize;
+				buf += bytes;
+				continue;
 			}
-			/* Zero no more than `len' bytes. */
-			n = blocksize - skipfirst;
-			n_left = len - ( buf - start_buf );
-			if (n > n_left)
-				n = n_left;
-			memset(buf, 0, n);
 		}
-		buf += blocksize - skipfirst;
-	}
-	if (previous_block_number != -1) {
+
 		/* spill */
-		status = ext4fs_devread(delayed_start,
-					delayed_skipfirst, delayed_extent,
-					delayed_buf);
-		if (status == 0) {
+		if (delayed_extent &&
+		    !ext4fs_devread(delayed_start, delayed_skipfirst,
+				    delayed_extent, delayed_buf)) {
 			ext_cache_fini(&cache);
 			return -1;
 		}
-		previous_block_number = -1;
+		delayed_extent = 0;
+
+		if (blknr) {
+			delayed_start = blknr;
+			delayed_skipfirst = skipfirst;
+			delayed_extent = bytes;
+			delayed_buf = buf;
+			delayed_next = blknr + ((lbaint_t)n << log2_fs_blocksize);
+		} else {
+			memset(buf, 0, bytes);
+		}
+		buf += bytes;
+	}
+
+	if (delayed_extent &&
+	    !ext4fs_devread(delayed_start, delayed_skipfirst, delayed_extent,
+			    delayed_buf)) {
+		ext_cache_fini(&cache);
+		return -1;
 	}
 
 	*actread  = len;
@@ -260,21 +260,41 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
 	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+		ALLOC_CACHE_ALIGN_BUFFER(__u8, sectbuf, mydata->sect_size);
+		__u32 bounce_count = mydata->clust_size;
+		__u8 *tmpbuf = NULL;
 
 		debug("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/* bounce through a cluster-sized buffer, or a sector if short */
+		if (size >= 2 * mydata->sect_size)
+			tmpbuf = malloc_cache_aligned(bounce_count *
+						      mydata->sect_size);
+		if (!tmpbuf) {
+			tmpbuf = sectbuf;
+			bounce_count = 1;
+		}
+
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			__u32 sect_count = min_t(unsigned long, bounce_count,
+						 size / mydata->sect_size);
+			__u32 bytes_read = sect_count * mydata->sect_size;
+
+			ret = disk_read(startsect, sect_count, tmpbuf);
+			if (ret != sect_count) {
 				debug("Error reading data (got %d)\n", ret);
+				if (tmpbuf != sectbuf)
+					free(tmpbuf);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			memcpy(buffer, tmpbuf, bytes_read);
+			startsect += sect_count;
+			buffer += bytes_read;
+			size -= bytes_read;
 		}
+		if (tmpbuf != sectbuf)
+			free(tmpbuf);
 	} else if (size >= mydata->sect_size) {
 		__u32 bytes_read;
 		__u32 sect_count = size / mydata->sect_size;
@@ -304,6 +324,95 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * A file's cluster chain, recorded as runs of consecutive clusters. The map is
+ * built with a single walk of the FAT and then lets the data be read one run
+ * at a time, and any position in the file be found without going back to the
+ * FAT.
+ */
+struct fat_extent {
+	__u32 fileclust;	/* index of the first cluster within the file */
+	__u32 clust;		/* first cluster on disk */
+	__u32 count;		/* number of consecutive clusters */
+};
+
+/**
+ * get_extents() - build the extent map of a cluster chain
+ *
+ * Follow the chain starting at 'clust' for at most 'nclust' clusters and
+ * record it as runs of consecutive clusters.
+ *
+ * @mydata:	file system description
+ * @clust:	first cluster of the chain
+ * @nclust:	number of clusters to map
+ * @extp:	returns the extent map, to be freed by the caller
+ * @countp:	returns the number of entries in the extent map
+ * Return:	-1 on error, otherwise 0
+ */
+static int get_extents(fsdata *mydata, __u32 clust, __u32 nclust,
+		       struct fat_extent **extp, __u32 *countp)
+{
+	struct fat_extent *ext = NULL, *tmp;
+	__u32 count = 0, size = 0;
+	__u32 fileclust = 0;
+
+	while (fileclust < nclust) {
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			goto err;
+		}
+
+		if (count && ext[count - 1].clust + ext[count - 1].count ==
+		    clust) {
+			ext[count - 1].count++;
+		} else {
+			if (count == size) {
+				size = size ? size * 2 : 16;
+				tmp = realloc(ext, size * sizeof(*ext));
+				if (!tmp) {
+					debug("Error: allocating extent map\n");
+					goto err;
+				}
+				ext = tmp;
+			}
+			ext[count].fileclust = fileclust;
+			ext[count].clust = clust;
+			ext[count].count = 1;
+			count++;
+		}
+
+		if (++fileclust < nclust)
+			clust = get_fatent(mydata, clust);
+	}
+
+	debug("%u clusters in %u extents\n", nclust, count);
+	*extp = ext;
+	*countp = count;
+
+	return 0;
+
+err:
+	free(ext);
+	return -1;
+}
+
+/* Find the extent holding cluster 'fileclust' of the file */
+static __u32 find_extent(struct fat_extent *ext, __u32 count, __u32 fileclust)
+{
+	__u32 lo = 0, hi = count - 1, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo + 1) / 2;
+		if (ext[mid].fileclust <= fileclust)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -324,9 +433,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	struct fat_extent *ext;
+	__u32 count, idx, skip;
 	loff_t actsize;
+	int ret = -1;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -341,101 +451,69 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	/* map the chain up to the last cluster to be read */
+	if (get_extents(mydata, START(dentptr),
+			DIV_ROUND_UP(filesize, bytesperclust), &ext, &count))
+		return -1;
 
 	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
-	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
+	idx = find_extent(ext, count, pos / bytesperclust);
+	skip = pos / bytesperclust - ext[idx].fileclust;
+	filesize -= pos;
+	pos %= bytesperclust;
 
 	/* align to beginning of next cluster if any */
 	if (pos) {
 		__u8 *tmp_buffer;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
+		actsize = min(filesize + pos, (loff_t)bytesperclust);
 		tmp_buffer = malloc_cache_aligned(actsize);
 		if (!tmp_buffer) {
 			debug("Error: allocating buffer\n");
-			return -1;
+			goto out;
 		}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
+		if (get_cluster(mydata, ext[idx].clust + skip, tmp_buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			free(tmp_buffer);
-			return -1;
+			goto out;
 		}
-		filesize -= actsize;
 		actsize -= pos;
 		memcpy(buffer, tmp_buffer + pos, actsize);
 		free(tmp_buffer);
 		*gotsize += actsize;
-		if (!filesize)
-			return 0;
+		filesize -= actsize;
 		buffer += actsize;
 
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
+		if (++skip == ext[idx].count) {
+			idx++;
+			skip = 0;
 		}
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
+	/* read the rest one run of consecutive clusters at a time */
+	while (filesize) {
+		actsize = (loff_t)(ext[idx].count - skip) * bytesperclust;
+		if (actsize > filesize)
+			actsize = filesize;
 
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		if (get_cluster(mydata, ext[idx].clust + skip, buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
-			return -1;
+			goto out;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		idx++;
+		skip = 0;
+	}
+	ret = 0;
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+out:
+	free(ext);
+	return ret;
 }
 
 /*
@@ -36,6 +36,7 @@ static struct blk_desc *fs_dev_desc;
 static int fs_dev_part;
 static struct disk_partition fs_partition;
 static int fs_type = FS_TYPE_ANY;
+static struct udevice *fs_writeback_dev;
 
 void fs_set_type(int type)
 {
@@ -485,13 +486,36 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part)
 	return -1;
 }
 
-void fs_close(void)
+/*
+ * Let the block device hold back the small writes of a filesystem update, so
+ * that repeated writes to the same metadata blocks reach the device only once.
+ * They are flushed by fs_close().
+ */
+static void fs_writeback_begin(void)
+{
+#if CONFIG_IS_ENABLED(BLK_WRITEBACK)
+	if (fs_dev_desc && !blk_set_writeback(fs_dev_desc->bdev, true))
+		fs_writeback_dev = fs_dev_desc->bdev;
+#endif
+}
+
+int fs_close(void)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
+	int ret = 0;
 
 	info->close();
 
+	if (fs_writeback_dev) {
+		ret = blk_set_writeback(fs_writeback_dev, false);
+		if (ret)
+			log_err("** Unable to flush block device **\n");
+		fs_writeback_dev = NULL;
+	}
+
 	fs_type = FS_TYPE_ANY;
+
+	return ret;
 }
 
 int fs_uuid(char *uuid_str)
@@ -567,7 +591,9 @@ static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
 	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
 	lmb_dump_all(&lmb);
 
-	if (lmb_alloc_addr(&lmb, addr, read_len) == addr)
+	ret = lmb_alloc_addr(&lmb, addr, read_len) == addr;
+	lmb_uninit(&lmb);
+	if (ret)
 		return 0;
 
 	log_err("** Reading file would overwrite reserved memory **\n");
@@ -617,9 +643,10 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 	void *buf;
-	int ret;
+	int ret, err;
 
 	buf = map_sysmem(addr, len);
+	fs_writeback_begin();
 	ret = info->write(filename, buf, offset, len, actwrite);
 	unmap_sysmem(buf);
 
@@ -627,9 +654,9 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 		log_err("** Unable to write file %s **\n", filename);
 		ret = -1;
 	}
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 struct fs_dir_stream *fs_opendir(const char *filename)
@@ -686,44 +713,47 @@ void fs_closedir(struct fs_dir_stream *dirs)
 
 int fs_unlink(const char *filename)
 {
-	int ret;
+	int ret, err;
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	fs_writeback_begin();
 	ret = info->unlink(filename);
 
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 int fs_mkdir(const char *dirname)
 {
-	int ret;
+	int ret, err;
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	fs_writeback_begin();
 	ret = info->mkdir(dirname);
 
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 int fs_ln(const char *fname, const char *target)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
-	int ret;
+	int ret, err;
 
+	fs_writeback_begin();
 	ret = info->ln(fname, target);
 
 	if (ret < 0) {
 		log_err("** Unable to create link %s -> %s **\n", fname, target);
 		ret = -1;
 	}
-	fs_close();
+	err = fs_close();
 
-	return ret;
+	return ret ? ret : err;
 }
 
 int do_size(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[],
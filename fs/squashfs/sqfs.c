@@ -14,6 +14,7 @@
 #include <linux/types.h>
 #include <asm/byteorder.h>
 #include <linux/compat.h>
+#include <linux/list.h>
 #include <memalign.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +27,162 @@
 
 static struct squashfs_ctxt ctxt;
 
+/*
+ * Decompressed metadata is kept from one mount of an image to the next, up to
+ * CONFIG_SQUASHFS_CACHE_SIZE KiB, so that loading several files from the same
+ * image decompresses every table and fragment block only once. The inode and
+ * directory tables are cached whole, as the lookup code needs them in one
+ * piece. Fragment table blocks and fragment blocks are cached individually,
+ * keyed by their position in the image, and evicted least recently used
+ * first when space is needed.
+ */
+struct sqfs_cache_block {
+	struct list_head list;
+	u64 start;
+	unsigned long size;	/* bytes allocated for data */
+	unsigned long len;	/* bytes of data held */
+	unsigned char data[] __aligned(8);
+};
+
+static struct {
+	/* the image the cache was filled from */
+	struct blk_desc *dev;
+	lbaint_t part_start;
+	struct squashfs_super_block sblk;
+
+	unsigned char *inode_table;
+	unsigned char *dir_table;
+	u32 *dir_pos_list;
+	int dir_metablks;
+	unsigned char *frag_table;
+	u64 frag_table_offset;
+	/* fragment table blocks and fragment blocks, most recent first */
+	struct list_head blocks;
+	unsigned long bytes;
+} sqfs_cache = {
+	.blocks = LIST_HEAD_INIT(sqfs_cache.blocks),
+};
+
+#define SQFS_CACHE_MAX_BYTES	(CONFIG_SQUASHFS_CACHE_SIZE * 1024UL)
+
+static void sqfs_cache_drop(struct sqfs_cache_block *blk)
+{
+	list_del(&blk->list);
+	sqfs_cache.bytes -= blk->size;
+	free(blk);
+}
+
+static void sqfs_cache_free(void)
+{
+	struct sqfs_cache_block *blk, *n;
+
+	list_for_each_entry_safe(blk, n, &sqfs_cache.blocks, list)
+		sqfs_cache_drop(blk);
+
+	free(sqfs_cache.inode_table);
+	free(sqfs_cache.dir_table);
+	free(sqfs_cache.dir_pos_list);
+	free(sqfs_cache.frag_table);
+	sqfs_cache.inode_table = NULL;
+	sqfs_cache.dir_table = NULL;
+	sqfs_cache.dir_pos_list = NULL;
+	sqfs_cache.frag_table = NULL;
+	sqfs_cache.bytes = 0;
+	sqfs_cache.dev = NULL;
+}
+
+/* Drop what the cache holds unless it comes from the image being mounted */
+static void sqfs_cache_check(struct squashfs_super_block *sblk)
+{
+	if (sqfs_cache.dev == ctxt.cur_dev &&
+	    sqfs_cache.part_start == ctxt.cur_part_info.start &&
+	    !memcmp(&sqfs_cache.sblk, sblk, sizeof(*sblk)))
+		return;
+
+	sqfs_cache_free();
+	sqfs_cache.dev = ctxt.cur_dev;
+	sqfs_cache.part_start = ctxt.cur_part_info.start;
+	memcpy(&sqfs_cache.sblk, sblk, sizeof(*sblk));
+}
+
+/* Make room for 'size' more bytes, evicting blocks if needed */
+static bool sqfs_cache_reserve(unsigned long size)
+{
+	struct sqfs_cache_block *blk;
+
+	while (sqfs_cache.bytes + size > SQFS_CACHE_MAX_BYTES) {
+		if (list_empty(&sqfs_cache.blocks))
+			return false;
+		blk = list_last_entry(&sqfs_cache.blocks,
+				      struct sqfs_cache_block, list);
+		sqfs_cache_drop(blk);
+	}
+
+	return true;
+}
+
+/* Account for a table once it is filled, and tell whether it may be kept */
+static bool sqfs_cache_table(unsigned long size)
+{
+	if (!sqfs_cache_reserve(size))
+		return false;
+	sqfs_cache.bytes += size;
+
+	return true;
+}
+
+static struct sqfs_cache_block *sqfs_cache_lookup(u64 start)
+{
+	struct sqfs_cache_block *blk;
+
+	list_for_each_entry(blk, &sqfs_cache.blocks, list) {
+		if (blk->start == start) {
+			list_move(&blk->list, &sqfs_cache.blocks);
+			return blk;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Allocate a block of up to 'size' bytes for the data at 'start'. It goes into
+ * the cache with sqfs_cache_insert() once filled. Returns NULL if the cache
+ * cannot take it, in which case the caller should use a buffer of its own.
+ */
+static struct sqfs_cache_block *sqfs_cache_alloc(u64 start,
+						 unsigned long size)
+{
+	struct sqfs_cache_block *blk;
+
+	if (!sqfs_cache_reserve(size))
+		return NULL;
+
+	blk = malloc(sizeof(*blk) + size);
+	if (!blk)
+		return NULL;
+	blk->start = start;
+	blk->size = size;
+	blk->len = 0;
+
+	return blk;
+}
+
+static void sqfs_cache_insert(struct sqfs_cache_block *blk, unsigned long len)
+{
+	blk->len = len;
+	list_add(&blk->list, &sqfs_cache.blocks);
+	sqfs_cache.bytes += blk->size;
+}
+
+/* Free a table unless it is the one held by the cache */
+static void sqfs_free_table(void *table)
+{
+	if (table != sqfs_cache.inode_table && table != sqfs_cache.dir_table &&
+	    table != sqfs_cache.dir_pos_list)
+		free(table);
+}
+
 static int sqfs_disk_read(__u32 block, __u32 nr_blocks, void *buf)
 {
 	ulong ret;
@@ -104,6 +261,8 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	unsigned char *metadata_buffer, *metadata, *table;
 	struct squashfs_fragment_block_entry *entries;
 	struct squashfs_super_block *sblk = ctxt.sblk;
+	struct sqfs_cache_block *blk, *new_blk = NULL;
+	void *tofree = NULL;
 	unsigned long dest_len;
 	int block, offset, ret;
 	u16 header;
@@ -115,28 +274,40 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	if (inode_fragment_index >= get_unaligned_le32(&sblk->fragments))
 		return -EINVAL;
 
-	start = get_unaligned_le64(&sblk->fragment_table_start);
-	end = get_unaligned_le64(&sblk->id_table_start);
-	exp_tbl = get_unaligned_le64(&sblk->export_table_start);
+	table = sqfs_cache.frag_table;
+	table_offset = sqfs_cache.frag_table_offset;
+	if (!table) {
+		start = get_unaligned_le64(&sblk->fragment_table_start);
+		end = get_unaligned_le64(&sblk->id_table_start);
+		exp_tbl = get_unaligned_le64(&sblk->export_table_start);
 
-	if (exp_tbl > start && exp_tbl < end)
-		end = exp_tbl;
+		if (exp_tbl > start && exp_tbl < end)
+			end = exp_tbl;
 
-	n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
-				  cpu_to_le64(end), &table_offset);
+		n_blks = sqfs_calc_n_blks(sblk->fragment_table_start,
+					  cpu_to_le64(end), &table_offset);
 
-	start /= ctxt.cur_dev->blksz;
+		start /= ctxt.cur_dev->blksz;
 
-	/* Allocate a proper sized buffer to store the fragment index table */
-	table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-	if (!table) {
-		ret = -ENOMEM;
-		goto out;
-	}
+		/*
+		 * Allocate a proper sized buffer to store the fragment index
+		 * table
+		 */
+		table = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+		if (!table) {
+			ret = -ENOMEM;
+			goto out;
+		}
 
-	if (sqfs_disk_read(start, n_blks, table) < 0) {
-		ret = -EINVAL;
-		goto out;
+		if (sqfs_disk_read(start, n_blks, table) < 0) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		if (sqfs_cache_table(n_blks * ctxt.cur_dev->blksz)) {
+			sqfs_cache.frag_table = table;
+			sqfs_cache.frag_table_offset = table_offset;
+		}
 	}
 
 	block = SQFS_FRAGMENT_INDEX(inode_fragment_index);
@@ -149,6 +320,12 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 	start_block = get_unaligned_le64(table + table_offset + block *
 					 sizeof(u64));
 
+	blk = sqfs_cache_lookup(start_block);
+	if (blk) {
+		entries = (void *)blk->data;
+		goto found;
+	}
+
 	start = start_block / ctxt.cur_dev->blksz;
 	n_blks = sqfs_calc_n_blks(cpu_to_le64(start_block),
 				  sblk->fragment_table_start, &table_offset);
@@ -173,7 +350,11 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 		goto out;
 	}
 
-	entries = malloc(SQFS_METADATA_BLOCK_SIZE);
+	new_blk = sqfs_cache_alloc(start_block, SQFS_METADATA_BLOCK_SIZE);
+	if (new_blk)
+		entries = (void *)new_blk->data;
+	else
+		entries = tofree = malloc(SQFS_METADATA_BLOCK_SIZE);
 	if (!entries) {
 		ret = -ENOMEM;
 		goto out;
@@ -189,16 +370,95 @@ static int sqfs_frag_lookup(u32 inode_fragment_index,
 			goto out;
 		}
 	} else {
-		memcpy(entries, metadata, SQFS_METADATA_SIZE(header));
+		dest_len = SQFS_METADATA_SIZE(header);
+		memcpy(entries, metadata, dest_len);
+	}
+
+	if (new_blk) {
+		sqfs_cache_insert(new_blk, dest_len);
+		new_blk = NULL;
 	}
 
+found:
 	*e = entries[offset];
 	ret = SQFS_COMPRESSED_BLOCK(e->size);
 
 out:
-	free(entries);
+	free(new_blk);
+	free(tofree);
 	free(metadata_buffer);
-	free(table);
+	if (table != sqfs_cache.frag_table)
+		free(table);
+
+	return ret;
+}
+
+/*
+ * Get the decompressed fragment block described by 'e', from the cache if
+ * possible. If the block cannot be cached, '*tofree' is set to the buffer
+ * holding it, which the caller must free.
+ */
+static int sqfs_get_fragment(struct squashfs_fragment_block_entry *e,
+			     bool comp, char **datap, char **tofree)
+{
+	struct squashfs_super_block *sblk = ctxt.sblk;
+	u64 start, n_blks, table_size, table_offset;
+	struct sqfs_cache_block *blk;
+	unsigned long dest_len;
+	char *fragment, *data;
+	int ret;
+
+	*tofree = NULL;
+	blk = sqfs_cache_lookup(e->start);
+	if (blk) {
+		*datap = (char *)blk->data;
+		return 0;
+	}
+
+	start = lldiv(e->start, ctxt.cur_dev->blksz);
+	table_size = SQFS_BLOCK_SIZE(e->size);
+	table_offset = e->start - (start * ctxt.cur_dev->blksz);
+	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
+
+	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
+	if (!fragment)
+		return -ENOMEM;
+
+	ret = sqfs_disk_read(start, n_blks, fragment);
+	if (ret < 0)
+		goto out;
+
+	dest_len = comp ? get_unaligned_le32(&sblk->block_size) : table_size;
+	blk = sqfs_cache_alloc(e->start, dest_len);
+	data = blk ? (char *)blk->data : malloc(dest_len);
+	if (!data) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (comp) {
+		ret = sqfs_decompress(&ctxt, data, &dest_len,
+				      fragment + table_offset, e->size);
+		if (ret) {
+			if (blk)
+				free(blk);
+			else
+				free(data);
+			goto out;
+		}
+	} else {
+		memcpy(data, fragment + table_offset, table_size);
+	}
+
+	if (blk)
+		sqfs_cache_insert(blk, dest_len);
+	else
+		*tofree = data;
+	*datap = data;
+	ret = 0;
+
+out:
+	free(fragment);
 
 	return ret;
 }
@@ -701,6 +961,11 @@ static int sqfs_read_inode_table(unsigned char **inode_table)
 	unsigned long dest_len = 0;
 	bool compressed;
 
+	if (sqfs_cache.inode_table) {
+		*inode_table = sqfs_cache.inode_table;
+		return 0;
+	}
+
 	table_size = get_unaligned_le64(&sblk->directory_table_start) -
 		get_unaligned_le64(&sblk->inode_table_start);
 	start = get_unaligned_le64(&sblk->inode_table_start) /
@@ -772,6 +1037,9 @@ static int sqfs_read_inode_table(unsigned char **inode_table)
 		src_table += src_len + SQFS_HEADER_SIZE;
 	}
 
+	if (sqfs_cache_table(metablks_count * SQFS_METADATA_BLOCK_SIZE))
+		sqfs_cache.inode_table = *inode_table;
+
 free_itb:
 	free(itb);
 
@@ -788,6 +1056,12 @@ static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
 	unsigned long dest_len = 0;
 	bool compressed;
 
+	if (sqfs_cache.dir_table) {
+		*dir_table = sqfs_cache.dir_table;
+		*pos_list = sqfs_cache.dir_pos_list;
+		return sqfs_cache.dir_metablks;
+	}
+
 	*dir_table = NULL;
 	*pos_list = NULL;
 	/* DIRECTORY TABLE */
@@ -866,6 +1140,13 @@ static int sqfs_read_directory_table(unsigned char **dir_table, u32 **pos_list)
 		src_table += src_len + SQFS_HEADER_SIZE;
 	}
 
+	if (sqfs_cache_table(metablks_count * (SQFS_METADATA_BLOCK_SIZE +
+						sizeof(u32)))) {
+		sqfs_cache.dir_table = *dir_table;
+		sqfs_cache.dir_pos_list = *pos_list;
+		sqfs_cache.dir_metablks = metablks_count;
+	}
+
 out:
 	if (metablks_count < 1) {
 		free(*dir_table);
@@ -963,10 +1244,11 @@ out:
 	for (j = 0; j < token_count; j++)
 		free(token_list[j]);
 	free(token_list);
-	free(pos_list);
+	sqfs_free_table(pos_list);
 	free(path);
 	if (ret) {
-		free(inode_table);
+		sqfs_free_table(inode_table);
+		sqfs_free_table(dir_table);
 		free(dirs);
 	}
 
@@ -1108,6 +1390,7 @@ int sqfs_probe(struct blk_desc *fs_dev_desc, struct disk_partition *fs_partition
 	}
 
 	ctxt.sblk = sblk;
+	sqfs_cache_check(sblk);
 
 	ret = sqfs_decompressor_init(&ctxt);
 	if (ret) {
@@ -1526,50 +1809,14 @@ int sqfs_read(const char *filename, void *buf, loff_t offset, loff_t len,
 		goto out;
 	}
 
-	start = lldiv(frag_entry.start, ctxt.cur_dev->blksz);
-	table_size = SQFS_BLOCK_SIZE(frag_entry.size);
-	table_offset = frag_entry.start - (start * ctxt.cur_dev->blksz);
-	n_blks = DIV_ROUND_UP(table_size + table_offset, ctxt.cur_dev->blksz);
-
-	fragment = malloc_cache_aligned(n_blks * ctxt.cur_dev->blksz);
-
-	if (!fragment) {
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	ret = sqfs_disk_read(start, n_blks, fragment);
-	if (ret < 0)
+	ret = sqfs_get_fragment(&frag_entry, finfo.comp, &fragment_block,
+				&fragment);
+	if (ret)
 		goto out;
 
-	/* File compressed and fragmented */
-	if (finfo.frag && finfo.comp) {
-		dest_len = get_unaligned_le32(&sblk->block_size);
-		fragment_block = malloc(dest_len);
-		if (!fragment_block) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		ret = sqfs_decompress(&ctxt, fragment_block, &dest_len,
-				      (void *)fragment  + table_offset,
-				      frag_entry.size);
-		if (ret) {
-			free(fragment_block);
-			goto out;
-		}
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-
-		free(fragment_block);
-
-	} else if (finfo.frag && !finfo.comp) {
-		fragment_block = (void *)fragment + table_offset;
-
-		memcpy(buf + *actread, &fragment_block[finfo.offset], finfo.size - *actread);
-		*actread = finfo.size;
-	}
+	memcpy(buf + *actread, &fragment_block[finfo.offset],
+	       finfo.size - *actread);
+	*actread = finfo.size;
 
 out:
 	free(fragment);
@@ -1725,8 +1972,8 @@ void sqfs_closedir(struct fs_dir_stream *dirs)
 		return;
 
 	sqfs_dirs = (struct squashfs_dir_stream *)dirs;
-	free(sqfs_dirs->inode_table);
-	free(sqfs_dirs->dir_table);
+	sqfs_free_table(sqfs_dirs->inode_table);
+	sqfs_free_table(sqfs_dirs->dir_table);
 	free(sqfs_dirs->dir_header);
 	free(sqfs_dirs);
 }
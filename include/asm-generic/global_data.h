@@ -217,6 +217,22 @@ struct global_data {
 	 * @uclass_root_s.
 	 */
 	struct list_head *uclass_root;
+# if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	/**
+	 * @uclass_index: index of uclasses and devices, for fast lookups
+	 */
+	struct uclass_index *uclass_index;
+# endif
+# if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/**
+	 * @dm_compat: index of driver compatible strings, sorted by string
+	 */
+	struct driver_compat *dm_compat;
+	/**
+	 * @dm_compat_count: number of entries in @dm_compat
+	 */
+	int dm_compat_count;
+# endif
 # if CONFIG_IS_ENABLED(OF_PLATDATA_DRIVER_RT)
 	/** @dm_driver_rt: Dynamic info about the driver */
 	struct driver_rt *dm_driver_rt;
@@ -9,6 +9,7 @@
 
 #include <dm/uclass-id.h>
 #include <efi.h>
+#include <linux/list.h>
 
 #ifdef CONFIG_SYS_64BIT_LBA
 typedef uint64_t lbaint_t;
@@ -103,6 +104,9 @@ struct blk_desc {
 #define PAD_TO_BLOCKSIZE(size, blk_desc) \
 	(PAD_SIZE(size, blk_desc->blksz))
 
+/* Use the global maximum blocks per entry for a device */
+#define BLKCACHE_DEFAULT	UINT_MAX
+
 #if CONFIG_IS_ENABLED(BLOCK_CACHE)
 
 /**
@@ -113,6 +117,9 @@ int blkcache_init(void);
 /**
  * blkcache_read() - attempt to read a set of blocks from cache
  *
+ * The cache may hold only the start of the range, in which case the caller
+ * must read the remaining blocks from the device.
+ *
  * @param iftype - uclass_id_x for type of device
  * @param dev - device index of particular type
  * @param start - starting block number
@@ -120,11 +127,11 @@ int blkcache_init(void);
  * @param blksz - size in bytes of each block
  * @param buffer - buffer to contain cached data
  *
- * Return: - 1 if block returned from cache, 0 otherwise.
+ * Return: - number of blocks from @start returned from cache, 0 if none
  */
-int blkcache_read(int iftype, int dev,
-		  lbaint_t start, lbaint_t blkcnt,
-		  unsigned long blksz, void *buffer);
+lbaint_t blkcache_read(int iftype, int dev,
+		       lbaint_t start, lbaint_t blkcnt,
+		       unsigned long blksz, void *buffer);
 
 /**
  * blkcache_fill() - make data read from a block device available
@@ -154,20 +161,46 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * @param blocks - maximum number of blocks of a read that is cached
+ * @param bytes - memory budget of the cache in bytes
+ */
+void blkcache_configure(unsigned blocks, ulong bytes);
+
+/**
+ * blkcache_set_policy() - set the cache policy of a single device
+ *
+ * Any cached data for the device is discarded.
+ *
+ * @iftype - UCLASS_ID_ for type of device
+ * @dev - device index of particular type
+ * @max_blocks - maximum number of blocks of a read that is cached, 0 to
+ *	disable caching or BLKCACHE_DEFAULT to use the global setting
+ * Return: 0 if OK, -ENOMEM if out of memory
+ */
+int blkcache_set_policy(int iftype, int dev, unsigned int max_blocks);
+
+/**
+ * blkcache_get_policy() - get the cache policy of a single device
+ *
+ * @iftype - UCLASS_ID_ for type of device
+ * @dev - device index of particular type
+ * Return: maximum number of blocks of a read that is cached for this device,
+ *	or BLKCACHE_DEFAULT if the global setting applies
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+unsigned int blkcache_get_policy(int iftype, int dev);
 
 /*
  * statistics of the block cache
  */
 struct block_cache_stats {
 	unsigned hits;
+	unsigned partial_hits;
 	unsigned misses;
-	unsigned entries; /* current entry count */
+	unsigned evictions;
+	unsigned entries; /* current segment count */
 	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	ulong bytes; /* current memory use */
+	ulong max_bytes;
 };
 
 /**
@@ -182,9 +215,9 @@ void blkcache_free(void);
 
 #else
 
-static inline int blkcache_read(int iftype, int dev,
-				lbaint_t start, lbaint_t blkcnt,
-				unsigned long blksz, void *buffer)
+static inline lbaint_t blkcache_read(int iftype, int dev,
+				     lbaint_t start, lbaint_t blkcnt,
+				     unsigned long blksz, void *buffer)
 {
 	return 0;
 }
@@ -195,6 +228,12 @@ static inline void blkcache_fill(int iftype, int dev,
 
 static inline void blkcache_invalidate(int iftype, int dev) {}
 
+static inline int blkcache_set_policy(int iftype, int dev,
+				      unsigned int max_blocks)
+{
+	return 0;
+}
+
 static inline void blkcache_free(void) {}
 
 #endif
@@ -202,6 +241,41 @@ static inline void blkcache_free(void) {}
 #if CONFIG_IS_ENABLED(BLK)
 struct udevice;
 
+/**
+ * struct blk_request - an asynchronous read or write of a block device
+ *
+ * The caller fills in @start, @blkcnt, @buffer, @write and optionally
+ * @complete and @priv, then passes the request to blk_submit(). The request
+ * must not be changed or freed until it is done.
+ *
+ * @start: First block to transfer
+ * @blkcnt: Number of blocks to transfer
+ * @buffer: Data to write, or place to put the data read
+ * @write: true to write, false to read
+ * @complete: Function called by blk_poll() when the request is done, or NULL.
+ *	It may submit more requests, but must not wait for any, nor read or
+ *	write the device synchronously.
+ * @priv: Private data for the caller
+ * @result: Number of blocks transferred, or -ve error, once @done is set
+ * @done: true once the request is done
+ * @dev: Device the request was submitted to (set by blk_submit())
+ * @sibling: Node in the device's list of requests (used by the uclass)
+ * @drv_priv: Private data for the driver while it carries out the request
+ */
+struct blk_request {
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	bool write;
+	void (*complete)(struct blk_request *req);
+	void *priv;
+	long result;
+	bool done;
+	struct udevice *dev;
+	struct list_head sibling;
+	ulong drv_priv;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -260,6 +334,38 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+	/**
+	 * submit() - start an asynchronous read or write
+	 *
+	 * This starts the transfer and returns without waiting for it. The
+	 * driver calls blk_complete() when it is done, normally from poll().
+	 * The uclass never has more requests in flight than the queue depth
+	 * set with blk_set_queue_depth().
+	 *
+	 * If this method is missing, requests are carried out with read() and
+	 * write() when the device is polled.
+	 *
+	 * @dev:	Device to read from or write to
+	 * @req:	Request to start
+	 * @return 0 if started, -EAGAIN if the device cannot take another
+	 * request until one completes, -ENOSYS to have this request carried
+	 * out with read() or write() instead, other -ve on error
+	 */
+	int (*submit)(struct udevice *dev, struct blk_request *req);
+
+	/**
+	 * poll() - check for completed requests
+	 *
+	 * This calls blk_complete() for each request which has finished. A
+	 * request which fails or times out must also be completed, with an
+	 * error.
+	 *
+	 * @dev:	Device to check
+	 * @return 0 if OK, -ve on error, which fails all the requests in
+	 * flight; the driver may still complete them, which is then ignored
+	 */
+	int (*poll)(struct udevice *dev);
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -277,6 +383,139 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+/**
+ * blk_set_readahead() - Set the read-ahead window of a block device
+ *
+ * Once a few reads of a device have each started where the previous one
+ * ended, smaller reads are widened to the read-ahead window and following
+ * reads are served from it. The initial window is set by
+ * CONFIG_BLK_READAHEAD_BLOCKS.
+ *
+ * @dev: Block device to update, which must be probed
+ * @blocks: Size of the window in blocks, 0 to disable read-ahead
+ * Return: 0 if OK, -EINVAL if the device is not probed, -ENOSYS if read-ahead
+ *	is not supported
+ */
+int blk_set_readahead(struct udevice *dev, lbaint_t blocks);
+
+/**
+ * blk_set_writeback() - Enable or disable write-back for a block device
+ *
+ * While write-back is enabled, small writes are held in memory and merged
+ * with overlapping or adjacent ones, then written to the device by
+ * blk_flush(). Reads see the data which is held. Disabling write-back flushes
+ * the device.
+ *
+ * @dev: Block device to update, which must be probed
+ * @enable: true to enable write-back, false to flush and disable it
+ * Return: 0 if OK, -EINVAL if the device is not probed, -ENOSYS if write-back
+ *	is not supported, other -ve on error writing to the device
+ */
+int blk_set_writeback(struct udevice *dev, bool enable);
+
+/**
+ * blk_flush() - Write any data held for a block device
+ *
+ * @dev: Block device to flush
+ * Return: 0 if OK, -EIO on error writing to the device
+ */
+int blk_flush(struct udevice *dev);
+
+/**
+ * blk_flush_all() - Write any data held for all block devices
+ *
+ * This must be called before anything that does not return to U-Boot, such
+ * as booting an OS or resetting the board.
+ *
+ * Return: 0 if OK, -EIO on error writing to any device
+ */
+int blk_flush_all(void);
+
+/**
+ * blk_submit() - Start an asynchronous read or write of a block device
+ *
+ * The request is passed to the device straight away if it supports
+ * asynchronous requests and has room for it, otherwise it is queued. Either
+ * way this does not wait for the transfer. Use blk_poll() or blk_wait() to
+ * find out when it is done.
+ *
+ * Requests may complete in any order. The block cache and read-ahead window
+ * are not used, but reads do see data held back by write-back.
+ *
+ * @dev: Block device to use, which must be probed
+ * @req: Request to submit, see struct blk_request
+ * Return: 0 if OK, -ENOSYS if the device cannot read (or write) or
+ *	asynchronous requests are not supported, other -ve on error
+ */
+int blk_submit(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_poll() - Make progress with the requests submitted to a block device
+ *
+ * This starts queued requests where the device has room for them, then calls
+ * the completion function of each request which is done. A device which does
+ * not support asynchronous requests carries them out here, one at a time.
+ *
+ * If the driver's poll() method fails, the requests it has in flight are
+ * completed with its error.
+ *
+ * @dev: Block device to poll
+ * Return: number of requests completed, or -ve on error
+ */
+int blk_poll(struct udevice *dev);
+
+/**
+ * blk_wait() - Wait for a request to complete
+ *
+ * This polls the device until @req is done. Completion functions of other
+ * requests may be called meanwhile. If no request completes for 30 seconds,
+ * @req is failed with -ETIMEDOUT. The driver may then still be using its
+ * buffer, so the device should be reset before the buffer is reused.
+ *
+ * @dev: Block device the request was submitted to
+ * @req: Request to wait for
+ * Return: number of blocks transferred, or -ve on error
+ */
+long blk_wait(struct udevice *dev, struct blk_request *req);
+
+/**
+ * blk_wait_all() - Wait for all requests submitted to a block device
+ *
+ * This includes any requests submitted by completion functions while waiting.
+ * Synchronous reads and writes of a device wait for its requests first. If no
+ * request completes for 30 seconds, all those left are failed with -ETIMEDOUT,
+ * as with blk_wait().
+ *
+ * @dev: Block device to wait for
+ * Return: 0 if OK, -ETIMEDOUT if requests timed out, -EIO if any other
+ * request failed
+ */
+int blk_wait_all(struct udevice *dev);
+
+/**
+ * blk_complete() - Report that a request is done
+ *
+ * This is for use by drivers. It may be called from the driver's submit() and
+ * poll() methods. The completion function is called later, by blk_poll().
+ *
+ * @req: Request which is done
+ * @result: Number of blocks transferred, or -ve on error
+ */
+void blk_complete(struct blk_request *req, long result);
+
+/**
+ * blk_set_queue_depth() - Set how many requests a device can have in flight
+ *
+ * Drivers which support asynchronous requests call this from their probe()
+ * method. The default is 1.
+ *
+ * @dev: Block device to update
+ * @depth: Number of requests, at least 1
+ * Return: 0 if OK, -EINVAL if @depth is 0, -ENOSYS if asynchronous requests
+ *	are not supported
+ */
+int blk_set_queue_depth(struct udevice *dev, uint depth);
+
 /**
  * blk_read() - Read from a block device
  *
@@ -514,9 +753,15 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 			      lbaint_t blkcnt, void *buffer)
 {
 	ulong blks_read;
-	if (blkcache_read(block_dev->uclass_id, block_dev->devnum,
-			  start, blkcnt, block_dev->blksz, buffer))
+	lbaint_t cached;
+
+	cached = blkcache_read(block_dev->uclass_id, block_dev->devnum,
+			       start, blkcnt, block_dev->blksz, buffer);
+	if (cached == blkcnt)
 		return blkcnt;
+	start += cached;
+	blkcnt -= cached;
+	buffer += cached * block_dev->blksz;
 
 	/*
 	 * We could check if block_read is NULL and return -ENOSYS. But this
@@ -528,7 +773,7 @@ static inline ulong blk_dread(struct blk_desc *block_dev, lbaint_t start,
 		blkcache_fill(block_dev->uclass_id, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
 
-	return blks_read;
+	return cached + blks_read;
 }
 
 static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
@@ -609,6 +854,16 @@ struct blk_driver {
 
 struct blk_driver *blk_driver_lookup_type(int uclass_id);
 
+static inline int blk_set_writeback(struct udevice *dev, bool enable)
+{
+	return -ENOSYS;
+}
+
+static inline int blk_flush_all(void)
+{
+	return 0;
+}
+
 #endif /* !CONFIG_BLK */
 
 /**
@@ -183,6 +183,8 @@ enum bootstage_id {
 	BOOTSTAGE_ID_START_UBOOT_F,
 	BOOTSTAGE_ID_START_UBOOT_R,
 	BOOTSTAGE_ID_USB_START,
+	BOOTSTAGE_ID_USB_SCAN_START,
+	BOOTSTAGE_ID_USB_SCAN_DONE,
 	BOOTSTAGE_ID_ETH_START,
 	BOOTSTAGE_ID_BOOTP_START,
 	BOOTSTAGE_ID_BOOTP_STOP,
@@ -211,6 +213,7 @@ enum bootstage_id {
 	BOOTSTAGE_ID_ACCUM_FSP_M,
 	BOOTSTAGE_ID_ACCUM_FSP_S,
 	BOOTSTAGE_ID_ACCUM_MMAP_SPI,
+	BOOTSTAGE_ID_ACCUM_DM_MATCH,
 
 	/* a few spare for the user, from here */
 	BOOTSTAGE_ID_USER,
@@ -12,6 +12,8 @@
 #include <dm/ofnode.h>
 #include <dm/uclass-id.h>
 
+struct udevice_id;
+
 /**
  * lists_driver_lookup_name() - Return u_boot_driver corresponding to name
  *
@@ -23,6 +25,20 @@
  */
 struct driver *lists_driver_lookup_name(const char *name);
 
+/**
+ * lists_driver_lookup_compat() - Return the driver for a compatible string
+ *
+ * This finds the first driver whose of_match table contains the given
+ * compatible string. Drivers are checked in linker-list order, so this is the
+ * driver which lists_bind_fdt() uses for that string.
+ *
+ * @compat: Compatible string to look up
+ * @idp: Returns the matching entry in the driver's of_match table
+ * Return: pointer to driver, or NULL if not found
+ */
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **idp);
+
 /**
  * lists_uclass_lookup() - Return uclass_driver based on ID of the class
  *
@@ -347,4 +347,104 @@ struct uclass *uclass_find(enum uclass_id key);
  */
 int uclass_destroy(struct uclass *uc);
 
+/**
+ * enum uclass_index_t - Ways of looking up a device in its uclass
+ *
+ * @UCLASS_INDEX_SEQ: By sequence number
+ * @UCLASS_INDEX_OFNODE: By devicetree node, using ofnode.of_offset as the key
+ * @UCLASS_INDEX_PHANDLE: By the phandle of its devicetree node
+ * @UCLASS_INDEX_COUNT: Number of ways
+ */
+enum uclass_index_t {
+	UCLASS_INDEX_SEQ,
+	UCLASS_INDEX_OFNODE,
+	UCLASS_INDEX_PHANDLE,
+
+	UCLASS_INDEX_COUNT,
+};
+
+/**
+ * uclass_index_init() - Set up an empty index of uclasses and devices
+ *
+ * This is called by dm_init(). If there is already an index, it is cleared.
+ * Before relocation, or if there is no memory for it, there is no index and
+ * lookups walk the lists instead.
+ */
+void uclass_index_init(void);
+
+/**
+ * uclass_index_add_uclass() - Add a new uclass to the index
+ *
+ * @uc: uclass to add
+ */
+void uclass_index_add_uclass(struct uclass *uc);
+
+/**
+ * uclass_index_remove_uclass() - Remove a uclass from the index
+ *
+ * @uc: uclass to remove, which must have no devices
+ */
+void uclass_index_remove_uclass(struct uclass *uc);
+
+/**
+ * uclass_index_find_uclass() - Find a uclass using the index
+ *
+ * @id: ID of uclass to find
+ * @ucp: Returns the uclass, or NULL if it has not been created
+ * Return: 0 if OK, -ENOSYS if there is no index
+ */
+int uclass_index_find_uclass(enum uclass_id id, struct uclass **ucp);
+
+/**
+ * uclass_index_add_device() - Add a device to the index
+ *
+ * The device must already be in its uclass's list of devices.
+ *
+ * @dev: Device to add
+ */
+void uclass_index_add_device(struct udevice *dev);
+
+/**
+ * uclass_index_remove_device() - Remove a device from the index
+ *
+ * This must be called while the device is still in its uclass's list.
+ *
+ * @dev: Device to remove
+ */
+void uclass_index_remove_device(struct udevice *dev);
+
+/**
+ * uclass_index_update_device() - Update the index after a device changes
+ *
+ * Call this after changing the sequence number or devicetree node of a device
+ * which is already bound.
+ *
+ * @dev: Device which has changed
+ */
+void uclass_index_update_device(struct udevice *dev);
+
+/**
+ * uclass_index_find_device() - Find a device in a uclass using the index
+ *
+ * This finds the same device as walking the uclass's devices in order and
+ * taking the first one which matches.
+ *
+ * @uc: uclass to search
+ * @type: What @key is
+ * @key: Sequence number, ofnode.of_offset or phandle to look for
+ * @devp: Returns the device, if found
+ * Return: 0 if OK, -ENODEV if not found, -ENOSYS if the index cannot be used,
+ *	in which case the caller must walk the devices itself
+ */
+int uclass_index_find_device(struct uclass *uc, enum uclass_index_t type,
+			     ulong key, struct udevice **devp);
+
+/**
+ * uclass_index_get_stats() - Get statistics about device lookups
+ *
+ * @lookupsp: Returns the number of lookups made using the index
+ * @stepsp: Returns the number of hash-table entries checked by those lookups
+ */
+void uclass_index_get_stats(ulong *lookupsp, ulong *stepsp);
+
 #endif
@@ -198,11 +198,19 @@ struct ext2_dirent {
 	__u8 filetype;
 };
 
+/* A run of file blocks which are contiguous on disk, or all in a hole */
+struct ext2fs_run {
+	int fileblock;		/* first block of the run in the file */
+	int count;		/* number of blocks, 0 if nothing is mapped */
+	long int blknr;		/* first block on disk, 0 for a hole */
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
 	int ino;
 	int inode_read;
+	struct ext2fs_run run;	/* last run mapped by ext4fs_read_file() */
 };
 
 /* Information about a "mounted" ext2 filesystem. */
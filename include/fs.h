@@ -88,8 +88,10 @@ int fs_set_blk_dev_with_part(struct blk_desc *desc, int part);
  * Many file functions implicitly call fs_close(), e.g. fs_closedir(),
  * fs_exist(), fs_ln(), fs_ls(), fs_mkdir(), fs_read(), fs_size(), fs_write(),
  * fs_unlink().
+ *
+ * Return: 0 if OK, -ve on error flushing writes held back by the block device
  */
-void fs_close(void);
+int fs_close(void);
 
 /**
  * fs_get_type() - Get type of current filesystem
@@ -45,6 +45,28 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 	   int stoponerr, int offset);
 
+/**
+ * gunzip_stream() - Decompress gzipped data, passing it on as it is read
+ *
+ * The source is read in pieces of @chunk bytes. Each piece is given to
+ * @update just before it is decompressed, so that a caller which needs to
+ * process the compressed data as well (e.g. to hash it) touches it only once.
+ *
+ * @dst: Destination for uncompressed data
+ * @dstlen: Size of destination buffer
+ * @src: Source data to decompress
+ * @lenp: On entry, length of data at @src. On exit, length of uncompressed data
+ * @chunk: Number of bytes to read at a time
+ * @update: Called with each piece of @src, the whole of @src being covered
+ *	in order. A non-zero return value stops decompression and is returned
+ * @priv: Private data for @update
+ * Return: 0 if OK, -1 on decompression error, or the error from @update
+ */
+int gunzip_stream(void *dst, int dstlen, unsigned char *src,
+		  unsigned long *lenp, ulong chunk,
+		  int (*update)(void *priv, const void *buf, ulong size),
+		  void *priv);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
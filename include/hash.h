@@ -120,6 +120,19 @@ int hash_command(const char *algo_name, int flags, struct cmd_tbl *cmdtp,
 int hash_block(const char *algo_name, const void *data, unsigned int len,
 	       uint8_t *output, int *output_size);
 
+/**
+ * hash_bench() - Time hash algorithms over a memory area
+ *
+ * Each algorithm is run once over the area and its time and throughput are
+ * printed.
+ *
+ * @algo_name:		Hash algorithm to time, or NULL for all of them
+ * @addr:		Address of the data to hash
+ * @len:		Length of the data in bytes
+ * Return: 0 if ok, -EPROTONOSUPPORT for an unknown algorithm
+ */
+int hash_bench(const char *algo_name, ulong addr, ulong len);
+
 #endif /* !USE_HOSTCC */
 
 /**
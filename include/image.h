@@ -365,6 +365,13 @@ struct bootm_headers {
 	void		*fit_hdr_os;	/* os FIT image header */
 	const char	*fit_uname_os;	/* os subimage node unit name */
 	int		fit_noffset_os;	/* os subimage node offset */
+	/*
+	 * Set before loading the os subimage to allow its hashes to be checked
+	 * by bootm_load_os() while decompressing it, see
+	 * CONFIG_FIT_STREAM_VERIFY. Left set by fit_image_load() only if the
+	 * check was in fact deferred.
+	 */
+	int		fit_stream_os;
 
 	void		*fit_hdr_rd;	/* init ramdisk FIT image header */
 	const char	*fit_uname_rd;	/* init ramdisk subimage node unit name */
@@ -944,6 +951,26 @@ int image_decomp(int comp, ulong load, ulong image_start, int type,
 		 void *load_buf, void *image_buf, ulong image_len,
 		 uint unc_len, ulong *load_end);
 
+/**
+ * image_decomp_stream() - decompress an image, passing its data to a callback
+ *
+ * This works like image_decomp() but also gives the compressed data, in
+ * order, to @update. For gzip this is done a chunk at a time just before the
+ * chunk is decompressed, so the data is only read from memory once. Other
+ * compression types are given to @update whole, then decompressed.
+ *
+ * @update:	Called with the compressed data. A non-zero return value stops
+ *		decompression and is returned
+ * @priv:	Private data for @update
+ * The remaining arguments are as for image_decomp()
+ * Return: 0 if OK, the error from @update, or -ve on other error
+ */
+int image_decomp_stream(int comp, ulong load, ulong image_start, int type,
+			void *load_buf, void *image_buf, ulong image_len,
+			uint unc_len, ulong *load_end,
+			int (*update)(void *priv, const void *buf, ulong size),
+			void *priv);
+
 /**
  * Set up properties in the FDT
  *
@@ -1179,6 +1206,7 @@ int fit_get_data_conf_prop(const void *fit, const char *prop_name,
 int fit_image_hash_get_algo(const void *fit, int noffset, const char **algo);
 int fit_image_hash_get_value(const void *fit, int noffset, uint8_t **value,
 				int *value_len);
+int fit_image_hash_get_ignore(const void *fit, int noffset, int *ignore);
 
 int fit_set_timestamp(void *fit, int noffset, time_t timestamp);
 
@@ -1263,6 +1291,46 @@ int fit_image_verify_with_data(const void *fit, int image_noffset,
 			       size_t size);
 
 int fit_image_verify(const void *fit, int noffset);
+
+/**
+ * fit_image_decomp_verify() - Decompress an image and check its hashes
+ *
+ * This works like image_decomp() but also checks the hash nodes of the image,
+ * computing them on each chunk of the compressed data just before it is
+ * decompressed, so the data is read only once.
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @noffset:	Offset in @fit of the component image node
+ * The remaining arguments are as for image_decomp()
+ * Return: 0 if OK, -EACCES if a hash does not match, other -ve value on other
+ *	error
+ */
+int fit_image_decomp_verify(const void *fit, int noffset, int comp, ulong load,
+			    ulong image_start, int type, void *load_buf,
+			    void *image_buf, ulong image_len, uint unc_len,
+			    ulong *load_end);
+
+#if CONFIG_IS_ENABLED(FIT_STREAM_VERIFY) && !defined(USE_HOSTCC)
+/**
+ * fit_image_can_stream() - Check if an image's hashes can be checked on load
+ *
+ * This is true for a gzip-compressed image whose hashes can all be computed
+ * progressively, and which has nothing else to verify up front: no signature,
+ * no required image key in the control FDT and no ciphered data.
+ *
+ * @fit:	Pointer to the FIT format image header
+ * @noffset:	Offset in @fit of the component image node
+ * Return: true if fit_image_decomp_verify() may be used instead of
+ *	fit_image_verify() followed by image_decomp()
+ */
+bool fit_image_can_stream(const void *fit, int noffset);
+#else
+static inline bool fit_image_can_stream(const void *fit, int noffset)
+{
+	return false;
+}
+#endif
+
 #if CONFIG_IS_ENABLED(FIT_SIGNATURE)
 int fit_config_verify(const void *fit, int conf_noffset);
 #else
@@ -40,34 +40,43 @@ struct lmb_property {
  * all the #if test are done with CONFIG_LMB_USE_MAX_REGIONS (boolean)
  *
  * case 1. CONFIG_LMB_USE_MAX_REGIONS is defined (legacy mode)
- *         => CONFIG_LMB_MAX_REGIONS is used to configure the region size,
- *         directly in the array lmb_region.region[], with the same
- *         configuration for memory and reserved regions.
+ *         => CONFIG_LMB_MAX_REGIONS is used to configure the initial size of
+ *         both the memory and the reserved region tables.
  *
- * case 2. CONFIG_LMB_USE_MAX_REGIONS is not defined, the size of each
- *         region is configurated *independently* with
+ * case 2. CONFIG_LMB_USE_MAX_REGIONS is not defined, the initial size of each
+ *         table is configurated *independently* with
  *         => CONFIG_LMB_MEMORY_REGIONS: struct lmb.memory_regions
  *         => CONFIG_LMB_RESERVED_REGIONS: struct lmb.reserved_regions
- *         lmb_region.region is only a pointer to the correct buffer,
- *         initialized in lmb_init(). This configuration is useful to manage
- *         more reserved memory regions with CONFIG_LMB_RESERVED_REGIONS.
+ *
+ * In both cases lmb_region.region points to the array in struct lmb, set up
+ * by lmb_init(). When a table is full it is moved to a larger one allocated
+ * with malloc(), so there is no fixed limit on the number of regions. Use
+ * lmb_uninit() to free it again.
  */
+#if IS_ENABLED(CONFIG_LMB_USE_MAX_REGIONS)
+#define LMB_MEMORY_REGIONS	CONFIG_LMB_MAX_REGIONS
+#define LMB_RESERVED_REGIONS	CONFIG_LMB_MAX_REGIONS
+#else
+#define LMB_MEMORY_REGIONS	CONFIG_LMB_MEMORY_REGIONS
+#define LMB_RESERVED_REGIONS	CONFIG_LMB_RESERVED_REGIONS
+#endif
 
 /**
  * struct lmb_region - Description of a set of region.
  *
+ * The regions are sorted by address and do not overlap, so they can be
+ * looked up with a binary search.
+ *
  * @cnt: Number of regions.
- * @max: Size of the region array, max value of cnt.
+ * @max: Size of the region array, max value of cnt before it must grow.
+ * @alloced: true if @region was allocated by malloc() as the array grew
  * @region: Array of the region properties
  */
 struct lmb_region {
 	unsigned long cnt;
 	unsigned long max;
-#if IS_ENABLED(CONFIG_LMB_USE_MAX_REGIONS)
-	struct lmb_property region[CONFIG_LMB_MAX_REGIONS];
-#else
+	bool alloced;
 	struct lmb_property *region;
-#endif
 };
 
 /**
@@ -80,19 +89,26 @@ struct lmb_region {
  *
  * @memory: Description of memory regions.
  * @reserved: Description of reserved regions.
- * @memory_regions: Array of the memory regions (statically allocated)
- * @reserved_regions: Array of the reserved regions (statically allocated)
+ * @memory_regions: Initial array of the memory regions
+ * @reserved_regions: Initial array of the reserved regions
  */
 struct lmb {
 	struct lmb_region memory;
 	struct lmb_region reserved;
-#if !IS_ENABLED(CONFIG_LMB_USE_MAX_REGIONS)
-	struct lmb_property memory_regions[CONFIG_LMB_MEMORY_REGIONS];
-	struct lmb_property reserved_regions[CONFIG_LMB_RESERVED_REGIONS];
-#endif
+	struct lmb_property memory_regions[LMB_MEMORY_REGIONS];
+	struct lmb_property reserved_regions[LMB_RESERVED_REGIONS];
 };
 
 void lmb_init(struct lmb *lmb);
+
+/**
+ * lmb_uninit() - Free the region arrays allocated as an lmb grew
+ *
+ * This leaves @lmb empty, as after lmb_init().
+ *
+ * @lmb:	the logical memory block struct
+ */
+void lmb_uninit(struct lmb *lmb);
 void lmb_init_and_reserve(struct lmb *lmb, struct bd_info *bd, void *fdt_blob);
 void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
 				phys_size_t size, void *fdt_blob);
@@ -999,6 +999,53 @@ extern ulong mem_malloc_brk;
 
 void mem_malloc_init(ulong start, ulong size);
 
+/**
+ * malloc_slab_init() - Set up the slab front-end of malloc()
+ *
+ * Small allocations are served from size-class slabs in this area, until it
+ * is used up. This is called by mem_malloc_init() when SYS_MALLOC_SLAB is
+ * enabled.
+ *
+ * @start: Start of the area
+ * @size: Size of the area in bytes
+ */
+void malloc_slab_init(ulong start, ulong size);
+
+/**
+ * malloc_slab_alloc() - Allocate a small object from the slabs
+ *
+ * @bytes: Number of bytes needed
+ * Return: pointer to the object, or NULL if @bytes is too large for a slab or
+ * the slab area is used up
+ */
+void *malloc_slab_alloc(size_t bytes);
+
+/**
+ * malloc_slab_free() - Free an object, if it came from the slabs
+ *
+ * @mem: Object to free
+ * Return: true if it was freed, false if it is not a slab object
+ */
+bool malloc_slab_free(void *mem);
+
+/**
+ * malloc_slab_usable_size() - Get the size of a slab object
+ *
+ * @mem: Object to check
+ * Return: number of usable bytes, or 0 if @mem is not a slab object
+ */
+size_t malloc_slab_usable_size(const void *mem);
+
+/**
+ * malloc_slab_in_use() - Get the number of bytes allocated from the slabs
+ *
+ * Return: total size of the slab objects in use
+ */
+size_t malloc_slab_in_use(void);
+
+/** malloc_slab_stats() - Show the usage of each slab size class */
+void malloc_slab_stats(void);
+
 #ifdef __cplusplus
 };  /* end of extern "C" */
 #endif
@@ -542,6 +542,32 @@ struct dm_mmc_ops {
 	 * @return 0 if success, -ve on error
 	 */
 	int (*hs400_prepare_ddr)(struct udevice *dev);
+
+	/**
+	 * send_cmd_start() - Send a command and start its data transfer
+	 *
+	 * This is like send_cmd() but returns once the card has responded,
+	 * while the controller moves the data by DMA. Use poll_data() to find
+	 * out when the transfer is done. Only reads are started this way.
+	 *
+	 * @dev:	Device to receive the command
+	 * @cmd:	Command to send
+	 * @data:	Data to receive
+	 * @return 0 if the transfer started, -ENOSYS if the controller cannot
+	 * do it in the background (e.g. it has no DMA), other -ve on error
+	 */
+	int (*send_cmd_start)(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data);
+
+	/**
+	 * poll_data() - Check a transfer started by send_cmd_start()
+	 *
+	 * @dev:	Device which is transferring the data
+	 * @data:	Data passed to send_cmd_start()
+	 * @return 0 if the transfer is done, -EBUSY if it is still going,
+	 * other -ve on error
+	 */
+	int (*poll_data)(struct udevice *dev, struct mmc_data *data);
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -558,6 +584,9 @@ int mmc_deferred_probe(struct mmc *mmc);
 int mmc_reinit(struct mmc *mmc);
 int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
 int mmc_hs400_prepare_ddr(struct mmc *mmc);
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data);
+int mmc_poll_data(struct mmc *mmc, struct mmc_data *data);
 #else
 struct mmc_ops {
 	int (*send_cmd)(struct mmc *mmc,
@@ -141,6 +141,34 @@ enum eth_recv_flags {
 	ETH_RECV_CHECK_DEVICE		= 1 << 0,
 };
 
+/**
+ * struct eth_rx_place - where to receive the next packet
+ *
+ * The packet is received at @buf - @hdr_len, so that its payload lands at
+ * @buf if the headers are the length expected. What was before @buf is put
+ * back once the packet has been processed.
+ *
+ * @buf: Where the payload of the packet goes
+ * @hdr_len: Length of the headers before the payload
+ * @len: Most payload bytes that may be written at @buf
+ */
+struct eth_rx_place {
+	uchar *buf;
+	int hdr_len;
+	int len;
+};
+
+/**
+ * struct eth_rx_pkt - a packet received as part of a batch
+ *
+ * @packet: The packet buffer
+ * @len: Length of the packet in bytes
+ */
+struct eth_rx_pkt {
+	uchar *packet;
+	int len;
+};
+
 /**
  * struct eth_ops - functions of Ethernet MAC controllers
  *
@@ -167,6 +195,21 @@ enum eth_recv_flags {
  *		    to the network stack. This function should fill in the
  *		    eth_pdata::enetaddr field - optional
  * set_promisc: Enable or Disable promiscuous mode
+ * rx_place: Receive the next packet straight into memory, at
+ *	     place->buf - place->hdr_len, if it is no longer than
+ *	     place->hdr_len + place->len. recv() then returns that pointer.
+ *	     Only one packet is received like this; a NULL place cancels it,
+ *	     or returns -EBUSY if a packet was received there already, which
+ *	     recv() returns later on. Return -ENOSYS if the hardware cannot do
+ *	     so this time - optional
+ * recv_batch: Check for up to "count" received packets at once and fill in
+ *	       "pkts" with them, in the order received. Return the number of
+ *	       packets, 0 if there are none, or an error. When supplied, the
+ *	       network stack uses this rather than recv(), which must still be
+ *	       supplied for others such as DSA - optional
+ * free_batch: Give back the buffers of the packets that recv_batch() returned,
+ *	       all at once, after the network stack processed them. This will
+ *	       only be called when recv_batch() returned packets - optional
  */
 struct eth_ops {
 	int (*start)(struct udevice *dev);
@@ -178,6 +221,11 @@ struct eth_ops {
 	int (*write_hwaddr)(struct udevice *dev);
 	int (*read_rom_hwaddr)(struct udevice *dev);
 	int (*set_promisc)(struct udevice *dev, bool enable);
+	int (*rx_place)(struct udevice *dev, const struct eth_rx_place *place);
+	int (*recv_batch)(struct udevice *dev, int flags,
+			  struct eth_rx_pkt *pkts, int count);
+	int (*free_batch)(struct udevice *dev, struct eth_rx_pkt *pkts,
+			  int count);
 };
 
 #define eth_get_ops(dev) ((struct eth_ops *)(dev)->driver->ops)
@@ -244,7 +292,30 @@ int eth_send(void *packet, int length);	   /* Send a packet */
 int eth_receive(void *packet, int length); /* Receive a packet*/
 extern void (*push_packet)(void *packet, int length);
 #endif
-int eth_rx(void);			/* Check for received packets */
+
+/**
+ * eth_rx() - check for received packets and process them
+ *
+ * Up to ETH_PACKETS_BATCH_RECV packets are processed in one call.
+ *
+ * Return: number of packets processed, or -ve on error
+ */
+int eth_rx(void);
+
+/**
+ * eth_rx_place() - receive the next packet straight into place
+ *
+ * Protocols which know where the payload of the next packet goes call this
+ * so that drivers which can do it receive the packet there, and the payload
+ * need not be copied. See struct eth_rx_place
+ *
+ * @buf: Where the payload goes, NULL to cancel
+ * @hdr_len: Length of the headers before the payload
+ * @len: Most payload bytes expected
+ * Return: 0 if OK, -ENOSYS if the driver cannot do this, -EBUSY if a packet
+ * is in the place set up before and not processed yet, other -ve on error
+ */
+int eth_rx_place(void *buf, int hdr_len, int len);
 void eth_halt(void);			/* stop SCC */
 const char *eth_get_name(void);		/* get name of current device */
 int eth_mcast_join(struct in_addr mcast_addr, int join);
@@ -516,6 +587,8 @@ extern char	net_boot_file_name[1024];/* Boot File name */
 extern bool	net_boot_file_name_explicit;
 /* The actual transferred size of the bootfile (in bytes) */
 extern u32	net_boot_file_size;
+/* Bytes of the boot file received straight into place */
+extern ulong	net_boot_file_in_place;
 /* Boot file size in blocks as reported by the DHCP server */
 extern u32	net_boot_file_expected_size_in_blocks;
 
@@ -553,6 +626,35 @@ extern int net_ntp_time_offset;			/* offset time from UTC */
 int net_init(void);
 int net_loop(enum proto_t);
 
+/**
+ * struct net_get - a file to fetch with net_get_files()
+ *
+ * @proto: TFTPGET or WGET
+ * @name: Name of the file, as given to the tftpboot or wget command
+ * @addr: Address to load the file to
+ * @size: Returns the size of the file, or -ve error if it was not fetched
+ */
+struct net_get {
+	enum proto_t proto;
+	const char *name;
+	ulong addr;
+	long size;
+};
+
+/**
+ * net_get_files() - fetch several files one after the other
+ *
+ * The files are fetched one after the other within a single net_loop(), so
+ * the network device is started once and each transfer starts as soon as the
+ * one before it completes. A file that cannot be fetched does not stop the
+ * others.
+ *
+ * @files: Files to fetch, each with its size or error filled in on return
+ * @count: Number of files
+ * Return: 0 if all the files were fetched, -EIO if any was not
+ */
+int net_get_files(struct net_get *files, int count);
+
 /* Load failed.	 Start again. */
 int net_start_again(void);
 
@@ -749,6 +851,25 @@ static inline void net_copy_u32(void *to, void *from)
 	memcpy((void *)to, (void *)from, sizeof(u32));
 }
 
+/**
+ * net_store_payload() - put received payload at its destination
+ *
+ * Nothing is copied when the packet was received in place, see
+ * eth_rx_place(). If its headers were not the length expected, the payload
+ * is near its destination and moved there.
+ *
+ * @dst: Destination
+ * @src: Payload in the packet received
+ * @len: Number of bytes
+ */
+static inline void net_store_payload(void *dst, const void *src, int len)
+{
+	if (dst == src)
+		net_boot_file_in_place += len;
+	else
+		memmove(dst, src, len);
+}
+
 /**
  * is_zero_ethaddr - Determine if give Ethernet address is all zeros.
  * @addr: Pointer to a six-byte array containing the Ethernet address
@@ -68,9 +68,6 @@ struct ip_tcp_hdr {
  * TCP header options, Seq, MSS, and SACK
  */
 
-#define TCP_SACK 32			/* Number of packets analyzed   */
-					/* on leading edge of stream    */
-
 #define TCP_O_END	0x00		/* End of option list		*/
 #define TCP_1_NOP	0x01		/* Single padding NOP		*/
 #define TCP_O_NOP	0x01010101	/* NOPs pad to 32 bit boundary	*/
@@ -86,7 +83,10 @@ struct ip_tcp_hdr {
 #define TCP_OPT_LEN_8	0x08
 #define TCP_OPT_LEN_A	0x0a		/* Timestamp Length		*/
 #define TCP_MSS		1460		/* Max segment size		*/
-#define TCP_SCALE	0x01		/* Scale			*/
+#define TCP_SCALE	0x07		/* Scale, for windows to 8 MiB	*/
+
+#define TCP_RCV_WND_INIT (PKTBUFSRX * TCP_MSS)	/* First receive window	*/
+#define TCP_ACK_EVERY	2		/* Segments per delayed ACK	*/
 
 /**
  * struct tcp_mss - TCP option structure for MSS (Max segment size)
@@ -143,6 +143,7 @@ struct sack_edges {
  */
 
 #define TCP_SACK_HILLS	4
+#define TCP_SACK_BLOCKS	3		/* Blocks sent, with timestamps	*/
 
 /**
  * struct tcp_sack_v - TCP option structure for SACK
@@ -279,6 +280,8 @@ enum tcp_state {
 
 enum tcp_state tcp_get_tcp_state(void);
 void tcp_set_tcp_state(enum tcp_state new_state);
+u32 tcp_get_ack_edge(void);
+u32 tcp_get_gap_end(void);
 int tcp_set_tcp_header(uchar *pkt, int dport, int sport, int payload_len,
 		       u8 action, u32 tcp_seq_num, u32 tcp_ack_num);
 
@@ -300,6 +303,7 @@ typedef void rxhand_tcp(uchar *pkt, u16 dport,
 void tcp_set_tcp_handler(rxhand_tcp *f);
 
 void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int len);
+void tcp_ack_flush(void);
 
 u16 tcp_set_pseudo_header(uchar *pkt, struct in_addr src, struct in_addr dest,
 			  int tcp_len, int pkt_len);
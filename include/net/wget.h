@@ -19,4 +19,5 @@ enum wget_state {
 #define DEBUG_WGET		0	/* Set to 1 for debug messages */
 #define SERVER_PORT		80
 #define WGET_RETRY_COUNT	30
+#define WGET_RECONNECT_COUNT	5	/* Resumes of one download */
 #define WGET_TIMEOUT		2000UL
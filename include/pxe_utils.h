@@ -83,6 +83,29 @@ struct pxe_context;
 typedef int (*pxe_getfile_func)(struct pxe_context *ctx, const char *file_path,
 				char *file_addr, ulong *filesizep);
 
+/* Most files of a label prefetched: kernel, initrd and FDT */
+#define PXE_PREFETCH_MAX	3
+
+/**
+ * struct pxe_prefetch - a file of a label fetched before it is needed
+ *
+ * @path: Path to the file, including the boot directory. This is allocated
+ * @addr: Address the file is loaded to
+ * @max_size: Most bytes the file may take, so as not to reach the next file
+ *	fetched with it
+ * @size: Size of the file in bytes, or -ve error if it was not fetched
+ *	(-ENOSPC if it is larger than @max_size)
+ */
+struct pxe_prefetch {
+	char *path;
+	ulong addr;
+	ulong max_size;
+	long size;
+};
+
+typedef int (*pxe_getfiles_func)(struct pxe_context *ctx,
+				 struct pxe_prefetch *files, int count);
+
 /**
  * struct pxe_context - context information for PXE parsing
  *
@@ -94,6 +117,11 @@ typedef int (*pxe_getfile_func)(struct pxe_context *ctx, const char *file_path,
  *	allocated
  * @pxe_file_size: Size of the PXE file
  * @use_ipv6: TRUE : use IPv6 addressing, FALSE : use IPv4 addressing
+ * @getfiles: Function called by PXE to read the files of a label in a row, so
+ *	that those read over the network come in one session. The files it
+ *	fetches are then not read again with @getfile - optional
+ * @prefetch: Files of the label being booted fetched with @getfiles
+ * @prefetch_count: Number of files in @prefetch
  */
 struct pxe_context {
 	struct cmd_tbl *cmdtp;
@@ -114,6 +142,9 @@ struct pxe_context {
 	char *bootdir;
 	ulong pxe_file_size;
 	bool use_ipv6;
+	pxe_getfiles_func getfiles;
+	struct pxe_prefetch prefetch[PXE_PREFETCH_MAX];
+	int prefetch_count;
 };
 
 /**
@@ -14,11 +14,19 @@
  * @label: Label for this device (allocated)
  * @filename: Name of file this is attached to, or NULL (allocated)
  * @fd: File descriptor of file, or 0 for none (file is not open)
+ * @read_count: Number of reads sent to the file, for testing
+ * @write_count: Number of writes sent to the file, for testing
+ * @poll_stall: true to have asynchronous requests never finish, for testing
+ * @poll_err: Error for the next poll of asynchronous requests, for testing
  */
 struct host_sb_plat {
 	char *label;
 	char *filename;
 	int fd;
+	uint read_count;
+	uint write_count;
+	bool poll_stall;
+	int poll_err;
 };
 
 /**
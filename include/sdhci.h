@@ -355,6 +355,7 @@ struct sdhci_host {
 #if CONFIG_IS_ENABLED(MMC_SDHCI_ADMA)
 	struct sdhci_adma_desc *adma_desc_table;
 #endif
+	ulong data_start;	/* Time a background data transfer started */
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
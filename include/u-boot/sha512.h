@@ -25,6 +25,23 @@ void sha512_finish(sha512_context * ctx, uint8_t digest[SHA512_SUM_LEN]);
 void sha512_csum_wd(const unsigned char *input, unsigned int ilen,
 		unsigned char *output, unsigned int chunk_sz);
 
+/**
+ * sha512_process() - Run the SHA-512 transform over whole blocks
+ *
+ * This is weak so that an architecture can provide a faster version. It is
+ * also used for SHA-384.
+ *
+ * @ctx:	Hash context, whose state is updated
+ * @data:	Input data
+ * @blocks:	Number of SHA512_BLOCK_SIZE blocks in @data
+ */
+void sha512_process(sha512_context *ctx, const unsigned char *data,
+		    unsigned int blocks);
+
+/* Portable C version of sha512_process(), for a fallback */
+void sha512_generic_process(sha512_context *ctx, const unsigned char *data,
+			    unsigned int blocks);
+
 extern const uint8_t sha384_der_prefix[];
 
 void sha384_starts(sha512_context * ctx);
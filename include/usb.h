@@ -655,11 +655,14 @@ struct usb_dev_plat {
  *		so this will be false.
  * @companion:  True if this is a companion controller to another USB
  *		controller
+ * @scan_err:	Result of enumerating the root hub, kept until the
+ *		outcome of the scan is reported
  */
 struct usb_bus_priv {
 	int next_addr;
 	bool desc_before_addr;
 	bool companion;
+	int scan_err;
 };
 
 /**
@@ -806,6 +809,45 @@ struct dm_usb_ops {
 	 * driver to do just that.
 	 */
 	int (*lock_async)(struct udevice *udev, int lock);
+
+	/**
+	 * alloc_streams() - Set up bulk streams on endpoints (XHCI)
+	 *
+	 * Give each of the bulk endpoints in @pipes the same number of
+	 * streams, so that transfers can be queued on them with
+	 * bulk_stream(). Stream IDs count from 1. This may set up fewer
+	 * streams than asked for, as limited by the controller and the
+	 * endpoints' SuperSpeed companion descriptors.
+	 *
+	 * @pipes:	Bulk pipes of the endpoints to set up
+	 * @num_pipes:	Number of @pipes
+	 * @num_streams: Number of streams wanted
+	 * @return number of streams set up, or -ve on error
+	 */
+	int (*alloc_streams)(struct udevice *bus, struct usb_device *udev,
+			     unsigned long *pipes, int num_pipes,
+			     unsigned int num_streams);
+
+	/**
+	 * free_streams() - Remove the streams set up by alloc_streams()
+	 *
+	 * @pipes:	Bulk pipes of the endpoints, as passed to alloc_streams()
+	 * @num_pipes:	Number of @pipes
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*free_streams)(struct udevice *bus, struct usb_device *udev,
+			    unsigned long *pipes, int num_pipes);
+
+	/**
+	 * bulk_stream() - Send a bulk message on a stream
+	 *
+	 * This works like bulk(), on an endpoint set up by alloc_streams().
+	 *
+	 * @stream_id:	Stream to use, from 1
+	 */
+	int (*bulk_stream)(struct udevice *bus, struct usb_device *udev,
+			   unsigned long pipe, unsigned int stream_id,
+			   void *buffer, int length);
 };
 
 #define usb_get_ops(dev)	((struct dm_usb_ops *)(dev)->driver->ops)
@@ -938,6 +980,25 @@ bool usb_device_has_child_on_port(struct usb_device *parent, int port);
 int usb_hub_probe(struct usb_device *dev, int ifnum);
 void usb_hub_reset(void);
 
+/**
+ * usb_hub_scan_begin() - Start scanning several USB buses at once
+ *
+ * Until usb_hub_scan_end() is called, configuring a hub only powers on its
+ * ports and queues them for scanning. This lets the root hubs of all
+ * controllers wait for power good and connect debounce at the same time.
+ */
+void usb_hub_scan_begin(void);
+
+/**
+ * usb_hub_scan_end() - Scan all ports queued since usb_hub_scan_begin()
+ *
+ * Polls the queued ports of all hubs until each one has either connected
+ * or timed out. Hubs found on the way are added to the same scan.
+ *
+ * Return: 0 if OK, -ve on error
+ */
+int usb_hub_scan_end(void);
+
 /*
  * usb_find_usb2_hub_address_port() - Get hub address and port for TT setting
  *
@@ -995,6 +1056,48 @@ int usb_update_hub_device(struct usb_device *dev);
  */
 int usb_get_max_xfer_size(struct usb_device *dev, size_t *size);
 
+/**
+ * usb_alloc_streams() - Set up bulk streams on endpoints
+ *
+ * See alloc_streams() in struct dm_usb_ops for details.
+ *
+ * @dev:		USB device
+ * @pipes:		Bulk pipes of the endpoints to set up
+ * @num_pipes:		Number of @pipes
+ * @num_streams:	Number of streams wanted
+ * Return: number of streams set up, -ENOSYS if the controller or the
+ *	   endpoints have no streams, other -ve on error
+ */
+int usb_alloc_streams(struct usb_device *dev, unsigned long *pipes,
+		      int num_pipes, unsigned int num_streams);
+
+/**
+ * usb_free_streams() - Remove the streams set up by usb_alloc_streams()
+ *
+ * @dev:		USB device
+ * @pipes:		Bulk pipes of the endpoints
+ * @num_pipes:		Number of @pipes
+ * Return: 0 if OK, -ve on error
+ */
+int usb_free_streams(struct usb_device *dev, unsigned long *pipes,
+		     int num_pipes);
+
+/**
+ * submit_bulk_stream_msg() - Send a bulk message on a stream
+ *
+ * This works like submit_bulk_msg(), on an endpoint set up by
+ * usb_alloc_streams().
+ *
+ * @dev:		USB device
+ * @pipe:		Bulk pipe to use
+ * @stream_id:		Stream to use, from 1
+ * @buffer:		Data to send, or place to put the data received
+ * @length:		Number of bytes to transfer
+ * Return: 0 if OK, -ve on error
+ */
+int submit_bulk_stream_msg(struct usb_device *dev, unsigned long pipe,
+			   unsigned int stream_id, void *buffer, int length);
+
 /**
  * usb_emul_setup_device() - Set up a new USB device emulation
  *
@@ -1035,6 +1138,41 @@ int usb_emul_control(struct udevice *emul, struct usb_device *udev,
 int usb_emul_bulk(struct udevice *emul, struct usb_device *udev,
 		  unsigned long pipe, void *buffer, int length);
 
+/**
+ * usb_emul_bulk_stream() - Send a bulk packet on a stream to an emulator
+ *
+ * @emul:	Emulator device
+ * @udev:	USB device (which the emulator is causing to appear)
+ * See struct dm_usb_ops for details on other parameters
+ * Return: 0 if OK, -ve on error
+ */
+int usb_emul_bulk_stream(struct udevice *emul, struct usb_device *udev,
+			 unsigned long pipe, unsigned int stream_id,
+			 void *buffer, int length);
+
+/**
+ * usb_emul_alloc_streams() - Ask an emulator to set up bulk streams
+ *
+ * @emul:	Emulator device
+ * @udev:	USB device (which the emulator is causing to appear)
+ * See struct dm_usb_ops for details on other parameters
+ * Return: number of streams set up, or -ve on error
+ */
+int usb_emul_alloc_streams(struct udevice *emul, struct usb_device *udev,
+			   unsigned long *pipes, int num_pipes,
+			   unsigned int num_streams);
+
+/**
+ * usb_emul_free_streams() - Ask an emulator to remove its bulk streams
+ *
+ * @emul:	Emulator device
+ * @udev:	USB device (which the emulator is causing to appear)
+ * See struct dm_usb_ops for details on other parameters
+ * Return: 0 if OK, -ve on error
+ */
+int usb_emul_free_streams(struct udevice *emul, struct usb_device *udev,
+			  unsigned long *pipes, int num_pipes);
+
 /**
  * usb_emul_int() - Send an interrupt packet to an emulator
  *
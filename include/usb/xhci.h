@@ -627,6 +627,25 @@ struct xhci_ep_ctx {
 /* Endpoint is set up with a Linear Stream Array (vs. Secondary Stream Array) */
 #define	EP_HAS_LSA			(1 << 15)
 
+/**
+ * struct xhci_stream_ctx
+ * @stream_ring:	64-bit stream ring address, cycle state, and stream
+ *			context type
+ *
+ * Stream Context - section 6.2.4. The endpoint dequeue pointer points to an
+ * array of these when the endpoint has streams. Entry 0 is reserved.
+ */
+struct xhci_stream_ctx {
+	__le64	stream_ring;
+	/* offset 0x08 - 0x0f reserved for HC internal use */
+	__le32	reserved[2];
+};
+
+/* Stream Context Type - bits 3:1 of the stream ring address */
+#define SCT_FOR_CTX(p)		(((p) & 0x7) << 1)
+/* Primary stream array type, dequeue pointer is to a transfer ring */
+#define SCT_PRI_TR		1
+
 /* ep_info2 bitmasks */
 /*
  * Force Event - generate transfer events for all TRBs for this endpoint
@@ -1059,6 +1078,11 @@ struct xhci_scratchpad {
 
 struct xhci_virt_ep {
 	struct xhci_ring		*ring;
+	/* Stream context array and rings, when the endpoint has streams */
+	struct xhci_stream_ctx		*stream_ctx;
+	dma_addr_t			stream_ctx_dma;
+	struct xhci_ring		**stream_rings;
+	unsigned int			num_stream_ctxs;
 	unsigned int			ep_state;
 #define SET_DEQ_PENDING		(1 << 0)
 #define EP_HALTED		(1 << 1)	/* For stall handling */
@@ -1259,6 +1283,8 @@ void xhci_acknowledge_event(struct xhci_ctrl *ctrl);
 union xhci_trb *xhci_wait_for_event(struct xhci_ctrl *ctrl, trb_type expected);
 int xhci_bulk_tx(struct usb_device *udev, unsigned long pipe,
 		 int length, void *buffer);
+int xhci_bulk_tx_stream(struct usb_device *udev, unsigned long pipe,
+			unsigned int stream_id, int length, void *buffer);
 int xhci_ctrl_tx(struct usb_device *udev, unsigned long pipe,
 		 struct devrequest *req, int length, void *buffer);
 int xhci_check_maxpacket(struct usb_device *udev);
@@ -1268,6 +1294,9 @@ void xhci_cleanup(struct xhci_ctrl *ctrl);
 struct xhci_ring *xhci_ring_alloc(struct xhci_ctrl *ctrl, unsigned int num_segs,
 				  bool link_trbs);
 int xhci_alloc_virt_device(struct xhci_ctrl *ctrl, unsigned int slot_id);
+void xhci_alloc_stream_rings(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep,
+			     unsigned int num_stream_ctxs);
+void xhci_free_stream_rings(struct xhci_ctrl *ctrl, struct xhci_virt_ep *ep);
 int xhci_mem_init(struct xhci_ctrl *ctrl, struct xhci_hccr *hccr,
 		  struct xhci_hcor *hcor);
 
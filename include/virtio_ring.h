@@ -63,6 +63,8 @@ struct vring_desc_shadow {
 	u16 next;
 	/* Metadata about the descriptor. */
 	bool chain_head;
+	/* Caller's first buffer, handed back by virtqueue_get_buf() */
+	void *data;
 };
 
 struct vring_avail {
@@ -103,6 +105,7 @@ struct vring {
  * @vring: actual memory layout for this queue
  * @vring_desc_shadow: guest-only copy of descriptors
  * @event: host publishes avail event idx
+ * @indirect: buffers may be added through a table of indirect descriptors
  * @free_head: head of free buffer list
  * @num_added: number we've added since last sync
  * @last_used_idx: last used index we've seen
@@ -117,6 +120,7 @@ struct virtqueue {
 	struct vring vring;
 	struct vring_desc_shadow *vring_desc_shadow;
 	bool event;
+	bool indirect;
 	unsigned int free_head;
 	unsigned int num_added;
 	u16 last_used_idx;
@@ -195,6 +199,31 @@ struct virtio_sg;
 int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sgs[],
 		  unsigned int out_sgs, unsigned int in_sgs);
 
+/**
+ * virtqueue_add_indirect - expose buffers to other end, using one descriptor
+ *
+ * @vq:		the struct virtqueue we're talking about
+ * @sgs:	array of terminated scatterlists
+ * @out_sgs:	the number of scatterlists readable by other side
+ * @in_sgs:	the number of scatterlists which are writable
+ *		(after readable ones)
+ * @table:	indirect descriptor table with room for @out_sgs + @in_sgs
+ *		entries, which must stay untouched until the buffers are used
+ *
+ * This works like virtqueue_add(), but the buffers are described in @table
+ * and take a single descriptor of the ring, so that many more fit. If the
+ * queue cannot use indirect descriptors (see @indirect in struct virtqueue),
+ * this falls back to virtqueue_add() and @table is not used.
+ *
+ * Caller must ensure we don't call this with other virtqueue operations
+ * at the same time (except where noted).
+ *
+ * Returns zero or a negative error (ie. ENOSPC, ENOMEM, EIO).
+ */
+int virtqueue_add_indirect(struct virtqueue *vq, struct virtio_sg *sgs[],
+			   unsigned int out_sgs, unsigned int in_sgs,
+			   struct vring_desc *table);
+
 /**
  * virtqueue_kick - update after add_buf
  *
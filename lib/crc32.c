@@ -31,6 +31,18 @@
 
 #define tole(x) cpu_to_le32(x)
 
+/*
+ * Slicing-by-8 needs 7KiB of extra tables, so it is left out of SPL. The
+ * tables are only laid out for little-endian machines.
+ */
+#if defined(CONFIG_ARM64_CRC32) || __BYTE_ORDER != __LITTLE_ENDIAN
+#define CRC_SLICE_BY_8 0
+#elif defined(USE_HOSTCC)
+#define CRC_SLICE_BY_8 1
+#else
+#define CRC_SLICE_BY_8 CONFIG_IS_ENABLED(CRC32_SLICE_BY_8)
+#endif
+
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
 
 static int __efi_runtime_data crc_table_empty = 1;
@@ -157,6 +169,35 @@ tole(0xb40bbe37L), tole(0xc30c8ea1L), tole(0x5a05df1bL), tole(0x2d02ef8dL)
 };
 #endif
 
+#if CRC_SLICE_BY_8
+/*
+ * Tables for slicing-by-8: crc_slice_table[k][n] is the CRC of byte n
+ * followed by k + 1 zero bytes, so that eight bytes can be folded into the
+ * CRC with independent lookups. Built from crc_table on first use.
+ */
+static int __efi_runtime_data crc_slice_table_empty = 1;
+static uint32_t __efi_runtime_data crc_slice_table[7][256];
+
+static void __efi_runtime make_crc_slice_table(void)
+{
+  uint32_t c;
+  int n, k;
+
+#ifdef CONFIG_DYNAMIC_CRC_TABLE
+  if (crc_table_empty)
+    make_crc_table();
+#endif
+  for (n = 0; n < 256; n++) {
+    c = crc_table[n];
+    for (k = 0; k < 7; k++) {
+      c = crc_table[c & 255] ^ (c >> 8);
+      crc_slice_table[k][n] = c;
+    }
+  }
+  crc_slice_table_empty = 0;
+}
+#endif
+
 #if 0
 /* =========================================================================
  * This function can be used by asm versions of crc32()
@@ -185,7 +226,17 @@ const uint32_t * ZEXPORT get_crc_table()
 uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 {
 #ifdef CONFIG_ARM64_CRC32
+    const uint64_t *w;
+
     crc = cpu_to_le32(crc);
+    while (len && ((long)buf & 7)) {
+        crc = __builtin_aarch64_crc32b(crc, *buf++);
+        len--;
+    }
+    /* 8 bytes per instruction for the aligned middle */
+    for (w = (const uint64_t *)buf; len >= 8; len -= 8)
+        crc = __builtin_aarch64_crc32x(crc, le64_to_cpu(*w++));
+    buf = (const Bytef *)w;
     while (len--)
         crc = __builtin_aarch64_crc32b(crc, *buf++);
     return le32_to_cpu(crc);
@@ -196,6 +247,10 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 #ifdef CONFIG_DYNAMIC_CRC_TABLE
     if (crc_table_empty)
       make_crc_table();
+#endif
+#if CRC_SLICE_BY_8
+    if (crc_slice_table_empty)
+      make_crc_slice_table();
 #endif
     crc = cpu_to_le32(crc);
     /* Align it */
@@ -207,6 +262,23 @@ uint32_t __efi_runtime crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#if CRC_SLICE_BY_8
+    /* 8 bytes at a time, one table lookup per byte without a dependency */
+    for (; len >= 8; len -= 8) {
+	 uint32_t one = *b++ ^ crc;
+	 uint32_t two = *b++;
+
+	 crc = crc_slice_table[6][one & 255] ^
+	       crc_slice_table[5][(one >> 8) & 255] ^
+	       crc_slice_table[4][(one >> 16) & 255] ^
+	       crc_slice_table[3][one >> 24] ^
+	       crc_slice_table[2][two & 255] ^
+	       crc_slice_table[1][(two >> 8) & 255] ^
+	       crc_slice_table[0][(two >> 16) & 255] ^
+	       tab[two >> 24];
+    }
+#endif
+
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
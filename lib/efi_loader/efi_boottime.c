@@ -6,6 +6,7 @@
  */
 
 #include <common.h>
+#include <blk.h>
 #include <bootm.h>
 #include <div64.h>
 #include <dm/device.h>
@@ -2173,6 +2174,7 @@ static efi_status_t EFIAPI efi_exit_boot_services(efi_handle_t image_handle,
 			list_del(&evt->link);
 	}
 
+	blk_flush_all();
 	if (!efi_st_keep_devices) {
 		bootm_disable_interrupts();
 		if (IS_ENABLED(CONFIG_USB_DEVICE))
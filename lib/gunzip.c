@@ -308,3 +308,63 @@ int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 
 	return err;
 }
+
+int gunzip_stream(void *dst, int dstlen, unsigned char *src,
+		  unsigned long *lenp, ulong chunk,
+		  int (*update)(void *priv, const void *buf, ulong size),
+		  void *priv)
+{
+	unsigned long len = *lenp, done = 0, now;
+	z_stream s;
+	int offset, err = 0;
+	int r;
+
+	offset = gzip_parse_header(src, len);
+	if (offset < 0)
+		return offset;
+
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+
+	r = inflateInit2(&s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		return -1;
+	}
+	s.next_in = src + offset;
+	s.avail_in = 0;
+	s.next_out = dst;
+	s.avail_out = dstlen;
+
+	/*
+	 * Hand each chunk to update() and then to inflate() while it is still
+	 * in the cache. Whatever follows the deflate stream (the gzip trailer
+	 * and any padding) is only passed to update().
+	 */
+	while (done < len) {
+		now = min(chunk, len - done);
+		err = update(priv, src + done, now);
+		if (err)
+			break;
+		done += now;
+		if (r == Z_STREAM_END || done <= offset)
+			continue;
+
+		s.avail_in = src + done - s.next_in;
+		r = inflate(&s, done == len ? Z_FINISH : Z_NO_FLUSH);
+		if (r != Z_OK && r != Z_STREAM_END) {
+			printf("Error: inflate() returned %d\n", r);
+			err = -1;
+			break;
+		}
+		schedule();
+	}
+	if (!err && r != Z_STREAM_END) {
+		printf("Error: inflate() returned %d\n", r);
+		err = -1;
+	}
+	*lenp = s.next_out - (unsigned char *)dst;
+	inflateEnd(&s);
+
+	return err;
+}
@@ -74,26 +74,72 @@ static long lmb_addrs_adjacent(phys_addr_t base1, phys_size_t size1,
 	return 0;
 }
 
-static long lmb_regions_adjacent(struct lmb_region *rgn, unsigned long r1,
-				 unsigned long r2)
+/*
+ * Find the first region which ends at or above @addr, which is the only one
+ * that can hold @addr, or rgn->cnt if there is none. The regions are sorted and
+ * do not overlap, so their ends are sorted too.
+ */
+static unsigned long lmb_find_region(struct lmb_region *rgn, phys_addr_t addr)
 {
-	phys_addr_t base1 = rgn->region[r1].base;
-	phys_size_t size1 = rgn->region[r1].size;
-	phys_addr_t base2 = rgn->region[r2].base;
-	phys_size_t size2 = rgn->region[r2].size;
+	unsigned long lo = 0, hi = rgn->cnt;
 
-	return lmb_addrs_adjacent(base1, size1, base2, size2);
+	while (lo < hi) {
+		unsigned long mid = lo + (hi - lo) / 2;
+		struct lmb_property *r = &rgn->region[mid];
+
+		if (r->base + r->size - 1 < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
 }
 
-static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
+/* Make room for one more region, moving to a larger array if this one is full */
+static int lmb_grow_region(struct lmb_region *rgn)
 {
-	unsigned long i;
+	struct lmb_property *region;
+	unsigned long max;
 
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
-		rgn->region[i].flags = rgn->region[i + 1].flags;
-	}
+	if (rgn->cnt < rgn->max)
+		return 0;
+
+	max = rgn->max ? rgn->max * 2 : 8;
+	region = malloc(max * sizeof(*region));
+	if (!region)
+		return -ENOMEM;
+	memcpy(region, rgn->region, rgn->cnt * sizeof(*region));
+	if (rgn->alloced)
+		free(rgn->region);
+	rgn->region = region;
+	rgn->max = max;
+	rgn->alloced = true;
+
+	return 0;
+}
+
+static long lmb_insert_region(struct lmb_region *rgn, unsigned long r,
+			      phys_addr_t base, phys_size_t size,
+			      enum lmb_flags flags)
+{
+	if (lmb_grow_region(rgn))
+		return -1;
+
+	memmove(&rgn->region[r + 1], &rgn->region[r],
+		(rgn->cnt - r) * sizeof(*rgn->region));
+	rgn->region[r].base = base;
+	rgn->region[r].size = size;
+	rgn->region[r].flags = flags;
+	rgn->cnt++;
+
+	return 0;
+}
+
+static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
+{
+	memmove(&rgn->region[r], &rgn->region[r + 1],
+		(rgn->cnt - r - 1) * sizeof(*rgn->region));
 	rgn->cnt--;
 }
 
@@ -107,19 +153,25 @@ static void lmb_coalesce_regions(struct lmb_region *rgn, unsigned long r1,
 
 void lmb_init(struct lmb *lmb)
 {
-#if IS_ENABLED(CONFIG_LMB_USE_MAX_REGIONS)
-	lmb->memory.max = CONFIG_LMB_MAX_REGIONS;
-	lmb->reserved.max = CONFIG_LMB_MAX_REGIONS;
-#else
-	lmb->memory.max = CONFIG_LMB_MEMORY_REGIONS;
-	lmb->reserved.max = CONFIG_LMB_RESERVED_REGIONS;
+	lmb->memory.max = LMB_MEMORY_REGIONS;
+	lmb->reserved.max = LMB_RESERVED_REGIONS;
 	lmb->memory.region = lmb->memory_regions;
 	lmb->reserved.region = lmb->reserved_regions;
-#endif
+	lmb->memory.alloced = false;
+	lmb->reserved.alloced = false;
 	lmb->memory.cnt = 0;
 	lmb->reserved.cnt = 0;
 }
 
+void lmb_uninit(struct lmb *lmb)
+{
+	if (lmb->memory.alloced)
+		free(lmb->memory.region);
+	if (lmb->reserved.alloced)
+		free(lmb->reserved.region);
+	lmb_init(lmb);
+}
+
 void arch_lmb_reserve_generic(struct lmb *lmb, ulong sp, ulong end, ulong align)
 {
 	ulong bank_end;
@@ -231,88 +283,51 @@ void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
 static long lmb_add_region_flags(struct lmb_region *rgn, phys_addr_t base,
 				 phys_size_t size, enum lmb_flags flags)
 {
+	struct lmb_property *prev = NULL, *next = NULL;
 	unsigned long coalesced = 0;
-	long adjacent, i;
-
-	if (rgn->cnt == 0) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		rgn->region[0].flags = flags;
-		rgn->cnt = 1;
-		return 0;
-	}
+	unsigned long i;
 
-	/* First try and coalesce this LMB with another. */
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		phys_size_t rgnflags = rgn->region[i].flags;
-		phys_addr_t end = base + size - 1;
-		phys_addr_t rgnend = rgnbase + rgnsize - 1;
-
-		if (rgnbase <= base && end <= rgnend) {
-			if (flags == rgnflags)
+	/* Only the regions either side of the new one can overlap or touch it */
+	i = lmb_find_region(rgn, base);
+	if (i > 0)
+		prev = &rgn->region[i - 1];
+	if (i < rgn->cnt) {
+		next = &rgn->region[i];
+		if (next->base <= base &&
+		    base + size - 1 <= next->base + next->size - 1) {
+			if (flags == next->flags)
 				/* Already have this region, so we're done */
 				return 0;
 			else
 				return -1; /* regions with new flags */
 		}
-
-		adjacent = lmb_addrs_adjacent(base, size, rgnbase, rgnsize);
-		if (adjacent > 0) {
-			if (flags != rgnflags)
-				break;
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (adjacent < 0) {
-			if (flags != rgnflags)
-				break;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (lmb_addrs_overlap(base, size, rgnbase, rgnsize)) {
-			/* regions overlap */
+		if (lmb_addrs_overlap(base, size, next->base, next->size))
 			return -1;
-		}
 	}
 
-	if ((i < rgn->cnt - 1) && lmb_regions_adjacent(rgn, i, i + 1)) {
-		if (rgn->region[i].flags == rgn->region[i + 1].flags) {
-			lmb_coalesce_regions(rgn, i, i + 1);
+	/* First try and coalesce this LMB with another. */
+	if (prev && flags == prev->flags &&
+	    lmb_addrs_adjacent(prev->base, prev->size, base, size) > 0) {
+		prev->size += size;
+		coalesced++;
+		if (next && flags == next->flags &&
+		    lmb_addrs_adjacent(prev->base, prev->size, next->base,
+				       next->size) > 0) {
+			lmb_coalesce_regions(rgn, i - 1, i);
 			coalesced++;
 		}
+	} else if (next && flags == next->flags &&
+		   lmb_addrs_adjacent(base, size, next->base, next->size) > 0) {
+		next->base -= size;
+		next->size += size;
+		coalesced++;
 	}
 
 	if (coalesced)
 		return coalesced;
-	if (rgn->cnt >= rgn->max)
-		return -1;
 
 	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i + 1].base = rgn->region[i].base;
-			rgn->region[i + 1].size = rgn->region[i].size;
-			rgn->region[i + 1].flags = rgn->region[i].flags;
-		} else {
-			rgn->region[i + 1].base = base;
-			rgn->region[i + 1].size = size;
-			rgn->region[i + 1].flags = flags;
-			break;
-		}
-	}
-
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		rgn->region[0].flags = flags;
-	}
-
-	rgn->cnt++;
-
-	return 0;
+	return lmb_insert_region(rgn, i, base, size, flags);
 }
 
 static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base,
@@ -336,19 +351,16 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	phys_addr_t end = base + size - 1;
 	int i;
 
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
-
 	/* Find the region where (base, size) belongs to */
-	for (i = 0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size - 1;
+	i = lmb_find_region(rgn, base);
+	if (i == rgn->cnt)
+		return -1;
 
-		if ((rgnbegin <= base) && (end <= rgnend))
-			break;
-	}
+	rgnbegin = rgn->region[i].base;
+	rgnend = rgnbegin + rgn->region[i].size - 1;
 
 	/* Didn't find the region */
-	if (i == rgn->cnt)
+	if (rgnbegin > base || end > rgnend)
 		return -1;
 
 	/* Check to see if we are removing entire region */
@@ -371,12 +383,15 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	}
 
 	/*
-	 * We need to split the entry -  adjust the current one to the
-	 * beginging of the hole and add the region after hole.
+	 * We need to split the entry -  add the region after hole and adjust
+	 * the current one to the beginging of the hole.
 	 */
-	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region_flags(rgn, end + 1, rgnend - end,
-				    rgn->region[i].flags);
+	if (lmb_insert_region(rgn, i + 1, end + 1, rgnend - end,
+			      rgn->region[i].flags))
+		return -1;
+	rgn->region[i].size = base - rgnbegin;
+
+	return 0;
 }
 
 long lmb_reserve_flags(struct lmb *lmb, phys_addr_t base, phys_size_t size,
@@ -397,14 +412,13 @@ static long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
 {
 	unsigned long i;
 
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if (lmb_addrs_overlap(base, size, rgnbase, rgnsize))
-			break;
-	}
+	/* a later region starts above this one, if this one does */
+	i = lmb_find_region(rgn, base);
+	if (i < rgn->cnt && lmb_addrs_overlap(base, size, rgn->region[i].base,
+					      rgn->region[i].size))
+		return i;
 
-	return (i < rgn->cnt) ? i : -1;
+	return -1;
 }
 
 phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
@@ -500,22 +514,20 @@ phys_addr_t lmb_alloc_addr(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 /* Return number of bytes from a given address that are free */
 phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
+	unsigned long i;
 	long rgn;
 
 	/* check if the requested address is in the memory regions */
 	rgn = lmb_overlaps_region(&lmb->memory, addr, 1);
 	if (rgn >= 0) {
-		for (i = 0; i < lmb->reserved.cnt; i++) {
+		i = lmb_find_region(&lmb->reserved, addr);
+		if (i < lmb->reserved.cnt) {
 			if (addr < lmb->reserved.region[i].base) {
 				/* first reserved range > requested address */
 				return lmb->reserved.region[i].base - addr;
 			}
-			if (lmb->reserved.region[i].base +
-			    lmb->reserved.region[i].size > addr) {
-				/* requested addr is in this reserved range */
-				return 0;
-			}
+			/* requested addr is in this reserved range */
+			return 0;
 		}
 		/* if we come here: no reserved ranges above requested addr */
 		return lmb->memory.region[lmb->memory.cnt - 1].base +
@@ -526,14 +538,12 @@ phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 
 int lmb_is_reserved_flags(struct lmb *lmb, phys_addr_t addr, int flags)
 {
-	int i;
+	unsigned long i;
+
+	i = lmb_find_region(&lmb->reserved, addr);
+	if (i < lmb->reserved.cnt && addr >= lmb->reserved.region[i].base)
+		return (lmb->reserved.region[i].flags & flags) == flags;
 
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return (lmb->reserved.region[i].flags & flags) == flags;
-	}
 	return 0;
 }
 
@@ -24,14 +24,21 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Longest headers that can be received ahead of a payload put in place */
+#define ETH_RX_PLACE_HDR_MAX	128
+
 /**
  * struct eth_device_priv - private structure for each Ethernet device
  *
  * @state: The state of the Ethernet MAC driver (defined by enum eth_state_t)
+ * @place: Where the driver is to receive the next packet, buf is NULL if not
+ * @place_saved: What was in memory where the headers of that packet go
  */
 struct eth_device_priv {
 	enum eth_state_t state;
 	bool running;
+	struct eth_rx_place place;
+	u8 place_saved[ETH_RX_PLACE_HDR_MAX];
 };
 
 /**
@@ -347,6 +354,34 @@ int eth_init(void)
 	return ret;
 }
 
+/* Put back what the headers of a packet received in place went over */
+static void eth_rx_place_restore(struct eth_device_priv *priv)
+{
+	struct eth_rx_place *place = &priv->place;
+
+	memcpy(place->buf - place->hdr_len, priv->place_saved, place->hdr_len);
+	place->buf = NULL;
+}
+
+/*
+ * Cancel the place set up for the next packet. A DMA driver may have written
+ * to it already, so it is restored, unless the driver has a packet there which
+ * is still to be processed, see rx_place() in struct eth_ops
+ */
+static int eth_rx_place_cancel(struct udevice *current,
+			       struct eth_device_priv *priv)
+{
+	int ret;
+
+	ret = eth_get_ops(current)->rx_place(current, NULL);
+	if (ret == -EBUSY)
+		return ret;
+	if (priv->place.buf)
+		eth_rx_place_restore(priv);
+
+	return ret;
+}
+
 void eth_halt(void)
 {
 	struct udevice *current;
@@ -360,6 +395,9 @@ void eth_halt(void)
 	if (!priv || !priv->running)
 		return;
 
+	/* a packet received in place is not processed once stopped */
+	if (priv->place.buf && eth_rx_place_cancel(current, priv) == -EBUSY)
+		eth_rx_place_restore(priv);
 	eth_get_ops(current)->stop(current);
 	priv->state = ETH_STATE_PASSIVE;
 	priv->running = false;
@@ -400,8 +438,97 @@ int eth_send(void *packet, int length)
 	return ret;
 }
 
+int eth_rx_place(void *buf, int hdr_len, int len)
+{
+	struct udevice *current;
+	struct eth_device_priv *priv;
+	int ret;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_is_active(current))
+		return -EINVAL;
+
+	if (!eth_get_ops(current)->rx_place)
+		return -ENOSYS;
+
+	priv = dev_get_uclass_priv(current);
+	if (!buf)
+		return eth_rx_place_cancel(current, priv);
+	if (hdr_len > ETH_RX_PLACE_HDR_MAX)
+		return -E2BIG;
+	if (priv->place.buf) {
+		ret = eth_rx_place_cancel(current, priv);
+		if (ret)
+			return ret;
+	}
+
+	/* the headers go over the end of what is before the payload */
+	memcpy(priv->place_saved, buf - hdr_len, hdr_len);
+	priv->place.buf = buf;
+	priv->place.hdr_len = hdr_len;
+	priv->place.len = len;
+	ret = eth_get_ops(current)->rx_place(current, &priv->place);
+	if (ret)
+		priv->place.buf = NULL;
+
+	return ret;
+}
+
+/* Process a packet the driver received in place, see eth_rx_place() */
+static void eth_rx_placed(struct eth_device_priv *priv, uchar *packet,
+			  int len)
+{
+	u8 saved[ETH_RX_PLACE_HDR_MAX];
+	int hdr_len = priv->place.hdr_len;
+
+	/* the packet may have a new place set up while processing it */
+	memcpy(saved, priv->place_saved, hdr_len);
+	priv->place.buf = NULL;
+	net_process_received_packet(packet, len);
+	memcpy(packet, saved, hdr_len);
+}
+
+static void eth_rx_packet(struct udevice *current,
+			  struct eth_device_priv *priv, uchar *packet, int len)
+{
+	if (!priv->place.buf) {
+		net_process_received_packet(packet, len);
+	} else if (packet == priv->place.buf - priv->place.hdr_len) {
+		eth_rx_placed(priv, packet, len);
+	} else {
+		/*
+		 * The place was meant for this packet, so no later packet
+		 * must go there, unless the driver received one there already
+		 */
+		eth_rx_place_cancel(current, priv);
+		net_process_received_packet(packet, len);
+	}
+}
+
+/* Process all the packets the driver has at once, see recv_batch() */
+static int eth_rx_batch(struct udevice *current, struct eth_device_priv *priv)
+{
+	struct eth_rx_pkt pkts[ETH_PACKETS_BATCH_RECV];
+	const struct eth_ops *ops = eth_get_ops(current);
+	int ret;
+	int i;
+
+	ret = ops->recv_batch(current, ETH_RECV_CHECK_DEVICE, pkts,
+			      ETH_PACKETS_BATCH_RECV);
+	for (i = 0; i < ret; i++)
+		eth_rx_packet(current, priv, pkts[i].packet, pkts[i].len);
+	if (ret > 0 && ops->free_batch)
+		ops->free_batch(current, pkts, ret);
+
+	return ret;
+}
+
 int eth_rx(void)
 {
+	struct eth_device_priv *priv;
 	struct udevice *current;
 	uchar *packet;
 	int flags;
@@ -415,25 +542,35 @@ int eth_rx(void)
 	if (!eth_is_active(current))
 		return -EINVAL;
 
-	/* Process up to 32 packets at one time */
-	flags = ETH_RECV_CHECK_DEVICE;
-	for (i = 0; i < ETH_PACKETS_BATCH_RECV; i++) {
-		ret = eth_get_ops(current)->recv(current, flags, &packet);
-		flags = 0;
-		if (ret > 0)
-			net_process_received_packet(packet, ret);
-		if (ret >= 0 && eth_get_ops(current)->free_pkt)
-			eth_get_ops(current)->free_pkt(current, packet, ret);
-		if (ret <= 0)
-			break;
+	priv = dev_get_uclass_priv(current);
+
+	if (eth_get_ops(current)->recv_batch) {
+		ret = eth_rx_batch(current, priv);
+		i = max(ret, 0);
+	} else {
+		/* Process up to 32 packets at one time */
+		flags = ETH_RECV_CHECK_DEVICE;
+		for (i = 0; i < ETH_PACKETS_BATCH_RECV; i++) {
+			ret = eth_get_ops(current)->recv(current, flags,
+							 &packet);
+			flags = 0;
+			if (ret > 0)
+				eth_rx_packet(current, priv, packet, ret);
+			if (ret >= 0 && eth_get_ops(current)->free_pkt)
+				eth_get_ops(current)->free_pkt(current, packet,
+							       ret);
+			if (ret <= 0)
+				break;
+		}
 	}
 	if (ret == -EAGAIN)
 		ret = 0;
 	if (ret < 0) {
 		/* We cannot completely return the error at present */
 		debug("%s: recv() returned error %d\n", __func__, ret);
+		return ret;
 	}
-	return ret;
+	return i;
 }
 
 int eth_initialize(void)
@@ -577,6 +714,12 @@ static int eth_post_probe(struct udevice *dev)
 			ops->write_hwaddr += gd->reloc_off;
 		if (ops->read_rom_hwaddr)
 			ops->read_rom_hwaddr += gd->reloc_off;
+		if (ops->rx_place)
+			ops->rx_place += gd->reloc_off;
+		if (ops->recv_batch)
+			ops->recv_batch += gd->reloc_off;
+		if (ops->free_batch)
+			ops->free_batch += gd->reloc_off;
 
 		reloc_done++;
 	}
@@ -184,9 +184,16 @@ char net_boot_file_name[1024];
 bool net_boot_file_name_explicit;
 /* The actual transferred size of the bootfile (in bytes) */
 u32 net_boot_file_size;
+/* The part of it received straight into place (in bytes) */
+ulong net_boot_file_in_place;
 /* Boot file size in blocks as reported by the DHCP server */
 u32 net_boot_file_expected_size_in_blocks;
 
+/* Files being fetched by net_get_files(), and the one in progress */
+static struct net_get *net_get_list;
+static int net_get_count;
+static int net_get_cur;
+
 static uchar net_pkt_buf[(PKTBUFSRX+1) * PKTSIZE_ALIGN + PKTALIGN];
 /* Receive packets */
 uchar *net_rx_packets[PKTBUFSRX];
@@ -391,6 +398,8 @@ static void net_clear_handlers(void)
 static void net_cleanup_loop(void)
 {
 	net_clear_handlers();
+	/* nothing more may be received into the boot file */
+	eth_rx_place(NULL, 0, 0);
 }
 
 int net_init(void)
@@ -427,10 +436,74 @@ int net_init(void)
  *	Main network processing loop.
  */
 
+/* Set up the file name and load address for file @i of net_get_files() */
+static enum proto_t net_get_setup(int i)
+{
+	struct net_get *get = &net_get_list[i];
+
+	image_load_addr = get->addr;
+	net_boot_file_name_explicit = true;
+	net_boot_file_expected_size_in_blocks = 0;
+	copy_filename(net_boot_file_name, get->name,
+		      sizeof(net_boot_file_name));
+
+	return get->proto;
+}
+
+/*
+ * Record how the current file of net_get_files() went, and set up the next
+ * one. Returns true if there is a next one.
+ */
+static bool net_get_next(long size, enum proto_t *protocol)
+{
+	/* not for a loop run on the way, such as NCSI set-up */
+	if (!net_get_list || *protocol != net_get_list[net_get_cur].proto)
+		return false;
+
+	net_get_list[net_get_cur].size = size;
+	if (++net_get_cur == net_get_count)
+		return false;
+
+	*protocol = net_get_setup(net_get_cur);
+	net_try_count = 1;
+
+	return true;
+}
+
+int net_get_files(struct net_get *files, int count)
+{
+	int ret;
+	int i;
+
+	if (!count)
+		return 0;
+
+	net_get_list = files;
+	net_get_count = count;
+	net_get_cur = 0;
+	ret = net_loop(net_get_setup(0));
+	net_get_list = NULL;
+
+	/* those not reached failed with the loop */
+	for (i = net_get_cur; i < count; i++)
+		files[i].size = ret < 0 ? ret : -EIO;
+
+	for (i = 0; i < count; i++) {
+		if (files[i].size < 0)
+			return -EIO;
+	}
+
+	return 0;
+}
+
 int net_loop(enum proto_t protocol)
 {
 	int ret = -EINVAL;
 	enum net_loop_state prev_net_state = net_state;
+	ulong start_ms = 0;
+	ulong poll_ms = 0;
+	bool poll;
+	int rx = 0;
 
 #if defined(CONFIG_CMD_PING)
 	if (protocol != PING)
@@ -484,7 +557,9 @@ restart:
 
 	switch (net_check_prereq(protocol)) {
 	case 1:
-		/* network not configured */
+		/* network not configured, perhaps just for this file */
+		if (net_get_next(-ENODEV, &protocol))
+			goto restart;
 		eth_halt();
 		net_set_state(prev_net_state);
 		return -ENODEV;
@@ -496,6 +571,8 @@ restart:
 	case 0:
 		net_dev_exists = 1;
 		net_boot_file_size = 0;
+		net_boot_file_in_place = 0;
+		start_ms = get_timer(0);
 		switch (protocol) {
 #ifdef CONFIG_CMD_TFTPBOOT
 		case TFTPGET:
@@ -632,27 +709,36 @@ restart:
 	 *	someone sets `net_state' to a state that terminates.
 	 */
 	for (;;) {
-		schedule();
-		if (arp_timeout_check() > 0)
-			time_start = get_timer(0);
-
-		if (IS_ENABLED(CONFIG_IPV6)) {
-			if (use_ip6 && (ndisc_timeout_check() > 0))
+		/*
+		 *	While packets keep coming in, do the housekeeping
+		 *	at most once a millisecond rather than once a batch.
+		 */
+		poll = rx <= 0 || get_timer(poll_ms);
+		if (poll) {
+			poll_ms = get_timer(0);
+			schedule();
+			if (arp_timeout_check() > 0)
 				time_start = get_timer(0);
+
+			if (IS_ENABLED(CONFIG_IPV6)) {
+				if (use_ip6 && (ndisc_timeout_check() > 0))
+					time_start = get_timer(0);
+			}
 		}
 
 		/*
-		 *	Check the ethernet for a new packet.  The ethernet
-		 *	receive routine will process it.
-		 *	Most drivers return the most recent packet size, but not
-		 *	errors that may have happened.
+		 *	Check the ethernet for new packets.  The ethernet
+		 *	receive routine will process them, and returns how
+		 *	many there were.
 		 */
-		eth_rx();
+		rx = eth_rx();
+		if (IS_ENABLED(CONFIG_PROT_TCP))
+			tcp_ack_flush();
 
 		/*
 		 *	Abort if ctrl-c was pressed.
 		 */
-		if (ctrlc()) {
+		if (poll && ctrlc()) {
 			/* cancel any ARP that may not have completed */
 			net_arp_wait_packet_ip.s_addr = 0;
 
@@ -721,6 +807,15 @@ restart:
 				env_set_hex("filesize", net_boot_file_size);
 				env_set_hex("fileaddr", image_load_addr);
 			}
+			if (net_boot_file_in_place) {
+				printf("Bytes received in place = %lu, %lu KiB/s\n",
+				       net_boot_file_in_place,
+				       net_boot_file_size / 1024 * 1000 /
+				       max(get_timer(start_ms), 1UL));
+			}
+			/* go straight on with the next file, if any */
+			if (net_get_next(net_boot_file_size, &protocol))
+				goto restart;
 			if (protocol != NETCONS && protocol != NCSI)
 				eth_halt();
 			else
@@ -734,6 +829,9 @@ restart:
 
 		case NETLOOP_FAIL:
 			net_cleanup_loop();
+			/* the device was halted, start it again for the next */
+			if (net_get_next(-ENONET, &protocol) && eth_init() >= 0)
+				goto restart;
 			/* Invalidate the last protocol */
 			eth_set_last_protocol(BOOTP);
 			debug_cond(DEBUG_INT_STATE, "--- net_loop Fail!\n");
@@ -22,6 +22,7 @@
 #include <console.h>
 #include <env_internal.h>
 #include <errno.h>
+#include <malloc.h>
 #include <net.h>
 #include <net/tcp.h>
 
@@ -34,25 +35,36 @@ static struct tcp_sack_v tcp_lost;
 static u32 loc_timestamp;
 static u32 rmt_timestamp;
 
-static u32 tcp_seq_init;
 static u32 tcp_ack_edge;
 
 static int tcp_activity_count;
 
 /*
- * Search for TCP_SACK and review the comments before the code section
- * TCP_SACK is the number of packets at the front of the stream
+ * Receive side. Everything up to tcp_ack_edge has arrived; the ranges beyond
+ * it that arrived out of order are kept sorted in rx_ranges[], which grows as
+ * needed. The application places each segment straight into its destination,
+ * so only the sequence numbers are kept here.
  */
+static struct sack_edges *rx_ranges;
+static int rx_nranges;
+static int rx_ranges_size;
+static int rx_last;		/* range of the latest segment, -1 if none */
 
-enum pkt_state {PKT, NOPKT};
-struct sack_r {
-	struct sack_edges se;
-	enum pkt_state st;
-};
+/* Receive window, doubled each time that much has arrived in order */
+static u32 tcp_rcv_wnd = TCP_RCV_WND_INIT;
+static u32 tcp_wnd_edge;	/* the window grows when tcp_ack_edge gets here */
+static u32 tcp_adv_wnd;		/* window as last advertised to the peer */
 
-static struct sack_r edge_a[TCP_SACK];
-static unsigned int sack_idx;
-static unsigned int prev_len;
+/*
+ * Segments received since the last ACK, which is held back until there are
+ * TCP_ACK_EVERY of them or until the received packets have been processed
+ */
+static int tcp_ack_segs;
+
+/* Ports and next sequence number of the last segment the app sent */
+static int tcp_dport;
+static int tcp_sport;
+static u32 tcp_snd_nxt;
 
 /*
  * TCP lengths are stored as a rounded up number of 32 bit words.
@@ -80,6 +92,27 @@ enum tcp_state tcp_get_tcp_state(void)
 	return current_tcp_state;
 }
 
+/**
+ * tcp_get_ack_edge() - get the sequence number expected next
+ *
+ * Return: Sequence number up to which all data has arrived
+ */
+u32 tcp_get_ack_edge(void)
+{
+	return tcp_ack_edge;
+}
+
+/**
+ * tcp_get_gap_end() - get where the data received out of order starts
+ *
+ * Return: Sequence number of the first byte received beyond a gap, the ack
+ * edge if there is no gap
+ */
+u32 tcp_get_gap_end(void)
+{
+	return rx_nranges ? rx_ranges[0].l : tcp_ack_edge;
+}
+
 /**
  * tcp_set_tcp_state() - set current TCP state
  * @new_state: new TCP state
@@ -318,9 +351,18 @@ int tcp_set_tcp_header(uchar *pkt, int dport, int sport, int payload_len,
 	pkt_len	= pkt_hdr_len + payload_len;
 	tcp_len	= pkt_len - IP_HDR_SIZE;
 
-	tcp_ack_edge = tcp_ack_num;
+	/* remember the connection for the ACKs sent from here */
+	if (!(action & TCP_RST)) {
+		tcp_dport = dport;
+		tcp_sport = sport;
+		tcp_snd_nxt = tcp_seq_num + payload_len +
+			(action & (TCP_SYN | TCP_FIN) ? 1 : 0);
+		if ((action & TCP_ACK) && tcp_ack_num == tcp_ack_edge)
+			tcp_ack_segs = 0;
+	}
+
 	/* TCP Header */
-	b->ip.hdr.tcp_ack = htonl(tcp_ack_edge);
+	b->ip.hdr.tcp_ack = htonl(tcp_ack_num);
 	b->ip.hdr.tcp_src = htons(sport);
 	b->ip.hdr.tcp_dst = htons(dport);
 	b->ip.hdr.tcp_seq = htonl(tcp_seq_num);
@@ -340,7 +382,13 @@ int tcp_set_tcp_header(uchar *pkt, int dport, int sport, int payload_len,
 	 * it is, then the u-boot tftp or nfs kernel netboot should be
 	 * considered.
 	 */
-	b->ip.hdr.tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	if (action & TCP_SYN) {
+		tcp_adv_wnd = min(tcp_rcv_wnd, 0xffffU);
+		b->ip.hdr.tcp_win = htons(tcp_adv_wnd);
+	} else {
+		b->ip.hdr.tcp_win = htons(tcp_rcv_wnd >> TCP_SCALE);
+		tcp_adv_wnd = tcp_rcv_wnd >> TCP_SCALE << TCP_SCALE;
+	}
 
 	b->ip.hdr.tcp_xsum = 0;
 	b->ip.hdr.tcp_ugr = 0;
@@ -354,112 +402,145 @@ int tcp_set_tcp_header(uchar *pkt, int dport, int sport, int payload_len,
 	return pkt_hdr_len;
 }
 
+/* Fill the SACK option, the block of the latest segment first */
+static void tcp_sack_update(void)
+{
+	int i, n = 0;
+
+	if (!IS_ENABLED(CONFIG_PROT_TCP_SACK))
+		return;
+
+	if (rx_last >= 0)
+		tcp_lost.hill[n++] = rx_ranges[rx_last];
+	for (i = 0; i < rx_nranges && n < TCP_SACK_BLOCKS; i++) {
+		if (i != rx_last)
+			tcp_lost.hill[n++] = rx_ranges[i];
+	}
+	tcp_lost.len = n ? TCP_OPT_LEN_2 + n * TCP_SACK_SIZE : 0;
+}
+
+/* Start receiving on a new connection, expecting @edge next */
+static void tcp_rx_reset(u32 edge)
+{
+	tcp_ack_edge = edge;
+	rx_nranges = 0;
+	rx_last = -1;
+	tcp_ack_segs = 0;
+	tcp_rcv_wnd = TCP_RCV_WND_INIT;
+	tcp_wnd_edge = edge + tcp_rcv_wnd;
+	tcp_sack_update();
+}
+
+/* Record the out of order range [@l, @r), merging it with its neighbours */
+static void tcp_rx_insert(u32 l, u32 r)
+{
+	struct sack_edges *ranges;
+	int i, j;
+
+	for (i = 0; i < rx_nranges && (s32)(rx_ranges[i].r - l) < 0; i++)
+		;
+	for (j = i; j < rx_nranges && (s32)(rx_ranges[j].l - r) <= 0; j++) {
+		if ((s32)(rx_ranges[j].l - l) < 0)
+			l = rx_ranges[j].l;
+		if ((s32)(rx_ranges[j].r - r) > 0)
+			r = rx_ranges[j].r;
+	}
+
+	if (i == j) {
+		if (rx_nranges == rx_ranges_size) {
+			ranges = realloc(rx_ranges, (rx_ranges_size + 16) *
+					 sizeof(*rx_ranges));
+			/* not recorded: the segment is sent again */
+			if (!ranges)
+				return;
+			rx_ranges = ranges;
+			rx_ranges_size += 16;
+		}
+		memmove(rx_ranges + i + 1, rx_ranges + i,
+			(rx_nranges - i) * sizeof(*rx_ranges));
+		rx_nranges++;
+	} else if (j > i + 1) {
+		memmove(rx_ranges + i + 1, rx_ranges + j,
+			(rx_nranges - j) * sizeof(*rx_ranges));
+		rx_nranges -= j - i - 1;
+	}
+	rx_ranges[i].l = l;
+	rx_ranges[i].r = r;
+	rx_last = i;
+}
+
 /**
- * tcp_hole() - Selective Acknowledgment (Essential for fast stream transfer)
- * @tcp_seq_num: TCP sequence start number
- * @len: the length of sequence numbers
+ * tcp_rx_data() - account for a data segment received
+ * @tcp_seq_num: sequence number of the segment
+ * @len: length of the segment
+ *
+ * An ACK is owed for every segment, and is sent at once when the segment
+ * is a duplicate, leaves or fills a gap, or is the TCP_ACK_EVERY'th since
+ * the last one. The window doubles each time a window's worth of data has
+ * arrived in order, up to CONFIG_PROT_TCP_RX_WINDOW.
+ *
+ * Return: true if the segment carries new data for the application
  */
-void tcp_hole(u32 tcp_seq_num, u32 len)
+static bool tcp_rx_data(u32 tcp_seq_num, u32 len)
 {
-	u32 idx_sack, sack_in;
-	u32 sack_end = TCP_SACK - 1;
-	u32 hill = 0;
-	enum pkt_state expect = PKT;
-	u32 seq = tcp_seq_num - tcp_seq_init;
-	u32 hol_l = tcp_ack_edge - tcp_seq_init;
-	u32 hol_r = 0;
-
-	/* Place new seq number in correct place in receive array */
-	if (prev_len == 0)
-		prev_len = len;
-
-	idx_sack = sack_idx + ((tcp_seq_num - tcp_ack_edge) / prev_len);
-	if (idx_sack < TCP_SACK) {
-		edge_a[idx_sack].se.l = tcp_seq_num;
-		edge_a[idx_sack].se.r = tcp_seq_num + len;
-		edge_a[idx_sack].st = PKT;
+	u32 end = tcp_seq_num + len;
+	bool gap = rx_nranges > 0;
 
-		/*
-		 * The fin (last) packet is not the same length as data
-		 * packets, and if it's length is recorded and used for
-		 *  array index calculation, calculation breaks.
-		 */
-		if (prev_len < len)
-			prev_len = len;
+	tcp_ack_segs++;
+
+	if ((s32)(end - tcp_ack_edge) <= 0) {
+		tcp_ack_segs = TCP_ACK_EVERY;
+		return false;
 	}
 
-	debug_cond(DEBUG_DEV_PKT,
-		   "TCP 1 seq %d, edg %d, len %d, sack_idx %d, sack_end %d\n",
-		    seq, hol_l, len, sack_idx, sack_end);
+	if ((s32)(tcp_seq_num - tcp_ack_edge) > 0) {
+		tcp_ack_segs = TCP_ACK_EVERY;
+		if (tcp_seq_num - tcp_ack_edge >= tcp_rcv_wnd)
+			return false;
+		tcp_rx_insert(tcp_seq_num, end);
+		tcp_sack_update();
+		return true;
+	}
 
-	/* Right edge of contiguous stream, is the left edge of first hill */
-	hol_l = tcp_seq_num - tcp_seq_init;
-	hol_r = hol_l + len;
+	tcp_ack_edge = end;
+	rx_last = -1;
+	while (rx_nranges && (s32)(rx_ranges[0].l - tcp_ack_edge) <= 0) {
+		if ((s32)(rx_ranges[0].r - tcp_ack_edge) > 0)
+			tcp_ack_edge = rx_ranges[0].r;
+		rx_nranges--;
+		memmove(rx_ranges, rx_ranges + 1,
+			rx_nranges * sizeof(*rx_ranges));
+	}
+	if (gap)
+		tcp_ack_segs = TCP_ACK_EVERY;
+
+	if (!rx_nranges && (s32)(tcp_ack_edge - tcp_wnd_edge) >= 0 &&
+	    tcp_rcv_wnd < CONFIG_PROT_TCP_RX_WINDOW) {
+		tcp_rcv_wnd = min(tcp_rcv_wnd * 2,
+				  (u32)CONFIG_PROT_TCP_RX_WINDOW);
+		tcp_wnd_edge = tcp_ack_edge + tcp_rcv_wnd;
+	}
+	tcp_sack_update();
 
-	if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
-		tcp_lost.len = TCP_OPT_LEN_2;
+	return true;
+}
 
-	debug_cond(DEBUG_DEV_PKT,
-		   "TCP 1 in %d, seq %d, pkt_l %d, pkt_r %d, sack_idx %d, sack_end %d\n",
-		   idx_sack, seq, hol_l, hol_r, sack_idx, sack_end);
-
-	for (sack_in = sack_idx; sack_in < sack_end && hill < TCP_SACK_HILLS;
-	     sack_in++)  {
-		switch (expect) {
-		case NOPKT:
-			switch (edge_a[sack_in].st) {
-			case NOPKT:
-				debug_cond(DEBUG_INT_STATE, "N");
-				break;
-			case PKT:
-				debug_cond(DEBUG_INT_STATE, "n");
-				if (IS_ENABLED(CONFIG_PROT_TCP_SACK)) {
-					tcp_lost.hill[hill].l =
-						edge_a[sack_in].se.l;
-					tcp_lost.hill[hill].r =
-						edge_a[sack_in].se.r;
-				}
-				expect = PKT;
-				break;
-			}
-			break;
-		case PKT:
-			switch (edge_a[sack_in].st) {
-			case NOPKT:
-				debug_cond(DEBUG_INT_STATE, "p");
-				if (sack_in > sack_idx &&
-				    hill < TCP_SACK_HILLS) {
-					hill++;
-					if (IS_ENABLED(CONFIG_PROT_TCP_SACK))
-						tcp_lost.len += TCP_OPT_LEN_8;
-				}
-				expect = NOPKT;
-				break;
-			case PKT:
-				debug_cond(DEBUG_INT_STATE, "P");
-
-				if (tcp_ack_edge == edge_a[sack_in].se.l) {
-					tcp_ack_edge = edge_a[sack_in].se.r;
-					edge_a[sack_in].st = NOPKT;
-					sack_idx++;
-				} else {
-					if (IS_ENABLED(CONFIG_PROT_TCP_SACK) &&
-					    hill < TCP_SACK_HILLS)
-						tcp_lost.hill[hill].r =
-							edge_a[sack_in].se.r;
-				if (IS_ENABLED(CONFIG_PROT_TCP_SACK) &&
-				    sack_in == sack_end - 1)
-					tcp_lost.hill[hill].r =
-						edge_a[sack_in].se.r;
-				}
-				break;
-			}
-			break;
-		}
-	}
-	debug_cond(DEBUG_INT_STATE, "\n");
-	if (!IS_ENABLED(CONFIG_PROT_TCP_SACK) || tcp_lost.len <= TCP_OPT_LEN_2)
-		sack_idx = 0;
+static void tcp_send_ack(void)
+{
+	net_send_tcp_packet(0, tcp_dport, tcp_sport, TCP_ACK, tcp_snd_nxt,
+			    tcp_ack_edge);
+}
+
+/**
+ * tcp_ack_flush() - send the ACK held back, if there is one
+ *
+ * Called from net_loop() once the received packets have been processed.
+ */
+void tcp_ack_flush(void)
+{
+	if (tcp_ack_segs && (current_tcp_state == TCP_ESTABLISHED ||
+			     current_tcp_state == TCP_CLOSE_WAIT))
+		tcp_send_ack();
 }
 
 /**
@@ -500,7 +581,22 @@ void tcp_parse_options(uchar *o, int o_len)
 	}
 }
 
-static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
+/*
+ * Only take a reset from the current connection: in SYN_SENT it must
+ * acknowledge our SYN, later its sequence number must be in the receive
+ * window we last advertised. Resets answering segments of an earlier
+ * connection are ignored.
+ */
+static bool tcp_rst_acceptable(u8 tcp_ack, u32 tcp_seq_num, u32 tcp_ack_num)
+{
+	if (current_tcp_state == TCP_SYN_SENT)
+		return tcp_ack && tcp_ack_num == 1;
+
+	return tcp_seq_num - tcp_ack_edge < tcp_adv_wnd;
+}
+
+static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, u32 tcp_ack_num,
+			    int payload_len)
 {
 	u8 tcp_fin = tcp_flags & TCP_FIN;
 	u8 tcp_syn = tcp_flags & TCP_SYN;
@@ -508,7 +604,6 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 	u8 tcp_push = tcp_flags & TCP_PUSH;
 	u8 tcp_ack = tcp_flags & TCP_ACK;
 	u8 action = TCP_DATA;
-	int i;
 
 	/*
 	 * tcp_flags are examined to determine TX action in a given state
@@ -521,6 +616,11 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 	 */
 	debug_cond(DEBUG_INT_STATE, "TCP STATE ENTRY %x\n", action);
 	if (tcp_rst) {
+		if (!tcp_rst_acceptable(tcp_ack, tcp_seq_num, tcp_ack_num)) {
+			debug_cond(DEBUG_INT_STATE, "TCP Reset ignored %x\n",
+				   tcp_flags);
+			return TCP_DATA;
+		}
 		action = TCP_DATA;
 		current_tcp_state = TCP_CLOSED;
 		net_set_state(NETLOOP_FAIL);
@@ -533,8 +633,7 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 		debug_cond(DEBUG_INT_STATE, "TCP CLOSED %x\n", tcp_flags);
 		if (tcp_syn) {
 			action = TCP_SYN | TCP_ACK;
-			tcp_seq_init = tcp_seq_num;
-			tcp_ack_edge = tcp_seq_num + 1;
+			tcp_rx_reset(tcp_seq_num + 1);
 			current_tcp_state = TCP_SYN_RECEIVED;
 		} else if (tcp_ack || tcp_fin) {
 			action = TCP_DATA;
@@ -549,15 +648,9 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 			current_tcp_state = TCP_CLOSE_WAIT;
 		} else if (tcp_ack || (tcp_syn && tcp_ack)) {
 			action |= TCP_ACK;
-			tcp_seq_init = tcp_seq_num;
-			tcp_ack_edge = tcp_seq_num + 1;
-			sack_idx = 0;
-			edge_a[sack_idx].se.l = tcp_ack_edge;
-			edge_a[sack_idx].se.r = tcp_ack_edge;
-			prev_len = 0;
+			if (current_tcp_state == TCP_SYN_SENT)
+				tcp_rx_reset(tcp_seq_num + 1);
 			current_tcp_state = TCP_ESTABLISHED;
-			for (i = 0; i < TCP_SACK; i++)
-				edge_a[i].st = NOPKT;
 
 			if (tcp_syn && tcp_ack)
 				action |= TCP_PUSH;
@@ -567,14 +660,8 @@ static u8 tcp_state_machine(u8 tcp_flags, u32 tcp_seq_num, int payload_len)
 		break;
 	case TCP_ESTABLISHED:
 		debug_cond(DEBUG_INT_STATE, "TCP_ESTABLISHED %x\n", tcp_flags);
-		if (payload_len > 0) {
-			tcp_hole(tcp_seq_num, payload_len);
-			tcp_fin = TCP_DATA;  /* cause standalone FIN */
-		}
-
-		if ((tcp_fin) &&
-		    (!IS_ENABLED(CONFIG_PROT_TCP_SACK) ||
-		     tcp_lost.len <= TCP_OPT_LEN_2)) {
+		/* a FIN is taken once everything before it has arrived */
+		if (tcp_fin && tcp_seq_num == tcp_ack_edge && !rx_nranges) {
 			action = action | TCP_FIN | TCP_PUSH | TCP_ACK;
 			current_tcp_state = TCP_CLOSE_WAIT;
 		} else if (tcp_ack) {
@@ -685,7 +772,7 @@ void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int pkt_len)
 
 	/* Packets are not ordered. Send to app as received. */
 	tcp_action = tcp_state_machine(b->ip.hdr.tcp_flags,
-				       tcp_seq_num, payload_len);
+				       tcp_seq_num, tcp_ack_num, payload_len);
 
 	tcp_activity_count++;
 	if (tcp_activity_count > TCP_ACTIVITY) {
@@ -693,7 +780,23 @@ void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int pkt_len)
 		tcp_activity_count = 0;
 	}
 
-	if ((tcp_action & TCP_PUSH) || payload_len > 0) {
+	/* Only new data goes to the app, which puts it in place */
+	if (payload_len > 0) {
+		switch (current_tcp_state) {
+		case TCP_CLOSED:
+		case TCP_SYN_SENT:
+		case TCP_SYN_RECEIVED:
+			break;
+		default:
+			if (!tcp_rx_data(tcp_seq_num, payload_len) &&
+			    !(tcp_action & TCP_FIN))
+				payload_len = 0;
+		}
+	}
+
+	/* A reset goes to the app, which may open a new connection */
+	if ((tcp_action & TCP_PUSH) || payload_len > 0 ||
+	    tcp_action == TCP_RST) {
 		debug_cond(DEBUG_DEV_PKT,
 			   "TCP Notify (action=%x, Seq=%u,Ack=%u,Pay%d)\n",
 			   tcp_action, tcp_seq_num, tcp_ack_num, payload_len);
@@ -702,6 +805,9 @@ void rxhand_tcp_f(union tcp_build_pkt *b, unsigned int pkt_len)
 				       b->ip.hdr.ip_src, b->ip.hdr.tcp_src, tcp_seq_num,
 				       tcp_ack_num, tcp_action, payload_len);
 
+		if (tcp_ack_segs >= TCP_ACK_EVERY)
+			tcp_ack_flush();
+
 	} else if (tcp_action != TCP_DATA) {
 		debug_cond(DEBUG_DEV_PKT,
 			   "TCP Action (action=%x,Seq=%u,Ack=%u,Pay=%d)\n",
@@ -98,6 +98,25 @@ static ushort	tftp_windowsize;
 static ushort	tftp_next_ack;
 /* Last nack block we send */
 static ushort	tftp_last_nack;
+/* Blocks received ahead of a gap, bit 0 for the next block expected */
+static u64	tftp_held;
+/* Bit in tftp_held of the final block, -1 if it has not arrived */
+static int	tftp_held_end;
+/* Window asked for, adapted to the loss seen by each transfer */
+static ushort	tftp_window_adapt;
+/* Window asked for by the current transfer, 0 if we are not reading */
+static ushort	tftp_window_asked;
+/* Keep blocks within the MTU after a lossy transfer of fragmented ones */
+static bool	tftp_no_frag;
+
+/* Statistics of the current transfer, shown at the end */
+static struct {
+	ulong blocks;		/* blocks received in order or after a gap */
+	ulong early;		/* blocks received ahead of a gap */
+	ulong dups;		/* blocks received more than once */
+	ulong gaps;		/* gaps, each acknowledged once */
+	ulong timeouts;
+} tftp_stats;
 #ifdef CONFIG_CMD_TFTPPUT
 /* 1 if writing, else 0 */
 static int	tftp_put_active;
@@ -118,6 +137,8 @@ static int	tftp_put_final_block_sent;
 
 /* default TFTP block size */
 #define TFTP_BLOCK_SIZE		512
+/* largest block that fits an Ethernet frame without IP fragmentation */
+#define TFTP_MTU_BLOCKSIZE	1468
 #define TFTP_MTU_BLOCKSIZE6 (CONFIG_TFTP_BLOCKSIZE - 20)
 /* sequence number is 16 bit */
 #define TFTP_SEQUENCE_SIZE	((ulong)(1<<16))
@@ -149,6 +170,9 @@ static char tftp_filename[MAX_LEN];
 #define TFTP_WINDOWSIZE 1
 #endif
 
+/* Blocks that can be received ahead of a gap and kept */
+#define TFTP_HELD_MAX		64
+
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = CONFIG_TFTP_BLOCKSIZE;
 static unsigned short tftp_window_size_option = TFTP_WINDOWSIZE;
@@ -175,7 +199,7 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	}
 #endif
 	ptr = map_sysmem(store_addr, len);
-	memcpy(ptr, src, len);
+	net_store_payload(ptr, src, len);
 	unmap_sysmem(ptr);
 
 	if (net_boot_file_size < newsize)
@@ -184,12 +208,35 @@ static inline int store_block(int block, uchar *src, unsigned int len)
 	return 0;
 }
 
+/*
+ * Have the driver receive the next block straight into place. The headers
+ * are expected to be as long as those of the block just received, at @data.
+ */
+static void tftp_place_next(uchar *data)
+{
+	ulong offset = tftp_cur_block * tftp_block_size +
+		       tftp_block_wrap_offset;
+	int hdr_len = data - net_rx_packet;
+
+	if (offset < hdr_len)
+		return;
+#ifdef CONFIG_LMB
+	if (tftp_load_size && offset + tftp_block_size > tftp_load_size)
+		return;
+#endif
+	eth_rx_place(map_sysmem(tftp_load_addr + offset, tftp_block_size),
+		     hdr_len, tftp_block_size);
+}
+
 /* Clear our state ready for a new transfer */
 static void new_transfer(void)
 {
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_held = 0;
+	tftp_held_end = -1;
+	memset(&tftp_stats, '\0', sizeof(tftp_stats));
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -283,6 +330,30 @@ static void update_block_number(void)
 	show_block_marker();
 }
 
+/*
+ * Pick the window and block size for the next transfer from the loss seen
+ * by this one. After a gap the server sends the window again from there, so
+ * the window is halved when more than an eighth of the blocks came twice,
+ * and doubled after a transfer without a gap. When blocks are fragmented,
+ * losing any fragment loses the block, so MTU-sized blocks are tried first.
+ */
+static void tftp_adapt(void)
+{
+	if (!tftp_stats.gaps && !tftp_stats.timeouts) {
+		if (tftp_window_adapt < tftp_window_size_option)
+			tftp_window_adapt = min(tftp_window_adapt * 2,
+						(int)tftp_window_size_option);
+		else
+			tftp_no_frag = false;
+	} else if (tftp_stats.timeouts ||
+		   tftp_stats.dups > tftp_stats.blocks / 8) {
+		if (tftp_block_size > TFTP_MTU_BLOCKSIZE)
+			tftp_no_frag = true;
+		else
+			tftp_window_adapt = max(tftp_window_adapt / 2, 1);
+	}
+}
+
 /* The TFTP get or put is complete */
 static void tftp_complete(void)
 {
@@ -301,6 +372,17 @@ static void tftp_complete(void)
 		print_size(net_boot_file_size /
 			time_start * 1000, "/s");
 	}
+	if (tftp_window_asked) {
+		tftp_adapt();
+		if (tftp_windowsize > 1 || tftp_stats.gaps ||
+		    tftp_stats.timeouts)
+			printf("\n\t %lu blocks of %d, window %d: %lu gaps, %lu early, %lu again, %lu timeouts; next window %d%s",
+			       tftp_stats.blocks, tftp_block_size,
+			       tftp_windowsize, tftp_stats.gaps,
+			       tftp_stats.early, tftp_stats.dups,
+			       tftp_stats.timeouts, tftp_window_adapt,
+			       tftp_no_frag ? ", unfragmented" : "");
+	}
 	puts("\ndone\n");
 	if (IS_ENABLED(CONFIG_CMD_BOOTEFI)) {
 		if (!tftp_put_active)
@@ -362,9 +444,9 @@ static void tftp_send(void)
 		 * Implemented only for tftp get.
 		 * Don't bother sending if it's 1
 		 */
-		if (tftp_state == STATE_SEND_RRQ && tftp_window_size_option > 1)
+		if (tftp_state == STATE_SEND_RRQ && tftp_window_asked > 1)
 			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
-					0, tftp_window_size_option, 0);
+					0, tftp_window_asked, 0);
 		len = pkt - xp;
 		break;
 
@@ -461,6 +543,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	__be16 *s;
 	int i;
 	u16 timeout_val_rcvd;
+	ushort ahead;
+	bool last, gap_filled;
 
 	if (dest != tftp_our_port) {
 			return;
@@ -588,18 +672,36 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			return;
 		len -= 2;
 
-		if (ntohs(*(__be16 *)pkt) != (ushort)(tftp_cur_block + 1)) {
+		ahead = (ushort)(ntohs(*(__be16 *)pkt) - tftp_cur_block - 1);
+		if (ahead) {
 			debug("Received unexpected block: %d, expected: %d\n",
 			      ntohs(*(__be16 *)pkt),
 			      (ushort)(tftp_cur_block + 1));
 			/*
-			 * Only ACK if the block count received is greater than
-			 * the expected block count, otherwise skip ACK.
-			 * (required to properly handle the server retransmitting
-			 *  the window)
+			 * Blocks before the expected one, or kept already,
+			 * come from the server sending a window again.
 			 */
-			if ((ushort)(tftp_cur_block + 1) - (short)(ntohs(*(__be16 *)pkt)) > 0)
+			if ((short)ahead < 0 ||
+			    (ahead < TFTP_HELD_MAX && (tftp_held >> ahead & 1))) {
+				tftp_stats.dups++;
 				break;
+			}
+			/*
+			 * Keep a block that arrives ahead of a gap, so that
+			 * it need not be sent again once the gap is filled.
+			 */
+			if (tftp_state == STATE_DATA && ahead < TFTP_HELD_MAX) {
+				if (store_block(tftp_cur_block + 1 + ahead,
+						pkt + 2, len)) {
+					eth_halt();
+					net_set_state(NETLOOP_FAIL);
+					break;
+				}
+				tftp_held |= 1ULL << ahead;
+				if (len < tftp_block_size)
+					tftp_held_end = ahead;
+				tftp_stats.early++;
+			}
 			/*
 			 * If one packet is dropped most likely
 			 * all other buffers in the window
@@ -611,6 +713,7 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				tftp_last_nack = tftp_cur_block;
 				tftp_next_ack = (ushort)(tftp_cur_block +
 							 tftp_windowsize);
+				tftp_stats.gaps++;
 			}
 			break;
 		}
@@ -655,8 +758,25 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			net_set_state(NETLOOP_FAIL);
 			break;
 		}
+		tftp_stats.blocks++;
+		last = len < tftp_block_size;
+
+		/* the blocks kept ahead of a gap just filled follow on */
+		tftp_held >>= 1;
+		tftp_held_end--;
+		gap_filled = tftp_held & 1;
+		while (tftp_held & 1) {
+			last = !tftp_held_end;
+			tftp_held >>= 1;
+			tftp_held_end--;
+			tftp_cur_block++;
+			tftp_cur_block %= TFTP_SEQUENCE_SIZE;
+			update_block_number();
+			tftp_prev_block = tftp_cur_block;
+			tftp_stats.blocks++;
+		}
 
-		if (len < tftp_block_size) {
+		if (last) {
 			tftp_send();
 			tftp_complete();
 			break;
@@ -664,12 +784,16 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 
 		/*
 		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	the remote for the next one. Once a gap is filled, the
+		 *	acknowledgment has the server go on after the blocks
+		 *	kept, rather than send them again.
 		 */
-		if (tftp_cur_block == tftp_next_ack) {
+		if (tftp_cur_block == tftp_next_ack || gap_filled) {
 			tftp_send();
-			tftp_next_ack += tftp_windowsize;
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
 		}
+		tftp_place_next(pkt + 2);
 		break;
 
 	case TFTP_ERROR:
@@ -705,6 +829,12 @@ static void tftp_timeout_handler(void)
 	} else {
 		puts("T ");
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
+		if (tftp_state == STATE_DATA) {
+			/* the server sends the window again after our ACK */
+			tftp_next_ack = (ushort)(tftp_cur_block +
+						 tftp_windowsize);
+			tftp_stats.timeouts++;
+		}
 		if (tftp_state != STATE_RECV_WRQ)
 			tftp_send();
 	}
@@ -720,6 +850,7 @@ static int tftp_init_load_addr(void)
 	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
 
 	max_size = lmb_get_free_size(&lmb, image_load_addr);
+	lmb_uninit(&lmb);
 	if (!max_size)
 		return -1;
 
@@ -758,7 +889,7 @@ static void sanitize_tftp_block_size_option(enum proto_t protocol)
 		 * (and small enough that it fits net_tx_packet which
 		 * has room for PKTSIZE_ALIGN bytes).
 		 */
-		cap = 1468;
+		cap = TFTP_MTU_BLOCKSIZE;
 	}
 	if (tftp_block_size_option > cap) {
 		printf("Capping tftp block size option to %d (was %d)\n",
@@ -766,6 +897,16 @@ static void sanitize_tftp_block_size_option(enum proto_t protocol)
 		saved_tftp_block_size_option = tftp_block_size_option;
 		tftp_block_size_option = cap;
 	}
+
+	/* fragmented blocks were lost too often last time */
+	if (protocol == TFTPGET && tftp_no_frag &&
+	    tftp_block_size_option > TFTP_MTU_BLOCKSIZE) {
+		debug("TFTP block size %d, to avoid fragments\n",
+		      TFTP_MTU_BLOCKSIZE);
+		if (!saved_tftp_block_size_option)
+			saved_tftp_block_size_option = tftp_block_size_option;
+		tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
+	}
 }
 
 void tftp_start(enum proto_t protocol)
@@ -815,8 +956,12 @@ void tftp_start(enum proto_t protocol)
 
 	sanitize_tftp_block_size_option(protocol);
 
+	if (!tftp_window_adapt || tftp_window_adapt > tftp_window_size_option)
+		tftp_window_adapt = max(tftp_window_size_option, (ushort)1);
+	tftp_window_asked = protocol == TFTPPUT ? 0 : tftp_window_adapt;
+
 	debug("TFTP blocksize = %i, TFTP windowsize = %d timeout = %ld ms\n",
-	      tftp_block_size_option, tftp_window_size_option, timeout_ms);
+	      tftp_block_size_option, tftp_window_asked, timeout_ms);
 
 	if (IS_ENABLED(CONFIG_IPV6))
 		tftp_remote_ip6 = net_server_ip6;
@@ -985,6 +1130,7 @@ void tftp_start_server(void)
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 	tftp_windowsize = 1;
+	tftp_window_asked = 0;
 	tftp_next_ack = tftp_windowsize;
 
 #ifdef CONFIG_TFTP_TSIZE
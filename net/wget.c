@@ -13,147 +13,312 @@
 #include <net.h>
 #include <net/tcp.h>
 #include <net/wget.h>
+#include <linux/ctype.h>
 
-static const char bootfile1[] = "GET ";
-static const char bootfile3[] = " HTTP/1.0\r\n\r\n";
 static const char http_eom[] = "\r\n\r\n";
-static const char http_ok[] = "200";
-static const char content_len[] = "Content-Length";
 static const char linefeed[] = "\r\n";
 static struct in_addr web_server_ip;
 static int our_port;
 static int wget_timeout_count;
 
-struct pkt_qd {
-	uchar *pkt;
-	unsigned int tcp_seq_num;
-	unsigned int len;
-};
+/* Room for the response header */
+#define WGET_HDR_SIZE		4096
 
-/*
- * This is a control structure for out of order packets received.
- * The actual packet bufers are in the kernel space, and are
- * expected to be overwritten by the downloaded image.
- */
-static struct pkt_qd pkt_q[PKTBUFSRX / 4];
-static int pkt_q_idx;
 static unsigned long content_length;
 static unsigned int packets;
 
-static unsigned int initial_data_seq_num;
-
 static enum  wget_state current_wget_state;
 
 static char *image_url;
 static unsigned int wget_timeout = WGET_TIMEOUT;
 
-static enum net_loop_state wget_loop_state;
+/*
+ * Connection. Sequence numbers are kept here rather than taken from the
+ * last segment received, so that every acknowledgment is cumulative.
+ * Segments are acknowledged by the TCP layer, which also keeps track of
+ * those that arrive out of order.
+ */
+static struct in_addr wget_conn_ip;	/* server of the open connection */
+static u32 wget_tx_seq;			/* sequence number of our request */
+static unsigned int wget_req_len;	/* length of our request */
+static u32 wget_rx_seq;			/* sequence number of the response */
+static bool wget_keep_alive;		/* connection can take another request */
+static bool wget_reused;		/* request sent on a kept connection */
+static bool wget_fin;			/* the server closed its side */
+static u32 wget_fin_off;		/* response offset of the server's FIN */
+static int wget_reconnects;
+
+static u32 rx_contig;			/* response bytes received without a gap */
+
+/*
+ * Response header, stored here until it is complete. Data past the end of
+ * wget_hdr goes to memory as if the header were empty, and is moved into
+ * place once the header is parsed.
+ */
+static char wget_hdr[WGET_HDR_SIZE + 1];
+static unsigned int wget_hdr_len;	/* header length, 0 until parsed */
+static unsigned int wget_hdr_end;	/* end of the data in wget_hdr */
+static u32 wget_raw_end;		/* end of the data past wget_hdr */
+static bool wget_chunked;
+
+/* Chunked body decoder, working in place on the raw body in memory */
+enum chunk_state {
+	CHUNK_SIZE,
+	CHUNK_EXT,
+	CHUNK_DATA,
+	CHUNK_DATA_END,
+	CHUNK_TRAILER,
+	CHUNK_DONE
+};
+
+static enum chunk_state chunk_state;
+static ulong chunk_left;		/* size, then bytes left, of the chunk */
+static ulong chunk_raw;			/* raw body bytes decoded */
+static ulong chunk_out;			/* decoded bytes */
+static int chunk_count;			/* characters in the line being read */
 
-/* Timeout retry parameters */
-static u8 retry_action;			/* actions for TCP retry */
-static unsigned int retry_tcp_ack_num;	/* TCP retry acknowledge number*/
-static unsigned int retry_tcp_seq_num;	/* TCP retry sequence number */
-static int retry_len;			/* TCP retry length */
+/*
+ * Resuming. wget_offset is the file offset the response starts at; what
+ * was loaded before a failure is kept for a retry of the same download.
+ */
+static ulong wget_offset;
+static ulong wget_resume_len;
+static ulong wget_resume_addr;
+static char wget_resume_name[sizeof(net_boot_file_name)];
+static char wget_validator[80];		/* ETag or Last-Modified of the file */
 
 /**
  * store_block() - store block in memory
  * @src: source of data
- * @offset: offset
+ * @offset: offset in the response body
  * @len: length
  */
-static inline int store_block(uchar *src, unsigned int offset, unsigned int len)
+static inline void store_block(const uchar *src, ulong offset,
+			       unsigned int len)
 {
-	ulong newsize = offset + len;
 	uchar *ptr;
 
-	ptr = map_sysmem(image_load_addr + offset, len);
-	memcpy(ptr, src, len);
+	ptr = map_sysmem(image_load_addr + wget_offset + offset, len);
+	net_store_payload(ptr, src, len);
 	unmap_sysmem(ptr);
-
-	if (net_boot_file_size < (offset + len))
-		net_boot_file_size = newsize;
-
-	return 0;
 }
 
 /**
- * wget_send_stored() - wget response dispatcher
+ * wget_place_next() - receive the next segment straight into place
+ * @pkt: data of the segment just received in order
+ * @len: its length
  *
- * WARNING, This, and only this, is the place in wget.c where
- * SEQUENCE NUMBERS are swapped between incoming (RX)
- * and outgoing (TX).
- * Procedure wget_handler() is correct for RX traffic.
+ * The next segment is expected to be as long, with headers as long. Any
+ * packet may land in the place, so it stops short of data kept beyond a gap.
  */
-static void wget_send_stored(void)
+static void wget_place_next(uchar *pkt, unsigned int len)
 {
-	u8 action = retry_action;
-	int len = retry_len;
-	unsigned int tcp_ack_num = retry_tcp_seq_num + (len == 0 ? 1 : len);
-	unsigned int tcp_seq_num = retry_tcp_ack_num;
-	uchar *ptr, *offset;
+	ulong offset = rx_contig - wget_hdr_len;
+	int hdr_len = pkt - net_rx_packet;
+	u32 gap = tcp_get_gap_end() - tcp_get_ack_edge();
 
-	switch (current_wget_state) {
-	case WGET_CLOSED:
-		debug_cond(DEBUG_WGET, "wget: send SYN\n");
-		current_wget_state = WGET_CONNECTING;
-		net_send_tcp_packet(0, SERVER_PORT, our_port, action,
-				    tcp_seq_num, tcp_ack_num);
-		packets = 0;
-		break;
-	case WGET_CONNECTING:
-		pkt_q_idx = 0;
-		net_send_tcp_packet(0, SERVER_PORT, our_port, action,
-				    tcp_seq_num, tcp_ack_num);
+	if (gap)
+		len = min(len, gap);
+
+	if (offset < hdr_len || offset + len > content_length)
+		return;
+	eth_rx_place(map_sysmem(image_load_addr + wget_offset + offset, len),
+		     hdr_len, len);
+}
+
+/* Bytes of the response body in memory, decoded and without a gap */
+static ulong wget_body_done(void)
+{
+	if (!wget_hdr_len)
+		return 0;
+	if (wget_chunked)
+		return chunk_out;
+
+	return min((ulong)(rx_contig - wget_hdr_len), content_length);
+}
+
+static bool wget_complete(void)
+{
+	if (!wget_hdr_len)
+		return false;
+	if (wget_chunked)
+		return chunk_state == CHUNK_DONE;
+	if (content_length != -1UL)
+		return rx_contig - wget_hdr_len >= content_length;
+
+	return wget_fin && rx_contig >= wget_fin_off;
+}
+
+static void wget_reset_response(void)
+{
+	rx_contig = 0;
+	wget_hdr_len = 0;
+	wget_hdr_end = 0;
+	wget_raw_end = 0;
+	wget_fin = false;
+	wget_chunked = false;
+	content_length = -1;
+	chunk_state = CHUNK_SIZE;
+	chunk_left = 0;
+	chunk_raw = 0;
+	chunk_out = 0;
+	chunk_count = 0;
+}
+
+static void wget_send_ack(void)
+{
+	net_send_tcp_packet(0, SERVER_PORT, our_port, TCP_ACK,
+			    wget_tx_seq + wget_req_len, wget_rx_seq + rx_contig);
+}
+
+static void wget_send_fin(void)
+{
+	u32 ack = wget_rx_seq + (wget_fin ? wget_fin_off + 1 : rx_contig);
+
+	net_send_tcp_packet(0, SERVER_PORT, our_port, TCP_ACK | TCP_FIN,
+			    wget_tx_seq + wget_req_len, ack);
+}
 
-		ptr = net_tx_packet + net_eth_hdr_size() +
-			IP_TCP_HDR_SIZE + TCP_TSOPT_SIZE + 2;
-		offset = ptr;
+static void wget_send_rst(void)
+{
+	net_send_tcp_packet(0, SERVER_PORT, our_port, TCP_RST,
+			    wget_tx_seq + wget_req_len, 0);
+}
+
+static void wget_connect(void)
+{
+	debug_cond(DEBUG_WGET, "wget: send SYN\n");
+	current_wget_state = WGET_CONNECTING;
+	wget_conn_ip = web_server_ip;
+	wget_reused = false;
+	wget_req_len = 0;
+	tcp_set_tcp_state(TCP_CLOSED);
+	net_send_tcp_packet(0, SERVER_PORT, our_port, TCP_SYN, 0, 0);
+}
 
-		memcpy(offset, &bootfile1, strlen(bootfile1));
-		offset += strlen(bootfile1);
+static void wget_send_request(void)
+{
+	char *req = (char *)net_tx_packet + net_eth_hdr_size() +
+		IP_TCP_HDR_SIZE + TCP_TSOPT_SIZE + 2;
+	int len;
+
+	len = sprintf(req, "GET %s HTTP/1.1\r\nHost: %pI4\r\n", image_url,
+		      &web_server_ip);
+	if (wget_offset) {
+		len += sprintf(req + len, "Range: bytes=%lu-\r\n", wget_offset);
+		if (wget_validator[0])
+			len += sprintf(req + len, "If-Range: %s\r\n",
+				       wget_validator);
+	}
+	len += sprintf(req + len, "%s", linefeed);
 
-		memcpy(offset, image_url, strlen(image_url));
-		offset += strlen(image_url);
+	wget_req_len = len;
+	net_send_tcp_packet(len, SERVER_PORT, our_port, TCP_PUSH,
+			    wget_tx_seq, wget_rx_seq + rx_contig);
+	current_wget_state = WGET_CONNECTED;
+}
 
-		memcpy(offset, &bootfile3, strlen(bootfile3));
-		offset += strlen(bootfile3);
-		net_send_tcp_packet((offset - ptr), SERVER_PORT, our_port,
-				    TCP_PUSH, tcp_seq_num, tcp_ack_num);
-		current_wget_state = WGET_CONNECTED;
+/**
+ * wget_send_stored() - send again what the current state waits on
+ */
+static void wget_send_stored(void)
+{
+	switch (current_wget_state) {
+	case WGET_CLOSED:
+	case WGET_CONNECTING:
+		wget_connect();
 		break;
 	case WGET_CONNECTED:
+		if (!rx_contig) {
+			wget_send_request();
+			break;
+		}
+		fallthrough;
 	case WGET_TRANSFERRING:
+		wget_send_ack();
+		break;
 	case WGET_TRANSFERRED:
-		net_send_tcp_packet(0, SERVER_PORT, our_port, action,
-				    tcp_seq_num, tcp_ack_num);
+		wget_send_fin();
 		break;
 	}
 }
 
-static void wget_send(u8 action, unsigned int tcp_seq_num,
-		      unsigned int tcp_ack_num, int len)
+static void wget_fail(char *error_message)
 {
-	retry_action = action;
-	retry_tcp_ack_num = tcp_ack_num;
-	retry_tcp_seq_num = tcp_seq_num;
-	retry_len = len;
+	printf("wget: Transfer Fail - %s\n", error_message);
+	net_set_timeout_handler(0, NULL);
+	net_set_state(NETLOOP_FAIL);
+}
+
+static void wget_timeout_handler(void);
 
-	wget_send_stored();
+static void wget_save_resume(void)
+{
+	wget_resume_len = wget_offset + wget_body_done();
 }
 
-void wget_fail(char *error_message, unsigned int tcp_seq_num,
-	       unsigned int tcp_ack_num, u8 action)
+/**
+ * wget_reconnect() - open a new connection after losing the current one
+ * @reason: what happened to the connection
+ *
+ * A kept connection the server closed before answering is simply replaced.
+ * Otherwise the download resumes with a Range request from the end of the
+ * data loaded so far, at most WGET_RECONNECT_COUNT times.
+ *
+ * Return: true if a new connection is being opened
+ */
+static bool wget_reconnect(const char *reason)
 {
-	printf("wget: Transfer Fail - %s\n", error_message);
-	net_set_timeout_handler(0, NULL);
-	wget_send(action, tcp_seq_num, tcp_ack_num, 0);
+	wget_keep_alive = false;
+
+	if (wget_reused && !rx_contig) {
+		debug_cond(DEBUG_WGET, "wget: kept connection lost, %s\n",
+			   reason);
+	} else if (current_wget_state == WGET_CONNECTING ||
+		   wget_reconnects >= WGET_RECONNECT_COUNT) {
+		wget_save_resume();
+		return false;
+	} else {
+		wget_reconnects++;
+		wget_offset += wget_body_done();
+		printf("\n%s; resuming at %lu bytes\n", reason, wget_offset);
+	}
+
+	wget_reset_response();
+	wget_timeout_count = 0;
+	our_port++;
+	wget_connect();
+	net_set_timeout_handler(wget_timeout, wget_timeout_handler);
+	net_set_state(NETLOOP_CONTINUE);
+
+	return true;
 }
 
-void wget_success(u8 action, unsigned int tcp_seq_num,
-		  unsigned int tcp_ack_num, int len, int packets)
+static void wget_done(void)
 {
+	ulong resp_len;
+
+	net_boot_file_size = wget_offset + wget_body_done();
 	printf("Packets received %d, Transfer Successful\n", packets);
-	wget_send(action, tcp_seq_num, tcp_ack_num, len);
+	wget_resume_len = 0;
+	current_wget_state = WGET_TRANSFERRED;
+
+	if (wget_keep_alive && !wget_fin) {
+		/* leave the connection open for the next request */
+		wget_send_ack();
+		resp_len = wget_hdr_len +
+			(wget_chunked ? chunk_raw : content_length);
+		wget_tx_seq += wget_req_len;
+		wget_req_len = 0;
+		wget_rx_seq += resp_len;
+		net_set_timeout_handler(0, NULL);
+		net_set_state(NETLOOP_SUCCESS);
+		return;
+	}
+
+	/* close our side; the server's answer ends the command */
+	wget_keep_alive = false;
+	wget_send_fin();
 }
 
 /*
@@ -161,9 +326,23 @@ void wget_success(u8 action, unsigned int tcp_seq_num,
  */
 static void wget_timeout_handler(void)
 {
+	if (current_wget_state == WGET_TRANSFERRED) {
+		/* the file is complete, whatever became of our FIN */
+		net_set_state(NETLOOP_SUCCESS);
+		return;
+	}
+
+	if (wget_reused && !rx_contig) {
+		wget_send_rst();
+		wget_reconnect("no response");
+		return;
+	}
+
 	if (++wget_timeout_count > WGET_RETRY_COUNT) {
+		wget_send_rst();
+		if (wget_reconnect("Retry count exceeded"))
+			return;
 		puts("\nRetry count exceeded; starting again\n");
-		wget_send(TCP_RST, 0, 0, 0);
 		net_start_again();
 	} else {
 		puts("T ");
@@ -174,95 +353,265 @@ static void wget_timeout_handler(void)
 	}
 }
 
-#define PKT_QUEUE_OFFSET 0x20000
-#define PKT_QUEUE_PACKET_SIZE 0x800
+/**
+ * wget_parse_header() - parse the response header once it is complete
+ *
+ * Return: 0 if the header is incomplete or good, -ve on error
+ */
+static int wget_parse_header(void)
+{
+	unsigned int len = min(rx_contig, (u32)WGET_HDR_SIZE);
+	bool http11, conn_close = false, conn_keep = false;
+	bool range = false;
+	ulong range_start = 0, raw = image_load_addr + wget_offset;
+	char *line, *next, *val, *end;
+	uchar *src, *dst;
+	int status;
+
+	wget_hdr[len] = '\0';
+	end = strstr(wget_hdr, http_eom);
+	if (!end)
+		return len == WGET_HDR_SIZE ? -E2BIG : 0;
+
+	wget_hdr_len = end - wget_hdr + strlen(http_eom);
+	*end = '\0';
+
+	line = wget_hdr;
+	next = strstr(line, linefeed);
+	if (next) {
+		*next = '\0';
+		next += strlen(linefeed);
+	} else {
+		next = end;
+	}
+	printf("%s\n", line);
+
+	if (strncmp(line, "HTTP/1.", 7) || !strchr(line, ' '))
+		return -EPROTO;
+	http11 = line[7] != '0';
+	status = simple_strtoul(strchr(line, ' ') + 1, NULL, 10);
+	if (status == 200)
+		wget_validator[0] = '\0';
+
+	for (line = next; line < end; line = next) {
+		next = strstr(line, linefeed);
+		if (next) {
+			*next = '\0';
+			next += strlen(linefeed);
+		} else {
+			next = end;
+		}
+		val = strchr(line, ':');
+		if (!val)
+			continue;
+		*val++ = '\0';
+		while (*val == ' ' || *val == '\t')
+			val++;
+
+		if (!strcasecmp(line, "Content-Length")) {
+			content_length = simple_strtoul(val, NULL, 10);
+		} else if (!strcasecmp(line, "Transfer-Encoding")) {
+			/* chunked is always the last coding applied */
+			len = strlen(val);
+			wget_chunked = len >= 7 &&
+				!strcasecmp(val + len - 7, "chunked");
+		} else if (!strcasecmp(line, "Connection")) {
+			conn_close = !strcasecmp(val, "close");
+			conn_keep = !strcasecmp(val, "keep-alive");
+		} else if (!strcasecmp(line, "Content-Range")) {
+			if (!strncasecmp(val, "bytes ", 6)) {
+				range_start = simple_strtoul(val + 6, NULL, 10);
+				range = true;
+			}
+		} else if (status == 200 && strlen(val) < sizeof(wget_validator) &&
+			   (!strcasecmp(line, "ETag") ||
+			    (!strcasecmp(line, "Last-Modified") &&
+			     !wget_validator[0]))) {
+			strcpy(wget_validator, val);
+		}
+	}
+	debug_cond(DEBUG_WGET, "wget: status %d, len %lu, chunked %d\n",
+		   status, content_length, wget_chunked);
+
+	if (status == 200) {
+		if (wget_offset)
+			debug_cond(DEBUG_WGET, "wget: range not honoured\n");
+		wget_offset = 0;
+	} else if (status != 206 || !range || range_start != wget_offset) {
+		return -EPROTO;
+	}
+
+	/* the body needs framing for the connection to carry another one */
+	wget_keep_alive = (http11 ? !conn_close : conn_keep) &&
+		(wget_chunked || content_length != -1UL);
+	if (wget_chunked)
+		content_length = -1;
+
+	if (wget_raw_end > WGET_HDR_SIZE) {
+		len = wget_raw_end - WGET_HDR_SIZE;
+		src = map_sysmem(raw + WGET_HDR_SIZE, len);
+		dst = map_sysmem(image_load_addr + wget_offset + WGET_HDR_SIZE -
+				 wget_hdr_len, len);
+		memmove(dst, src, len);
+		unmap_sysmem(dst);
+		unmap_sysmem(src);
+	}
+	if (wget_hdr_end > wget_hdr_len) {
+		len = wget_hdr_end - wget_hdr_len;
+		if (!wget_chunked && len > content_length)
+			len = content_length;
+		store_block((uchar *)wget_hdr + wget_hdr_len, 0, len);
+	}
+	current_wget_state = WGET_TRANSFERRING;
+
+	return 0;
+}
 
-static void wget_connected(uchar *pkt, unsigned int tcp_seq_num,
-			   u8 action, unsigned int tcp_ack_num, unsigned int len)
+static uchar wget_body_byte(ulong offset)
 {
-	uchar *pkt_in_q;
-	char *pos;
-	int hlen, i;
-	uchar *ptr1;
+	uchar *ptr = map_sysmem(image_load_addr + wget_offset + offset, 1);
+	uchar c = *ptr;
 
-	pkt[len] = '\0';
-	pos = strstr((char *)pkt, http_eom);
+	unmap_sysmem(ptr);
 
-	if (!pos) {
-		debug_cond(DEBUG_WGET,
-			   "wget: Connected, data before Header %p\n", pkt);
-		pkt_in_q = (void *)image_load_addr + PKT_QUEUE_OFFSET +
-			(pkt_q_idx * PKT_QUEUE_PACKET_SIZE);
-
-		ptr1 = map_sysmem((phys_addr_t)pkt_in_q, len);
-		memcpy(ptr1, pkt, len);
-		unmap_sysmem(ptr1);
-
-		pkt_q[pkt_q_idx].pkt = pkt_in_q;
-		pkt_q[pkt_q_idx].tcp_seq_num = tcp_seq_num;
-		pkt_q[pkt_q_idx].len = len;
-		pkt_q_idx++;
-	} else {
-		debug_cond(DEBUG_WGET, "wget: Connected HTTP Header %p\n", pkt);
-		/* sizeof(http_eom) - 1 is the string length of (http_eom) */
-		hlen = pos - (char *)pkt + sizeof(http_eom) - 1;
-		pos = strstr((char *)pkt, linefeed);
-		if (pos > 0)
-			i = pos - (char *)pkt;
-		else
-			i = hlen;
-		printf("%.*s", i,  pkt);
-
-		current_wget_state = WGET_TRANSFERRING;
-
-		if (strstr((char *)pkt, http_ok) == 0) {
-			debug_cond(DEBUG_WGET,
-				   "wget: Connected Bad Xfer\n");
-			initial_data_seq_num = tcp_seq_num + hlen;
-			wget_loop_state = NETLOOP_FAIL;
-			wget_send(action, tcp_seq_num, tcp_ack_num, len);
-		} else {
-			debug_cond(DEBUG_WGET,
-				   "wget: Connctd pkt %p  hlen %x\n",
-				   pkt, hlen);
-			initial_data_seq_num = tcp_seq_num + hlen;
+	return c;
+}
 
-			pos = strstr((char *)pkt, content_len);
-			if (!pos) {
-				content_length = -1;
-			} else {
-				pos += sizeof(content_len) + 2;
-				strict_strtoul(pos, 10, &content_length);
-				debug_cond(DEBUG_WGET,
-					   "wget: Connected Len %lu\n",
-					   content_length);
+/**
+ * wget_chunk_decode() - decode the chunked body received without a gap
+ *
+ * The body is decoded in place: chunk data is moved down over the chunk
+ * framing, and never overtakes the raw data still to be decoded.
+ *
+ * Return: 0 if OK, -EPROTO if the chunk framing is bad
+ */
+static int wget_chunk_decode(void)
+{
+	ulong avail = rx_contig - wget_hdr_len;
+	uchar *src, *dst;
+	ulong n;
+	int c;
+
+	while (chunk_raw < avail && chunk_state != CHUNK_DONE) {
+		if (chunk_state == CHUNK_DATA) {
+			n = min(chunk_left, avail - chunk_raw);
+			if (chunk_out != chunk_raw) {
+				src = map_sysmem(image_load_addr + wget_offset +
+						 chunk_raw, n);
+				dst = map_sysmem(image_load_addr + wget_offset +
+						 chunk_out, n);
+				memmove(dst, src, n);
+				unmap_sysmem(dst);
+				unmap_sysmem(src);
 			}
+			chunk_raw += n;
+			chunk_out += n;
+			chunk_left -= n;
+			if (!chunk_left)
+				chunk_state = CHUNK_DATA_END;
+			continue;
+		}
 
-			net_boot_file_size = 0;
+		c = wget_body_byte(chunk_raw++);
+		switch (chunk_state) {
+		case CHUNK_SIZE:
+			if (isxdigit(c)) {
+				if (chunk_left >> (BITS_PER_LONG - 4))
+					return -EPROTO;
+				chunk_left = chunk_left << 4 |
+					(isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+				chunk_count++;
+				break;
+			}
+			if (!chunk_count)
+				return -EPROTO;
+			chunk_state = CHUNK_EXT;
+			fallthrough;
+		case CHUNK_EXT:
+			/* chunk extensions are ignored */
+			if (c != '\n')
+				break;
+			chunk_count = 0;
+			chunk_state = chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+			break;
+		case CHUNK_DATA_END:
+			if (c == '\n')
+				chunk_state = CHUNK_SIZE;
+			else if (c != '\r')
+				return -EPROTO;
+			break;
+		case CHUNK_TRAILER:
+			if (c == '\n') {
+				if (!chunk_count)
+					chunk_state = CHUNK_DONE;
+				chunk_count = 0;
+			} else if (c != '\r') {
+				chunk_count++;
+			}
+			break;
+		default:
+			break;
+		}
+	}
 
-			if (len > hlen)
-				store_block(pkt + hlen, 0, len - hlen);
+	return 0;
+}
 
-			debug_cond(DEBUG_WGET,
-				   "wget: Connected Pkt %p hlen %x\n",
-				   pkt, hlen);
-
-			for (i = 0; i < pkt_q_idx; i++) {
-				ptr1 = map_sysmem(
-					(phys_addr_t)(pkt_q[i].pkt),
-					pkt_q[i].len);
-				store_block(ptr1,
-					    pkt_q[i].tcp_seq_num -
-					    initial_data_seq_num,
-					    pkt_q[i].len);
-				unmap_sysmem(ptr1);
-				debug_cond(DEBUG_WGET,
-					   "wget: Connctd pkt Q %p len %x\n",
-					   pkt_q[i].pkt, pkt_q[i].len);
-			}
+/**
+ * wget_rx() - take in one segment of the response
+ * @pkt: segment data
+ * @tcp_seq_num: sequence number of the segment
+ * @len: segment length
+ *
+ * Return: 0 if OK, -ve on error
+ */
+static int wget_rx(uchar *pkt, u32 tcp_seq_num, unsigned int len)
+{
+	u32 off = tcp_seq_num - wget_rx_seq;
+	unsigned int n;
+
+	rx_contig = tcp_get_ack_edge() - wget_rx_seq;
+
+	/* drop whatever lies before the response */
+	if ((s32)off < 0) {
+		if ((s32)(off + len) <= 0)
+			return 0;
+		pkt -= (s32)off;
+		len += (s32)off;
+		off = 0;
+	}
+
+	if (!wget_hdr_len) {
+		n = off < WGET_HDR_SIZE ? min(len, WGET_HDR_SIZE - off) : 0;
+		if (n) {
+			memcpy(wget_hdr + off, pkt, n);
+			wget_hdr_end = max(wget_hdr_end, off + n);
+		}
+		if (n < len) {
+			store_block(pkt + n, off + n, len - n);
+			wget_raw_end = max(wget_raw_end, off + len);
+		}
+		if (wget_parse_header())
+			return -EPROTO;
+	} else if (off + len > wget_hdr_len) {
+		n = off < wget_hdr_len ? wget_hdr_len - off : 0;
+		off += n - wget_hdr_len;
+		len -= n;
+		if (!wget_chunked) {
+			if (off >= content_length)
+				return 0;
+			len = min((ulong)len, content_length - off);
 		}
+		store_block(pkt + n, off, len);
+		/* chunks are decoded in place, so stay clear of that */
+		if (!wget_chunked && off + len == rx_contig - wget_hdr_len)
+			wget_place_next(pkt + n, len);
 	}
-	wget_send(action, tcp_seq_num, tcp_ack_num, len);
+
+	if (wget_chunked)
+		return wget_chunk_decode();
+
+	return 0;
 }
 
 /**
@@ -289,6 +638,14 @@ static void wget_handler(uchar *pkt, u16 dport,
 	net_set_timeout_handler(wget_timeout, wget_timeout_handler);
 	packets++;
 
+	if (action == TCP_RST) {
+		if (current_wget_state == WGET_TRANSFERRED)
+			net_set_state(NETLOOP_SUCCESS);
+		else if (!wget_reconnect("Connection reset"))
+			wget_fail("connection reset");
+		return;
+	}
+
 	switch (current_wget_state) {
 	case WGET_CLOSED:
 		debug_cond(DEBUG_WGET, "wget: Handler: Error!, State wrong\n");
@@ -301,64 +658,51 @@ static void wget_handler(uchar *pkt, u16 dport,
 			if (wget_tcp_state == TCP_ESTABLISHED) {
 				debug_cond(DEBUG_WGET,
 					   "wget: Cting, send, len=%x\n", len);
-				wget_send(action, tcp_seq_num, tcp_ack_num,
-					  len);
+				wget_rx_seq = tcp_seq_num + 1;
+				wget_tx_seq = tcp_ack_num;
+				wget_send_ack();
+				wget_send_request();
 			} else {
-				printf("%.*s", len,  pkt);
-				wget_fail("wget: Handler Connected Fail\n",
-					  tcp_seq_num, tcp_ack_num, action);
+				wget_fail("Handler Connected Fail");
 			}
 		}
 		break;
 	case WGET_CONNECTED:
-		debug_cond(DEBUG_WGET, "wget: Connected seq=%u, len=%x\n",
-			   tcp_seq_num, len);
-		if (!len) {
-			wget_fail("Image not found, no data returned\n",
-				  tcp_seq_num, tcp_ack_num, action);
-		} else {
-			wget_connected(pkt, tcp_seq_num, action, tcp_ack_num, len);
-		}
-		break;
 	case WGET_TRANSFERRING:
 		debug_cond(DEBUG_WGET,
 			   "wget: Transferring, seq=%x, ack=%x,len=%x\n",
 			   tcp_seq_num, tcp_ack_num, len);
-
-		if (tcp_seq_num >= initial_data_seq_num &&
-		    store_block(pkt, tcp_seq_num - initial_data_seq_num,
-				len) != 0) {
-			wget_fail("wget: store error\n",
-				  tcp_seq_num, tcp_ack_num, action);
+		if (len && wget_rx(pkt, tcp_seq_num, len)) {
+			wget_send_rst();
+			wget_fail("bad response");
 			return;
 		}
+		if (action & TCP_FIN) {
+			wget_fin = true;
+			wget_fin_off = tcp_seq_num + len - wget_rx_seq;
+		}
 
-		switch (wget_tcp_state) {
-		case TCP_FIN_WAIT_2:
-			wget_send(TCP_ACK, tcp_seq_num, tcp_ack_num, len);
-			fallthrough;
-		case TCP_SYN_SENT:
-		case TCP_SYN_RECEIVED:
-		case TCP_CLOSING:
-		case TCP_FIN_WAIT_1:
-		case TCP_CLOSED:
-			net_set_state(NETLOOP_FAIL);
-			break;
-		case TCP_ESTABLISHED:
-			wget_send(TCP_ACK, tcp_seq_num, tcp_ack_num,
-				  len);
-			wget_loop_state = NETLOOP_SUCCESS;
-			break;
-		case TCP_CLOSE_WAIT:     /* End of transfer */
-			current_wget_state = WGET_TRANSFERRED;
-			wget_send(action | TCP_ACK | TCP_FIN,
-				  tcp_seq_num, tcp_ack_num, len);
-			break;
+		if (wget_complete()) {
+			wget_done();
+		} else if (wget_fin && rx_contig >= wget_fin_off) {
+			/* closed early: nothing more is coming */
+			wget_send_rst();
+			if (wget_reconnect("Connection closed"))
+				break;
+			if (!wget_hdr_len)
+				wget_fail("Image not found, no data returned");
+			else
+				wget_fail("connection closed");
 		}
 		break;
 	case WGET_TRANSFERRED:
-		printf("Packets received %d, Transfer Successful\n", packets);
-		net_set_state(wget_loop_state);
+		if (action & TCP_FIN) {
+			wget_fin = true;
+			wget_fin_off = tcp_seq_num + len - wget_rx_seq;
+			wget_send_ack();
+		}
+		net_set_timeout_handler(0, NULL);
+		net_set_state(NETLOOP_SUCCESS);
 		break;
 	}
 }
@@ -424,9 +768,24 @@ void wget_start(void)
 	tcp_set_tcp_handler(wget_handler);
 
 	wget_timeout_count = 0;
-	current_wget_state = WGET_CLOSED;
-
-	our_port = random_port();
+	wget_reconnects = 0;
+	packets = 0;
+	wget_reset_response();
+
+	/* a retry of a failed download carries on where it stopped */
+	if (wget_resume_len && wget_resume_addr == image_load_addr &&
+	    !strcmp(wget_resume_name, net_boot_file_name)) {
+		wget_offset = wget_resume_len;
+		printf("Resuming at %lu bytes\n", wget_offset);
+	} else {
+		wget_offset = 0;
+		wget_validator[0] = '\0';
+		wget_resume_addr = image_load_addr;
+		strlcpy(wget_resume_name, net_boot_file_name,
+			sizeof(wget_resume_name));
+	}
+	wget_resume_len = 0;
+	net_boot_file_size = 0;
 
 	/*
 	 * Zero out server ether to force arp resolution in case
@@ -436,5 +795,14 @@ void wget_start(void)
 
 	memset(net_server_ethaddr, 0, 6);
 
-	wget_send(TCP_SYN, 0, 0, 0);
+	if (wget_keep_alive && wget_conn_ip.s_addr == web_server_ip.s_addr &&
+	    tcp_get_tcp_state() == TCP_ESTABLISHED) {
+		debug_cond(DEBUG_WGET, "wget: reusing connection\n");
+		wget_reused = true;
+		wget_send_request();
+	} else {
+		wget_keep_alive = false;
+		our_port = random_port();
+		wget_connect();
+	}
 }
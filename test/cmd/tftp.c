@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for tftpboot with blocks lost or out of order
+ */
+
+#include <common.h>
+#include <command.h>
+#include <dm.h>
+#include <env.h>
+#include <net.h>
+#include <mapmem.h>
+#include <asm/eth.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* TFTP opcodes, as in net/tftp.c */
+#define SB_TFTP_RRQ		1
+#define SB_TFTP_DATA		3
+#define SB_TFTP_ACK		4
+#define SB_TFTP_OACK		6
+
+#define SB_TFTP_PORT		69
+#define SB_TFTP_TID		4000	/* server port for the transfer */
+#define SB_TFTP_BLKSIZE		512
+#define SB_TFTP_SIZE		(40 * SB_TFTP_BLKSIZE + 100)
+
+/*
+ * A fake TFTP server. It answers an acknowledgment of the last block sent
+ * with the next window, and any other with the one block after it. The
+ * window is kept to half the receive queue, so that a block sent again and
+ * the next window both fit.
+ */
+struct sb_tftp {
+	int rrqs;
+	int window;		/* window agreed, 1 if none was asked */
+	int next;		/* next new block to send */
+	int drop;		/* lose this block the first time it is sent */
+	int swap;		/* send this block after the next one, once */
+	int lost;		/* blocks lost */
+	int swapped;		/* blocks sent out of order */
+	int resent;		/* blocks sent again */
+};
+
+static struct sb_tftp sb_tftp;
+
+static u8 sb_tftp_file_byte(uint i)
+{
+	return i * 7 + (i >> 9);
+}
+
+static int sb_arp_handler(struct udevice *dev, void *packet,
+			  unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct arp_hdr *arp = packet + ETHER_HDR_SIZE;
+	int ret;
+
+	if (ntohs(arp->ar_op) != ARPOP_REQUEST)
+		return -EPROTONOSUPPORT;
+
+	priv->fake_host_ipaddr = net_read_ip(&arp->ar_spa);
+	ret = sandbox_eth_recv_arp_req(dev);
+	if (ret)
+		return ret;
+
+	return sandbox_eth_arp_req_to_reply(dev, packet, len);
+}
+
+static void sb_tftp_send(struct udevice *dev, void *packet, ushort opcode,
+			 const void *data, int data_len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_send;
+	struct ip_udp_hdr *ip_send;
+	__be16 *payload;
+	int len = 2 + data_len;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_send = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_send->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_send->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_send->et_protlen = htons(PROT_IP);
+	ip_send = (void *)eth_send + ETHER_HDR_SIZE;
+	payload = (void *)ip_send + IP_UDP_HDR_SIZE;
+	payload[0] = htons(opcode);
+	memcpy(payload + 1, data, data_len);
+	net_set_ip_header((uchar *)ip_send, net_read_ip(&ip->ip_src),
+			  net_read_ip(&ip->ip_dst), IP_UDP_HDR_SIZE + len,
+			  IPPROTO_UDP);
+	ip_send->udp_src = htons(SB_TFTP_TID);
+	ip_send->udp_dst = ip->udp_src;
+	ip_send->udp_len = htons(UDP_HDR_SIZE + len);
+	ip_send->udp_xsum = 0;
+
+	priv->recv_packet_length[priv->recv_packets] =
+		ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len;
+	++priv->recv_packets;
+}
+
+static void sb_tftp_send_block(struct udevice *dev, void *packet, int block)
+{
+	u8 data[2 + SB_TFTP_BLKSIZE];
+	uint start = (block - 1) * SB_TFTP_BLKSIZE;
+	uint i, len = min(SB_TFTP_SIZE - start, (uint)SB_TFTP_BLKSIZE);
+
+	*(__be16 *)data = htons(block);
+	for (i = 0; i < len; i++)
+		data[2 + i] = sb_tftp_file_byte(start + i);
+	sb_tftp_send(dev, packet, SB_TFTP_DATA, data, 2 + len);
+}
+
+/* Blocks 1 to this one make up the file, the last one short */
+static int sb_tftp_last_block(void)
+{
+	return SB_TFTP_SIZE / SB_TFTP_BLKSIZE + 1;
+}
+
+static void sb_tftp_send_window(struct udevice *dev, void *packet)
+{
+	struct sb_tftp *t = &sb_tftp;
+	int end = min(t->next + t->window, sb_tftp_last_block() + 1);
+	int block;
+
+	for (block = t->next; block < end; block++) {
+		if (block == t->drop && block + 1 < end) {
+			t->drop = 0;
+			t->lost++;
+		} else if (block == t->swap && block + 1 < end) {
+			t->swap = 0;
+			t->swapped++;
+			sb_tftp_send_block(dev, packet, ++block);
+			sb_tftp_send_block(dev, packet, block - 1);
+		} else {
+			sb_tftp_send_block(dev, packet, block);
+		}
+	}
+	t->next = end;
+}
+
+static void sb_tftp_rrq(struct udevice *dev, void *packet, const char *opt,
+			int len)
+{
+	struct sb_tftp *t = &sb_tftp;
+	char oack[64];
+	int oack_len;
+	int asked = 1;
+	int i;
+
+	/* the file name, the mode and then option names and values */
+	for (i = 0; i < len; i += strnlen(opt + i, len - i) + 1) {
+		if (!strcmp(opt + i, "windowsize") && i + 11 < len)
+			asked = dectoul(opt + i + 11, NULL);
+	}
+	t->rrqs++;
+	t->window = min(asked, PKTBUFSRX / 2);
+	t->next = 1;
+
+	oack_len = sprintf(oack, "blksize%c%d", 0, SB_TFTP_BLKSIZE) + 1;
+	if (asked > 1)
+		oack_len += sprintf(oack + oack_len, "windowsize%c%d", 0,
+				    t->window) + 1;
+	sb_tftp_send(dev, packet, SB_TFTP_OACK, oack, oack_len);
+}
+
+static int sb_tftp_handler(struct udevice *dev, void *packet,
+			   unsigned int len)
+{
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct sb_tftp *t = &sb_tftp;
+	__be16 *payload = (void *)ip + IP_UDP_HDR_SIZE;
+	int payload_len;
+	int block;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP)
+		return -EPROTONOSUPPORT;
+
+	payload_len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	if (payload_len < 4)
+		return 0;
+
+	if (ntohs(ip->udp_dst) == SB_TFTP_PORT &&
+	    ntohs(payload[0]) == SB_TFTP_RRQ) {
+		sb_tftp_rrq(dev, packet, (char *)(payload + 1),
+			    payload_len - 2);
+	} else if (ntohs(ip->udp_dst) == SB_TFTP_TID &&
+		   ntohs(payload[0]) == SB_TFTP_ACK) {
+		block = ntohs(payload[1]);
+		if (block + 1 == t->next) {
+			sb_tftp_send_window(dev, packet);
+		} else if (block + 1 < t->next) {
+			sb_tftp_send_block(dev, packet, block + 1);
+			t->resent++;
+		}
+	}
+
+	return 0;
+}
+
+static int sb_tftp_start(struct unit_test_state *uts)
+{
+	memset(&sb_tftp, '\0', sizeof(sb_tftp));
+	sandbox_eth_set_tx_handler(0, sb_tftp_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("tftpwindowsize", "4");
+
+	return 0;
+}
+
+static int sb_tftp_check_file(struct unit_test_state *uts, ulong addr)
+{
+	u8 *buf = map_sysmem(addr, SB_TFTP_SIZE);
+	uint i;
+
+	ut_asserteq(SB_TFTP_SIZE, env_get_hex("filesize", 0));
+	for (i = 0; i < SB_TFTP_SIZE && buf[i] == sb_tftp_file_byte(i); i++)
+		;
+	unmap_sysmem(buf);
+	ut_asserteq(SB_TFTP_SIZE, i);
+
+	return 0;
+}
+
+static int sb_tftp_finish(struct unit_test_state *uts)
+{
+	sandbox_eth_set_tx_handler(0, NULL);
+	env_set("tftpwindowsize", NULL);
+
+	return 0;
+}
+
+/*
+ * A block lost from a window is sent again alone: the block after it is kept
+ * and acknowledged once the gap is filled.
+ */
+static int net_test_tftp_lost_block(struct unit_test_state *uts)
+{
+	ut_assertok(sb_tftp_start(uts));
+	sb_tftp.drop = 5;
+	ut_assertok(run_command("tftpboot 0x20000 1.1.2.2:file", 0));
+	ut_assertok(sb_tftp_finish(uts));
+
+	ut_asserteq(1, sb_tftp.rrqs);
+	ut_asserteq(PKTBUFSRX / 2, sb_tftp.window);
+	ut_asserteq(1, sb_tftp.lost);
+	ut_asserteq(1, sb_tftp.resent);
+	ut_assertok(sb_tftp_check_file(uts, 0x20000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_tftp_lost_block, 0);
+
+/* Two blocks swapped in a window make for a single block sent again */
+static int net_test_tftp_reordered_block(struct unit_test_state *uts)
+{
+	ut_assertok(sb_tftp_start(uts));
+	sb_tftp.swap = 7;
+	ut_assertok(run_command("tftpboot 0x20000 1.1.2.2:file", 0));
+	ut_assertok(sb_tftp_finish(uts));
+
+	ut_asserteq(1, sb_tftp.rrqs);
+	ut_asserteq(PKTBUFSRX / 2, sb_tftp.window);
+	ut_asserteq(1, sb_tftp.swapped);
+	ut_asserteq(1, sb_tftp.resent);
+	ut_assertok(sb_tftp_check_file(uts, 0x20000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_tftp_reordered_block, 0);
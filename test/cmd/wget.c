@@ -16,6 +16,7 @@
 #include <net.h>
 #include <net/tcp.h>
 #include <net/wget.h>
+#include <mapmem.h>
 #include <asm/eth.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -23,6 +24,7 @@
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <time.h>
 
 #define SHIFT_TO_TCPHDRLEN_FIELD(x) ((x) << 4)
 #define LEN_B_TO_DW(x) ((x) >> 2)
@@ -104,7 +106,7 @@ static int sb_ack_handler(struct udevice *dev, void *packet,
 	int pkt_len;
 	int payload_len = 0;
 	const char *payload1 = "HTTP/1.1 200 OK\r\n"
-		"Content-Length: 30\r\n\r\n\r\n"
+		"Content-Length: 32\r\n\r\n\r\n"
 		"<html><body>Hi</body></html>\r\n";
 
 	/* Don't allow the buffer to overrun */
@@ -204,3 +206,515 @@ static int net_test_wget(struct unit_test_state *uts)
 }
 
 LIB_TEST(net_test_wget, 0);
+
+/*
+ * A fake HTTP/1.1 server for the tests below. It keeps the connection open,
+ * sends as far ahead of the last acknowledgment as the client's window and
+ * the receive queue allow, and sends the first unacknowledged segment again
+ * when an acknowledgment is repeated.
+ */
+#define SB_HTTP_SEG		512	/* segment size */
+#define SB_HTTP_ISN		1000	/* server initial sequence number */
+#define SB_HTTP_ETAG		"\"sb-1\""
+
+struct sb_http {
+	int syns;		/* connections opened */
+	int requests;
+	bool chunked;		/* send responses chunked */
+	bool swap;		/* send the second and third segments swapped */
+	int overlap;		/* send data past a gap shorter than a segment */
+	uint reset_at;		/* reset the connection at this offset once */
+	int reset_wnd;		/* reset inside (> 0) or past (< 0) a grown window */
+	uint loss;		/* lose one in this many new segments */
+	int lost;		/* segments lost */
+	int rexmits;		/* segments sent again */
+	long range[4];		/* Range asked by each request, -1 if none */
+	bool if_range[4];	/* If-Range with the ETag given by each request */
+	/* connection */
+	bool open;
+	u32 rcv_nxt;		/* client sequence number expected */
+	u32 base;		/* sequence number of the current response */
+	u32 wnd;		/* client receive window */
+	u32 acked;		/* response bytes acknowledged */
+	uint sent;		/* response bytes sent */
+	bool resent;		/* segment at acked sent again */
+	uint segs;		/* new segments sent */
+	uint resp_len;
+	char resp[256 * 1024];
+};
+
+static struct sb_http sb_http;
+
+static uint sb_http_file_size(char name)
+{
+	if (name == 'c')
+		return 200000;
+
+	return name == 'a' ? 3000 : 5000;
+}
+
+static u8 sb_http_file_byte(char name, uint i)
+{
+	return i * 7 + (i >> 8) + name;
+}
+
+static void sb_http_send(struct udevice *dev, void *packet, u8 flags,
+			 u32 seq, const void *data, int payload_len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct ethernet_hdr *eth_send;
+	struct ip_tcp_hdr *tcp_send;
+	int pkt_len;
+
+	if (priv->recv_packets >= PKTBUFSRX)
+		return;
+
+	eth_send = (void *)priv->recv_packet_buffer[priv->recv_packets];
+	memcpy(eth_send->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_send->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_send->et_protlen = htons(PROT_IP);
+	tcp_send = (void *)eth_send + ETHER_HDR_SIZE;
+	tcp_send->tcp_src = tcp->tcp_dst;
+	tcp_send->tcp_dst = tcp->tcp_src;
+	tcp_send->tcp_seq = htonl(seq);
+	tcp_send->tcp_ack = htonl(sb_http.rcv_nxt);
+	tcp_send->tcp_hlen = SHIFT_TO_TCPHDRLEN_FIELD(LEN_B_TO_DW(TCP_HDR_SIZE));
+	tcp_send->tcp_flags = flags;
+	tcp_send->tcp_win = htons(PKTBUFSRX * TCP_MSS >> TCP_SCALE);
+	tcp_send->tcp_xsum = 0;
+	tcp_send->tcp_ugr = 0;
+	memcpy((void *)tcp_send + IP_TCP_HDR_SIZE, data, payload_len);
+	pkt_len = IP_TCP_HDR_SIZE + payload_len;
+	tcp_send->tcp_xsum = tcp_set_pseudo_header((uchar *)tcp_send,
+						   tcp->ip_src,
+						   tcp->ip_dst,
+						   pkt_len - IP_HDR_SIZE,
+						   pkt_len);
+	net_set_ip_header((uchar *)tcp_send,
+			  tcp->ip_src,
+			  tcp->ip_dst,
+			  pkt_len,
+			  IPPROTO_TCP);
+
+	priv->recv_packet_length[priv->recv_packets] = ETHER_HDR_SIZE + pkt_len;
+	++priv->recv_packets;
+}
+
+/* Build the response to a GET request */
+static void sb_http_request(const char *data, int len)
+{
+	struct sb_http *h = &sb_http;
+	char req[256], *pos;
+	int n = h->requests++;
+	uint size, start = 0, i, chunk;
+	char name;
+
+	memcpy(req, data, min(len, (int)sizeof(req) - 1));
+	req[min(len, (int)sizeof(req) - 1)] = '\0';
+	name = strncmp(req, "GET /", 5) ? 'a' : req[5];
+	size = sb_http_file_size(name);
+
+	pos = strstr(req, "\r\nRange: bytes=");
+	h->range[n] = pos ? simple_strtol(pos + 15, NULL, 10) : -1;
+	h->if_range[n] = !!strstr(req, "\r\nIf-Range: " SB_HTTP_ETAG "\r\n");
+
+	h->base += h->resp_len;
+	h->acked = 0;
+	h->sent = 0;
+	h->resent = false;
+	if (h->range[n] > 0) {
+		start = h->range[n];
+		h->resp_len = sprintf(h->resp, "HTTP/1.1 206 Partial Content\r\n"
+				      "ETag: " SB_HTTP_ETAG "\r\n"
+				      "Content-Range: bytes %u-%u/%u\r\n"
+				      "Content-Length: %u\r\n\r\n",
+				      start, size - 1, size, size - start);
+	} else if (h->chunked) {
+		h->resp_len = sprintf(h->resp, "HTTP/1.1 200 OK\r\n"
+				      "ETag: " SB_HTTP_ETAG "\r\n"
+				      "transfer-encoding: chunked\r\n\r\n");
+	} else {
+		h->resp_len = sprintf(h->resp, "HTTP/1.1 200 OK\r\n"
+				      "ETag: " SB_HTTP_ETAG "\r\n"
+				      "Content-Length: %u\r\n\r\n", size);
+	}
+
+	for (i = start; i < size; i += chunk) {
+		/* chunks of odd sizes, one with an extension */
+		chunk = size - i;
+		if (h->chunked && chunk > 700)
+			chunk = i ? 1 + i % 997 : 700;
+		if (h->chunked)
+			h->resp_len += sprintf(h->resp + h->resp_len,
+					       i ? "%x\r\n" : "%X;ext=1\r\n",
+					       chunk);
+		for (len = 0; len < chunk; len++)
+			h->resp[h->resp_len++] = sb_http_file_byte(name, i + len);
+		if (h->chunked)
+			h->resp_len += sprintf(h->resp + h->resp_len, "\r\n");
+	}
+	if (h->chunked && !start)
+		h->resp_len += sprintf(h->resp + h->resp_len,
+				       "0\r\nX-Trailer: 1\r\n\r\n");
+}
+
+/* Send the response segments the window allows */
+static void sb_http_push(struct udevice *dev, void *packet)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct sb_http *h = &sb_http;
+	uint end = min(h->acked + h->wnd, h->resp_len);
+	bool inside;
+	uint n;
+
+	/*
+	 * The client has taken in at most h->sent, so a reset at
+	 * h->acked + h->wnd - 1 is inside its window but more than the first
+	 * window from its start, and one at h->sent + h->wnd is past its end.
+	 * The connection is left open, so that only a reset which the client
+	 * takes leads to a new connection.
+	 */
+	if (h->reset_wnd && h->wnd > 2 * TCP_RCV_WND_INIT &&
+	    h->sent - h->acked < TCP_RCV_WND_INIT &&
+	    priv->recv_packets < PKTBUFSRX) {
+		inside = h->reset_wnd > 0;
+		h->reset_wnd = 0;
+		sb_http_send(dev, packet, TCP_RST | TCP_ACK,
+			     h->base + (inside ? h->acked + h->wnd - 1 :
+					h->sent + h->wnd), NULL, 0);
+		if (inside)
+			return;
+	}
+
+	while (h->sent < end && priv->recv_packets < PKTBUFSRX) {
+		if (h->reset_at && h->sent >= h->reset_at) {
+			sb_http_send(dev, packet, TCP_RST | TCP_ACK,
+				     h->base + h->sent, NULL, 0);
+			h->reset_at = 0;
+			h->open = false;
+			return;
+		}
+		/*
+		 * Data past a short gap and the segment before the gap, then
+		 * that segment again, first of the next batch received, which
+		 * must not land over the data past the gap, and what fills it
+		 */
+		if (h->overlap == 1 && h->sent >= 2 * SB_HTTP_SEG &&
+		    h->sent + 3 * SB_HTTP_SEG <= end &&
+		    priv->recv_packets + 2 <= PKTBUFSRX) {
+			n = h->sent + 2 * SB_HTTP_SEG - 100;
+			sb_http_send(dev, packet, TCP_ACK | TCP_PUSH,
+				     h->base + n, h->resp + n, SB_HTTP_SEG);
+			sb_http_send(dev, packet, TCP_ACK,
+				     h->base + h->sent, h->resp + h->sent,
+				     SB_HTTP_SEG);
+			h->sent += SB_HTTP_SEG;
+			h->overlap = 2;
+			return;
+		}
+		if (h->overlap == 2 && priv->recv_packets + 2 <= PKTBUFSRX) {
+			sb_http_send(dev, packet, TCP_ACK,
+				     h->base + h->sent - SB_HTTP_SEG,
+				     h->resp + h->sent - SB_HTTP_SEG,
+				     SB_HTTP_SEG);
+			sb_http_send(dev, packet, TCP_ACK, h->base + h->sent,
+				     h->resp + h->sent, SB_HTTP_SEG - 100);
+			h->sent += 2 * SB_HTTP_SEG - 100;
+			h->overlap = 0;
+			continue;
+		}
+		if (h->overlap == 2)
+			return;
+		if (h->swap && h->sent == SB_HTTP_SEG &&
+		    h->sent + 2 * SB_HTTP_SEG <= end &&
+		    priv->recv_packets + 2 <= PKTBUFSRX) {
+			sb_http_send(dev, packet, TCP_ACK | TCP_PUSH,
+				     h->base + h->sent + SB_HTTP_SEG,
+				     h->resp + h->sent + SB_HTTP_SEG,
+				     SB_HTTP_SEG);
+			sb_http_send(dev, packet, TCP_ACK,
+				     h->base + h->sent, h->resp + h->sent,
+				     SB_HTTP_SEG);
+			h->sent += 2 * SB_HTTP_SEG;
+			h->swap = false;
+			continue;
+		}
+		n = min(h->resp_len - h->sent, (uint)SB_HTTP_SEG);
+		/* never one of the last few, so later ones show the loss */
+		if (h->loss && !(++h->segs % h->loss) &&
+		    h->sent + 4 * SB_HTTP_SEG < h->resp_len) {
+			h->lost++;
+		} else {
+			sb_http_send(dev, packet, TCP_ACK | TCP_PUSH,
+				     h->base + h->sent, h->resp + h->sent, n);
+		}
+		h->sent += n;
+	}
+}
+
+static int sb_http11_handler(struct udevice *dev, void *packet,
+			     unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct ethernet_hdr *eth = packet;
+	struct ip_tcp_hdr *tcp = packet + ETHER_HDR_SIZE;
+	struct sb_http *h = &sb_http;
+	int hdr_len, payload_len;
+	u32 seq, ack;
+	uint n;
+
+	if (ntohs(eth->et_protlen) == PROT_ARP)
+		return sb_arp_handler(dev, packet, len);
+	if (ntohs(eth->et_protlen) != PROT_IP || tcp->ip_p != IPPROTO_TCP)
+		return -EPROTONOSUPPORT;
+
+	hdr_len = (tcp->tcp_hlen >> 4) * 4;
+	payload_len = ntohs(tcp->ip_len) - IP_HDR_SIZE - hdr_len;
+	seq = ntohl(tcp->tcp_seq);
+	ack = ntohl(tcp->tcp_ack);
+
+	if (tcp->tcp_flags & TCP_RST) {
+		h->open = false;
+		return 0;
+	}
+	if (tcp->tcp_flags == TCP_SYN) {
+		h->syns++;
+		h->open = true;
+		h->rcv_nxt = seq + 1;
+		h->base = SB_HTTP_ISN + 1;
+		h->wnd = ntohs(tcp->tcp_win);
+		h->resp_len = 0;
+		h->acked = 0;
+		h->sent = 0;
+		sb_http_send(dev, packet, TCP_SYN | TCP_ACK, SB_HTTP_ISN,
+			     NULL, 0);
+		return 0;
+	}
+	if (!h->open) {
+		sb_http_send(dev, packet, TCP_RST, ack, NULL, 0);
+		return 0;
+	}
+
+	h->wnd = ntohs(tcp->tcp_win) << TCP_SCALE;
+	if (payload_len > 0 && seq == h->rcv_nxt) {
+		h->rcv_nxt += payload_len;
+		sb_http_request((void *)tcp + IP_HDR_SIZE + hdr_len,
+				payload_len);
+	} else if (!payload_len && ack - h->base == h->acked &&
+		   h->acked < h->sent && !h->resent &&
+		   priv->recv_packets < PKTBUFSRX) {
+		/* repeated acknowledgment: send the missing segment again */
+		n = min(h->sent - h->acked, (uint)SB_HTTP_SEG);
+		sb_http_send(dev, packet, TCP_ACK | TCP_PUSH,
+			     h->base + h->acked, h->resp + h->acked, n);
+		h->resent = true;
+		h->rexmits++;
+	}
+	if (ack - h->base > h->acked && ack - h->base <= h->sent) {
+		h->acked = ack - h->base;
+		h->resent = false;
+	}
+	sb_http_push(dev, packet);
+
+	return 0;
+}
+
+static int sb_http_start(struct unit_test_state *uts)
+{
+	memset(&sb_http, '\0', sizeof(sb_http));
+	sandbox_eth_set_tx_handler(0, sb_http11_handler);
+	sandbox_eth_set_priv(0, uts);
+
+	/* do not carry on a connection left by another test */
+	tcp_set_tcp_state(TCP_CLOSED);
+	env_set("ethact", "eth@10002000");
+	env_set("ethrotate", "no");
+	env_set("loadaddr", "0x20000");
+
+	return 0;
+}
+
+static int sb_http_check_data(struct unit_test_state *uts, char name,
+			      ulong addr)
+{
+	uint size = sb_http_file_size(name);
+	u8 *buf = map_sysmem(addr, size);
+	uint i;
+
+	for (i = 0; i < size && buf[i] == sb_http_file_byte(name, i); i++)
+		;
+	unmap_sysmem(buf);
+	ut_asserteq(size, i);
+
+	return 0;
+}
+
+static int sb_http_check_file(struct unit_test_state *uts, char name,
+			      ulong addr)
+{
+	ut_asserteq(sb_http_file_size(name), env_get_hex("filesize", 0));
+
+	return sb_http_check_data(uts, name, addr);
+}
+
+static int net_test_wget_keep_alive(struct unit_test_state *uts)
+{
+	ut_assertok(sb_http_start(uts));
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/a", 0));
+	ut_assertok(sb_http_check_file(uts, 'a', 0x20000));
+	ut_assertok(run_command("wget 0x30000 1.1.2.2:/b", 0));
+	ut_assertok(sb_http_check_file(uts, 'b', 0x30000));
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	/* both files came over the one connection */
+	ut_asserteq(1, sb_http.syns);
+	ut_asserteq(2, sb_http.requests);
+	ut_asserteq(-1, sb_http.range[1]);
+
+	return 0;
+}
+
+LIB_TEST(net_test_wget_keep_alive, 0);
+
+static int net_test_wget_chunked(struct unit_test_state *uts)
+{
+	ut_assertok(sb_http_start(uts));
+	sb_http.chunked = true;
+	sb_http.swap = true;
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/b", 0));
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	ut_asserteq(false, sb_http.swap);
+	ut_assertok(sb_http_check_file(uts, 'b', 0x20000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_wget_chunked, 0);
+
+static int net_test_wget_overlap(struct unit_test_state *uts)
+{
+	ut_assertok(sb_http_start(uts));
+	sb_http.overlap = 1;
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/b", 0));
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	ut_asserteq(0, sb_http.overlap);
+	ut_assertok(sb_http_check_file(uts, 'b', 0x20000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_wget_overlap, 0);
+
+static int net_test_wget_resume(struct unit_test_state *uts)
+{
+	ut_assertok(sb_http_start(uts));
+	sb_http.reset_at = 2000;
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/b", 0));
+	sandbox_eth_set_tx_handler(0, NULL);
+
+	/* the second connection asked for the rest of the file only */
+	ut_asserteq(2, sb_http.syns);
+	ut_asserteq(2, sb_http.requests);
+	ut_asserteq(-1, sb_http.range[0]);
+	ut_assert(sb_http.range[1] > 0 && sb_http.range[1] < 2000);
+	ut_assert(sb_http.if_range[1]);
+	ut_assertok(sb_http_check_file(uts, 'b', 0x20000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_wget_resume, 0);
+
+static int net_test_wget_reset_window(struct unit_test_state *uts)
+{
+	/* a reset past the end of the advertised window is ignored */
+	ut_assertok(sb_http_start(uts));
+	sb_http.reset_wnd = -1;
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/c", 0));
+	sandbox_eth_set_tx_handler(0, NULL);
+	ut_asserteq(0, sb_http.reset_wnd);
+	ut_asserteq(1, sb_http.syns);
+	ut_assertok(sb_http_check_file(uts, 'c', 0x20000));
+
+	/* one inside the window, once it grew past the first, is not */
+	ut_assertok(sb_http_start(uts));
+	sb_http.reset_wnd = 1;
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/c", 0));
+	sandbox_eth_set_tx_handler(0, NULL);
+	ut_asserteq(0, sb_http.reset_wnd);
+	/* the SYN may need sending again if the queue was full of old data */
+	ut_assert(sb_http.syns > 1);
+	ut_assertok(sb_http_check_file(uts, 'c', 0x20000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_wget_reset_window, 0);
+
+static int net_test_wget_lossy(struct unit_test_state *uts)
+{
+	ulong start, clean_us, lossy_us, size;
+
+	ut_assertok(sb_http_start(uts));
+	start = timer_get_us();
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/c", 0));
+	clean_us = timer_get_us() - start;
+	ut_assertok(sb_http_check_file(uts, 'c', 0x20000));
+
+	/* each lost segment is sent again once, and nothing else is */
+	sb_http.loss = 10;
+	start = timer_get_us();
+	ut_assertok(run_command("wget 0x20000 1.1.2.2:/c", 0));
+	lossy_us = timer_get_us() - start;
+	sandbox_eth_set_tx_handler(0, NULL);
+	ut_assertok(sb_http_check_file(uts, 'c', 0x20000));
+	ut_assert(sb_http.lost > 0);
+	ut_asserteq(sb_http.lost, sb_http.rexmits);
+
+	size = sb_http_file_size('c') / 1024 * 1000000UL;
+	printf("wget: %lu KiB/s, %lu KiB/s losing 1 segment in %u\n",
+	       size / max(clean_us, 1UL), size / max(lossy_us, 1UL),
+	       sb_http.loss);
+
+	return 0;
+}
+
+LIB_TEST(net_test_wget_lossy, 0);
+
+static int net_test_netget(struct unit_test_state *uts)
+{
+	struct net_get files[] = {
+		{ WGET, "1.1.2.2:/a", 0x20000 },
+		{ WGET, "1.1.2.2:/b", 0x30000 },
+	};
+
+	ut_assertok(sb_http_start(uts));
+	ut_assertok(run_command("netget 0x20000 http://1.1.2.2/a "
+				"0x30000 http://1.1.2.2/b "
+				"0x40000 http://1.1.2.2/c", 0));
+	ut_assertok(sb_http_check_data(uts, 'a', 0x20000));
+	ut_assertok(sb_http_check_data(uts, 'b', 0x30000));
+	ut_assertok(sb_http_check_file(uts, 'c', 0x40000));
+
+	/* all the files came over the one connection */
+	ut_asserteq(1, sb_http.syns);
+	ut_asserteq(3, sb_http.requests);
+
+	/* the size of each file is given back */
+	ut_assertok(sb_http_start(uts));
+	memset(map_sysmem(0x20000, 0x20000), '\0', 0x20000);
+	ut_assertok(net_get_files(files, ARRAY_SIZE(files)));
+	sandbox_eth_set_tx_handler(0, NULL);
+	ut_asserteq(sb_http_file_size('a'), files[0].size);
+	ut_asserteq(sb_http_file_size('b'), files[1].size);
+	ut_assertok(sb_http_check_data(uts, 'a', 0x20000));
+	ut_assertok(sb_http_check_data(uts, 'b', 0x30000));
+
+	return 0;
+}
+
+LIB_TEST(net_test_netget, 0);
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit tests for the slab front-end of malloc()
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Number of objects to allocate, enough to need more than one page */
+#define SLAB_TEST_OBJS	200
+
+/* Test that small objects come from the slabs and are reused */
+static int common_test_malloc_slab(struct unit_test_state *uts)
+{
+	void *obj[SLAB_TEST_OBJS];
+	ulong start = ut_check_free();
+	size_t in_use = malloc_slab_in_use();
+	u8 *ptr, *other;
+	int i, j;
+
+	/* rounded up to the size class, and aligned */
+	ptr = malloc(40);
+	ut_assertnonnull(ptr);
+	ut_asserteq(48, malloc_slab_usable_size(ptr));
+	ut_asserteq(48, malloc_usable_size(ptr));
+	ut_asserteq(0, (ulong)ptr & 15);
+	ut_asserteq(in_use + 48, malloc_slab_in_use());
+
+	/* a freed object is the next one handed out in its class */
+	free(ptr);
+	ut_asserteq(in_use, malloc_slab_in_use());
+	ut_asserteq_ptr(ptr, malloc(33));
+
+	/* it can shrink in place, but must move to grow */
+	ut_asserteq_ptr(ptr, realloc(ptr, 20));
+	memset(ptr, 0x5a, 48);
+	ptr = realloc(ptr, 1000);
+	ut_assertnonnull(ptr);
+	ut_asserteq(0, malloc_slab_usable_size(ptr));
+	for (i = 0; i < 48 && ptr[i] == 0x5a; i++)
+		;
+	ut_asserteq(48, i);
+	free(ptr);
+
+	/* calloc() clears a reused object */
+	ptr = malloc(100);
+	memset(ptr, 0xff, 128);
+	free(ptr);
+	other = calloc(10, 10);
+	ut_asserteq_ptr(ptr, other);
+	for (i = 0; i < 100 && !other[i]; i++)
+		;
+	ut_asserteq(100, i);
+	free(other);
+	ptr = malloc(48);
+	memset(ptr, 0xff, 48);
+	free(ptr);
+	other = calloc(1, 48);
+	ut_asserteq_ptr(ptr, other);
+	for (i = 0; i < 48 && !other[i]; i++)
+		;
+	ut_asserteq(48, i);
+	free(other);
+
+	/* larger and strongly aligned requests go to dlmalloc */
+	ptr = malloc(1000);
+	ut_assertnonnull(ptr);
+	ut_asserteq(0, malloc_slab_usable_size(ptr));
+	free(ptr);
+	ptr = memalign(64, 32);
+	ut_assertnonnull(ptr);
+	ut_asserteq(0, (ulong)ptr & 63);
+	free(ptr);
+
+	/* fill more than a page of one class, keeping the objects apart */
+	for (i = 0; i < SLAB_TEST_OBJS; i++) {
+		obj[i] = malloc(24);
+		ut_assertnonnull(obj[i]);
+		ut_asserteq(32, malloc_slab_usable_size(obj[i]));
+		memset(obj[i], i, 24);
+	}
+	ut_asserteq(in_use + SLAB_TEST_OBJS * 32, malloc_slab_in_use());
+	for (i = 0; i < SLAB_TEST_OBJS; i++) {
+		ptr = obj[i];
+		for (j = 0; j < 24 && ptr[j] == (u8)i; j++)
+			;
+		ut_asserteq(24, j);
+		free(obj[i]);
+	}
+	ut_asserteq(in_use, malloc_slab_in_use());
+
+	/* malloc_enable_testing() applies to slab objects too */
+	malloc_enable_testing(1);
+	ptr = malloc(16);
+	ut_assertnonnull(ptr);
+	ut_assertnull(malloc(16));
+	malloc_disable_testing();
+	free(ptr);
+
+	ut_assertok(ut_check_delta(start));
+
+	return 0;
+}
+COMMON_TEST(common_test_malloc_slab, 0);
@@ -5,11 +5,14 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
+#include <os.h>
 #include <part.h>
 #include <sandbox_host.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <asm/state.h>
+#include <dm/device-internal.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -334,3 +337,511 @@ static int dm_test_blk_foreach(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_blk_foreach, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLK_READAHEAD) || CONFIG_IS_ENABLED(BLK_WRITEBACK) || \
+	CONFIG_IS_ENABLED(BLK_ASYNC)
+/*
+ * Create a host device of @blocks blocks backed by @fname, with each block
+ * filled with the low byte of its block number
+ */
+static int setup_blk_image(struct unit_test_state *uts, const char *fname,
+			   int blocks, struct udevice **devp,
+			   struct udevice **blkp)
+{
+	char buf[512];
+	int fd, i;
+
+	fd = os_open(fname, OS_O_RDWR | OS_O_CREAT | OS_O_TRUNC);
+	ut_assert(fd >= 0);
+	for (i = 0; i < blocks; i++) {
+		memset(buf, i, 512);
+		ut_asserteq(512, os_write(fd, buf, 512));
+	}
+	os_close(fd);
+
+	ut_assertok(host_create_device("test", true, devp));
+	ut_assertok(host_attach_file(*devp, fname));
+	ut_assertok(blk_get_from_parent(*devp, blkp));
+	ut_assertok(device_probe(*blkp));
+
+	return 0;
+}
+#endif
+
+#if CONFIG_IS_ENABLED(BLK_READAHEAD)
+/* Test that sequential reads are widened to the read-ahead window */
+static int dm_test_blk_readahead(struct unit_test_state *uts)
+{
+	static const char fname[] = "blk_readahead.img";
+	struct udevice *dev, *blk;
+	struct host_sb_plat *plat;
+	struct blk_desc *desc;
+	char buf[512 * 4];
+	int i;
+
+	ut_assertok(setup_blk_image(uts, fname, 256, &dev, &blk));
+	ut_assertok(blk_set_readahead(blk, 16));
+	desc = dev_get_uclass_plat(blk);
+	ut_assertok(blkcache_set_policy(desc->uclass_id, desc->devnum, 0));
+	plat = dev_get_plat(dev);
+	plat->read_count = 0;
+
+	/*
+	 * The first read goes to the file and the second starts the window,
+	 * so 64 single-block reads need only five reads of the file
+	 */
+	for (i = 0; i < 64; i++) {
+		ut_asserteq(1, blk_read(blk, i, 1, buf));
+		ut_asserteq(i, buf[0]);
+		ut_asserteq(i, buf[511]);
+	}
+	ut_asserteq(5, plat->read_count);
+
+	/* A read running past the end of the window is served partly from it */
+	ut_asserteq(4, blk_read(blk, 62, 4, buf));
+	ut_asserteq(62, buf[0]);
+	ut_asserteq(65, buf[512 * 3]);
+	ut_asserteq(6, plat->read_count);
+
+	/* Random reads go straight to the file */
+	plat->read_count = 0;
+	ut_asserteq(1, blk_read(blk, 200, 1, buf));
+	ut_asserteq((char)200, buf[0]);
+	ut_asserteq(1, blk_read(blk, 100, 1, buf));
+	ut_asserteq(1, blk_read(blk, 150, 1, buf));
+	ut_asserteq(3, plat->read_count);
+
+	/* Writes discard the window */
+	ut_asserteq(1, blk_read(blk, 151, 1, buf));
+	ut_asserteq(1, blk_read(blk, 152, 1, buf));
+	memset(buf, 0x55, 512);
+	ut_asserteq(1, blk_write(blk, 153, 1, buf));
+	ut_asserteq(1, blk_read(blk, 153, 1, buf));
+	ut_asserteq(0x55, buf[0]);
+
+	/* With read-ahead disabled, each read goes to the file */
+	ut_assertok(blk_set_readahead(blk, 0));
+	plat->read_count = 0;
+	for (i = 0; i < 8; i++)
+		ut_asserteq(1, blk_read(blk, i + 160, 1, buf));
+	ut_asserteq(8, plat->read_count);
+
+	ut_assertok(blkcache_set_policy(desc->uclass_id, desc->devnum,
+					BLKCACHE_DEFAULT));
+	ut_assertok(host_detach_file(dev));
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(0, os_unlink(fname));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_readahead, 0);
+#endif
+
+#if CONFIG_IS_ENABLED(BLK_WRITEBACK)
+/* Check that block @blk of file @fname is filled with @val */
+static int check_file_block(struct unit_test_state *uts, const char *fname,
+			    int blk, char val)
+{
+	char buf[512];
+	int fd;
+
+	fd = os_open(fname, OS_O_RDONLY);
+	ut_assert(fd >= 0);
+	ut_assert(os_lseek(fd, blk * 512, OS_SEEK_SET) != -1);
+	ut_asserteq(512, os_read(fd, buf, 512));
+	os_close(fd);
+	ut_asserteq(val, buf[0]);
+	ut_asserteq(val, buf[511]);
+
+	return 0;
+}
+
+/* Test holding back and merging writes */
+static int dm_test_blk_writeback(struct unit_test_state *uts)
+{
+	static const char fname[] = "blk_writeback.img";
+	int big_blocks = (CONFIG_BLK_WRITEBACK_SIZE << 10) / 512 + 1;
+	struct udevice *dev, *blk;
+	struct host_sb_plat *plat;
+	char buf[512 * 4], *big;
+
+	/* leave room for the large write at block 13 */
+	ut_assertok(setup_blk_image(uts, fname, 16 + big_blocks, &dev, &blk));
+	ut_assertok(blk_set_writeback(blk, true));
+	plat = dev_get_plat(dev);
+	plat->write_count = 0;
+
+	/* Repeated and adjacent writes are held back */
+	memset(buf, 0xa1, 512);
+	ut_asserteq(1, blk_write(blk, 11, 1, buf));
+	memset(buf, 0xa0, 512);
+	ut_asserteq(1, blk_write(blk, 10, 1, buf));
+	memset(buf, 0xa2, 1024);
+	ut_asserteq(2, blk_write(blk, 12, 2, buf));
+	memset(buf, 0xb1, 1024);
+	ut_asserteq(2, blk_write(blk, 11, 2, buf));
+	memset(buf, 0xc0, 512);
+	ut_asserteq(1, blk_write(blk, 20, 1, buf));
+	ut_asserteq(0, plat->write_count);
+	ut_assertok(check_file_block(uts, fname, 11, 11));
+
+	/* Reads see the data held back */
+	ut_asserteq(4, blk_read(blk, 9, 4, buf));
+	ut_asserteq(9, buf[0]);
+	ut_asserteq((char)0xa0, buf[512]);
+	ut_asserteq((char)0xb1, buf[1024]);
+	ut_asserteq((char)0xb1, buf[1536]);
+
+	/* A large write goes to the device, replacing older data */
+	big = malloc(big_blocks * 512);
+	ut_assertnonnull(big);
+	memset(big, 0xd0, big_blocks * 512);
+	ut_asserteq(big_blocks, blk_write(blk, 13, big_blocks, big));
+	free(big);
+	ut_asserteq(1, plat->write_count);
+	ut_asserteq(1, blk_read(blk, 13, 1, buf));
+	ut_asserteq((char)0xd0, buf[0]);
+	ut_asserteq(1, blk_read(blk, 20, 1, buf));
+	ut_asserteq((char)0xd0, buf[0]);
+
+	/* Flushing writes the merged run 10..12 in one go */
+	ut_assertok(blk_set_writeback(blk, false));
+	ut_asserteq(2, plat->write_count);
+	ut_assertok(check_file_block(uts, fname, 10, 0xa0));
+	ut_assertok(check_file_block(uts, fname, 11, 0xb1));
+	ut_assertok(check_file_block(uts, fname, 12, 0xb1));
+	ut_assertok(check_file_block(uts, fname, 13, 0xd0));
+	ut_assertok(check_file_block(uts, fname, 20, 0xd0));
+
+	/* Without write-back, writes go straight to the device */
+	memset(buf, 0xe0, 512);
+	ut_asserteq(1, blk_write(blk, 30, 1, buf));
+	ut_asserteq(3, plat->write_count);
+
+	/* Removing the device flushes it */
+	ut_assertok(blk_set_writeback(blk, true));
+	ut_asserteq(1, blk_write(blk, 31, 1, buf));
+	ut_asserteq(3, plat->write_count);
+	ut_assertok(device_remove(blk, DM_REMOVE_NORMAL));
+	ut_asserteq(4, plat->write_count);
+	ut_assertok(check_file_block(uts, fname, 31, 0xe0));
+
+	ut_assertok(host_detach_file(dev));
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(0, os_unlink(fname));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_writeback, 0);
+#endif
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+/**
+ * struct blk_async_state - Completions seen by blk_async_complete()
+ *
+ * @count: Number of requests completed
+ * @last: Request completed last
+ * @next: Request to submit on the first completion, or NULL
+ */
+struct blk_async_state {
+	int count;
+	struct blk_request *last;
+	struct blk_request *next;
+};
+
+static void blk_async_complete(struct blk_request *req)
+{
+	struct blk_async_state *state = req->priv;
+
+	if (state->next && !state->count)
+		blk_submit(req->dev, state->next);
+	state->count++;
+	state->last = req;
+}
+
+/* Submit @count reads of two blocks, ten blocks apart */
+static int blk_async_submit(struct unit_test_state *uts, struct udevice *blk,
+			    struct blk_request *req, int count, char *buf,
+			    struct blk_async_state *state)
+{
+	int i;
+
+	memset(state, '\0', sizeof(*state));
+	memset(req, '\0', count * sizeof(*req));
+	for (i = 0; i < count; i++) {
+		req[i].start = i * 10;
+		req[i].blkcnt = 2;
+		req[i].buffer = buf + i * 1024;
+		req[i].complete = blk_async_complete;
+		req[i].priv = state;
+		ut_assertok(blk_submit(blk, &req[i]));
+	}
+
+	return 0;
+}
+
+/* Test asynchronous reads and writes */
+static int dm_test_blk_async(struct unit_test_state *uts)
+{
+	static const char fname[] = "blk_async.img";
+	struct blk_request req[6], more;
+	struct blk_async_state state;
+	struct udevice *dev, *blk;
+	struct host_sb_plat *plat;
+	char buf[6 * 1024];
+	int i;
+
+	ut_assertok(setup_blk_image(uts, fname, 256, &dev, &blk));
+	plat = dev_get_plat(dev);
+	plat->read_count = 0;
+
+	/* Nothing is read until the device is polled */
+	ut_assertok(blk_async_submit(uts, blk, req, 6, buf, &state));
+	ut_asserteq(0, plat->read_count);
+	ut_asserteq(false, req[0].done);
+
+	/* The emulated device finishes one request each time it is polled */
+	ut_asserteq(1, blk_poll(blk));
+	ut_asserteq(1, state.count);
+	ut_asserteq_ptr(&req[0], state.last);
+	ut_asserteq(true, req[0].done);
+	ut_asserteq(2, req[0].result);
+	ut_asserteq(false, req[1].done);
+	ut_asserteq(2, blk_wait(blk, &req[2]));
+	ut_asserteq(3, state.count);
+	ut_assertok(blk_wait_all(blk));
+	ut_asserteq(6, state.count);
+	ut_asserteq(6, plat->read_count);
+	for (i = 0; i < 6; i++) {
+		ut_asserteq(2, req[i].result);
+		ut_asserteq(i * 10, buf[i * 1024]);
+		ut_asserteq(i * 10 + 1, buf[i * 1024 + 512]);
+	}
+
+	/* Requests the device cannot take yet wait in the uclass */
+	ut_assertok(blk_set_queue_depth(blk, 8));
+	ut_asserteq(-EINVAL, blk_set_queue_depth(blk, 0));
+	memset(buf, '\0', sizeof(buf));
+	ut_assertok(blk_async_submit(uts, blk, req, 6, buf, &state));
+	ut_assertok(blk_wait_all(blk));
+	ut_asserteq(6, state.count);
+	ut_asserteq(50, buf[5 * 1024]);
+
+	/* A completion function can submit another request */
+	memset(&more, '\0', sizeof(more));
+	more.start = 100;
+	more.blkcnt = 1;
+	more.buffer = buf;
+	ut_assertok(blk_async_submit(uts, blk, req, 1, buf + 1024, &state));
+	state.next = &more;
+	ut_asserteq(2, blk_wait(blk, &req[0]));
+	ut_asserteq(1, blk_wait(blk, &more));
+	ut_asserteq(100, buf[0]);
+
+	/* A write replaces cached data */
+	ut_asserteq(1, blk_read(blk, 40, 1, buf));
+	memset(buf, 0x77, 512);
+	memset(&more, '\0', sizeof(more));
+	more.start = 40;
+	more.blkcnt = 1;
+	more.buffer = buf;
+	more.write = true;
+	ut_assertok(blk_submit(blk, &more));
+	ut_asserteq(1, blk_wait(blk, &more));
+	ut_asserteq(1, blk_read(blk, 40, 1, buf + 1024));
+	ut_asserteq(0x77, buf[1024]);
+
+	/* A synchronous read waits for outstanding requests */
+	more.write = false;
+	ut_assertok(blk_submit(blk, &more));
+	ut_asserteq(1, blk_read(blk, 41, 1, buf + 1024));
+	ut_asserteq(true, more.done);
+	ut_asserteq(41, buf[1024]);
+
+	/* Reads see data held back by write-back */
+	if (CONFIG_IS_ENABLED(BLK_WRITEBACK)) {
+		ut_assertok(blk_set_writeback(blk, true));
+		memset(buf + 1024, 0x88, 512);
+		ut_asserteq(1, blk_write(blk, 50, 1, buf + 1024));
+		more.start = 50;
+		ut_assertok(blk_submit(blk, &more));
+		ut_asserteq(1, blk_wait(blk, &more));
+		ut_asserteq((char)0x88, buf[0]);
+		ut_assertok(blk_set_writeback(blk, false));
+	}
+
+	/* Failures are reported, here a read past the end of the file */
+	more.start = 300;
+	ut_assertok(blk_submit(blk, &more));
+	ut_asserteq(-EIO, blk_wait_all(blk));
+	ut_asserteq(0, more.result);
+
+	/* Requests which never finish time out, those not started too */
+	plat->poll_stall = true;
+	more.start = 60;
+	ut_assertok(blk_submit(blk, &more));
+	ut_asserteq(-ETIMEDOUT, blk_wait(blk, &more));
+	ut_assertok(blk_async_submit(uts, blk, req, 6, buf, &state));
+	ut_asserteq(-ETIMEDOUT, blk_wait_all(blk));
+	ut_asserteq(6, state.count);
+	ut_asserteq(-ETIMEDOUT, req[0].result);
+	ut_asserteq(-ETIMEDOUT, req[5].result);
+
+	/* The device finishing them later on is ignored */
+	plat->poll_stall = false;
+	plat->read_count = 0;
+	ut_assertok(blk_submit(blk, &more));
+	ut_asserteq(1, blk_wait(blk, &more));
+	ut_asserteq(5, plat->read_count);
+	ut_asserteq(-ETIMEDOUT, req[0].result);
+
+	/* A failed poll fails the requests in flight, but not the others */
+	ut_assertok(blk_async_submit(uts, blk, req, 6, buf, &state));
+	plat->poll_err = -EPROTO;
+	ut_asserteq(4, blk_poll(blk));
+	for (i = 0; i < 4; i++)
+		ut_asserteq(-EPROTO, req[i].result);
+	ut_asserteq(false, req[4].done);
+	ut_assertok(blk_wait_all(blk));
+	ut_asserteq(2, req[4].result);
+	ut_asserteq(2, req[5].result);
+
+	ut_assertok(host_detach_file(dev));
+	ut_assertok(device_unbind(dev));
+	ut_asserteq(0, os_unlink(fname));
+
+	return 0;
+}
+DM_TEST(dm_test_blk_async, 0);
+#endif
+
+#if CONFIG_IS_ENABLED(BLOCK_CACHE)
+/* Test the block cache */
+static int dm_test_blk_cache(struct unit_test_state *uts)
+{
+	struct block_cache_stats stats;
+	char in[9 * 512], out[sizeof(in)];
+	int i;
+
+	for (i = 0; i < sizeof(in); i++)
+		in[i] = i * 3;
+
+	blkcache_configure(8, 4 * 8 * 512);
+	blkcache_stats(&stats);
+
+	/* Fill blocks 6..9, which straddles two segments */
+	blkcache_fill(UCLASS_HOST, 0, 6, 4, 512, in);
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.entries);
+	ut_asserteq(2 * 8 * 512, stats.bytes);
+
+	/* Reads of any sub-range are hits */
+	ut_asserteq(4, blkcache_read(UCLASS_HOST, 0, 6, 4, 512, out));
+	ut_asserteq_mem(in, out, 4 * 512);
+	ut_asserteq(2, blkcache_read(UCLASS_HOST, 0, 7, 2, 512, out));
+	ut_asserteq_mem(in + 512, out, 2 * 512);
+
+	/* A read running past the end returns the cached prefix */
+	ut_asserteq(2, blkcache_read(UCLASS_HOST, 0, 8, 4, 512, out));
+	ut_asserteq_mem(in + 2 * 512, out, 2 * 512);
+
+	/* Other devices and block sizes do not match */
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 1, 6, 4, 512, out));
+	ut_asserteq(0, blkcache_read(UCLASS_MMC, 0, 6, 4, 512, out));
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 6, 1, 1024, out));
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 5, 1, 512, out));
+
+	blkcache_stats(&stats);
+	ut_asserteq(2, stats.hits);
+	ut_asserteq(1, stats.partial_hits);
+	ut_asserteq(4, stats.misses);
+
+	/* Large reads are not cached */
+	blkcache_fill(UCLASS_HOST, 0, 100, 9, 512, in);
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 100, 1, 512, out));
+
+	/* Filling more than the budget evicts the least recently used */
+	blkcache_fill(UCLASS_HOST, 0, 16, 1, 512, in);
+	blkcache_fill(UCLASS_HOST, 0, 24, 1, 512, in);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 6, 1, 512, out));
+	blkcache_fill(UCLASS_HOST, 0, 32, 1, 512, in);
+	blkcache_stats(&stats);
+	ut_asserteq(4, stats.entries);
+	ut_asserteq(1, stats.evictions);
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 8, 1, 512, out));
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 6, 1, 512, out));
+
+	/* A device can have its own policy */
+	ut_assertok(blkcache_set_policy(UCLASS_HOST, 0, 0));
+	ut_asserteq(0, blkcache_get_policy(UCLASS_HOST, 0));
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 6, 1, 512, out));
+	blkcache_fill(UCLASS_HOST, 0, 6, 1, 512, in);
+	ut_asserteq(0, blkcache_read(UCLASS_HOST, 0, 6, 1, 512, out));
+	blkcache_fill(UCLASS_HOST, 1, 6, 1, 512, in);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 1, 6, 1, 512, out));
+
+	ut_assertok(blkcache_set_policy(UCLASS_HOST, 0, 16));
+	blkcache_fill(UCLASS_HOST, 0, 100, 9, 512, in);
+	ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, 100, 1, 512, out));
+	ut_assertok(blkcache_set_policy(UCLASS_HOST, 0, BLKCACHE_DEFAULT));
+	ut_asserteq(BLKCACHE_DEFAULT, blkcache_get_policy(UCLASS_HOST, 0));
+
+	/* Many cached blocks can all be found */
+	blkcache_configure(8, 4096 * 8 * 512);
+	blkcache_invalidate(-1, 0);
+	for (i = 0; i < 4096; i++)
+		blkcache_fill(UCLASS_HOST, 0, i, 1, 512, in);
+	blkcache_stats(&stats);
+	ut_asserteq(4096 / 8, stats.entries);
+	for (i = 0; i < 4096; i += 7)
+		ut_asserteq(1, blkcache_read(UCLASS_HOST, 0, i, 1, 512, out));
+	ut_asserteq_mem(in, out, 512);
+
+	blkcache_configure(8, CONFIG_BLOCK_CACHE_SIZE << 10);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache, 0);
+
+/* Time @count lookups spread over @entries cached blocks, best of three */
+static ulong blkcache_time_lookups(int entries, int count)
+{
+	ulong best = ULONG_MAX, start;
+	char buf[512];
+	int i, run;
+
+	blkcache_invalidate(-1, 0);
+	for (i = 0; i < entries; i++)
+		blkcache_fill(UCLASS_HOST, 0, i, 1, sizeof(buf), buf);
+
+	for (run = 0; run < 3; run++) {
+		start = timer_get_us();
+		for (i = 0; i < count; i++)
+			blkcache_read(UCLASS_HOST, 0, (i * 7) % entries, 1,
+				      sizeof(buf), buf);
+		best = min(best, timer_get_us() - start);
+	}
+
+	return best;
+}
+
+/* Benchmark cache lookups, which take about as long with many blocks cached */
+static int dm_test_blk_cache_bench(struct unit_test_state *uts)
+{
+	ulong small, large;
+
+	blkcache_configure(8, 4096 * 8 * 512);
+	small = blkcache_time_lookups(32, 100000);
+	large = blkcache_time_lookups(4096, 100000);
+	blkcache_invalidate(-1, 0);
+	blkcache_configure(8, CONFIG_BLOCK_CACHE_SIZE << 10);
+	printf("blkcache: 100000 lookups in %lu us with 32 blocks cached, %lu us with 4096\n",
+	       small, large);
+
+	/* searching the blocks one by one would take 100 times as long */
+	ut_assert(large < small * 4);
+
+	return 0;
+}
+DM_TEST(dm_test_blk_cache_bench, 0);
+#endif
@@ -11,8 +11,10 @@
 #include <fdtdec.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <asm/global_data.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -1353,3 +1355,165 @@ static int dm_test_dev_get_mem(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_dev_get_mem, UT_TESTF_SCAN_FDT);
+
+/* Test that looking up a compatible string finds the first driver listing it */
+static int dm_test_lookup_compat(struct unit_test_state *uts)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *id, *found_id, *first_id;
+	struct driver *entry, *first;
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	struct driver_compat *index, *pre_reloc_index;
+	struct driver *found;
+	ulong malloc_ptr;
+#endif
+	int checked = 0;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (id = entry->of_match; id && id->compatible; id++) {
+			/* find the first match the slow way */
+			for (first = driver; ; first++) {
+				for (first_id = first->of_match;
+				     first_id && first_id->compatible;
+				     first_id++) {
+					if (!strcmp(first_id->compatible,
+						    id->compatible))
+						break;
+				}
+				if (first_id && first_id->compatible)
+					break;
+			}
+
+			found_id = NULL;
+			ut_asserteq_ptr(first,
+					lists_driver_lookup_compat(id->compatible,
+								   &found_id));
+			ut_asserteq_ptr(first_id, found_id);
+			checked++;
+		}
+	}
+	ut_assert(checked > 100);
+
+	ut_assertnull(lists_driver_lookup_compat("sandbox,no-such-driver",
+						 &found_id));
+	ut_assertnull(lists_driver_lookup_compat("", &found_id));
+	ut_assertnull(lists_driver_lookup_compat("zzzz", &found_id));
+
+#if CONFIG_IS_ENABLED(DM_COMPAT_INDEX)
+	/* before relocation the index is built in the pre-relocation area */
+	ut_assertnonnull(gd->dm_compat);
+	index = gd->dm_compat;
+	malloc_ptr = gd->malloc_ptr;
+	gd->dm_compat = NULL;
+	gd->flags &= ~GD_FLG_FULL_MALLOC_INIT;
+	found = lists_driver_lookup_compat("denx,u-boot-probe-test", &found_id);
+	gd->flags |= GD_FLG_FULL_MALLOC_INIT;
+	pre_reloc_index = gd->dm_compat;
+	gd->dm_compat = index;
+	gd->malloc_ptr = malloc_ptr;
+	ut_assertnonnull(pre_reloc_index);
+	ut_asserteq_ptr(map_sysmem(gd->malloc_base + malloc_ptr, 0),
+			pre_reloc_index);
+	ut_assertnonnull(found);
+	ut_asserteq_str("denx,u-boot-probe-test", found_id->compatible);
+#endif
+
+	return 0;
+}
+DM_TEST(dm_test_lookup_compat, 0);
+
+/* Test that indexed lookups find the same devices as walking the uclasses */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct udevice *dev, *first, *found;
+	struct uclass *uc;
+	int checked = 0;
+
+	list_for_each_entry(uc, gd->uclass_root, sibling_node) {
+		enum uclass_id id = uc->uc_drv->id;
+
+		ut_asserteq_ptr(uc, uclass_find(id));
+		uclass_foreach_dev(dev, uc) {
+			int seq = dev_seq(dev);
+			ofnode node = dev_ofnode(dev);
+
+			if (seq != -1) {
+				uclass_foreach_dev(first, uc) {
+					if (dev_seq(first) == seq)
+						break;
+				}
+				ut_assertok(uclass_find_device_by_seq(id, seq,
+								      &found));
+				ut_asserteq_ptr(first, found);
+				checked++;
+			}
+			if (ofnode_valid(node)) {
+				uclass_foreach_dev(first, uc) {
+					if (ofnode_equal(dev_ofnode(first),
+							 node))
+						break;
+				}
+				ut_assertok(uclass_find_device_by_ofnode(id, node,
+									 &found));
+				ut_asserteq_ptr(first, found);
+				checked++;
+			}
+		}
+	}
+	ut_assert(checked > 100);
+	ut_assertnull(uclass_find(UCLASS_COUNT));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/* Test the number of steps taken by lookups with many devices */
+static int dm_test_uclass_index_steps(struct unit_test_state *uts)
+{
+	struct udevice *dev, *devs[1000];
+	const int count = ARRAY_SIZE(devs);
+	ulong lookups, steps, old_lookups, old_steps;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		ut_assertok(device_bind_driver(gd->dm_root, "test_drv",
+					       "test_index", &devs[i]));
+		ut_asserteq(i, dev_seq(devs[i]));
+	}
+
+	uclass_index_get_stats(&old_lookups, &old_steps);
+	for (i = 0; i < count; i++) {
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, i, &dev));
+		ut_asserteq_ptr(devs[i], dev);
+	}
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST, count,
+						       &dev));
+	uclass_index_get_stats(&lookups, &steps);
+	lookups -= old_lookups;
+	steps -= old_steps;
+
+	/* walking the list would take count / 2 steps on average */
+	ut_asserteq(count + 1, lookups);
+	ut_assert(steps < lookups * 3);
+
+	/* remove every other device, checking the rest can still be found */
+	for (i = 0; i < count; i += 2)
+		ut_assertok(device_unbind(devs[i]));
+	for (i = 0; i < count; i++) {
+		if (i & 1) {
+			ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, i,
+							      &dev));
+			ut_asserteq_ptr(devs[i], dev);
+		} else {
+			ut_asserteq(-ENODEV,
+				    uclass_find_device_by_seq(UCLASS_TEST, i,
+							      &dev));
+		}
+	}
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index_steps, 0);
+#endif
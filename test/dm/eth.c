@@ -14,6 +14,7 @@
 #include <malloc.h>
 #include <net.h>
 #include <net6.h>
+#include <time.h>
 #include <asm/eth.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -24,6 +25,9 @@
 
 #define DM_TEST_ETH_NUM		4
 
+/* Number of packets received by the receive benchmark */
+#define DM_TEST_ETH_RX_PKTS	200000
+
 #if IS_ENABLED(CONFIG_IPV6)
 static int dm_test_string_to_ip6(struct unit_test_state *uts)
 {
@@ -609,6 +613,82 @@ static int dm_test_eth_async_ping_reply(struct unit_test_state *uts)
 
 DM_TEST(dm_test_eth_async_ping_reply, UT_TESTF_SCAN_FDT);
 
+/* Fill the receive queue with frames that nobody listens to */
+static void sb_fill_rx_queue(struct eth_sandbox_priv *priv, const uchar *frame,
+			     int len)
+{
+	int i;
+
+	for (i = 0; i < PKTBUFSRX; i++) {
+		memcpy(priv->recv_packet_buffer[i], frame, len);
+		priv->recv_packet_length[i] = len;
+	}
+	priv->recv_packets = PKTBUFSRX;
+}
+
+static int dm_test_eth_rx_batch(struct unit_test_state *uts)
+{
+	struct eth_sandbox_priv *priv;
+	ulong start, batch_us, one_us;
+	struct ethernet_hdr *eth;
+	const struct eth_ops *ops;
+	struct udevice *dev;
+	uchar frame[64];
+	uchar *packet;
+	int i, j, len;
+
+	env_set("ethact", "eth@10002000");
+	ut_assertok(net_init());
+	ut_assertok(eth_init());
+	dev = eth_get_dev();
+	ut_assertnonnull(dev);
+	priv = dev_get_priv(dev);
+	ops = eth_get_ops(dev);
+	ut_assertnonnull(ops->recv_batch);
+
+	memset(frame, 0, sizeof(frame));
+	eth = (struct ethernet_hdr *)frame;
+	memset(eth->et_dest, 0xff, ARP_HLEN);
+	memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth->et_protlen = htons(0x88b5);
+
+	/* the packets all come out, in batches of what is queued */
+	sb_fill_rx_queue(priv, frame, sizeof(frame));
+	ut_asserteq(PKTBUFSRX, eth_rx());
+	ut_asserteq(0, priv->recv_packets);
+	ut_asserteq(0, eth_rx());
+
+	start = timer_get_us();
+	for (i = 0; i < DM_TEST_ETH_RX_PKTS / PKTBUFSRX; i++) {
+		sb_fill_rx_queue(priv, frame, sizeof(frame));
+		eth_rx();
+	}
+	batch_us = timer_get_us() - start;
+	ut_asserteq(0, priv->recv_packets);
+
+	/* the same, the way eth_rx() does without recv_batch() */
+	start = timer_get_us();
+	for (i = 0; i < DM_TEST_ETH_RX_PKTS / PKTBUFSRX; i++) {
+		sb_fill_rx_queue(priv, frame, sizeof(frame));
+		for (j = 0; j < PKTBUFSRX; j++) {
+			len = ops->recv(dev, ETH_RECV_CHECK_DEVICE, &packet);
+			net_process_received_packet(packet, len);
+			ops->free_pkt(dev, packet, len);
+		}
+	}
+	one_us = timer_get_us() - start;
+	ut_asserteq(0, priv->recv_packets);
+	eth_halt();
+
+	printf("eth rx: %llu packets/s in batches of %d, %llu one at a time\n",
+	       DM_TEST_ETH_RX_PKTS * 1000000ULL / max(batch_us, 1UL),
+	       PKTBUFSRX, DM_TEST_ETH_RX_PKTS * 1000000ULL / max(one_us, 1UL));
+
+	return 0;
+}
+
+DM_TEST(dm_test_eth_rx_batch, UT_TESTF_SCAN_FDT);
+
 #if IS_ENABLED(CONFIG_IPV6_ROUTER_DISCOVERY)
 
 static u8 ip6_ra_buf[] = {0x60, 0xf, 0xc5, 0x4a, 0x0, 0x38, 0x3a, 0xff, 0xfe,
@@ -52,3 +52,39 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(BLK_ASYNC)
+/* Sandbox MMC has no DMA, so requests are carried out while polling */
+static int dm_test_mmc_async(struct unit_test_state *uts)
+{
+	char write[4 * 512], read[4 * 512];
+	struct blk_request req = {};
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	int i;
+
+	ut_assertok(uclass_get_device(UCLASS_MMC, 0, &dev));
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+
+	for (i = 0; i < sizeof(write); i++)
+		write[i] = i * 7;
+	req.start = 8;
+	req.blkcnt = 4;
+	req.buffer = write;
+	req.write = true;
+	ut_assertok(blk_submit(dev_desc->bdev, &req));
+	ut_asserteq(false, req.done);
+	ut_asserteq(1, blk_poll(dev_desc->bdev));
+	ut_asserteq(true, req.done);
+	ut_asserteq(4, req.result);
+
+	req.buffer = read;
+	req.write = false;
+	ut_assertok(blk_submit(dev_desc->bdev, &req));
+	ut_asserteq(4, blk_wait(dev_desc->bdev, &req));
+	ut_asserteq_mem(write, read, sizeof(write));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_async, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
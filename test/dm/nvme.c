@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the NVMe driver, using the sandbox controller emulation
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/root.h>
+#include <dm/test.h>
+#include <asm/test.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of the emulated namespace, in 512-byte blocks */
+#define SB_NVME_BLOCKS		2048
+/* Blocks in the largest command the emulated controller takes */
+#define SB_NVME_CMD_BLOCKS	16
+/* Commands the driver can have outstanding on the I/O queue */
+#define SB_NVME_SLOTS		63
+
+static u8 sb_nvme_byte(uint i)
+{
+	return i * 7 + (i >> 9);
+}
+
+/* Set up the emulated controller, write a pattern to it and check it */
+static int sb_nvme_start(struct unit_test_state *uts, struct udevice **devp,
+			 struct udevice **blkp, u8 **bufp)
+{
+	uint size = SB_NVME_BLOCKS << 9;
+	u8 *buf;
+	uint i;
+
+	sandbox_set_enable_memio(true);
+	ut_assertok(device_bind_driver(dm_root(), "sandbox_nvme", "nvme",
+				       devp));
+	ut_assertok(device_probe(*devp));
+	ut_assertok(device_find_first_child_by_uclass(*devp, UCLASS_BLK,
+						      blkp));
+
+	buf = memalign(ARCH_DMA_MINALIGN, size);
+	ut_assertnonnull(buf);
+	for (i = 0; i < size; i++)
+		buf[i] = sb_nvme_byte(i);
+	ut_asserteq(SB_NVME_BLOCKS, blk_write(*blkp, 0, SB_NVME_BLOCKS, buf));
+	*bufp = buf;
+
+	return 0;
+}
+
+/* Read @blkcnt blocks from the start and check those which are returned */
+static int sb_nvme_check(struct unit_test_state *uts, struct udevice *blk,
+			 u8 *buf, ulong blkcnt, ulong *countp)
+{
+	ulong count;
+	uint i;
+
+	memset(buf, '\0', blkcnt << 9);
+	count = blk_read(blk, 0, blkcnt, buf);
+	for (i = 0; i < count << 9 && buf[i] == sb_nvme_byte(i); i++)
+		;
+	ut_asserteq(count << 9, i);
+	*countp = count;
+
+	return 0;
+}
+
+static int sb_nvme_finish(struct unit_test_state *uts, struct udevice *dev,
+			  u8 *buf)
+{
+	free(buf);
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_assertok(device_unbind(dev));
+	sandbox_set_enable_memio(false);
+
+	return 0;
+}
+
+/*
+ * A transfer larger than the maximum transfer size is split into commands
+ * which fill the I/O queue, and complete in any order
+ */
+static int dm_test_nvme_deep_queue(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	uint max_busy, aborts, resets;
+	ulong count;
+	u8 *buf;
+
+	ut_assertok(sb_nvme_start(uts, &dev, &blk, &buf));
+	ut_assertok(sb_nvme_check(uts, blk, buf, SB_NVME_BLOCKS, &count));
+	ut_asserteq(SB_NVME_BLOCKS, count);
+
+	sandbox_nvme_get_stats(dev, &max_busy, &aborts, &resets);
+	ut_asserteq(SB_NVME_SLOTS, max_busy);
+	ut_asserteq(0, aborts);
+	ut_asserteq(0, resets);
+
+	/* a transfer which is not a multiple of the command size */
+	ut_assertok(sb_nvme_check(uts, blk, buf, SB_NVME_CMD_BLOCKS * 3 + 5,
+				  &count));
+	ut_asserteq(SB_NVME_CMD_BLOCKS * 3 + 5, count);
+
+	return sb_nvme_finish(uts, dev, buf);
+}
+DM_TEST(dm_test_nvme_deep_queue, UT_TESTF_SCAN_FDT);
+
+/*
+ * A command which does not complete is aborted, and its slot is not used
+ * again until the controller reports it done
+ */
+static int dm_test_nvme_abort(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	uint max_busy, aborts, resets;
+	ulong count;
+	u8 *buf;
+
+	ut_assertok(sb_nvme_start(uts, &dev, &blk, &buf));
+
+	/* the controller takes the first batch of commands newest first */
+	sandbox_nvme_set_drop(dev, 1, true);
+	ut_assertok(sb_nvme_check(uts, blk, buf, SB_NVME_BLOCKS, &count));
+	ut_asserteq((SB_NVME_SLOTS - 1) * SB_NVME_CMD_BLOCKS, count);
+
+	sandbox_nvme_get_stats(dev, &max_busy, &aborts, &resets);
+	ut_asserteq(1, aborts);
+	ut_asserteq(0, resets);
+
+	ut_assertok(sb_nvme_check(uts, blk, buf, SB_NVME_BLOCKS, &count));
+	ut_asserteq(SB_NVME_BLOCKS, count);
+
+	return sb_nvme_finish(uts, dev, buf);
+}
+DM_TEST(dm_test_nvme_abort, UT_TESTF_SCAN_FDT);
+
+/*
+ * If a command cannot be aborted the controller is reset, and the commands
+ * outstanding which had not timed out are sent again
+ */
+static int dm_test_nvme_reset(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk;
+	uint max_busy, aborts, resets;
+	ulong count;
+	u8 *buf;
+
+	ut_assertok(sb_nvme_start(uts, &dev, &blk, &buf));
+
+	sandbox_nvme_set_drop(dev, 1, false);
+	ut_assertok(sb_nvme_check(uts, blk, buf, SB_NVME_BLOCKS, &count));
+	ut_asserteq((SB_NVME_SLOTS - 1) * SB_NVME_CMD_BLOCKS, count);
+
+	sandbox_nvme_get_stats(dev, &max_busy, &aborts, &resets);
+	ut_asserteq(0, aborts);
+	ut_asserteq(1, resets);
+
+	ut_assertok(sb_nvme_check(uts, blk, buf, SB_NVME_BLOCKS, &count));
+	ut_asserteq(SB_NVME_BLOCKS, count);
+
+	return sb_nvme_finish(uts, dev, buf);
+}
+DM_TEST(dm_test_nvme_reset, UT_TESTF_SCAN_FDT);
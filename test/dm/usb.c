@@ -6,12 +6,15 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <malloc.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/io.h>
 #include <asm/state.h>
 #include <asm/test.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/root.h>
 #include <dm/test.h>
 #include <dm/uclass-internal.h>
 #include <test/test.h>
@@ -85,6 +88,136 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/*
+ * Swap the normal bus for the one with the UAS sticks, so that they are the
+ * only mass-storage devices, then start USB
+ */
+static int usb_uas_start(struct unit_test_state *uts)
+{
+	struct udevice *bus;
+
+	ut_assertok(uclass_find_device_by_seq(UCLASS_USB, 1, &bus));
+	ut_assertok(device_unbind(bus));
+	ut_assertok(device_bind_driver_to_node(dm_root(), "usb_sandbox",
+					       "usb@0", ofnode_path("/usb@0"),
+					       &bus));
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+
+	return 0;
+}
+
+/* Get the UAS stick @i (0 with streams, 1 without) and its emulator */
+static int usb_uas_get(struct unit_test_state *uts, int i,
+		       struct udevice **devp, struct udevice **blkp,
+		       struct udevice **emulp)
+{
+	char name[20];
+
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, i, devp));
+	ut_assertok(device_find_first_child_by_uclass(*devp, UCLASS_BLK,
+						      blkp));
+	snprintf(name, sizeof(name), "uas-stick@%d", i);
+	ut_assertok(uclass_find_device_by_name(UCLASS_USB_EMUL, name, emulp));
+
+	return 0;
+}
+
+/*
+ * Test UAS flash sticks, with and without bulk streams. A large read needs
+ * several commands, which should all be queued at once.
+ */
+static int dm_test_usb_uas(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk, *emul;
+	struct blk_desc *desc;
+	const int count = 1000;
+	char *buf;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_USB_UAS))
+		return -EAGAIN;
+
+	ut_assertok(usb_uas_start(uts));
+	buf = malloc(count * 512);
+	ut_assertnonnull(buf);
+	for (i = 0; i < 2; i++) {
+		ut_assertok(usb_uas_get(uts, i, &dev, &blk, &emul));
+		desc = dev_get_uclass_plat(blk);
+		ut_asserteq(512, desc->blksz);
+
+		memset(buf, '\0', count * 512);
+		ut_asserteq(count, blk_read(blk, 0, count, buf));
+		ut_asserteq_str("this is a test", buf);
+
+		strcpy(buf, "another test");
+		ut_asserteq(1, blk_write(blk, 1, 1, buf));
+
+		memset(buf, '\0', 1024);
+		ut_asserteq(2, blk_read(blk, 0, 2, buf));
+		ut_asserteq_str("this is a test", buf);
+		ut_asserteq_str("another test", buf + 512);
+
+		memset(buf, '\0', 512);
+		ut_asserteq(1, blk_write(blk, 1, 1, buf));
+
+		/* 1000 blocks need five commands of up to 240 blocks */
+		ut_asserteq(5, sandbox_flash_uas_max_queued(emul));
+		ut_asserteq(0, sandbox_flash_uas_tmfs(emul));
+	}
+	free(buf);
+
+	/* One stream is kept for task management; all go on removal */
+	ut_assertok(usb_uas_get(uts, 0, &dev, &blk, &emul));
+	ut_asserteq(8, sandbox_flash_uas_streams(emul));
+	ut_assertok(device_remove(dev, DM_REMOVE_NORMAL));
+	ut_asserteq(0, sandbox_flash_uas_streams(emul));
+
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_uas, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/*
+ * Test that a UAS transfer error part-way through a queue of commands aborts
+ * the rest on the device, so that they can be sent again
+ */
+static int dm_test_usb_uas_error(struct unit_test_state *uts)
+{
+	struct udevice *dev, *blk, *emul;
+	const int count = 1000;
+	char *buf, *cmp;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_USB_UAS))
+		return -EAGAIN;
+
+	ut_assertok(usb_uas_start(uts));
+	buf = malloc(count * 512);
+	ut_assertnonnull(buf);
+	cmp = malloc(count * 512);
+	ut_assertnonnull(cmp);
+	for (i = 0; i < 2; i++) {
+		ut_assertok(usb_uas_get(uts, i, &dev, &blk, &emul));
+		ut_asserteq(count, blk_read(blk, 0, count, cmp));
+
+		/* fail the data phase of the third of five commands */
+		sandbox_flash_uas_set_fail(emul, 3);
+		memset(buf, '\0', count * 512);
+		ut_asserteq(count, blk_read(blk, 0, count, buf));
+		ut_asserteq_mem(cmp, buf, count * 512);
+		ut_asserteq(1, sandbox_flash_uas_tmfs(emul));
+	}
+	free(cmp);
+	free(buf);
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_uas_error, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
@@ -167,6 +300,36 @@ static int dm_test_usb_stop(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_stop, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/*
+ * Test that two buses are scanned together: each reports what it found only
+ * once the devices on both have been enumerated
+ */
+static int dm_test_usb_scan_buses(struct unit_test_state *uts)
+{
+	struct udevice *bus, *dev;
+	int i;
+
+	ut_assertok(device_bind_driver_to_node(dm_root(), "usb_sandbox",
+					       "usb@0", ofnode_path("/usb@0"),
+					       &bus));
+
+	state_set_skip_delays(true);
+	console_record_reset_enable();
+	ut_assertok(usb_init());
+	ut_assert_nextline("Bus usb@1: Bus usb@0: scanning bus usb@1 for devices... 5 USB Device(s) found");
+	ut_assert_nextline("scanning bus usb@0 for devices... 3 USB Device(s) found");
+	ut_assert_console_end();
+
+	/* three sticks on usb@1 and two on usb@0 */
+	for (i = 0; i < 5; i++)
+		ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, i, &dev));
+	ut_asserteq(-ENODEV, uclass_get_device(UCLASS_MASS_STORAGE, 5, &dev));
+	ut_assertok(usb_stop());
+
+	return 0;
+}
+DM_TEST(dm_test_usb_scan_buses, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /**
  * dm_test_usb_keyb() - test USB keyboard driver
  *
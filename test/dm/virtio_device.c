@@ -133,6 +133,7 @@ static int dm_test_virtio_ring(struct unit_test_state *uts)
 	struct virtqueue *vq;
 	struct virtio_sg sg[2];
 	struct virtio_sg *sgs[2];
+	struct vring_desc table[2];
 	unsigned int len;
 	u8 buffer[2][32];
 
@@ -193,6 +194,46 @@ static int dm_test_virtio_ring(struct unit_test_state *uts)
 	ut_asserteq(6, len);
 	ut_assertok(virtio_del_vqs(dev));
 
+	/* each chain hands back its own buffer, in completion order */
+	ut_assertok(virtio_find_vqs(dev, 1, &vq));
+	ut_assertok(virtqueue_add(vq, &sgs[0], 0, 1));
+	ut_assertok(virtqueue_add(vq, &sgs[1], 0, 1));
+	vq->vring.used->idx = 2;
+	vq->vring.used->ring[0].id = 1;
+	vq->vring.used->ring[0].len = 16;
+	vq->vring.used->ring[1].id = 0;
+	vq->vring.used->ring[1].len = 8;
+	ut_asserteq_ptr(buffer[1], virtqueue_get_buf(vq, &len));
+	ut_asserteq(16, len);
+	ut_asserteq_ptr(buffer[0], virtqueue_get_buf(vq, &len));
+	ut_asserteq(8, len);
+	ut_assertok(virtio_del_vqs(dev));
+
+	/* buffers added through an indirect table take a single descriptor */
+	ut_assertok(virtio_find_vqs(dev, 1, &vq));
+	vq->indirect = true;
+	ut_assertok(virtqueue_add_indirect(vq, sgs, 1, 1, table));
+	ut_asserteq(virtqueue_get_vring_size(vq) - 1, vq->num_free);
+	ut_asserteq(VRING_DESC_F_INDIRECT,
+		    virtio16_to_cpu(dev, vq->vring.desc[0].flags));
+	ut_asserteq(2 * sizeof(table[0]),
+		    virtio32_to_cpu(dev, vq->vring.desc[0].len));
+	ut_asserteq_64((uintptr_t)table,
+		       virtio64_to_cpu(dev, vq->vring.desc[0].addr));
+	ut_asserteq_64((uintptr_t)buffer[0],
+		       virtio64_to_cpu(dev, table[0].addr));
+	ut_asserteq(VRING_DESC_F_NEXT, virtio16_to_cpu(dev, table[0].flags));
+	ut_asserteq(1, virtio16_to_cpu(dev, table[0].next));
+	ut_asserteq(VRING_DESC_F_WRITE, virtio16_to_cpu(dev, table[1].flags));
+	ut_asserteq(sizeof(buffer[1]), virtio32_to_cpu(dev, table[1].len));
+	vq->vring.used->idx = 1;
+	vq->vring.used->ring[0].id = 0;
+	vq->vring.used->ring[0].len = 32;
+	ut_asserteq_ptr(buffer, virtqueue_get_buf(vq, &len));
+	ut_asserteq(32, len);
+	ut_asserteq(virtqueue_get_vring_size(vq), vq->num_free);
+	ut_assertok(virtio_del_vqs(dev));
+
 	return 0;
 }
 DM_TEST(dm_test_virtio_ring, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
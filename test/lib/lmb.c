@@ -697,12 +697,13 @@ static int lib_test_lmb_max_regions(struct unit_test_state *uts)
 	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS);
 	ut_asserteq(lmb.reserved.cnt, 0);
 
-	/*  error for the (CONFIG_LMB_MAX_REGIONS + 1) memory regions */
-	offset = ram + 2 * (CONFIG_LMB_MAX_REGIONS + 1) * ram_size;
+	/*  the (CONFIG_LMB_MAX_REGIONS + 1) memory region grows the table */
+	offset = ram + 2 * CONFIG_LMB_MAX_REGIONS * ram_size;
 	ret = lmb_add(&lmb, offset, ram_size);
-	ut_asserteq(ret, -1);
+	ut_asserteq(ret, 0);
 
-	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS);
+	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS + 1);
+	ut_assert(lmb.memory.max > CONFIG_LMB_MAX_REGIONS);
 	ut_asserteq(lmb.reserved.cnt, 0);
 
 	/*  reserve CONFIG_LMB_MAX_REGIONS regions */
@@ -712,30 +713,119 @@ static int lib_test_lmb_max_regions(struct unit_test_state *uts)
 		ut_asserteq(ret, 0);
 	}
 
-	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS);
+	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS + 1);
 	ut_asserteq(lmb.reserved.cnt, CONFIG_LMB_MAX_REGIONS);
 
-	/*  error for the 9th reserved blocks */
-	offset = ram + 2 * (CONFIG_LMB_MAX_REGIONS + 1) * blk_size;
+	/*  and so does the (CONFIG_LMB_MAX_REGIONS + 1) reserved block */
+	offset = ram + 2 * CONFIG_LMB_MAX_REGIONS * blk_size;
 	ret = lmb_reserve(&lmb, offset, blk_size);
-	ut_asserteq(ret, -1);
+	ut_asserteq(ret, 0);
 
-	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS);
-	ut_asserteq(lmb.reserved.cnt, CONFIG_LMB_MAX_REGIONS);
+	ut_asserteq(lmb.memory.cnt, CONFIG_LMB_MAX_REGIONS + 1);
+	ut_asserteq(lmb.reserved.cnt, CONFIG_LMB_MAX_REGIONS + 1);
+	ut_assert(lmb.reserved.max > CONFIG_LMB_MAX_REGIONS);
 
 	/*  check each regions */
-	for (i = 0; i < CONFIG_LMB_MAX_REGIONS; i++)
+	for (i = 0; i <= CONFIG_LMB_MAX_REGIONS; i++)
 		ut_asserteq(lmb.memory.region[i].base, ram + 2 * i * ram_size);
 
-	for (i = 0; i < CONFIG_LMB_MAX_REGIONS; i++)
+	for (i = 0; i <= CONFIG_LMB_MAX_REGIONS; i++)
 		ut_asserteq(lmb.reserved.region[i].base, ram + 2 * i * blk_size);
 
+	lmb_uninit(&lmb);
+	ut_asserteq(lmb.memory.cnt, 0);
+	ut_asserteq(lmb.memory.max, CONFIG_LMB_MAX_REGIONS);
+	ut_asserteq(lmb.reserved.cnt, 0);
+	ut_asserteq(lmb.reserved.max, CONFIG_LMB_MAX_REGIONS);
+
 	return 0;
 }
-#endif
 
 DM_TEST(lib_test_lmb_max_regions,
 	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+/* Number of blocks reserved by lib_test_lmb_many_regions() */
+#define LMB_TEST_MANY_REGIONS	4096
+
+/* Reserve, fill in and split up again thousands of regions */
+static int lib_test_lmb_many_regions(struct unit_test_state *uts)
+{
+	const phys_addr_t ram = 0x40000000;
+	const phys_size_t ram_size = 0x20000000;
+	const phys_size_t blk_size = 0x1000;
+	const int count = LMB_TEST_MANY_REGIONS;
+	phys_addr_t top = ram + 2 * count * blk_size;
+	struct lmb lmb;
+	long ret;
+	int i, j;
+
+	lmb_init(&lmb);
+
+	ret = lmb_add(&lmb, ram, ram_size);
+	ut_asserteq(ret, 0);
+
+	/* reserve every other block, in an order which jumps about */
+	for (i = 0; i < count; i++) {
+		j = (i * 1237) % count;
+		ret = lmb_reserve(&lmb, ram + 2 * j * blk_size, blk_size);
+		ut_asserteq(ret, 0);
+	}
+	ut_asserteq(lmb.reserved.cnt, count);
+	for (i = 0; i < count; i++) {
+		ut_asserteq(lmb.reserved.region[i].base,
+			    ram + 2 * i * blk_size);
+		ut_asserteq(lmb.reserved.region[i].size, blk_size);
+		ut_asserteq(lmb_is_reserved(&lmb, ram + 2 * i * blk_size), 1);
+		ut_asserteq(lmb_is_reserved(&lmb,
+					    ram + (2 * i + 1) * blk_size), 0);
+	}
+	for (i = 0; i < count - 1; i++) {
+		ut_asserteq(lmb_get_free_size(&lmb,
+					      ram + (2 * i + 1) * blk_size),
+			    blk_size);
+		ut_asserteq(lmb_get_free_size(&lmb, ram + 2 * i * blk_size), 0);
+	}
+
+	/* overlapping reservations are still refused */
+	ret = lmb_reserve(&lmb, ram + 3 * blk_size, 2 * blk_size);
+	ut_asserteq(ret, -1);
+	ret = lmb_reserve(&lmb, top - blk_size - blk_size / 2, blk_size);
+	ut_asserteq(ret, -1);
+	ut_asserteq(lmb.reserved.cnt, count);
+
+	/* no gap below top is big enough */
+	ut_asserteq(__lmb_alloc_base(&lmb, 2 * blk_size, blk_size, top), 0);
+	ut_asserteq(__lmb_alloc_base(&lmb, blk_size, blk_size, top),
+		    top - blk_size);
+
+	/* filling in the gaps leaves a single region */
+	for (i = 0; i < count - 1; i++) {
+		j = (i * 1237) % (count - 1);
+		ut_asserteq(lmb_alloc_addr(&lmb, ram + (2 * j + 1) * blk_size,
+					   blk_size),
+			    ram + (2 * j + 1) * blk_size);
+	}
+	ASSERT_LMB(&lmb, ram, ram_size, 1, ram, top - ram, 0, 0, 0, 0);
+
+	/* and freeing them splits it up again */
+	for (i = 0; i < count; i++) {
+		j = (i * 1237) % count;
+		ret = lmb_free(&lmb, ram + (2 * j + 1) * blk_size, blk_size);
+		ut_asserteq(ret, 0);
+	}
+	ut_asserteq(lmb.reserved.cnt, count);
+	for (i = 0; i < count; i++)
+		ut_asserteq(lmb.reserved.region[i].base,
+			    ram + 2 * i * blk_size);
+
+	lmb_uninit(&lmb);
+
+	return 0;
+}
+
+DM_TEST(lib_test_lmb_many_regions,
+	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
 static int lib_test_lmb_flags(struct unit_test_state *uts)
 {
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Unit test and throughput benchmark for crc32
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <linux/sizes.h>
+#include <time.h>
+#include <test/lib.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+/* Size of the buffer used for the throughput benchmark */
+#define CRC32_BENCH_SIZE	SZ_1M
+
+/* Bit at a time reference, without the ones complement */
+static u32 crc32_bitwise(u32 crc, const u8 *buf, uint len)
+{
+	int k;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (k = 0; k < 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+	}
+
+	return crc;
+}
+
+static int lib_crc32(struct unit_test_state *uts)
+{
+	const char check[] = "123456789";
+	u8 buf[300];
+	uint ofs, len, i;
+
+	ut_asserteq(0xcbf43926, crc32(0, (u8 *)check, strlen(check)));
+	ut_asserteq(0, crc32(0, NULL, 0));
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 37 + (i >> 3);
+
+	/* every alignment and every tail length of the word-wise loops */
+	for (ofs = 0; ofs < 8; ofs++) {
+		for (len = 0; len + ofs <= sizeof(buf); len++) {
+			ut_asserteq(crc32_bitwise(0x12345678, buf + ofs, len),
+				    crc32_no_comp(0x12345678, buf + ofs, len));
+		}
+	}
+
+	/* a CRC can be carried over from one part of the data to the next */
+	for (len = 0; len <= sizeof(buf); len += 13) {
+		ut_asserteq(crc32(0, buf, sizeof(buf)),
+			    crc32(crc32(0, buf, len), buf + len,
+				  sizeof(buf) - len));
+	}
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32, 0);
+
+static int lib_crc32_speed(struct unit_test_state *uts)
+{
+	ulong start, crc_us, ref_us;
+	u32 crc, ref;
+	u8 *buf;
+	int i;
+
+	buf = malloc(CRC32_BENCH_SIZE);
+	ut_assertnonnull(buf);
+	for (i = 0; i < CRC32_BENCH_SIZE; i++)
+		buf[i] = i ^ (i >> 8);
+
+	start = timer_get_us();
+	for (i = 0; i < 16; i++)
+		crc = crc32(0, buf, CRC32_BENCH_SIZE);
+	crc_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	ref = ~crc32_bitwise(~0, buf, CRC32_BENCH_SIZE);
+	ref_us = (timer_get_us() - start) * 16;
+	free(buf);
+
+	ut_asserteq(ref, crc);
+	printf("crc32: %lu MiB/s, bit at a time: %lu MiB/s\n",
+	       16000000 / max(crc_us, 1UL), 16000000 / max(ref_us, 1UL));
+
+	return 0;
+}
+
+LIB_TEST(lib_crc32_speed, 0);
@@ -26,6 +26,7 @@ base_its = '''
                         compression = "%(compression)s";
                         load = <0x40000>;
                         entry = <0x8>;
+                        %(kernel_hash)s
                 };
                 kernel-2 {
                         data = /incbin/("%(loadables1)s");
@@ -280,6 +281,7 @@ def test_fit(u_boot_console):
             'kernel_out' : kernel_out,
             'kernel_addr' : 0x40000,
             'kernel_size' : filesize(kernel),
+            'kernel_hash' : '',
 
             'fdt' : fdt,
             'fdt_out' : fdt_out,
@@ -388,6 +390,30 @@ def test_fit(u_boot_console):
             check_not_equal(ramdisk, ramdisk_out, 'Ramdisk got decompressed?')
             check_equal(ramdisk + '.gz', ramdisk_out, 'Ramdist not loaded')
 
+        # Compressed kernel with a hash, which may be checked while the kernel
+        # is decompressed (CONFIG_FIT_STREAM_VERIFY)
+        with cons.log.section('Compressed kernel with hash'):
+            params['kernel_hash'] = 'hash-1 { algo = "sha256"; };'
+            fit = fit_util.make_fit(cons, mkimage, base_its, params)
+            cons.restart_uboot()
+            output = cons.run_command_list(cmd.splitlines())
+            check_equal(kernel, kernel_out, 'Kernel not loaded')
+            assert 'sha256+ OK' in '\n'.join(output)
+
+        # Break the gzip trailer, which gunzip() does not check, so that only
+        # the hash can catch it
+        with cons.log.section('Compressed kernel with bad hash'):
+            data = bytearray(read_file(fit))
+            gz_data = read_file(params['kernel'])
+            pos = data.find(gz_data)
+            assert pos != -1
+            data[pos + len(gz_data) - 5] ^= 0xff
+            with open(fit, 'wb') as fd:
+                fd.write(data)
+            cons.restart_uboot()
+            output = cons.run_command_list(cmd.splitlines())
+            assert 'Bad Data Hash' in '\n'.join(output)
+
 
     cons = u_boot_console
     try:
@@ -0,0 +1,143 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Test lookups in ext4 directories with a hash tree index (dir_index)
+
+import os
+import pytest
+import shutil
+import subprocess
+
+HTREE_SRC_DIR = 'ext4_htree_src_dir'
+HTREE_NUM_FILES = 5000
+HTREE_HASHES = ['half_md4', 'tea', 'legacy']
+
+def make_htree_src(build_dir):
+    """
+    Makes the directory tree put in the images:
+
+    ext4_htree_src_dir/
+    ├── boot/
+    │   └── vmlinuz
+    └── mods/
+        ├── module_1.ko ... module_5000.ko
+        └── a few names of other lengths
+    """
+    root = os.path.join(build_dir, HTREE_SRC_DIR)
+    mods = os.path.join(root, 'mods')
+    os.makedirs(mods)
+    for i in range(1, HTREE_NUM_FILES + 1):
+        with open(os.path.join(mods, 'module_%d.ko' % i), 'w') as f:
+            f.write('module %d\n' % i)
+    for name in htree_special_names():
+        with open(os.path.join(mods, name), 'w') as f:
+            f.write(name + '\n')
+    os.makedirs(os.path.join(root, 'boot'))
+    with open(os.path.join(root, 'boot', 'vmlinuz'), 'w') as f:
+        f.write('kernel\n')
+    return root
+
+def htree_special_names():
+    """
+    Names which exercise the padding and the multi-block input of the hash
+    functions.
+    """
+    return ['a', 'abcd', 'abcdefghijklmnop',
+            'a_long_name_which_needs_more_than_one_block_of_hash_input.bin']
+
+def make_htree_image(build_dir, src, name, hash_alg):
+    """
+    Makes an ext4 image of src. With hash_alg set, all directories are given
+    a hash tree index using that hash, otherwise dir_index is disabled.
+    """
+    image = os.path.join(build_dir, name)
+    features = '^metadata_csum,^64bit'
+    if not hash_alg:
+        features += ',^dir_index'
+    subprocess.run(['mkfs.ext4', '-q', '-O', features, '-d', src, image,
+                    '64M'], check=True, stdout=subprocess.DEVNULL)
+    if hash_alg:
+        subprocess.run(['tune2fs', '-E', 'hash_alg=' + hash_alg, image],
+                       check=True, stdout=subprocess.DEVNULL)
+        # e2fsck returns 1 after optimising the directories
+        subprocess.run(['e2fsck', '-fyD', image], stdout=subprocess.DEVNULL,
+                       stderr=subprocess.DEVNULL)
+        out = subprocess.run(['debugfs', '-R', 'htree /mods', image],
+                             capture_output=True, text=True)
+        assert 'Root node dump' in out.stdout
+    return image
+
+def htree_lookup(u_boot_console, names):
+    """
+    Looks up each of names in /mods and checks that all are found.
+    """
+    cmd = 'for n in %s; do ext4size host 0 /mods/$n || echo miss $n; done' % (
+        ' '.join(names))
+    out = u_boot_console.run_command(cmd)
+    assert 'miss' not in out
+
+def make_stale_htree_image(build_dir, src):
+    """
+    Makes an image whose directories still have a hash tree index, but with
+    dir_index turned off and a new hash seed, so that the index no longer
+    leads to the names.
+    """
+    image = make_htree_image(build_dir, src, 'ext4_stale.img', 'half_md4')
+    subprocess.run(['tune2fs', '-O', '^dir_index', image], check=True,
+                   stdout=subprocess.DEVNULL)
+    subprocess.run(['debugfs', '-w', '-R', 'ssv hash_seed random', image],
+                   check=True, stdout=subprocess.DEVNULL,
+                   stderr=subprocess.DEVNULL)
+    return image
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ext4')
+@pytest.mark.buildconfigspec('ext4_dir_index')
+@pytest.mark.requiredtool('mkfs.ext4')
+@pytest.mark.requiredtool('tune2fs')
+@pytest.mark.requiredtool('e2fsck')
+@pytest.mark.requiredtool('debugfs')
+def test_ext4_htree(u_boot_console):
+    """
+    Checks that names are found through the hash tree index with each hash
+    version, that missing names are reported, that the same names are found
+    by a linear scan, and that an index left behind with dir_index turned
+    off is not used.
+    """
+    build_dir = u_boot_console.config.build_dir
+    src = os.path.join(build_dir, HTREE_SRC_DIR)
+    images = []
+    names = ['module_%d.ko' % i for i in
+             range(HTREE_NUM_FILES, 0, -HTREE_NUM_FILES // 50)]
+    names += htree_special_names()
+
+    try:
+        make_htree_src(build_dir)
+
+        for hash_alg in HTREE_HASHES:
+            image = make_htree_image(build_dir, src,
+                                     'ext4_htree_%s.img' % hash_alg, hash_alg)
+            images.append(image)
+            u_boot_console.run_command('host bind 0 %s' % image)
+            htree_lookup(u_boot_console, names)
+
+            out = u_boot_console.run_command(
+                'ext4load host 0 $kernel_addr_r /boot/vmlinuz')
+            assert '7 bytes read' in out
+            out = u_boot_console.run_command(
+                'ext4load host 0 $kernel_addr_r /mods/module_0.ko')
+            assert 'Failed to load' in out
+
+        image = make_htree_image(build_dir, src, 'ext4_linear.img', None)
+        images.append(image)
+        u_boot_console.run_command('host bind 0 %s' % image)
+        htree_lookup(u_boot_console, names)
+
+        image = make_stale_htree_image(build_dir, src)
+        images.append(image)
+        u_boot_console.run_command('host bind 0 %s' % image)
+        htree_lookup(u_boot_console, names)
+    finally:
+        u_boot_console.run_command('host unbind 0')
+        shutil.rmtree(src, ignore_errors=True)
+        for image in images:
+            os.remove(image)
@@ -55,6 +55,8 @@ def sqfs_load_files(u_boot_console, files, sizes, address):
     """
     build_dir = u_boot_console.config.build_dir
     for (file, size) in zip(files, sizes):
+        # clear the destination so that a load which copies nothing is caught
+        u_boot_console.run_command('mw.b {} 0 {}'.format(address, hex(int(size))))
         out = u_boot_console.run_command('sqfsload host 0 {} {}'.format(address, file))
 
         # check if the right amount of bytes was read
@@ -78,6 +80,23 @@ def sqfs_load_files_at_root(u_boot_console):
     address = '$kernel_addr_r'
     sqfs_load_files(u_boot_console, files, sizes, address)
 
+def sqfs_load_files_again(u_boot_console):
+    """ Calls sqfs_load_files passing the files at the root again.
+
+    This test checks the reads served from the metadata and fragment caches,
+    which were filled by the first loads of the same files. The files are
+    loaded in the opposite order so that the fragment shared by f5096 and
+    f1000 is looked up first by the other file.
+
+    Args:
+        u_boot_console: provides the means to interact with U-Boot's console.
+    """
+
+    files = ['f1000', 'f5096', 'f4096', 'f1000']
+    sizes = ['1000', '5096', '4096', '1000']
+    address = '$kernel_addr_r'
+    sqfs_load_files(u_boot_console, files, sizes, address)
+
 def sqfs_load_files_at_subdir(u_boot_console):
     """ Calls sqfs_load_files passing the files at the SquashFS image's subdir.
 
@@ -113,6 +132,7 @@ def sqfs_run_all_load_tests(u_boot_console):
         u_boot_console: provides the means to interact with U-Boot's console.
     """
     sqfs_load_files_at_root(u_boot_console)
+    sqfs_load_files_again(u_boot_console)
     sqfs_load_files_at_subdir(u_boot_console)
     sqfs_load_non_existent_file(u_boot_console)
 